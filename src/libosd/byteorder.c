@@ -0,0 +1,151 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "byteorder.h"
+
+#include <assert.h>
+#include <byteswap.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BYTEORDER_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BYTEORDER_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void bswap16_scalar(uint16_t *dst, const uint16_t *src, size_t words)
+{
+    for (size_t w = 0; w < words; w++) {
+        dst[w] = bswap_16(src[w]);
+    }
+}
+
+#ifdef BYTEORDER_HAVE_X86
+__attribute__((target("sse2")))
+static void bswap16_sse2(uint16_t *dst, const uint16_t *src, size_t words)
+{
+    size_t w = 0;
+    for (; w + 8 <= words; w += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + w));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + w), v);
+    }
+    bswap16_scalar(dst + w, src + w, words - w);
+}
+
+__attribute__((target("avx2")))
+static void bswap16_avx2(uint16_t *dst, const uint16_t *src, size_t words)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    size_t w = 0;
+    for (; w + 16 <= words; w += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + w));
+        v = _mm256_shuffle_epi8(v, shuffle);
+        _mm256_storeu_si256((__m256i *)(dst + w), v);
+    }
+    if (w + 8 <= words) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + w));
+        v = _mm_shuffle_epi8(v, _mm256_castsi256_si128(shuffle));
+        _mm_storeu_si128((__m128i *)(dst + w), v);
+        w += 8;
+    }
+    bswap16_scalar(dst + w, src + w, words - w);
+}
+#endif
+
+#ifdef BYTEORDER_HAVE_NEON
+static void bswap16_neon(uint16_t *dst, const uint16_t *src, size_t words)
+{
+    size_t w = 0;
+    for (; w + 8 <= words; w += 8) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(src + w));
+        vst1q_u8((uint8_t *)(dst + w), vrev16q_u8(v));
+    }
+    bswap16_scalar(dst + w, src + w, words - w);
+}
+#endif
+
+/**
+ * All implementations, ordered from the slowest to the fastest one
+ */
+static const struct byteorder_bswap16_impl bswap16_impls_all[] = {
+    { "scalar", bswap16_scalar },
+#ifdef BYTEORDER_HAVE_X86
+    { "sse2", bswap16_sse2 },
+    { "avx2", bswap16_avx2 },
+#endif
+#ifdef BYTEORDER_HAVE_NEON
+    { "neon", bswap16_neon },
+#endif
+};
+
+#define BSWAP16_IMPLS_MAX \
+    (sizeof(bswap16_impls_all) / sizeof(bswap16_impls_all[0]))
+
+static struct {
+    pthread_once_t init_once;
+    struct byteorder_bswap16_impl impls[BSWAP16_IMPLS_MAX];
+    size_t impl_cnt;
+    byteorder_bswap16_fn best;
+} bswap16_sel = {
+    .init_once = PTHREAD_ONCE_INIT,
+};
+
+static bool bswap16_impl_supported(const struct byteorder_bswap16_impl *impl)
+{
+#ifdef BYTEORDER_HAVE_X86
+    __builtin_cpu_init();
+    if (impl->fn == bswap16_sse2) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (impl->fn == bswap16_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return true;
+}
+
+static void bswap16_select(void)
+{
+    for (size_t i = 0; i < BSWAP16_IMPLS_MAX; i++) {
+        if (bswap16_impl_supported(&bswap16_impls_all[i])) {
+            bswap16_sel.impls[bswap16_sel.impl_cnt++] = bswap16_impls_all[i];
+        }
+    }
+    assert(bswap16_sel.impl_cnt > 0);
+    bswap16_sel.best = bswap16_sel.impls[bswap16_sel.impl_cnt - 1].fn;
+}
+
+void byteorder_bswap16(uint16_t *dst, const uint16_t *src, size_t words)
+{
+    pthread_once(&bswap16_sel.init_once, bswap16_select);
+    bswap16_sel.best(dst, src, words);
+}
+
+const struct byteorder_bswap16_impl *byteorder_bswap16_get_impls(
+    size_t *impl_cnt)
+{
+    pthread_once(&bswap16_sel.init_once, bswap16_select);
+    *impl_cnt = bswap16_sel.impl_cnt;
+    return bswap16_sel.impls;
+}
@@ -0,0 +1,104 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BYTEORDER_H
+#define BYTEORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Byte order conversion of 16 bit word arrays
+ *
+ * The debug system transfers data as big endian 16 bit words. The conversion
+ * functions in here are used on the data path between the device and the
+ * host; they use SIMD instructions where available. The best implementation
+ * for the CPU the code is running on is selected at runtime.
+ */
+
+/**
+ * Swap the bytes in each word of an array of 16 bit words
+ *
+ * @param dst destination buffer
+ * @param src source buffer. May be identical to @p dst for an in-place
+ *            conversion, other overlaps are not allowed.
+ * @param words number of words to convert
+ */
+typedef void (*byteorder_bswap16_fn)(uint16_t * /* dst */,
+                                     const uint16_t * /* src */,
+                                     size_t /* words */);
+
+/**
+ * An implementation of the byte swapping function
+ */
+struct byteorder_bswap16_impl {
+    /** Name of the implementation (e.g. the instruction set it uses) */
+    const char *name;
+    /** The byte swapping function */
+    byteorder_bswap16_fn fn;
+};
+
+/**
+ * Swap the bytes in each word of an array of 16 bit words
+ *
+ * This function uses the fastest implementation supported by the CPU.
+ *
+ * @see byteorder_bswap16_fn
+ */
+void byteorder_bswap16(uint16_t *dst, const uint16_t *src, size_t words);
+
+/**
+ * Get all implementations of byteorder_bswap16() supported by the CPU
+ *
+ * This function is mainly useful for testing and benchmarking.
+ *
+ * @param[out] impl_cnt number of returned implementations
+ * @return the supported implementations, ordered from the slowest (the
+ *         scalar implementation) to the fastest one
+ */
+const struct byteorder_bswap16_impl *byteorder_bswap16_get_impls(
+    size_t *impl_cnt);
+
+/**
+ * Convert big endian words to the native byte order
+ *
+ * @see byteorder_bswap16_fn for a description of the parameters
+ */
+static inline void byteorder_be16_to_native(uint16_t *dst, const uint16_t *src,
+                                            size_t words)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    byteorder_bswap16(dst, src, words);
+#else
+    if (dst != src) {
+        memcpy(dst, src, words * sizeof(uint16_t));
+    }
+#endif
+}
+
+/**
+ * Convert words in the native byte order to big endian
+ *
+ * @see byteorder_bswap16_fn for a description of the parameters
+ */
+static inline void byteorder_native_to_be16(uint16_t *dst, const uint16_t *src,
+                                            size_t words)
+{
+    // the conversion is symmetric
+    byteorder_be16_to_native(dst, src, words);
+}
+
+#endif  // BYTEORDER_H
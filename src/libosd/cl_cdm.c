@@ -104,7 +104,8 @@ osd_result osd_cl_cdm_get_desc(struct osd_hostmod_ctx *hostmod_ctx,
     cdm_desc->core_reg_upper = regvalue;
 
     rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, cdm_di_addr,
-                              OSD_REG_CDM_CORE_DATA_WIDTH, 16, 0);
+                              OSD_REG_CDM_CORE_DATA_WIDTH, 16,
+                              OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) return rv;
     cdm_desc->core_data_width = regvalue;
 
@@ -129,14 +129,14 @@ osd_result osd_cl_ctm_get_desc(struct osd_hostmod_ctx *hostmod_ctx,
 
     uint16_t regvalue;
     rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, ctm_di_addr,
-                              OSD_REG_CTM_ADDR_WIDTH, 16, 0);
+                              OSD_REG_CTM_ADDR_WIDTH, 16, OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) return rv;
     assert((regvalue == 16 || regvalue == 32 || regvalue == 64) &&
            "Spec violation: ADDR_WIDTH register has an invalid value.");
     ctm_desc->addr_width_bit = regvalue;
 
     rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, ctm_di_addr,
-                              OSD_REG_CTM_DATA_WIDTH, 16, 0);
+                              OSD_REG_CTM_DATA_WIDTH, 16, OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) return rv;
     assert((regvalue == 16 || regvalue == 32 || regvalue == 64) &&
            "Spec violation: DATA_WIDTH register has an invalid value.");
@@ -169,16 +169,16 @@ static osd_result send_mam_transfer(const struct osd_mem_desc *mem_desc,
         rv = pkg_in_transfer(mem_desc, hostmod_ctx, transfer, transfer_size, i,
                              &pkg);
         if (OSD_FAILED(rv)) {
-            free(pkg);
+            osd_packet_free(&pkg);
             return rv;
         }
 
         rv = osd_hostmod_event_send(hostmod_ctx, pkg);
         if (OSD_FAILED(rv)) {
-            free(pkg);
+            osd_packet_free(&pkg);
             return rv;
         }
-        free(pkg);
+        osd_packet_free(&pkg);
     }
 
     return OSD_OK;
@@ -218,7 +218,7 @@ static osd_result mam_write(const struct osd_mem_desc *mem_desc,
         struct osd_packet *rx_pkg = NULL;
         rv = osd_hostmod_event_receive(hostmod_ctx, &rx_pkg,
                                        OSD_HOSTMOD_BLOCKING);
-        free(rx_pkg);
+        osd_packet_free(&rx_pkg);
         if (OSD_FAILED(rv)) {
             retval = rv;
             goto free_return;
@@ -422,7 +422,7 @@ static osd_result mam_read(const struct osd_mem_desc *mem_desc,
             rx_nbyte += 2;
         }
 
-        free(rx_pkg);
+        osd_packet_free(&rx_pkg);
     } while (rx_nbyte < nbyte);
 
     return rv;
@@ -593,21 +593,23 @@ osd_result osd_cl_mam_get_mem_desc(struct osd_hostmod_ctx *hostmod_ctx,
 
     mem_desc->di_addr = mam_di_addr;
 
-    uint16_t regvalue;
-    rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, mam_di_addr,
-                              OSD_REG_MAM_AW, 16, 0);
+    uint16_t aw, dw, num_regions;
+    struct osd_hostmod_reg_op info_ops[] = {
+        { .type = OSD_HOSTMOD_REG_OP_READ, .diaddr = mam_di_addr,
+          .reg_addr = OSD_REG_MAM_AW, .reg_size_bit = 16, .reg_val = &aw },
+        { .type = OSD_HOSTMOD_REG_OP_READ, .diaddr = mam_di_addr,
+          .reg_addr = OSD_REG_MAM_DW, .reg_size_bit = 16, .reg_val = &dw },
+        { .type = OSD_HOSTMOD_REG_OP_READ, .diaddr = mam_di_addr,
+          .reg_addr = OSD_REG_MAM_REGIONS, .reg_size_bit = 16,
+          .reg_val = &num_regions },
+    };
+    rv = osd_hostmod_reg_batch(hostmod_ctx, info_ops,
+                               sizeof(info_ops) / sizeof(info_ops[0]),
+                               OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) return rv;
-    mem_desc->addr_width_bit = regvalue;
-
-    rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, mam_di_addr,
-                              OSD_REG_MAM_DW, 16, 0);
-    if (OSD_FAILED(rv)) return rv;
-    mem_desc->data_width_bit = regvalue;
-
-    rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, mam_di_addr,
-                              OSD_REG_MAM_REGIONS, 16, 0);
-    if (OSD_FAILED(rv)) return rv;
-    mem_desc->num_regions = regvalue;
+    mem_desc->addr_width_bit = aw;
+    mem_desc->data_width_bit = dw;
+    mem_desc->num_regions = num_regions;
 
     assert(mem_desc->num_regions <= 8);
 
@@ -617,31 +619,43 @@ osd_result osd_cl_mam_get_mem_desc(struct osd_hostmod_ctx *hostmod_ctx,
         mem_desc->regions[i].memsize = 0;
     }
 
+    // read base address and size of all regions at once: 4 words each
+    uint16_t baseaddr_words[8][4];
+    uint16_t memsize_words[8][4];
+    struct osd_hostmod_reg_op region_ops[8 * 8];
+    size_t op_cnt = 0;
     for (int region = 0; region < mem_desc->num_regions; region++) {
-        uint64_t baseaddr = 0;
         for (int w = 0; w < 4; w++) {
-            rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, mam_di_addr,
-                                      OSD_REG_MAM_REGION_BASEADDR(region, w),
-                                      16, 0);
-            if (OSD_FAILED(rv)) return rv;
-            uint8_t regvalue_msb = (regvalue >> 8) & 0xFF;
-            uint8_t regvalue_lsb = regvalue & 0xFF;
-            baseaddr |= (uint64_t)regvalue_msb << (w * 16 + 8);
-            baseaddr |= (uint64_t)regvalue_lsb << (w* 16);
+            region_ops[op_cnt++] = (struct osd_hostmod_reg_op){
+                .type = OSD_HOSTMOD_REG_OP_READ,
+                .diaddr = mam_di_addr,
+                .reg_addr = OSD_REG_MAM_REGION_BASEADDR(region, w),
+                .reg_size_bit = 16,
+                .reg_val = &baseaddr_words[region][w],
+            };
         }
-        mem_desc->regions[region].baseaddr = baseaddr;
+        for (int w = 0; w < 4; w++) {
+            region_ops[op_cnt++] = (struct osd_hostmod_reg_op){
+                .type = OSD_HOSTMOD_REG_OP_READ,
+                .diaddr = mam_di_addr,
+                .reg_addr = OSD_REG_MAM_REGION_MEMSIZE(region, w),
+                .reg_size_bit = 16,
+                .reg_val = &memsize_words[region][w],
+            };
+        }
+    }
+    rv = osd_hostmod_reg_batch(hostmod_ctx, region_ops, op_cnt,
+                               OSD_HOSTMOD_CACHED);
+    if (OSD_FAILED(rv)) return rv;
 
+    for (int region = 0; region < mem_desc->num_regions; region++) {
+        uint64_t baseaddr = 0;
         uint64_t memsize = 0;
         for (int w = 0; w < 4; w++) {
-            rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, mam_di_addr,
-                                      OSD_REG_MAM_REGION_MEMSIZE(region, w),
-                                      16, 0);
-            if (OSD_FAILED(rv)) return rv;
-            uint8_t regvalue_msb = (regvalue >> 8) & 0xFF;
-            uint8_t regvalue_lsb = regvalue & 0xFF;
-            memsize |= (uint64_t)regvalue_msb << (w * 16 + 8);
-            memsize |= (uint64_t)regvalue_lsb << (w * 16);
+            baseaddr |= (uint64_t)baseaddr_words[region][w] << (w * 16);
+            memsize |= (uint64_t)memsize_words[region][w] << (w * 16);
         }
+        mem_desc->regions[region].baseaddr = baseaddr;
         mem_desc->regions[region].memsize = memsize;
     }
     return OSD_OK;
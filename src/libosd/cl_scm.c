@@ -49,6 +49,29 @@ osd_result osd_cl_scm_cpus_stop(struct osd_hostmod_ctx *hostmod_ctx,
                                   OSD_HOSTMOD_BLOCKING);
 }
 
+API_EXPORT
+osd_result osd_cl_scm_system_reset(struct osd_hostmod_ctx *hostmod_ctx,
+                                   unsigned int subnet_addr)
+{
+    osd_result rv;
+
+    rv = osd_hostmod_reg_setbit(hostmod_ctx, OSD_REG_SCM_SYSRST_SYS_RST_BIT, 1,
+                                get_scm_diaddr(subnet_addr),
+                                OSD_REG_SCM_SYSRST, 16, OSD_HOSTMOD_BLOCKING);
+    if (OSD_SUCCEEDED(rv)) {
+        rv = osd_hostmod_reg_setbit(hostmod_ctx,
+                                    OSD_REG_SCM_SYSRST_SYS_RST_BIT, 0,
+                                    get_scm_diaddr(subnet_addr),
+                                    OSD_REG_SCM_SYSRST, 16,
+                                    OSD_HOSTMOD_BLOCKING);
+    }
+
+    // cached registers might have changed, even if the reset failed half-way
+    osd_hostmod_reg_cache_invalidate(hostmod_ctx);
+
+    return rv;
+}
+
 /**
  * Read the system information from the device, as stored in the SCM
  */
@@ -63,19 +86,22 @@ osd_result osd_cl_scm_get_subnetinfo(struct osd_hostmod_ctx *hostmod_ctx,
     struct osd_log_ctx* log_ctx = osd_hostmod_log_ctx(hostmod_ctx);
 
     rv = osd_hostmod_reg_read(hostmod_ctx, &subnet_desc->vendor_id, scm_diaddr,
-                              OSD_REG_SCM_SYSTEM_VENDOR_ID, 16, 0);
+                              OSD_REG_SCM_SYSTEM_VENDOR_ID, 16,
+                              OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) {
         err(log_ctx, "Unable to read VENDOR_ID from SCM (rv=%d)", rv);
         return rv;
     }
     rv = osd_hostmod_reg_read(hostmod_ctx, &subnet_desc->device_id, scm_diaddr,
-                                  OSD_REG_SCM_SYSTEM_DEVICE_ID, 16, 0);
+                                  OSD_REG_SCM_SYSTEM_DEVICE_ID, 16,
+                                  OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) {
         err(log_ctx, "Unable to read DEVICE_ID from SCM (rv=%d)", rv);
         return rv;
     }
     rv = osd_hostmod_reg_read(hostmod_ctx, &subnet_desc->max_pkt_len, scm_diaddr,
-                                  OSD_REG_SCM_MAX_PKT_LEN, 16, 0);
+                                  OSD_REG_SCM_MAX_PKT_LEN, 16,
+                                  OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) {
         err(log_ctx, "Unable to read MAX_PKT_LEN from SCM (rv=%d)", rv);
         return rv;
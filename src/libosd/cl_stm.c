@@ -117,7 +117,7 @@ osd_result osd_cl_stm_get_desc(struct osd_hostmod_ctx *hostmod_ctx,
 
     uint16_t regvalue;
     rv = osd_hostmod_reg_read(hostmod_ctx, &regvalue, stm_di_addr,
-                              OSD_REG_STM_VALWIDTH, 16, 0);
+                              OSD_REG_STM_VALWIDTH, 16, OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) return rv;
     assert((regvalue == 16 || regvalue == 32 || regvalue == 64)
            && "Spec violation: VALWIDTH register has an invalid value.");
@@ -145,6 +145,16 @@ osd_result osd_coretracelogger_new(struct osd_coretracelogger_ctx **ctx,
                                    struct osd_log_ctx *log_ctx,
                                    const char *host_controller_address,
                                    uint16_t ctm_di_addr)
+{
+    return osd_coretracelogger_new_with_reactor(
+        ctx, log_ctx, host_controller_address, ctm_di_addr, NULL);
+}
+
+API_EXPORT
+osd_result osd_coretracelogger_new_with_reactor(
+    struct osd_coretracelogger_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address, uint16_t ctm_di_addr,
+    struct osd_ioreactor_ctx *reactor)
 {
     osd_result rv;
 
@@ -158,9 +168,13 @@ osd_result osd_coretracelogger_new(struct osd_coretracelogger_ctx **ctx,
     c->ctm_event_handler.cb_arg = (void*)c;
 
     struct osd_hostmod_ctx *hostmod_ctx;
-    rv = osd_hostmod_new(&hostmod_ctx, log_ctx, host_controller_address,
-                         osd_cl_ctm_handle_event, (void*)&c->ctm_event_handler);
+    rv = osd_hostmod_new_with_reactor(&hostmod_ctx, log_ctx,
+                                      host_controller_address,
+                                      osd_cl_ctm_handle_event,
+                                      (void*)&c->ctm_event_handler, reactor);
     assert(OSD_SUCCEEDED(rv));
+    // all traffic of the logger is exchanged with the subnet of the CTM
+    osd_hostmod_set_target_subnet(hostmod_ctx, osd_diaddr_subnet(ctm_di_addr));
     c->hostmod_ctx = hostmod_ctx;
 
     *ctx = c;
@@ -174,6 +188,13 @@ osd_result osd_coretracelogger_connect(struct osd_coretracelogger_ctx *ctx)
     return osd_hostmod_connect(ctx->hostmod_ctx);
 }
 
+API_EXPORT
+osd_result osd_coretracelogger_set_event_handler_thread(
+    struct osd_coretracelogger_ctx *ctx, bool enable)
+{
+    return osd_hostmod_set_event_handler_thread(ctx->hostmod_ctx, enable);
+}
+
 API_EXPORT
 osd_result osd_coretracelogger_disconnect(struct osd_coretracelogger_ctx *ctx)
 {
@@ -246,6 +267,10 @@ osd_result osd_coretracelogger_stop(struct osd_coretracelogger_ctx *ctx)
     if (rv == OSD_ERROR_TIMEDOUT) {
         rv = OSD_OK;
     }
+
+    // write out all events received until now
+    osd_hostmod_event_handler_flush(ctx->hostmod_ctx);
+
     return rv;
 }
 
@@ -0,0 +1,168 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dtd_parser.h"
+#include "byteorder.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Maximum size of a DTD in bytes: length word + data words
+ */
+#define DTD_MAX_SIZE ((1 + UINT16_MAX) * sizeof(uint16_t))
+
+/**
+ * DTD parser context
+ *
+ * The receive buffer contains (in this order):
+ * - [0, start): consumed data (DTDs returned by dtd_parser_parse())
+ * - [start, conv_end): data converted to native byte order
+ * - [conv_end, end): received data not yet converted (an odd byte at most)
+ * - [end, capacity): free space
+ *
+ * Consumed data is discarded by moving the remaining data to the start of the
+ * buffer. As DTDs are typically much smaller than a chunk, only a few bytes
+ * need to be moved.
+ */
+struct dtd_parser {
+    uint8_t *buf;
+    size_t capacity;
+    size_t chunk_size;
+
+    size_t start;
+    size_t conv_end;
+    size_t end;
+
+    uint64_t invalid_cnt;
+};
+
+void dtd_parser_new(struct dtd_parser **parser_p, size_t chunk_size)
+{
+    assert(chunk_size > 0);
+
+    struct dtd_parser *parser = calloc(1, sizeof(struct dtd_parser));
+    assert(parser);
+
+    // room for a chunk after an incomplete DTD (and an odd byte)
+    parser->chunk_size = chunk_size;
+    parser->capacity = DTD_MAX_SIZE + chunk_size + 1;
+    parser->buf = malloc(parser->capacity);
+    assert(parser->buf);
+
+    *parser_p = parser;
+}
+
+void dtd_parser_free(struct dtd_parser **parser_p)
+{
+    assert(parser_p);
+    struct dtd_parser *parser = *parser_p;
+    if (!parser) {
+        return;
+    }
+
+    free(parser->buf);
+    free(parser);
+    *parser_p = NULL;
+}
+
+void dtd_parser_get_rx_space(struct dtd_parser *parser, uint8_t **buf,
+                             size_t *size)
+{
+    assert(parser);
+
+    if (parser->start > 0) {
+        memmove(parser->buf, parser->buf + parser->start,
+                parser->end - parser->start);
+        parser->conv_end -= parser->start;
+        parser->end -= parser->start;
+        parser->start = 0;
+    }
+
+    *buf = parser->buf + parser->end;
+    *size = parser->capacity - parser->end;
+    if (*size > parser->chunk_size) {
+        *size = parser->chunk_size;
+    }
+}
+
+void dtd_parser_rx_done(struct dtd_parser *parser, size_t size)
+{
+    assert(parser);
+    assert(parser->end + size <= parser->capacity);
+
+    parser->end += size;
+
+    // convert all complete words to native byte order
+    size_t conv_words = (parser->end - parser->conv_end) / sizeof(uint16_t);
+    uint16_t *conv_start = (uint16_t *)(parser->buf + parser->conv_end);
+    byteorder_be16_to_native(conv_start, conv_start, conv_words);
+    parser->conv_end += conv_words * sizeof(uint16_t);
+}
+
+size_t dtd_parser_bytes_missing(const struct dtd_parser *parser)
+{
+    assert(parser);
+
+    size_t avail = parser->end - parser->start;
+    if (avail < sizeof(uint16_t)) {
+        return sizeof(uint16_t) - avail;
+    }
+
+    uint16_t data_size_words = *(uint16_t *)(parser->buf + parser->start);
+    size_t dtd_size = (1 + data_size_words) * sizeof(uint16_t);
+    return dtd_size > avail ? dtd_size - avail : 0;
+}
+
+size_t dtd_parser_parse(struct dtd_parser *parser, struct osd_packet_view *pkgs,
+                        size_t max_pkgs)
+{
+    assert(parser);
+    assert(pkgs);
+
+    size_t pkg_cnt = 0;
+    while (pkg_cnt < max_pkgs) {
+        size_t avail = parser->conv_end - parser->start;
+        if (avail < sizeof(uint16_t)) {
+            break;
+        }
+
+        const uint16_t *dtd = (const uint16_t *)(parser->buf + parser->start);
+        uint16_t data_size_words = dtd[0];
+        size_t dtd_size = (1 + data_size_words) * sizeof(uint16_t);
+        if (dtd_size > avail) {
+            break;
+        }
+        parser->start += dtd_size;
+
+        if (data_size_words < osd_packet_sizeconv_payload2data(0)) {
+            parser->invalid_cnt++;
+            continue;
+        }
+
+        pkgs[pkg_cnt].data_size_words = data_size_words;
+        pkgs[pkg_cnt].data_raw = dtd + 1;
+        pkg_cnt++;
+    }
+
+    return pkg_cnt;
+}
+
+uint64_t dtd_parser_get_invalid_cnt(const struct dtd_parser *parser)
+{
+    assert(parser);
+    return parser->invalid_cnt;
+}
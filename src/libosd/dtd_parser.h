@@ -0,0 +1,121 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DTD_PARSER_H
+#define DTD_PARSER_H
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Parser for a stream of Debug Transport Datagrams (DTDs)
+ *
+ * Devices send DI packets as a stream of DTDs: a length word (the number of
+ * data words in the packet), followed by the packet data words. All words are
+ * big endian.
+ *
+ * The parser owns a receive buffer which the caller fills with data read from
+ * the device in large chunks. All complete DTDs in the buffer can then be
+ * obtained at once as packet views (in native byte order) into the buffer.
+ *
+ * Usage:
+ * 1. Get free space in the buffer with dtd_parser_get_rx_space(), read data
+ *    from the device into it and report the number of bytes read with
+ *    dtd_parser_rx_done().
+ * 2. If dtd_parser_bytes_missing() returns a non-zero value, the next DTD is
+ *    not complete yet, continue with step 1.
+ * 3. Obtain the received packets with dtd_parser_parse().
+ */
+
+/**
+ * Default chunk size in bytes
+ */
+#define DTD_PARSER_CHUNK_SIZE_DEFAULT (16 * 1024)
+
+/**
+ * Maximum chunk size in bytes
+ */
+#define DTD_PARSER_CHUNK_SIZE_MAX (64 * 1024 * 1024)
+
+struct dtd_parser;
+
+/**
+ * Create a new DTD parser
+ *
+ * @param[out] parser_p the created parser
+ * @param chunk_size maximum number of bytes read from the device at once
+ */
+void dtd_parser_new(struct dtd_parser **parser_p, size_t chunk_size);
+
+/**
+ * Free a DTD parser
+ */
+void dtd_parser_free(struct dtd_parser **parser_p);
+
+/**
+ * Get free space in the receive buffer
+ *
+ * All packet views obtained from dtd_parser_parse() become invalid.
+ *
+ * @param parser the parser
+ * @param[out] buf start of the free space
+ * @param[out] size size of the free space in bytes (at most the chunk size).
+ *                  May be 0 if the buffer is filled with complete DTDs which
+ *                  have not been parsed yet.
+ */
+void dtd_parser_get_rx_space(struct dtd_parser *parser, uint8_t **buf,
+                             size_t *size);
+
+/**
+ * Mark data as received
+ *
+ * @param parser the parser
+ * @param size number of bytes written to the buffer returned by
+ *             dtd_parser_get_rx_space()
+ */
+void dtd_parser_rx_done(struct dtd_parser *parser, size_t size);
+
+/**
+ * Get the number of bytes which must be received to complete the next DTD
+ *
+ * @return 0 if a complete DTD is available
+ */
+size_t dtd_parser_bytes_missing(const struct dtd_parser *parser);
+
+/**
+ * Get all complete DTDs from the receive buffer
+ *
+ * Malformed DTDs (too short to contain a DI packet header) are skipped and
+ * counted, see dtd_parser_get_invalid_cnt().
+ *
+ * @param parser the parser
+ * @param[out] pkgs views on the received packets. They point into the receive
+ *                  buffer and are valid until the next call to
+ *                  dtd_parser_get_rx_space().
+ * @param max_pkgs maximum number of packets to return
+ * @return the number of packets written to @p pkgs
+ */
+size_t dtd_parser_parse(struct dtd_parser *parser, struct osd_packet_view *pkgs,
+                        size_t max_pkgs);
+
+/**
+ * Get the number of malformed DTDs which have been skipped
+ */
+uint64_t dtd_parser_get_invalid_cnt(const struct dtd_parser *parser);
+
+#endif  // DTD_PARSER_H
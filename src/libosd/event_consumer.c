@@ -0,0 +1,273 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_consumer.h"
+#include "packet_ring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Maximum number of packets taken out of the ring at once
+ */
+#define EVENT_CONSUMER_BATCH_MAX_PKGS 64
+
+struct event_consumer {
+    struct packet_ring *ring;
+    pthread_t thread;
+
+    /** eventfd signaling the consumer thread to stop */
+    int stop_fd;
+
+    /** Event handler, or NULL if batch_handler is used */
+    event_consumer_handler_fn handler;
+    event_consumer_batch_handler_fn batch_handler;
+    void *handler_arg;
+
+    /** Number of packets added by the producer */
+    uint64_t pushed;
+
+    /** Protects handled */
+    pthread_mutex_t lock;
+    /** Signaled when handled changes */
+    pthread_cond_t handled_cond;
+    /** Number of packets passed to the event handler */
+    uint64_t handled;
+
+    uint64_t handler_time_total_ns;
+    uint64_t handler_time_max_ns;
+};
+
+static uint64_t time_ns(void)
+{
+    struct timespec ts;
+    int rv = clock_gettime(CLOCK_MONOTONIC, &ts);
+    assert(rv == 0);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void account_handler_time(struct event_consumer *consumer,
+                                 uint64_t start_ns)
+{
+    uint64_t handler_time_ns = time_ns() - start_ns;
+
+    __atomic_add_fetch(&consumer->handler_time_total_ns, handler_time_ns,
+                       __ATOMIC_RELAXED);
+    if (handler_time_ns > consumer->handler_time_max_ns) {
+        __atomic_store_n(&consumer->handler_time_max_ns, handler_time_ns,
+                         __ATOMIC_RELAXED);
+    }
+}
+
+static void handle_pkgs(struct event_consumer *consumer,
+                        const struct osd_packet_view *pkgs, size_t pkg_cnt)
+{
+    osd_result rv;
+
+    if (consumer->batch_handler) {
+        uint64_t start_ns = time_ns();
+        rv = consumer->batch_handler(consumer->handler_arg, pkgs, pkg_cnt);
+        if (OSD_FAILED(rv)) {
+            // ignore (error in user logic, packets are possibly dropped)
+        }
+        account_handler_time(consumer, start_ns);
+        return;
+    }
+
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        struct osd_packet *pkg;
+        rv = osd_packet_new_from_view(&pkg, &pkgs[i]);
+        assert(OSD_SUCCEEDED(rv));
+
+        uint64_t start_ns = time_ns();
+        rv = consumer->handler(consumer->handler_arg, pkg);
+        if (OSD_FAILED(rv)) {
+            // ignore (error in user logic, packet is possibly dropped)
+        }
+        account_handler_time(consumer, start_ns);
+    }
+}
+
+static void *consumerthread_main(void *consumer_void)
+{
+    struct event_consumer *consumer = consumer_void;
+    assert(consumer);
+
+    struct pollfd fds[2] = {
+        { .fd = packet_ring_get_fd(consumer->ring), .events = POLLIN },
+        { .fd = consumer->stop_fd, .events = POLLIN },
+    };
+    bool stop = false;
+
+    while (1) {
+        struct osd_packet_view pkgs[EVENT_CONSUMER_BATCH_MAX_PKGS];
+        size_t pkg_cnt = packet_ring_peek(consumer->ring, pkgs,
+                                          EVENT_CONSUMER_BATCH_MAX_PKGS);
+        if (pkg_cnt > 0) {
+            handle_pkgs(consumer, pkgs, pkg_cnt);
+            packet_ring_release(consumer->ring);
+
+            pthread_mutex_lock(&consumer->lock);
+            consumer->handled += pkg_cnt;
+            pthread_cond_broadcast(&consumer->handled_cond);
+            pthread_mutex_unlock(&consumer->lock);
+            continue;
+        }
+
+        if (!packet_ring_consumer_sleep(consumer->ring)) {
+            continue;
+        }
+
+        // The ring is empty: all packets added before the stop request have
+        // been handled.
+        if (stop) {
+            break;
+        }
+
+        int rv = poll(fds, 2, -1);
+        assert(rv > 0 || (rv == -1 && errno == EINTR));
+        if (fds[1].revents & POLLIN) {
+            stop = true;
+        }
+    }
+
+    return NULL;
+}
+
+static void consumer_new(struct event_consumer **consumer_p,
+                         size_t capacity_words,
+                         event_consumer_handler_fn handler,
+                         event_consumer_batch_handler_fn batch_handler,
+                         void *handler_arg)
+{
+    int rv;
+
+    struct event_consumer *consumer = calloc(1, sizeof(struct event_consumer));
+    assert(consumer);
+
+    consumer->handler = handler;
+    consumer->batch_handler = batch_handler;
+    consumer->handler_arg = handler_arg;
+
+    packet_ring_new(&consumer->ring, capacity_words);
+
+    consumer->stop_fd = eventfd(0, EFD_CLOEXEC);
+    assert(consumer->stop_fd != -1);
+
+    rv = pthread_mutex_init(&consumer->lock, NULL);
+    assert(rv == 0);
+    rv = pthread_cond_init(&consumer->handled_cond, NULL);
+    assert(rv == 0);
+
+    rv = pthread_create(&consumer->thread, NULL, consumerthread_main, consumer);
+    assert(rv == 0);
+
+    *consumer_p = consumer;
+}
+
+void event_consumer_new(struct event_consumer **consumer_p,
+                        size_t capacity_words,
+                        event_consumer_handler_fn handler, void *handler_arg)
+{
+    assert(handler);
+    consumer_new(consumer_p, capacity_words, handler, NULL, handler_arg);
+}
+
+void event_consumer_new_batch(struct event_consumer **consumer_p,
+                              size_t capacity_words,
+                              event_consumer_batch_handler_fn batch_handler,
+                              void *handler_arg)
+{
+    assert(batch_handler);
+    consumer_new(consumer_p, capacity_words, NULL, batch_handler, handler_arg);
+}
+
+void event_consumer_free(struct event_consumer **consumer_p)
+{
+    assert(consumer_p);
+    struct event_consumer *consumer = *consumer_p;
+    if (!consumer) {
+        return;
+    }
+
+    uint64_t one = 1;
+    ssize_t wrv;
+    do {
+        wrv = write(consumer->stop_fd, &one, sizeof(one));
+    } while (wrv == -1 && errno == EINTR);
+    assert(wrv == sizeof(one));
+
+    int rv = pthread_join(consumer->thread, NULL);
+    assert(rv == 0);
+
+    pthread_cond_destroy(&consumer->handled_cond);
+    pthread_mutex_destroy(&consumer->lock);
+    close(consumer->stop_fd);
+    packet_ring_free(&consumer->ring);
+
+    free(consumer);
+    *consumer_p = NULL;
+}
+
+void event_consumer_push(struct event_consumer *consumer,
+                         const struct osd_packet_view *pkg)
+{
+    assert(consumer);
+
+    packet_ring_push(consumer->ring, pkg);
+    __atomic_add_fetch(&consumer->pushed, 1, __ATOMIC_RELEASE);
+}
+
+void event_consumer_flush(struct event_consumer *consumer)
+{
+    assert(consumer);
+
+    uint64_t pushed = __atomic_load_n(&consumer->pushed, __ATOMIC_ACQUIRE);
+
+    pthread_mutex_lock(&consumer->lock);
+    while (consumer->handled < pushed) {
+        pthread_cond_wait(&consumer->handled_cond, &consumer->lock);
+    }
+    pthread_mutex_unlock(&consumer->lock);
+}
+
+void event_consumer_get_stats(struct event_consumer *consumer,
+                              struct event_consumer_stats *stats)
+{
+    assert(consumer);
+    assert(stats);
+
+    pthread_mutex_lock(&consumer->lock);
+    stats->events = consumer->handled;
+    pthread_mutex_unlock(&consumer->lock);
+
+    stats->handler_time_total_ns =
+        __atomic_load_n(&consumer->handler_time_total_ns, __ATOMIC_RELAXED);
+    stats->handler_time_max_ns =
+        __atomic_load_n(&consumer->handler_time_max_ns, __ATOMIC_RELAXED);
+
+    struct packet_ring_stats ring_stats;
+    packet_ring_get_stats(consumer->ring, &ring_stats);
+    stats->queue_fill_bytes = ring_stats.fill_bytes;
+    stats->queue_fill_max_bytes = ring_stats.fill_max_bytes;
+    stats->queue_stalls = ring_stats.producer_stalls;
+}
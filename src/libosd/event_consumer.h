@@ -0,0 +1,129 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EVENT_CONSUMER_H
+#define EVENT_CONSUMER_H
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Thread calling an event handler for packets produced by another thread
+ *
+ * The producer (typically an I/O thread) adds packets with
+ * event_consumer_push(); they are passed through a packet ring to the
+ * consumer thread, which calls the event handler for each packet in order.
+ * A slow event handler therefore only delays the producer once the ring is
+ * full.
+ *
+ * Alternatively, a batch event handler is called once for all packets taken
+ * out of the ring at once. The packets are passed to it directly from the
+ * ring, without copying.
+ */
+
+struct event_consumer;
+
+/**
+ * Event handler called in the consumer thread
+ *
+ * The ownership of @p pkg is passed to the handler.
+ */
+typedef osd_result (*event_consumer_handler_fn)(void *arg,
+                                                struct osd_packet *pkg);
+
+/**
+ * Batch event handler called in the consumer thread
+ *
+ * The packets are only valid until the handler returns.
+ */
+typedef osd_result (*event_consumer_batch_handler_fn)(
+    void *arg, const struct osd_packet_view *pkgs, size_t pkg_cnt);
+
+/**
+ * Statistics of an event consumer
+ */
+struct event_consumer_stats {
+    //! number of packets passed to the event handler
+    uint64_t events;
+    //! total time spent in the event handler in ns
+    uint64_t handler_time_total_ns;
+    //! longest time spent in a single call of the event handler in ns
+    uint64_t handler_time_max_ns;
+    //! number of bytes waiting for the consumer thread
+    size_t queue_fill_bytes;
+    //! maximum number of bytes waiting for the consumer thread
+    size_t queue_fill_max_bytes;
+    //! number of times the producer had to wait for the consumer thread
+    uint64_t queue_stalls;
+};
+
+/**
+ * Create a new event consumer and start its thread
+ *
+ * @param[out] consumer_p the created event consumer
+ * @param capacity_words capacity of the packet ring in uint16_t words (see
+ *                       packet_ring_new())
+ * @param handler the event handler
+ * @param handler_arg argument passed to @p handler
+ */
+void event_consumer_new(struct event_consumer **consumer_p,
+                        size_t capacity_words,
+                        event_consumer_handler_fn handler, void *handler_arg);
+
+/**
+ * Create a new event consumer calling a batch event handler
+ *
+ * @see event_consumer_new()
+ */
+void event_consumer_new_batch(struct event_consumer **consumer_p,
+                              size_t capacity_words,
+                              event_consumer_batch_handler_fn batch_handler,
+                              void *handler_arg);
+
+/**
+ * Stop the consumer thread and free the event consumer
+ *
+ * All packets added before are passed to the event handler before the thread
+ * stops.
+ */
+void event_consumer_free(struct event_consumer **consumer_p);
+
+/**
+ * Add a packet for the event handler (producer)
+ *
+ * The packet is copied. Blocks until enough space is available in the ring.
+ */
+void event_consumer_push(struct event_consumer *consumer,
+                         const struct osd_packet_view *pkg);
+
+/**
+ * Wait until all packets added so far have been handled
+ *
+ * This function can be called from any thread except the consumer thread.
+ */
+void event_consumer_flush(struct event_consumer *consumer);
+
+/**
+ * Get statistics about the event consumer
+ *
+ * This function can be called from any thread.
+ */
+void event_consumer_get_stats(struct event_consumer *consumer,
+                              struct event_consumer_stats *stats);
+
+#endif  // EVENT_CONSUMER_H
@@ -0,0 +1,359 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_reassembly.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * Number of slots in a slot table (one table per upper byte of the DI address)
+ */
+#define SLOT_TABLE_SIZE 256
+
+/**
+ * Initial size of the buffer of a slot in words
+ */
+#define SLOT_BUF_WORDS_INITIAL 64
+
+/**
+ * Number of header words of a DI packet
+ */
+#define PKG_HEADER_WORDS 3
+
+/**
+ * Reassembly state of one source DI address
+ */
+struct reassembly_slot {
+    /** Partial event (header and payload words), NULL if not allocated */
+    uint16_t *buf;
+    /** Allocated size of buf in words */
+    size_t buf_words;
+    /** Used size of buf in words, 0 if no partial event is stored */
+    size_t size_words;
+    /**
+     * All packets of the current event are dropped until its EV_LAST packet
+     * is received (the event was too large)
+     */
+    bool discarding;
+    /** Time the last packet of the partial event was received */
+    int64_t last_ms;
+
+    /** Is the slot in the list of partial events? */
+    bool is_partial;
+    struct reassembly_slot *prev;
+    struct reassembly_slot *next;
+};
+
+struct event_reassembly {
+    /** Slots indexed by the upper and the lower byte of the DI address */
+    struct reassembly_slot *slot_tables[SLOT_TABLE_SIZE];
+
+    /** Slots with a partial event, least recently updated first */
+    struct reassembly_slot *partial_head;
+    struct reassembly_slot *partial_tail;
+
+    /** Maximum size of a partial event in words */
+    size_t max_words;
+    unsigned int timeout_ms;
+
+    uint64_t completed;
+    uint64_t timed_out;
+    uint64_t overflowed;
+    size_t partial_events;
+    size_t partial_bytes;
+};
+
+static void stat_add(size_t *stat, ssize_t value)
+{
+    __atomic_store_n(stat, *stat + value, __ATOMIC_RELAXED);
+}
+
+static void stat_inc(uint64_t *stat)
+{
+    __atomic_store_n(stat, *stat + 1, __ATOMIC_RELAXED);
+}
+
+static struct reassembly_slot *get_slot(struct event_reassembly *reassembly,
+                                        unsigned int src, bool create)
+{
+    struct reassembly_slot **table = &reassembly->slot_tables[src >> 8];
+    if (!*table) {
+        if (!create) {
+            return NULL;
+        }
+        *table = calloc(SLOT_TABLE_SIZE, sizeof(struct reassembly_slot));
+        assert(*table);
+    }
+    return &(*table)[src & 0xff];
+}
+
+static void partial_list_remove(struct event_reassembly *reassembly,
+                                struct reassembly_slot *slot)
+{
+    if (!slot->is_partial) {
+        return;
+    }
+
+    if (slot->prev) {
+        slot->prev->next = slot->next;
+    } else {
+        reassembly->partial_head = slot->next;
+    }
+    if (slot->next) {
+        slot->next->prev = slot->prev;
+    } else {
+        reassembly->partial_tail = slot->prev;
+    }
+    slot->prev = NULL;
+    slot->next = NULL;
+    slot->is_partial = false;
+    stat_add(&reassembly->partial_events, -1);
+}
+
+/**
+ * Mark a slot as the most recently updated partial event
+ */
+static void partial_list_touch(struct event_reassembly *reassembly,
+                               struct reassembly_slot *slot, int64_t now_ms)
+{
+    slot->last_ms = now_ms;
+    if (slot->is_partial && !slot->next) {
+        return;
+    }
+
+    partial_list_remove(reassembly, slot);
+
+    slot->prev = reassembly->partial_tail;
+    if (reassembly->partial_tail) {
+        reassembly->partial_tail->next = slot;
+    } else {
+        reassembly->partial_head = slot;
+    }
+    reassembly->partial_tail = slot;
+    slot->is_partial = true;
+    stat_add(&reassembly->partial_events, 1);
+}
+
+/**
+ * Drop the partial event stored in a slot
+ */
+static void slot_clear(struct event_reassembly *reassembly,
+                       struct reassembly_slot *slot)
+{
+    stat_add(&reassembly->partial_bytes,
+             -(ssize_t)(slot->size_words * sizeof(uint16_t)));
+    slot->size_words = 0;
+}
+
+void event_reassembly_new(struct event_reassembly **reassembly_p,
+                          size_t max_bytes, unsigned int timeout_ms)
+{
+    struct event_reassembly *reassembly =
+        calloc(1, sizeof(struct event_reassembly));
+    assert(reassembly);
+
+    event_reassembly_set_limits(reassembly, max_bytes, timeout_ms);
+
+    *reassembly_p = reassembly;
+}
+
+void event_reassembly_free(struct event_reassembly **reassembly_p)
+{
+    assert(reassembly_p);
+    struct event_reassembly *reassembly = *reassembly_p;
+    if (!reassembly) {
+        return;
+    }
+
+    for (size_t t = 0; t < SLOT_TABLE_SIZE; t++) {
+        struct reassembly_slot *table = reassembly->slot_tables[t];
+        if (!table) {
+            continue;
+        }
+        for (size_t i = 0; i < SLOT_TABLE_SIZE; i++) {
+            free(table[i].buf);
+        }
+        free(table);
+    }
+
+    free(reassembly);
+    *reassembly_p = NULL;
+}
+
+void event_reassembly_set_limits(struct event_reassembly *reassembly,
+                                 size_t max_bytes, unsigned int timeout_ms)
+{
+    assert(reassembly);
+
+    // the data size of a packet is limited to UINT16_MAX words
+    reassembly->max_words = max_bytes / sizeof(uint16_t);
+    if (reassembly->max_words > UINT16_MAX) {
+        reassembly->max_words = UINT16_MAX;
+    }
+    assert(reassembly->max_words > PKG_HEADER_WORDS);
+
+    reassembly->timeout_ms = timeout_ms;
+}
+
+bool event_reassembly_add(struct event_reassembly *reassembly,
+                          const struct osd_packet_view *pkg, int64_t now_ms,
+                          struct osd_packet_view *event)
+{
+    assert(reassembly);
+    assert(event);
+    assert(osd_packet_view_get_type(pkg) == OSD_PACKET_TYPE_EVENT);
+
+    unsigned int type_sub = osd_packet_view_get_type_sub(pkg);
+    unsigned int src = osd_packet_view_get_src(pkg);
+
+    if (type_sub != EV_CONT && type_sub != EV_LAST) {
+        // not part of a split event: return as-is
+        *event = *pkg;
+        return true;
+    }
+
+    struct reassembly_slot *slot =
+        get_slot(reassembly, src, type_sub == EV_CONT);
+    if (type_sub == EV_LAST && (!slot || !slot->is_partial)) {
+        // single-packet event
+        *event = *pkg;
+        return true;
+    }
+
+    if (slot->discarding) {
+        if (type_sub == EV_LAST) {
+            slot->discarding = false;
+            partial_list_remove(reassembly, slot);
+        } else {
+            partial_list_touch(reassembly, slot, now_ms);
+        }
+        return false;
+    }
+
+    size_t payload_words = osd_packet_view_get_payload_words(pkg);
+    size_t size_words = slot->size_words;
+    if (size_words == 0) {
+        size_words = PKG_HEADER_WORDS;
+    }
+    size_t new_size_words = size_words + payload_words;
+
+    if (new_size_words > reassembly->max_words) {
+        stat_inc(&reassembly->overflowed);
+        slot_clear(reassembly, slot);
+        if (type_sub == EV_CONT) {
+            slot->discarding = true;
+            partial_list_touch(reassembly, slot, now_ms);
+        } else {
+            partial_list_remove(reassembly, slot);
+        }
+        return false;
+    }
+
+    if (new_size_words > slot->buf_words) {
+        size_t buf_words = slot->buf_words * 2;
+        if (buf_words < SLOT_BUF_WORDS_INITIAL) {
+            buf_words = SLOT_BUF_WORDS_INITIAL;
+        }
+        if (buf_words > reassembly->max_words) {
+            buf_words = reassembly->max_words;
+        }
+        if (buf_words < new_size_words) {
+            buf_words = new_size_words;
+        }
+        slot->buf = realloc(slot->buf, buf_words * sizeof(uint16_t));
+        assert(slot->buf);
+        slot->buf_words = buf_words;
+    }
+
+    if (slot->size_words == 0) {
+        // the header of the first packet becomes the header of the event
+        memcpy(slot->buf, pkg->data_raw, PKG_HEADER_WORDS * sizeof(uint16_t));
+    }
+    memcpy(&slot->buf[size_words], osd_packet_view_get_payload(pkg),
+           payload_words * sizeof(uint16_t));
+    stat_add(&reassembly->partial_bytes,
+             (new_size_words - slot->size_words) * sizeof(uint16_t));
+    slot->size_words = new_size_words;
+
+    if (type_sub == EV_CONT) {
+        partial_list_touch(reassembly, slot, now_ms);
+        return false;
+    }
+
+    // The event carries the header of its EV_LAST packet. The buffer content
+    // stays valid after the slot is cleared, until the slot is used again.
+    memcpy(slot->buf, pkg->data_raw, PKG_HEADER_WORDS * sizeof(uint16_t));
+    event->data_size_words = slot->size_words;
+    event->data_raw = slot->buf;
+
+    slot_clear(reassembly, slot);
+    partial_list_remove(reassembly, slot);
+    stat_inc(&reassembly->completed);
+
+    return true;
+}
+
+size_t event_reassembly_expire(struct event_reassembly *reassembly,
+                               int64_t now_ms)
+{
+    assert(reassembly);
+
+    size_t expired_cnt = 0;
+    struct reassembly_slot *slot;
+    while ((slot = reassembly->partial_head) &&
+           now_ms - slot->last_ms >= reassembly->timeout_ms) {
+        if (!slot->discarding) {
+            stat_inc(&reassembly->timed_out);
+            expired_cnt++;
+        }
+        slot->discarding = false;
+        slot_clear(reassembly, slot);
+        partial_list_remove(reassembly, slot);
+
+        // the source might not send events any more: release the buffer
+        free(slot->buf);
+        slot->buf = NULL;
+        slot->buf_words = 0;
+    }
+
+    return expired_cnt;
+}
+
+bool event_reassembly_has_partial(const struct event_reassembly *reassembly)
+{
+    assert(reassembly);
+    return reassembly->partial_head != NULL;
+}
+
+void event_reassembly_get_stats(const struct event_reassembly *reassembly,
+                                struct event_reassembly_stats *stats)
+{
+    assert(reassembly);
+    assert(stats);
+
+    stats->completed = __atomic_load_n(&reassembly->completed,
+                                       __ATOMIC_RELAXED);
+    stats->timed_out = __atomic_load_n(&reassembly->timed_out,
+                                       __ATOMIC_RELAXED);
+    stats->overflowed = __atomic_load_n(&reassembly->overflowed,
+                                        __ATOMIC_RELAXED);
+    stats->partial_events = __atomic_load_n(&reassembly->partial_events,
+                                            __ATOMIC_RELAXED);
+    stats->partial_bytes = __atomic_load_n(&reassembly->partial_bytes,
+                                           __ATOMIC_RELAXED);
+}
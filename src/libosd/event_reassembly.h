@@ -0,0 +1,142 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EVENT_REASSEMBLY_H
+#define EVENT_REASSEMBLY_H
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Reassembly of events split into multiple EVENT packets
+ *
+ * A module sends an event which doesn't fit into a single packet as a
+ * sequence of EV_CONT packets, terminated by an EV_LAST packet. Packets of
+ * different sources may be interleaved.
+ *
+ * Partial events are kept in one slot per source DI address, which is found
+ * in constant time. The payload of a partial event is collected in a
+ * contiguous buffer owned by the slot; the buffer is reused for subsequent
+ * events of the same source.
+ *
+ * Partial events are discarded if they grow beyond a maximum size, or if no
+ * packet of the event has been received for a timeout (e.g. because the
+ * EV_LAST packet was lost).
+ *
+ * Partial events must be accessed from a single thread, only the statistics
+ * can be obtained from any thread.
+ */
+
+/**
+ * Default maximum size of a partial event in bytes
+ */
+#define EVENT_REASSEMBLY_MAX_BYTES_DEFAULT (64 * 1024)
+
+/**
+ * Default time after which a partial event is discarded in ms
+ */
+#define EVENT_REASSEMBLY_TIMEOUT_MS_DEFAULT 1000
+
+struct event_reassembly;
+
+/**
+ * Statistics of the event reassembly
+ */
+struct event_reassembly_stats {
+    //! number of events reassembled from multiple packets
+    uint64_t completed;
+    //! number of partial events discarded after the timeout
+    uint64_t timed_out;
+    //! number of partial events discarded because they were too large
+    uint64_t overflowed;
+    //! number of sources with a partial event
+    size_t partial_events;
+    //! number of bytes in all partial events
+    size_t partial_bytes;
+};
+
+/**
+ * Create a new event reassembly
+ *
+ * @param[out] reassembly_p the created event reassembly
+ * @param max_bytes maximum size of a partial event (of one source) in bytes
+ * @param timeout_ms time after the last packet of a partial event was
+ *                   received until the partial event is discarded
+ */
+void event_reassembly_new(struct event_reassembly **reassembly_p,
+                          size_t max_bytes, unsigned int timeout_ms);
+
+/**
+ * Free an event reassembly, including all partial events
+ */
+void event_reassembly_free(struct event_reassembly **reassembly_p);
+
+/**
+ * Change the limits of the event reassembly
+ *
+ * The limits apply to all packets added afterwards.
+ *
+ * @see event_reassembly_new()
+ */
+void event_reassembly_set_limits(struct event_reassembly *reassembly,
+                                 size_t max_bytes, unsigned int timeout_ms);
+
+/**
+ * Add an EVENT packet
+ *
+ * No memory is allocated for events which consist of a single packet: @p event
+ * refers to @p pkg itself. A reassembled event refers to memory owned by the
+ * event reassembly, which stays valid until the next call to
+ * event_reassembly_add() or event_reassembly_expire(). Use
+ * osd_packet_new_from_view() to keep the event longer.
+ *
+ * @param reassembly the event reassembly
+ * @param pkg the packet. The packet is copied if it is part of a split event.
+ * @param now_ms the current time in ms (e.g. from zclock_mono())
+ * @param[out] event the complete event if @p pkg completed one
+ * @return true if @p pkg completed an event, false otherwise
+ */
+bool event_reassembly_add(struct event_reassembly *reassembly,
+                          const struct osd_packet_view *pkg, int64_t now_ms,
+                          struct osd_packet_view *event);
+
+/**
+ * Discard all partial events which timed out
+ *
+ * @param reassembly the event reassembly
+ * @param now_ms the current time in ms
+ * @return the number of discarded partial events
+ */
+size_t event_reassembly_expire(struct event_reassembly *reassembly,
+                               int64_t now_ms);
+
+/**
+ * Are partial events waiting for more packets?
+ */
+bool event_reassembly_has_partial(const struct event_reassembly *reassembly);
+
+/**
+ * Get statistics about the event reassembly
+ *
+ * This function can be called from any thread.
+ */
+void event_reassembly_get_stats(const struct event_reassembly *reassembly,
+                                struct event_reassembly_stats *stats);
+
+#endif  // EVENT_REASSEMBLY_H
@@ -27,8 +27,9 @@
  *   functions. Most of them forward the actual work to one of the worker
  *   threads.
  * - The ``devicerxthread`` (a plain POSIX thread) calls the packet_read()
- *   function of the device to read a new packet. Received packets are sent to
- *   the ZeroMQ socket device_rx_socket.
+ *   function of the device to read a new packet (or packet_read_batch() to
+ *   read multiple packets at once). Received packets are copied into the
+ *   device_rx_ring, a lock-free single-producer/single-consumer queue.
  * - The ``hostiothread`` is a worker thread (implemented using the ``worker``
  *   helper class) performing all interaction with the host controller. This
  *   includes
@@ -36,7 +37,8 @@
  *   - Writing packets to the device when they are received from the host
  *     controller.
  *   - Forwarding data read from the device (in the ``devicerxthread``) to the
- *     host controller.
+ *     host controller. The hostiothread is woken up through an eventfd when
+ *     new packets are available in the device_rx_ring.
  *
  * Behavior on connection loss
  * ---------------------------
@@ -62,7 +64,10 @@
 #include <osd/gateway.h>
 #include <osd/osd.h>
 #include <osd/packet.h>
+#include "hostctrl_client.h"
 #include "osd-private.h"
+#include "packet_batch.h"
+#include "packet_ring.h"
 #include "worker.h"
 
 #include <assert.h>
@@ -76,6 +81,17 @@
  */
 #define DEVICE_DISCONNECT_TIMEOUT_SECONDS 2
 
+/**
+ * Maximum number of messages from the host controller which are collected
+ * before the contained packets are written to the device
+ */
+#define HOSTIO_WRITE_MAX_MSGS 64
+
+/**
+ * Maximum number of packets passed to packet_write_batch() at once
+ */
+#define HOSTIO_WRITE_MAX_PKGS 256
+
 /**
  * Gateway context
  */
@@ -104,16 +120,20 @@ struct osd_gateway_ctx {
     pthread_t devicerxthread;
 
     /**
-     * ZeroMQ PAIR socket, forwarding data read from the device to the I/O
-     * thread
+     * Queue of packets read from the device, forwarded by the I/O thread
      */
-    zsock_t *device_rx_socket;
+    struct packet_ring *device_rx_ring;
 
     /**
      * Read a single packet from the device (blocking)
      */
     packet_read_fn packet_read;
 
+    /**
+     * Read multiple packets from the device (blocking), optional
+     */
+    packet_read_batch_fn packet_read_batch;
+
     /** Callback argument pointer (passed to the callbacks, internally unused)*/
     void *cb_arg;
 
@@ -121,6 +141,18 @@ struct osd_gateway_ctx {
     struct osd_gateway_transfer_stats stats;
 };
 
+/**
+ * Opcodes of messages exchanged between the main thread and the hostiothread
+ */
+enum hostiothread_opcode {
+    HOSTIOTHREAD_OP_CONNECT = WORKER_OP_USER,
+    HOSTIOTHREAD_OP_CONNECT_DONE,
+    HOSTIOTHREAD_OP_DISCONNECT,
+    HOSTIOTHREAD_OP_DISCONNECT_DONE,
+    HOSTIOTHREAD_OP_SET_BATCH_POLICY,
+    HOSTIOTHREAD_OP_SET_WRITE_BATCH_FN,
+};
+
 /**
  * Context used on the hostiothread
  */
@@ -134,14 +166,17 @@ struct hostiothread_usr_ctx {
     /** Write a packet to the device */
     packet_write_fn packet_write;
 
+    /** Write multiple packets to the device, optional */
+    packet_write_batch_fn packet_write_batch;
+
     /** Callback argument pointer (passed to the callbacks, internally unused)*/
     void *cb_arg;
 
     /**
-     * ZeroMQ PAIR socket, receiving data from the device RX thread, to be
-     * forwarded to the host controller
+     * Queue of packets read from the device RX thread, to be forwarded to the
+     * host controller
      */
-    zsock_t *device_rx_socket;
+    struct packet_ring *device_rx_ring;
 
     /** Address of the subnet connected to this gateway */
     uint16_t device_subnet_addr;
@@ -156,6 +191,20 @@ struct hostiothread_usr_ctx {
      * Non-synchronized pointer to the osd_gateway_ctx.stats struct.
      */
     struct osd_gateway_transfer_stats *stats;
+
+    /** Batch builder for packets sent to the host controller */
+    struct packet_batch *tx_batch;
+
+    /** Messages received from the host controller, not yet destroyed */
+    zmsg_t *write_msgs[HOSTIO_WRITE_MAX_MSGS];
+    size_t write_msg_cnt;
+
+    /**
+     * Packets to be written to the device. The views point into the messages
+     * in write_msgs.
+     */
+    struct osd_packet_view write_pkgs[HOSTIO_WRITE_MAX_PKGS];
+    size_t write_pkg_cnt;
 };
 
 /**
@@ -190,46 +239,75 @@ static void stats_add_pkg(uint64_t *byte_counter, const struct osd_packet *pkg)
     *byte_counter += pkg->data_size_words * sizeof(uint16_t);
 }
 
+static void stats_add_pkg_view(uint64_t *byte_counter,
+                               const struct osd_packet_view *pkg)
+{
+    *byte_counter += pkg->data_size_words * sizeof(uint16_t);
+}
+
 /**
- * Read data from the device encoded as Debug Transport Datagrams (DTDs)
+ * Number of packets the devicerxthread reads at once using packet_read_batch()
  */
-static void *devicerxthread_main(void *gateway_ctx_void)
+#define DEVICERX_BATCH_MAX_PKGS 256
+
+/**
+ * Number of packets the hostiothread takes out of the device_rx_ring at once
+ */
+#define DEVICERX_FORWARD_MAX_PKGS 256
+
+/**
+ * Maximum number of chunks of DEVICERX_FORWARD_MAX_PKGS packets forwarded to
+ * the host controller before the hostiothread handles other events
+ */
+#define DEVICERX_FORWARD_MAX_ROUNDS 16
+
+/**
+ * Handle a failed read from the device in the devicerxthread
+ *
+ * @return true if the devicerxthread should terminate
+ */
+static bool devicerxthread_read_failed(struct osd_gateway_ctx *gateway_ctx,
+                                       osd_result rv)
+{
+    if (rv == OSD_ERROR_NOT_CONNECTED) {
+        dbg(gateway_ctx->log_ctx, "Connection to device was terminated "
+            "during packet_read. Signaling main thread to disconnect.");
+
+        // Request cleanup on the main thread
+        gateway_ctx->device_disconnect_detected = true;
+        return true;
+    }
+
+    dbg(gateway_ctx->log_ctx,
+        "packet_read() failed with error %d. Trying again.", rv);
+    return false;
+}
+
+/**
+ * Read data from the device encoded as Debug Transport Datagrams (DTDs),
+ * one packet at a time
+ */
+static void *devicerxthread_main_single(struct osd_gateway_ctx *gateway_ctx)
 {
     osd_result rv;
-    int zmq_rv;
-    struct osd_gateway_ctx *gateway_ctx = gateway_ctx_void;
-    assert(gateway_ctx);
 
     while (1) {
         struct osd_packet *rcv_packet = NULL;
         rv = gateway_ctx->packet_read(&rcv_packet, gateway_ctx->cb_arg);
         if (OSD_FAILED(rv)) {
-            if (rv == OSD_ERROR_NOT_CONNECTED) {
-                dbg(gateway_ctx->log_ctx, "Connection to device was terminated "
-                    "during packet_read. Signaling main thread to disconnect.");
-                osd_packet_free(&rcv_packet);
-
-                // Request cleanup on the main thread
-                gateway_ctx->device_disconnect_detected = true;
-
+            osd_packet_free(&rcv_packet);
+            if (devicerxthread_read_failed(gateway_ctx, rv)) {
                 return (void *)OSD_ERROR_NOT_CONNECTED;
-            } else {
-                dbg(gateway_ctx->log_ctx,
-                    "packet_read() failed with error %d. Trying again.", rv);
-                osd_packet_free(&rcv_packet);
-                continue;
             }
+            continue;
         }
         assert(rcv_packet);
 
-        zmsg_t *msg;
-        msg = zmsg_new();
-        assert(msg);
-        zmq_rv = zmsg_addstr(msg, "D");
-        assert(zmq_rv == 0);
-        zmq_rv = zmsg_addmem(msg, rcv_packet->data_raw,
-                             osd_packet_sizeof(rcv_packet));
-        zmsg_send(&msg, gateway_ctx->device_rx_socket);
+        struct osd_packet_view pkg_view = {
+            .data_size_words = rcv_packet->data_size_words,
+            .data_raw = rcv_packet->data_raw,
+        };
+        packet_ring_push(gateway_ctx->device_rx_ring, &pkg_view);
 
         stats_add_pkg(&gateway_ctx->stats.bytes_from_device, rcv_packet);
 
@@ -239,63 +317,214 @@ static void *devicerxthread_main(void *gateway_ctx_void)
     return (void *)OSD_OK;
 }
 
+/**
+ * Read data from the device encoded as Debug Transport Datagrams (DTDs),
+ * multiple packets at a time
+ */
+static void *devicerxthread_main_batch(struct osd_gateway_ctx *gateway_ctx)
+{
+    osd_result rv;
+
+    struct osd_packet_view pkgs[DEVICERX_BATCH_MAX_PKGS];
+
+    while (1) {
+        size_t pkg_cnt = 0;
+        rv = gateway_ctx->packet_read_batch(pkgs, DEVICERX_BATCH_MAX_PKGS,
+                                            &pkg_cnt, gateway_ctx->cb_arg);
+        if (OSD_FAILED(rv)) {
+            if (devicerxthread_read_failed(gateway_ctx, rv)) {
+                return (void *)OSD_ERROR_NOT_CONNECTED;
+            }
+            continue;
+        }
+
+        for (size_t i = 0; i < pkg_cnt; i++) {
+            packet_ring_push(gateway_ctx->device_rx_ring, &pkgs[i]);
+            stats_add_pkg_view(&gateway_ctx->stats.bytes_from_device,
+                               &pkgs[i]);
+        }
+    }
+
+    return (void *)OSD_OK;
+}
+
+/**
+ * Read data from the device encoded as Debug Transport Datagrams (DTDs)
+ */
+static void *devicerxthread_main(void *gateway_ctx_void)
+{
+    struct osd_gateway_ctx *gateway_ctx = gateway_ctx_void;
+    assert(gateway_ctx);
+
+    if (gateway_ctx->packet_read_batch) {
+        return devicerxthread_main_batch(gateway_ctx);
+    }
+    return devicerxthread_main_single(gateway_ctx);
+}
+
 static void hostiothread_disconnect_from_hostctrl(
     struct worker_thread_ctx *thread_ctx);
 
 /**
- * Process incoming messages from the host controller
+ * Write packets received from the host controller to the device
  *
- * @return 0 if the message was processed, -1 if @p loop should be terminated
+ * If writing to the device fails the connection to the host controller is
+ * terminated.
+ *
+ * @return OSD_OK if the packets were written, any other value indicates that
+ *         the connection to the device has been closed.
  */
-static int hostiothread_rcv_from_hostctrl(zloop_t *loop, zsock_t *reader,
-                                          void *thread_ctx_void)
+static osd_result hostiothread_write_to_device(
+    struct worker_thread_ctx *thread_ctx, const struct osd_packet_view *pkgs,
+    size_t pkg_cnt)
 {
-    struct worker_thread_ctx *thread_ctx =
-        (struct worker_thread_ctx *)thread_ctx_void;
-    assert(thread_ctx);
-
     struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    int retval;
     osd_result rv;
+    osd_result device_write_rv = OSD_OK;
+    // number of packets which were written to the device
+    size_t written_cnt = 0;
+
+    if (usrctx->packet_write_batch) {
+        device_write_rv = usrctx->packet_write_batch(pkgs, pkg_cnt,
+                                                     usrctx->cb_arg);
+        if (OSD_SUCCEEDED(device_write_rv)) {
+            written_cnt = pkg_cnt;
+        }
+    } else {
+        for (size_t i = 0; i < pkg_cnt; i++) {
+            // packet_write() takes a struct osd_packet, which includes the
+            // size field in front of the packet data. Copy the packet to get
+            // one.
+            struct osd_packet *pkg;
+            rv = osd_packet_new_from_view(&pkg, &pkgs[i]);
+            assert(OSD_SUCCEEDED(rv));
+            device_write_rv = usrctx->packet_write(pkg, usrctx->cb_arg);
+            osd_packet_free(&pkg);
+            if (OSD_FAILED(device_write_rv)) {
+                break;
+            }
+            written_cnt++;
+        }
+    }
 
-    zmsg_t *msg = zmsg_recv(reader);
-    if (!msg) {
-        return -1;  // process was interrupted, terminate zloop
+    for (size_t i = 0; i < written_cnt; i++) {
+        usrctx->stats->bytes_to_device += osd_packet_view_sizeof(&pkgs[i]);
+    }
+
+    if (OSD_FAILED(device_write_rv)) {
+        if (device_write_rv == OSD_ERROR_NOT_CONNECTED) {
+            dbg(thread_ctx->log_ctx, "Connection to device was terminated "
+                "during packet_write. Unregistering from gateway and "
+                "signaling main thread to disconnect");
+        } else {
+            err(thread_ctx->log_ctx,
+                "Device write failed (%d). Packet dropped.",
+                device_write_rv);
+            // XXX: can we retry here?
+        }
+        hostiothread_disconnect_from_hostctrl(thread_ctx);
+        *usrctx->device_disconnect_detected = true;
+        return device_write_rv;
+    }
+
+    return OSD_OK;
+}
+
+/**
+ * Write all queued packets to the device
+ *
+ * @see hostiothread_write_to_device()
+ */
+static osd_result hostiothread_flush_writes(
+    struct worker_thread_ctx *thread_ctx)
+{
+    struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    if (usrctx->write_pkg_cnt == 0) {
+        return OSD_OK;
+    }
+
+    osd_result rv = hostiothread_write_to_device(
+        thread_ctx, usrctx->write_pkgs, usrctx->write_pkg_cnt);
+    usrctx->write_pkg_cnt = 0;
+    return rv;
+}
+
+/**
+ * Queue a packet to be written to the device
+ *
+ * The memory @p pkg points to must remain valid until the queue is flushed.
+ *
+ * @see hostiothread_write_to_device()
+ */
+static osd_result hostiothread_queue_write(
+    struct worker_thread_ctx *thread_ctx, const struct osd_packet_view *pkg)
+{
+    struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    if (usrctx->write_pkg_cnt == HOSTIO_WRITE_MAX_PKGS) {
+        osd_result rv = hostiothread_flush_writes(thread_ctx);
+        if (OSD_FAILED(rv)) {
+            return rv;
+        }
     }
 
+    usrctx->write_pkgs[usrctx->write_pkg_cnt++] = *pkg;
+    return OSD_OK;
+}
+
+/**
+ * Process a message received from the host controller
+ *
+ * Data packets in the message are queued to be written to the device, the
+ * message must not be destroyed before the queue is flushed.
+ *
+ * @return OSD_OK if the message was processed, any other value indicates that
+ *         the connection to the device has been closed.
+ */
+static osd_result hostiothread_process_hostctrl_msg(
+    struct worker_thread_ctx *thread_ctx, zmsg_t *msg)
+{
+    osd_result rv;
+
     zframe_t *type_frame = zmsg_first(msg);
     assert(type_frame);
     if (zframe_streq(type_frame, "D")) {
         zframe_t *data_frame = zmsg_next(msg);
         assert(data_frame);
 
-        struct osd_packet *pkg;
-        rv = osd_packet_new_from_zframe(&pkg, data_frame);
-        assert(OSD_SUCCEEDED(rv));
-        osd_result device_write_rv = usrctx->packet_write(pkg, usrctx->cb_arg);
-
-        stats_add_pkg(&usrctx->stats->bytes_to_device, pkg);
-
-        free(pkg);
-
-        if (OSD_FAILED(device_write_rv)) {
-            if (device_write_rv == OSD_ERROR_NOT_CONNECTED) {
-                dbg(thread_ctx->log_ctx, "Connection to device was terminated "
-                    "during packet_write. Unregistering from gateway and "
-                    "signaling main thread to disconnect");
-            } else {
-                err(thread_ctx->log_ctx,
-                    "Device write failed (%d). Packet dropped.",
-                    device_write_rv);
-                // XXX: can we retry here?
+        struct osd_packet_view pkg_view;
+        rv = osd_packet_view_from_zframe(&pkg_view, data_frame);
+        if (OSD_FAILED(rv)) {
+            err(thread_ctx->log_ctx, "Dropping invalid data packet (%d)", rv);
+            return OSD_OK;
+        }
+
+        return hostiothread_queue_write(thread_ctx, &pkg_view);
+
+    } else if (zframe_streq(type_frame, "B")) {
+        zframe_t *batch_frame = zmsg_next(msg);
+        assert(batch_frame);
+
+        struct packet_batch_iter iter;
+        struct osd_packet_view pkg_view;
+        packet_batch_iter_init(&iter, batch_frame);
+        while (packet_batch_iter_next(&iter, &pkg_view)) {
+            rv = hostiothread_queue_write(thread_ctx, &pkg_view);
+            if (OSD_FAILED(rv)) {
+                return rv;
             }
-            hostiothread_disconnect_from_hostctrl(thread_ctx);
-            *usrctx->device_disconnect_detected = true;
-            retval = -1; // end zloop and with it the hostiothread
-            goto free_return;
         }
+        if (iter.invalid) {
+            err(thread_ctx->log_ctx,
+                "Received malformed batch data message, dropping remaining "
+                "packets in batch.");
+        }
+        return OSD_OK;
 
     } else if (zframe_streq(type_frame, "M")) {
         assert(0 && "TODO: Handle incoming management messages.");
@@ -304,9 +533,69 @@ static int hostiothread_rcv_from_hostctrl(zloop_t *loop, zsock_t *reader,
         assert(0 && "Message of unknown type received.");
     }
 
-    retval = 0;
-free_return:
-    zmsg_destroy(&msg);
+    return OSD_OK;
+}
+
+/**
+ * Process incoming messages from the host controller
+ *
+ * All messages which are already queued in the socket are received at once,
+ * and the contained packets are written to the device together. Burst writes
+ * from the host (e.g. memory writes) thereby result in few large device
+ * writes instead of one write per packet.
+ *
+ * @return 0 if the message was processed, -1 if @p loop should be terminated
+ */
+static int hostiothread_rcv_from_hostctrl(zloop_t *loop, zsock_t *reader,
+                                          void *thread_ctx_void)
+{
+    struct worker_thread_ctx *thread_ctx =
+        (struct worker_thread_ctx *)thread_ctx_void;
+    assert(thread_ctx);
+
+    struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    int retval = 0;
+    osd_result rv = OSD_OK;
+
+    zmsg_t *msg = zmsg_recv(reader);
+    if (!msg) {
+        return -1;  // process was interrupted, terminate zloop
+    }
+
+    while (1) {
+        usrctx->write_msgs[usrctx->write_msg_cnt++] = msg;
+
+        rv = hostiothread_process_hostctrl_msg(thread_ctx, msg);
+        if (OSD_FAILED(rv)) {
+            break;
+        }
+
+        if (usrctx->write_msg_cnt == HOSTIO_WRITE_MAX_MSGS ||
+            !(zsock_events(reader) & ZMQ_POLLIN)) {
+            break;
+        }
+
+        msg = zmsg_recv(reader);
+        if (!msg) {
+            retval = -1;  // process was interrupted, terminate zloop
+            break;
+        }
+    }
+
+    if (OSD_SUCCEEDED(rv)) {
+        rv = hostiothread_flush_writes(thread_ctx);
+    }
+    if (OSD_FAILED(rv)) {
+        retval = -1; // end zloop and with it the hostiothread
+    }
+
+    usrctx->write_pkg_cnt = 0;
+    for (size_t i = 0; i < usrctx->write_msg_cnt; i++) {
+        zmsg_destroy(&usrctx->write_msgs[i]);
+    }
+    usrctx->write_msg_cnt = 0;
 
     return retval;
 }
@@ -435,10 +724,10 @@ static osd_result hostiothread_unregister_gw(
 /**
  * Connect to the host controller in the I/O thread
  *
- * This function is called by the inprochelper as response to the I-CONNECT
- * message. It creates a new DEALER ZeroMQ socket and uses it to connect to the
- * host controller. After completion the function sends out a I-CONNECT-DONE
- * message. The message value is -1 if the connection failed for any reason,
+ * This function is called by the inprochelper as response to the
+ * HOSTIOTHREAD_OP_CONNECT message. It creates a new DEALER ZeroMQ socket and
+ * uses it to connect to the host controller. After completion the function
+ * sends out a HOSTIOTHREAD_OP_CONNECT_DONE message. The message value is -1 if the connection failed for any reason,
  * or the DI address assigned to the host module if the connection was
  * successfully established.
  */
@@ -451,15 +740,21 @@ static void hostiothread_connect_to_hostctrl(
     osd_result retval;
     osd_result osd_rv;
 
-    // create new DEALER socket to connect with the host controller
-    usrctx->hostctrl_socket = zsock_new_dealer(usrctx->host_controller_address);
-    if (!usrctx->hostctrl_socket) {
-        err(thread_ctx->log_ctx, "Unable to connect to %s",
-            usrctx->host_controller_address);
+    // The device RX thread of a previous connection might have left packets
+    // in the ring, which must not be sent as part of this connection. (The
+    // device RX thread of this connection is started after this function.)
+    packet_ring_discard(usrctx->device_rx_ring);
+
+    // connect to the routing thread of the host controller serving the
+    // device subnet
+    osd_rv = hostctrl_connect(thread_ctx->log_ctx,
+                              usrctx->host_controller_address,
+                              usrctx->device_subnet_addr,
+                              &usrctx->hostctrl_socket);
+    if (OSD_FAILED(osd_rv)) {
         retval = -1;
         goto free_return;
     }
-    zsock_set_rcvtimeo(usrctx->hostctrl_socket, ZMQ_RCV_TIMEOUT);
 
     // Register us as gateway for the device subnet
     osd_rv = hostiothread_register_gw(thread_ctx);
@@ -480,15 +775,16 @@ free_return:
     if (retval == -1) {
         zsock_destroy(&usrctx->hostctrl_socket);
     }
-    worker_send_status(thread_ctx->inproc_socket, "I-CONNECT-DONE", retval);
+    worker_send_status(thread_ctx->inproc_socket, HOSTIOTHREAD_OP_CONNECT_DONE,
+                       retval);
 }
 
 /**
  * Disconnect from the host controller in the I/O thread
  *
- * This function is called when receiving a I-DISCONNECT message in the
- * I/O thread. After the disconnect is done a I-DISCONNECT-DONE message is sent
- * to the main thread.
+ * This function is called when receiving a HOSTIOTHREAD_OP_DISCONNECT message
+ * in the I/O thread. After the disconnect is done a
+ * HOSTIOTHREAD_OP_DISCONNECT_DONE message is sent to the main thread.
  */
 static void hostiothread_disconnect_from_hostctrl(
     struct worker_thread_ctx *thread_ctx)
@@ -501,6 +797,9 @@ static void hostiothread_disconnect_from_hostctrl(
 
     zloop_reader_end(thread_ctx->zloop, usrctx->hostctrl_socket);
 
+    // send out all pending packets before closing the connection
+    packet_batch_flush(usrctx->tx_batch);
+
     // Unregister us as gateway for the device subnet
     osd_rv = hostiothread_unregister_gw(thread_ctx);
     if (OSD_FAILED(osd_rv)) {
@@ -512,39 +811,75 @@ static void hostiothread_disconnect_from_hostctrl(
 
     retval = OSD_OK;
 
-    worker_send_status(thread_ctx->inproc_socket, "I-DISCONNECT-DONE", retval);
+    worker_send_status(thread_ctx->inproc_socket,
+                       HOSTIOTHREAD_OP_DISCONNECT_DONE, retval);
 }
 
-static osd_result hostiothread_handle_inproc_request(
-    struct worker_thread_ctx *thread_ctx, const char *name, zmsg_t *msg)
+static osd_result hostiothread_handle_connect(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    hostiothread_connect_to_hostctrl(thread_ctx);
+    return OSD_OK;
+}
+
+static osd_result hostiothread_handle_disconnect(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    hostiothread_disconnect_from_hostctrl(thread_ctx);
+    return OSD_OK;
+}
+
+static osd_result hostiothread_handle_set_batch_policy(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
 {
     struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    if (!strcmp(name, "I-CONNECT")) {
-        hostiothread_connect_to_hostctrl(thread_ctx);
+    zframe_t *policy_frame = zmsg_last(*msg_p);
+    assert(zframe_size(policy_frame) ==
+           sizeof(struct osd_packet_batch_policy));
+    struct osd_packet_batch_policy policy;
+    memcpy(&policy, zframe_data(policy_frame), sizeof(policy));
+    packet_batch_set_policy(usrctx->tx_batch, &policy);
 
-    } else if (!strcmp(name, "I-DISCONNECT")) {
-        hostiothread_disconnect_from_hostctrl(thread_ctx);
-#if 0
-    } else if (!strcmp(name, "D")) {
-        // Forward data packet to the host controller
-        rv = zmsg_send(&msg, usrctx->hostctrl_socket);
-        assert(rv == 0);
-#endif
-    } else {
-        assert(0 && "Received unknown message from main thread.");
-    }
+    return OSD_OK;
+}
+
+static osd_result hostiothread_handle_set_write_batch_fn(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
 
-    zmsg_destroy(&msg);
+    zframe_t *fn_frame = zmsg_last(*msg_p);
+    assert(zframe_size(fn_frame) == sizeof(packet_write_batch_fn));
+    memcpy(&usrctx->packet_write_batch, zframe_data(fn_frame),
+           sizeof(packet_write_batch_fn));
 
     return OSD_OK;
 }
 
 /**
- * Handler inside the I/O worker thread: forward a packet to the host controller
+ * Handlers for messages from the main thread
  */
-static int forward_devicerx_to_hostctrl(zloop_t *loop, zsock_t *reader,
+static const struct worker_cmd_handler hostiothread_cmd_handlers[] = {
+    { HOSTIOTHREAD_OP_CONNECT, hostiothread_handle_connect },
+    { HOSTIOTHREAD_OP_DISCONNECT, hostiothread_handle_disconnect },
+    { HOSTIOTHREAD_OP_SET_BATCH_POLICY, hostiothread_handle_set_batch_policy },
+    { HOSTIOTHREAD_OP_SET_WRITE_BATCH_FN,
+      hostiothread_handle_set_write_batch_fn },
+};
+
+/**
+ * Handler inside the I/O worker thread: forward packets to the host controller
+ *
+ * Forwards all packets the devicerxthread put into the device_rx_ring to the
+ * host controller according to the batch policy. To keep the I/O thread
+ * responsive while the device sends data continuously, the handler returns to
+ * the event loop after forwarding DEVICERX_FORWARD_MAX_ROUNDS chunks of
+ * packets; it is called again immediately after other events are processed.
+ */
+static int forward_devicerx_to_hostctrl(zloop_t *loop, zmq_pollitem_t *item,
                                         void *thread_ctx_void)
 {
     struct worker_thread_ctx *thread_ctx = thread_ctx_void;
@@ -553,19 +888,45 @@ static int forward_devicerx_to_hostctrl(zloop_t *loop, zsock_t *reader,
     struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    int zmq_rv;
+    struct osd_packet_view pkgs[DEVICERX_FORWARD_MAX_PKGS];
 
-    zmsg_t *msg = zmsg_recv(reader);
-    if (!msg) {
-        return -1;  // process was interrupted, terminate zloop
-    }
+    for (unsigned int round = 0; round < DEVICERX_FORWARD_MAX_ROUNDS;
+         round++) {
+        size_t pkg_cnt = packet_ring_peek(usrctx->device_rx_ring, pkgs,
+                                          DEVICERX_FORWARD_MAX_PKGS);
+        if (pkg_cnt == 0) {
+            if (packet_ring_consumer_sleep(usrctx->device_rx_ring)) {
+                break;
+            }
+            continue;
+        }
 
-    zmq_rv = zmsg_send(&msg, usrctx->hostctrl_socket);
-    assert(zmq_rv == 0);
+        // with batching disabled, packet_batch_add() sends each packet in a
+        // separate data message
+        for (size_t i = 0; i < pkg_cnt; i++) {
+            packet_batch_add(usrctx->tx_batch, &pkgs[i]);
+        }
+        packet_ring_release(usrctx->device_rx_ring);
+    }
 
     return 0;
 }
 
+/**
+ * Send a message from the batch builder to the host controller
+ */
+static void hostiothread_send_to_hostctrl(zmsg_t **msg_p,
+                                          void *thread_ctx_void)
+{
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
+    assert(thread_ctx);
+    struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    int zmq_rv = zmsg_send(msg_p, usrctx->hostctrl_socket);
+    assert(zmq_rv == 0);
+}
+
 static osd_result hostiothread_init(struct worker_thread_ctx *thread_ctx)
 {
     assert(thread_ctx);
@@ -574,13 +935,17 @@ static osd_result hostiothread_init(struct worker_thread_ctx *thread_ctx)
 
     int zmq_rv;
 
-    usrctx->device_rx_socket = zsock_new_pair(">inproc://devicerx");
-    assert(usrctx->device_rx_socket);
-
-    zmq_rv = zloop_reader(thread_ctx->zloop, usrctx->device_rx_socket,
+    zmq_pollitem_t device_rx_item = {
+        .fd = packet_ring_get_fd(usrctx->device_rx_ring),
+        .events = ZMQ_POLLIN,
+    };
+    zmq_rv = zloop_poller(thread_ctx->zloop, &device_rx_item,
                           forward_devicerx_to_hostctrl, thread_ctx);
     assert(zmq_rv == 0);
-    zloop_reader_set_tolerant(thread_ctx->zloop, usrctx->device_rx_socket);
+    zloop_poller_set_tolerant(thread_ctx->zloop, &device_rx_item);
+
+    packet_batch_new(&usrctx->tx_batch, thread_ctx->zloop,
+                     hostiothread_send_to_hostctrl, thread_ctx);
 
     return OSD_OK;
 }
@@ -591,7 +956,7 @@ static osd_result hostiothread_destroy(struct worker_thread_ctx *thread_ctx)
     struct hostiothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    zsock_destroy(&usrctx->device_rx_socket);
+    packet_batch_free(&usrctx->tx_batch);
 
     free(usrctx->host_controller_address);
     free(usrctx);
@@ -622,6 +987,8 @@ osd_result osd_gateway_new(struct osd_gateway_ctx **ctx,
     c->device_disconnect_detected = false;
     // c->stats is 0-initialized by calloc above
 
+    packet_ring_new(&c->device_rx_ring, PACKET_RING_CAPACITY_DEFAULT_WORDS);
+
     // prepare custom data passed to I/O thread for host communication
     struct hostiothread_usr_ctx *hostiothread_usr_data =
         calloc(1, sizeof(struct hostiothread_usr_ctx));
@@ -633,12 +1000,15 @@ osd_result osd_gateway_new(struct osd_gateway_ctx **ctx,
     hostiothread_usr_data->device_subnet_addr = device_subnet_addr;
     hostiothread_usr_data->device_disconnect_detected =
             &c->device_disconnect_detected;
+    hostiothread_usr_data->device_rx_ring = c->device_rx_ring;
 
     // non-synchronized pointer to the statistics. Use with caution!
     hostiothread_usr_data->stats = &c->stats;
 
     rv = worker_new(&c->ioworker_ctx, log_ctx, hostiothread_init,
-                    hostiothread_destroy, hostiothread_handle_inproc_request,
+                    hostiothread_destroy, hostiothread_cmd_handlers,
+                    sizeof(hostiothread_cmd_handlers) /
+                        sizeof(hostiothread_cmd_handlers[0]),
                     hostiothread_usr_data);
     if (OSD_FAILED(rv)) {
         return rv;
@@ -657,14 +1027,15 @@ static osd_result connect_to_hostctrl(struct osd_gateway_ctx *ctx)
         return OSD_OK;
     }
 
-    rv = worker_main_send_status(ctx->ioworker_ctx, "I-CONNECT", 0);
+    rv = worker_main_send_status(ctx->ioworker_ctx, HOSTIOTHREAD_OP_CONNECT,
+                                 0);
     if (OSD_FAILED(rv)) {
         err(ctx->log_ctx, "Unable to send data to worker thread.");
         return OSD_ERROR_CONNECTION_FAILED;
     }
     int retval;
     rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
-                                "I-CONNECT-DONE", &retval);
+                                HOSTIOTHREAD_OP_CONNECT_DONE, &retval);
     if (OSD_FAILED(rv) || retval == -1) {
         err(ctx->log_ctx, "Unable to establish connection to host controller.");
         return OSD_ERROR_CONNECTION_FAILED;
@@ -682,10 +1053,7 @@ static osd_result connect_to_device(struct osd_gateway_ctx *ctx)
     int irv;
 
     // prepare device RX thread to read data from the device and forward it to
-    // the I/O thread. Forwarding is done through a inproc socket.
-    ctx->device_rx_socket = zsock_new_pair("@inproc://devicerx");
-    assert(ctx->device_rx_socket);
-
+    // the I/O thread through the device_rx_ring
     irv = pthread_create(&ctx->devicerxthread, NULL, devicerxthread_main,
                          (void *)ctx);
     assert(irv == 0);
@@ -736,11 +1104,12 @@ static osd_result disconnect_from_hostctrl(struct osd_gateway_ctx *ctx)
         return OSD_OK;
     }
 
-    rv = worker_main_send_status(ctx->ioworker_ctx, "I-DISCONNECT", 0);
+    rv = worker_main_send_status(ctx->ioworker_ctx,
+                                 HOSTIOTHREAD_OP_DISCONNECT, 0);
     if (rv != OSD_ERROR_NOT_CONNECTED) {
         osd_result retval;
         rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
-                                    "I-DISCONNECT-DONE", &retval);
+                                    HOSTIOTHREAD_OP_DISCONNECT_DONE, &retval);
         if (OSD_FAILED(rv)) {
             return rv;
         }
@@ -762,7 +1131,7 @@ static osd_result disconnect_from_device(struct osd_gateway_ctx *ctx)
         return OSD_OK;
     }
 
-    // end device RX thread and associated ZeroMQ socket
+    // end device RX thread
     struct timespec ts;
     int irv;
     void *retval;
@@ -788,8 +1157,6 @@ static osd_result disconnect_from_device(struct osd_gateway_ctx *ctx)
             "connection was dropped.");
     }
 
-    zsock_destroy(&ctx->device_rx_socket);
-
     ctx->is_connected_to_device = false;
 
     return OSD_OK;
@@ -822,14 +1189,78 @@ void osd_gateway_free(struct osd_gateway_ctx **ctx_p)
     }
 
     worker_free(&ctx->ioworker_ctx);
+    packet_ring_free(&ctx->device_rx_ring);
 
     free(ctx);
     *ctx_p = NULL;
 }
 
+API_EXPORT
+osd_result osd_gateway_set_packet_read_batch_fn(
+    struct osd_gateway_ctx *ctx, packet_read_batch_fn packet_read_batch)
+{
+    assert(ctx);
+
+    if (ctx->is_connected_to_device) {
+        err(ctx->log_ctx, "The read function cannot be changed while the "
+            "gateway is connected.");
+        return OSD_ERROR_FAILURE;
+    }
+
+    ctx->packet_read_batch = packet_read_batch;
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_gateway_set_packet_write_batch_fn(
+    struct osd_gateway_ctx *ctx, packet_write_batch_fn packet_write_batch)
+{
+    assert(ctx);
+
+    if (ctx->is_connected_to_hostctrl) {
+        err(ctx->log_ctx, "The write function cannot be changed while the "
+            "gateway is connected.");
+        return OSD_ERROR_FAILURE;
+    }
+
+    // the function is used on the hostiothread
+    worker_send_data(ctx->ioworker_ctx->inproc_socket,
+                     HOSTIOTHREAD_OP_SET_WRITE_BATCH_FN, &packet_write_batch,
+                     sizeof(packet_write_batch));
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_gateway_set_batch_policy(
+    struct osd_gateway_ctx *ctx, const struct osd_packet_batch_policy *policy)
+{
+    assert(ctx);
+    assert(policy);
+    assert((policy->max_packets <= 1 || policy->max_delay_us > 0) &&
+           "A maximum delay is required if batching is enabled.");
+
+    perform_outstanding_main_thread_tasks(ctx);
+
+    if (!ctx->ioworker_ctx->thread_is_running) {
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+    worker_send_data(ctx->ioworker_ctx->inproc_socket,
+                     HOSTIOTHREAD_OP_SET_BATCH_POLICY, policy,
+                     sizeof(struct osd_packet_batch_policy));
+
+    return OSD_OK;
+}
+
 API_EXPORT
 struct osd_gateway_transfer_stats*
 osd_gateway_get_transfer_stats(struct osd_gateway_ctx *ctx)
 {
+    struct packet_ring_stats ring_stats;
+    packet_ring_get_stats(ctx->device_rx_ring, &ring_stats);
+    ctx->stats.rx_queue_capacity_bytes = ring_stats.capacity_bytes;
+    ctx->stats.rx_queue_fill_bytes = ring_stats.fill_bytes;
+    ctx->stats.rx_queue_fill_max_bytes = ring_stats.fill_max_bytes;
+    ctx->stats.rx_queue_stalls = ring_stats.producer_stalls;
+
     return &ctx->stats;
 }
@@ -15,14 +15,27 @@
 
 #include <osd/gateway.h>
 #include <osd/gateway_glip.h>
+#include "byteorder.h"
+#include "dtd_parser.h"
 #include "osd-private.h"
 
 #include <assert.h>
-#include <byteswap.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
 
+/**
+ * Initial size of the write buffer: the largest possible DTD (length word +
+ * packet). The buffer grows if a batch of packets doesn't fit.
+ */
+#define GLIP_WRITE_BUF_SIZE_WORDS (1 + UINT16_MAX)
+
+/**
+ * Name of the option to set the number of bytes read from the device at once
+ */
+#define GLIP_OPTION_RX_CHUNK_SIZE "osd_rx_chunk_size"
+
 /**
  * GLIP gateway context
  */
@@ -35,6 +48,30 @@ struct osd_gateway_glip_ctx {
 
     /** OSD gateway context object */
     struct osd_gateway_ctx *gw_ctx;
+
+    /**
+     * Buffer for DTDs converted to big endian before writing them to the
+     * device
+     *
+     * Only accessed from the gateway's I/O thread.
+     */
+    uint16_t *write_buf;
+
+    /** Size of write_buf in uint16_t words */
+    size_t write_buf_size_words;
+
+    /**
+     * Parser for the DTD stream read from the device
+     *
+     * Only accessed from the gateway's device RX thread while connected.
+     */
+    struct dtd_parser *dtd_parser;
+
+    /** Number of bytes read from the device at once */
+    size_t rx_chunk_size;
+
+    /** Number of malformed DTDs reported in the log */
+    uint64_t rx_invalid_cnt_logged;
 };
 
 /**
@@ -64,99 +101,70 @@ static void glip_log_handler(struct glip_ctx *ctx, int priority,
 }
 
 /**
- * Read data from the device
+ * Read data from the device into the DTD parser
  *
- * @param buf a preallocated buffer for the read data
- * @param size_words number of uint16_t words to read from the device
- * @param flags currently unused, set to 0
+ * @param ctx the GLIP gateway context
+ * @param size_min read at least this number of bytes (blocking). If 0, read
+ *                 only data which is available without blocking.
  *
- * @return the number of uint16_t words read
- * @return -ENOTCONN if the connection was closed during the read
- * @return any other negative value indicates an error
+ * @return OSD_OK if successful
+ * @return OSD_ERROR_NOT_CONNECTED if the connection was closed during the read
+ * @return any other value indicates an error
  */
-static ssize_t device_read(struct glip_ctx *glip_ctx, uint16_t *buf,
-                           size_t size_words, int flags)
+static osd_result device_read(struct osd_gateway_glip_ctx *ctx,
+                              size_t size_min)
 {
     int rv;
-    ssize_t words_read;
-    size_t bytes_read;
 
-    uint16_t *buf_be;
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-    buf_be = malloc(size_words * sizeof(uint16_t));
-    if (!buf_be) {
-        return -1;
+    uint8_t *buf;
+    size_t buf_size;
+    size_t bytes_read = 0;
+    dtd_parser_get_rx_space(ctx->dtd_parser, &buf, &buf_size);
+
+    if (size_min == 0) {
+        if (buf_size == 0) {
+            return OSD_OK;
+        }
+        rv = glip_read(ctx->glip_ctx, 0, buf_size, buf, &bytes_read);
+    } else {
+        if (size_min > buf_size) {
+            size_min = buf_size;
+        }
+        rv = glip_read_b(ctx->glip_ctx, 0, size_min, buf, &bytes_read,
+                         0 /* timeout [ms]; 0 == never */);
     }
-#else
-    buf_be = buf;
-#endif
-
-    rv = glip_read_b(glip_ctx, 0, size_words * sizeof(uint16_t),
-                     (uint8_t *)buf_be, &bytes_read,
-                     0 /* timeout [ms]; 0 == never */);
     if (rv == -ENOTCONN || rv == -ECANCELED) {
-        words_read = -ENOTCONN;
-        goto free_return;
+        return OSD_ERROR_NOT_CONNECTED;
     } else if (rv != 0) {
-        words_read = -1;
-        goto free_return;
+        err(ctx->log_ctx, "Unable to read data from device (%d).", rv);
+        return OSD_ERROR_FAILURE;
     }
-    words_read = bytes_read / sizeof(uint16_t);
 
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-    for (ssize_t w = 0; w < words_read; w++) {
-        buf[w] = bswap_16(buf_be[w]);
-    }
-#endif
+    // GLIP and OSD are big endian, the parser converts the data
+    dtd_parser_rx_done(ctx->dtd_parser, bytes_read);
 
-free_return: ;
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-    free(buf_be);
-#endif
-    return words_read;
+    return OSD_OK;
 }
 
 /**
  * Write to the device
  *
- * @param buf data to write
- * @param size_words size of @p buf in uint16_t words
- * @param flags currently unused, set to 0
+ * @param buf_be data to write, in big endian byte order
+ * @param size_words size of @p buf_be in uint16_t words
  *
  * @return the number of uint16_t words written, if successful
  * @return -ENOTCONN if the device is not connected
  * @return any other negative value indicates an error
  */
-static ssize_t device_write(struct glip_ctx *glip_ctx, const uint16_t *buf,
-                            size_t size_words, int flags)
+static ssize_t device_write(struct osd_gateway_glip_ctx *ctx,
+                            const uint16_t *buf_be, size_t size_words)
 {
     size_t bytes_written;
     int rv;
 
-    // GLIP and OSD are big endian, |buf| is in native endianness
-    uint16_t *buf_be;
-
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-    buf_be = malloc(size_words * sizeof(uint16_t));
-    if (!buf_be) {
-        return -1;
-    }
-
-    for (size_t w = 0; w < size_words; w++) {
-        buf_be[w] = bswap_16(buf[w]);
-    }
-#else
-    buf_be = buf;
-#endif
-
-    rv = glip_write_b(glip_ctx, 0, size_words * sizeof(uint16_t),
+    rv = glip_write_b(ctx->glip_ctx, 0, size_words * sizeof(uint16_t),
                       (uint8_t *)buf_be, &bytes_written,
                       0 /* timeout [ms]; 0 == never */);
-
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-    free(buf_be);
-#endif
-
     if (rv == -ENOTCONN || rv == -ECANCELED) {
         return -ENOTCONN;
     } else if (rv != 0) {
@@ -167,6 +175,26 @@ static ssize_t device_write(struct glip_ctx *glip_ctx, const uint16_t *buf,
     return words_written;
 }
 
+/**
+ * Make sure the write buffer can hold at least @p size_words words
+ */
+static void write_buf_reserve(struct osd_gateway_glip_ctx *ctx,
+                              size_t size_words)
+{
+    if (size_words <= ctx->write_buf_size_words) {
+        return;
+    }
+
+    size_t new_size_words = 2 * ctx->write_buf_size_words;
+    if (new_size_words < size_words) {
+        new_size_words = size_words;
+    }
+    ctx->write_buf = realloc(ctx->write_buf,
+                             new_size_words * sizeof(uint16_t));
+    assert(ctx->write_buf);
+    ctx->write_buf_size_words = new_size_words;
+}
+
 /**
  * Initialize GLIP for device communication
  */
@@ -197,77 +225,143 @@ static struct glip_ctx* init_glip(struct osd_log_ctx *log_ctx,
     return glip_ctx;
 }
 
-static osd_result packet_read_from_device(struct osd_packet **pkg, void *cb_arg)
+/**
+ * Read all packets available from the device (at least one)
+ *
+ * Data is read from the device in chunks; all complete DTDs in the received
+ * data are returned at once.
+ */
+static osd_result packet_read_batch_from_device(struct osd_packet_view *pkgs,
+                                                size_t max_pkgs,
+                                                size_t *pkg_cnt, void *cb_arg)
 {
     osd_result rv;
-    ssize_t s_rv;
 
     struct osd_gateway_glip_ctx *gw_ctx = cb_arg;
     assert(gw_ctx);
 
-    // read packet size, which is transmitted as first word in a DTD
-    uint16_t pkg_size_words;
-    s_rv = device_read(gw_ctx->glip_ctx, &pkg_size_words, 1, 0);
-    if (s_rv == -ENOTCONN) {
-        return OSD_ERROR_NOT_CONNECTED;
-    } else if (s_rv != 1) {
-        err(gw_ctx->log_ctx, "Unable to read packet length from device (%zd).",
-            s_rv);
-        return OSD_ERROR_FAILURE;
+    // read everything which is available without blocking
+    rv = device_read(gw_ctx, 0);
+    if (OSD_FAILED(rv)) {
+        return rv;
     }
 
-    rv = osd_packet_new(pkg, pkg_size_words);
-    assert(OSD_SUCCEEDED(rv));
+    // wait until at least one DTD is complete
+    size_t bytes_missing;
+    while ((bytes_missing = dtd_parser_bytes_missing(gw_ctx->dtd_parser))) {
+        rv = device_read(gw_ctx, bytes_missing);
+        if (OSD_FAILED(rv)) {
+            return rv;
+        }
+    }
 
-    // read packet data
-    s_rv = device_read(gw_ctx->glip_ctx, (*pkg)->data_raw, pkg_size_words, 0);
-    if (s_rv == -ENOTCONN) {
-        return OSD_ERROR_NOT_CONNECTED;
-    } else if (s_rv != pkg_size_words) {
-        err(gw_ctx->log_ctx, "Unable to read packet data from device (%zd).",
-            s_rv);
-        return OSD_ERROR_FAILURE;
+    *pkg_cnt = dtd_parser_parse(gw_ctx->dtd_parser, pkgs, max_pkgs);
+
+    uint64_t invalid_cnt = dtd_parser_get_invalid_cnt(gw_ctx->dtd_parser);
+    if (invalid_cnt != gw_ctx->rx_invalid_cnt_logged) {
+        err(gw_ctx->log_ctx, "Dropped %" PRIu64 " malformed DTDs received "
+            "from device.", invalid_cnt - gw_ctx->rx_invalid_cnt_logged);
+        gw_ctx->rx_invalid_cnt_logged = invalid_cnt;
     }
 
 #ifdef DEBUG
-    osd_packet_log(*pkg, gw_ctx->log_ctx,
-                   "GLIP gateway: Read packet from device.");
+    for (size_t i = 0; i < *pkg_cnt; i++) {
+        struct osd_packet *pkg;
+        rv = osd_packet_new_from_view(&pkg, &pkgs[i]);
+        assert(OSD_SUCCEEDED(rv));
+        osd_packet_log(pkg, gw_ctx->log_ctx,
+                       "GLIP gateway: Read packet from device.");
+        osd_packet_free(&pkg);
+    }
 #endif
 
     return OSD_OK;
 }
 
-static osd_result packet_write_to_device(const struct osd_packet *pkg,
-                                         void *cb_arg)
+/**
+ * Read a single packet from the device
+ *
+ * The gateway uses packet_read_batch_from_device() to read from the device,
+ * this function is only provided as required fallback.
+ */
+static osd_result packet_read_from_device(struct osd_packet **pkg, void *cb_arg)
+{
+    osd_result rv;
+
+    struct osd_packet_view pkg_view;
+    size_t pkg_cnt;
+    do {
+        rv = packet_read_batch_from_device(&pkg_view, 1, &pkg_cnt, cb_arg);
+        if (OSD_FAILED(rv)) {
+            return rv;
+        }
+    } while (pkg_cnt == 0);
+
+    return osd_packet_new_from_view(pkg, &pkg_view);
+}
+
+/**
+ * Write packets to the device
+ *
+ * All packets are converted to DTDs in one contiguous buffer, which is then
+ * written to the device at once.
+ */
+static osd_result packet_write_batch_to_device(
+    const struct osd_packet_view *pkgs, size_t pkg_cnt, void *cb_arg)
 {
     ssize_t s_rv;
 
     struct osd_gateway_glip_ctx *gw_ctx = cb_arg;
     assert(gw_ctx);
 
+    size_t dtds_size_words = 0;
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        dtds_size_words += 1 /* len */ + pkgs[i].data_size_words;
+    }
+    write_buf_reserve(gw_ctx, dtds_size_words);
+
+    // GLIP and OSD are big endian, the packets are in native endianness
+    uint16_t *dtd = gw_ctx->write_buf;
+    for (size_t i = 0; i < pkg_cnt; i++) {
 #ifdef DEBUG
-    osd_packet_log(pkg, gw_ctx->log_ctx,
-                   "GLIP gateway: Writing packet to device.");
+        struct osd_packet *pkg;
+        osd_result rv = osd_packet_new_from_view(&pkg, &pkgs[i]);
+        assert(OSD_SUCCEEDED(rv));
+        osd_packet_log(pkg, gw_ctx->log_ctx,
+                       "GLIP gateway: Writing packet to device.");
+        osd_packet_free(&pkg);
 #endif
+        byteorder_native_to_be16(dtd, &pkgs[i].data_size_words, 1);
+        byteorder_native_to_be16(dtd + 1, pkgs[i].data_raw,
+                                 pkgs[i].data_size_words);
+        dtd += 1 + pkgs[i].data_size_words;
+    }
 
-    uint16_t *pkg_dtd = (uint16_t *)pkg;
-    size_t pkg_dtd_size_words = 1 /* len */ + pkg->data_size_words;
-
-    s_rv = device_write(gw_ctx->glip_ctx, pkg_dtd, pkg_dtd_size_words, 0);
+    s_rv = device_write(gw_ctx, gw_ctx->write_buf, dtds_size_words);
     if (s_rv == -ENOTCONN) {
         return OSD_ERROR_NOT_CONNECTED;
     } else if (s_rv < 0) {
-        err(gw_ctx->log_ctx, "Device write failed (%zu)", s_rv);
+        err(gw_ctx->log_ctx, "Device write failed (%zd)", s_rv);
         return OSD_ERROR_FAILURE;
-    } else if ((size_t)s_rv != pkg_dtd_size_words) {
+    } else if ((size_t)s_rv != dtds_size_words) {
         err(gw_ctx->log_ctx,
-            "Short write: requested device write of %zu bytes, wrote %zu bytes",
-            pkg_dtd_size_words, s_rv);
+            "Short write: requested device write of %zu words, wrote %zd "
+            "words", dtds_size_words, s_rv);
         return OSD_ERROR_FAILURE;
     }
     return OSD_OK;
 }
 
+static osd_result packet_write_to_device(const struct osd_packet *pkg,
+                                         void *cb_arg)
+{
+    struct osd_packet_view pkg_view = {
+        .data_size_words = pkg->data_size_words,
+        .data_raw = pkg->data_raw,
+    };
+    return packet_write_batch_to_device(&pkg_view, 1, cb_arg);
+}
+
 osd_result osd_gateway_glip_new(struct osd_gateway_glip_ctx **ctx,
                                 struct osd_log_ctx *log_ctx,
                                 const char *host_controller_address,
@@ -283,11 +377,43 @@ osd_result osd_gateway_glip_new(struct osd_gateway_glip_ctx **ctx,
     assert(c);
 
     c->log_ctx = log_ctx;
+    c->rx_chunk_size = DTD_PARSER_CHUNK_SIZE_DEFAULT;
+
+    // filter out options handled by the gateway itself
+    struct glip_option *glip_options =
+        calloc(glip_backend_options_len + 1, sizeof(struct glip_option));
+    assert(glip_options);
+    size_t glip_options_len = 0;
+    for (size_t i = 0; i < glip_backend_options_len; i++) {
+        const struct glip_option *opt = &glip_backend_options[i];
+        if (strcmp(opt->name, GLIP_OPTION_RX_CHUNK_SIZE) == 0) {
+            char *endptr;
+            errno = 0;
+            unsigned long chunk_size = strtoul(opt->value, &endptr, 0);
+            if (errno || *endptr != '\0' || chunk_size == 0 ||
+                chunk_size > DTD_PARSER_CHUNK_SIZE_MAX) {
+                err(log_ctx, "Invalid value for option %s: %s",
+                    GLIP_OPTION_RX_CHUNK_SIZE, opt->value);
+                free(glip_options);
+                free(c);
+                return OSD_ERROR_FAILURE;
+            }
+            c->rx_chunk_size = chunk_size;
+        } else {
+            glip_options[glip_options_len++] = *opt;
+        }
+    }
+
+    c->write_buf = malloc(GLIP_WRITE_BUF_SIZE_WORDS * sizeof(uint16_t));
+    assert(c->write_buf);
+    c->write_buf_size_words = GLIP_WRITE_BUF_SIZE_WORDS;
 
-    c->glip_ctx = init_glip(log_ctx, glip_backend_name, glip_backend_options,
-                            glip_backend_options_len);
+    c->glip_ctx = init_glip(log_ctx, glip_backend_name, glip_options,
+                            glip_options_len);
+    free(glip_options);
     if (!c->glip_ctx) {
         err(log_ctx, "Unable to initialize GLIP");
+        osd_gateway_glip_free(&c);
         return OSD_ERROR_FAILURE;
     }
 
@@ -296,10 +422,18 @@ osd_result osd_gateway_glip_new(struct osd_gateway_glip_ctx **ctx,
                          device_subnet_addr, packet_read_from_device,
                          packet_write_to_device, (void *)c);
     if (OSD_FAILED(rv)) {
+        osd_gateway_glip_free(&c);
         return rv;
     }
     assert(c->gw_ctx);
 
+    rv = osd_gateway_set_packet_read_batch_fn(c->gw_ctx,
+                                              packet_read_batch_from_device);
+    assert(OSD_SUCCEEDED(rv));
+    rv = osd_gateway_set_packet_write_batch_fn(c->gw_ctx,
+                                               packet_write_batch_to_device);
+    assert(OSD_SUCCEEDED(rv));
+
     *ctx = c;
 
     return OSD_OK;
@@ -326,6 +460,10 @@ osd_result osd_gateway_glip_connect(struct osd_gateway_glip_ctx *ctx)
 
     dbg(ctx->log_ctx, "Connected to device.");
 
+    // start with an empty receive buffer
+    dtd_parser_free(&ctx->dtd_parser);
+    dtd_parser_new(&ctx->dtd_parser, ctx->rx_chunk_size);
+
     // connect to host controller
     dbg(ctx->log_ctx, "Connecting to host controller");
     rv = osd_gateway_connect(ctx->gw_ctx);
@@ -368,10 +506,14 @@ void osd_gateway_glip_free(struct osd_gateway_glip_ctx **ctx_p)
     }
 
     osd_gateway_free(&ctx->gw_ctx);
-    glip_free(ctx->glip_ctx);
+    if (ctx->glip_ctx) {
+        glip_free(ctx->glip_ctx);
+    }
 
+    dtd_parser_free(&ctx->dtd_parser);
+    free(ctx->write_buf);
     free(ctx);
-    ctx_p = NULL;
+    *ctx_p = NULL;
 }
 
 bool osd_gateway_glip_is_connected(struct osd_gateway_glip_ctx *ctx)
@@ -13,17 +13,315 @@
  * limitations under the License.
  */
 
+/*
+ * Implementation Notes
+ * ====================
+ *
+ * Routing threads
+ * ---------------
+ *
+ * The host controller routes packets in one or more routing threads, each of
+ * which is a worker (see worker.h) owning one ZeroMQ ROUTER socket. ZeroMQ
+ * sockets cannot be shared between threads, therefore every routing thread
+ * binds to its own address (see hostctrl_router_address()), i.e. to one
+ * additional TCP port per additional routing thread. A host module or gateway
+ * is owned by the routing thread it connected to: all messages from it are
+ * received, and all messages to it are sent, by this thread.
+ *
+ * Subnet n is served by routing thread n modulo the number of routing threads.
+ * Gateways, and host modules exchanging most of their packets with one subnet
+ * (see osd_hostmod_set_target_subnet()), ask routing thread 0 for the routing
+ * thread serving their subnet ("ROUTER_THREAD <subnet>", answered with the
+ * index of the routing thread) and connect to it (see hostctrl_connect()).
+ * The packets of a subnet are therefore routed by a single routing thread,
+ * and the gateways of different subnets are spread over the routing threads.
+ *
+ * The routing tables (DI addresses of host modules and gateways of subnets)
+ * are shared by all routing threads. They are flat arrays of struct route,
+ * each of which contains the host address (the ZeroMQ routing id) as
+ * fixed-size blob. Lookups do not take a lock: a route is owned by the routing
+ * thread the host module or gateway is connected to, and only the owner reads
+ * or writes the host address. Other routing threads only read the (atomic)
+ * owner of the route. Changes to the tables are serialized by a mutex.
+ *
+ * Local DI addresses are allocated from a two-level bitmap, which finds the
+ * lowest unused address in constant time. To release the DI address of a host
+ * module without searching the routing table, each routing thread keeps a
+ * hash table mapping the host addresses of its host modules to their local DI
+ * addresses.
+ *
+ * A packet to a module owned by another routing thread is copied into a
+ * lock-free ring (struct packet_ring) between the two threads. The owning
+ * thread takes the packets out of the ring and sends them, consecutive packets
+ * to the same destination as one batch data message. A routing thread never
+ * waits for space in a ring: if the ring is full, the packet is dropped and
+ * counted (osd_hostctrl_get_stats()).
+ *
+ * Peer host controllers
+ * ---------------------
+ *
+ * Host controllers on different machines can be connected to each other
+ * ("peers"), each host controller owning a different subnet for its host
+ * modules. A host controller connects to the peers it is configured with
+ * (osd_hostctrl_add_peer()) with a DEALER socket ("link"); the peer sees this
+ * connection as a regular client on its ROUTER socket. Both sides use this
+ * single connection in both directions.
+ *
+ * Peers exchange the subnets they own: their own subnet, and the subnets of
+ * gateways which registered with them directly. Both sides send a
+ * "PEER_SUBNETS <own subnet> [<gateway subnet> ...]" management message
+ * with the complete list: the connecting side periodically (which also
+ * re-establishes the routes after a peer restarted), and the other side in
+ * response and whenever its subnets change. The receiver adds a gateway route
+ * to the peer for each listed subnet and removes the routes to subnets which
+ * are no longer listed. Subnets learned from a peer are not passed on to
+ * other peers, i.e. peers need to be connected directly to exchange packets.
+ *
+ * All peers are handled by routing thread 0: peers must connect to the base
+ * address of the host controller. Packets to peers can be batched
+ * (osd_hostctrl_set_peer_batch_policy()) to reduce the number of messages on
+ * the network.
+ *
+ * Event subscriptions
+ * -------------------
+ *
+ * A debug module sends its events to a single destination (EVENT_DEST).
+ * Additional host modules can subscribe to the events of a module
+ * ("EVENT_SUBSCRIBE <source DI address>"); the host controller then passes a
+ * copy of every EVENT packet of this source to each subscriber. The packets
+ * are not modified, i.e. their destination is still the EVENT_DEST of the
+ * source.
+ *
+ * The subscriptions are stored in a small shared table, together with a
+ * bitmap of all subscribed source addresses: packets from sources without
+ * subscribers are rejected with a single bit test. A subscriber is served by
+ * the routing thread owning it. A routing thread receiving a subscribed event
+ * from a host module, gateway or peer sends the copies to its own
+ * subscribers, and passes the packet to every other routing thread with
+ * subscribers (unless the packet is passed to this thread for delivery
+ * anyway). Packets received from other routing threads are only copied to the
+ * subscribers of the receiving thread.
+ *
+ * Copies are zmq_msg_copy()'s of the received message, which share the
+ * (reference counted) payload: a data message, or a batch whose packets all
+ * go to the subscriber, is not copied. Copies are never waited for. If the
+ * queue of a subscriber (the ZeroMQ send high water mark) is full, or the ring
+ * to another routing thread has no space, the copy is dropped. A slow
+ * subscriber therefore never delays the delivery to the EVENT_DEST or to
+ * other subscribers.
+ *
+ * Forwarding fast path
+ * --------------------
+ *
+ * Data messages are received into zmq_msg_t's on the stack, not into zmsg_t
+ * or zframe_t objects. Only the destination in the packet header is needed
+ * for routing, which is read in place from the received payload. The payload
+ * is then moved into the outgoing message (zmq_msg_send()), and the host
+ * address is sent directly from the routing table. Forwarding a data message,
+ * or a batch data message to a single destination, therefore doesn't allocate
+ * any memory in the host controller. Only packets which are split off a batch
+ * or passed between routing threads are copied into a new message.
+ */
+
 #include <osd/hostctrl.h>
 #include <osd/osd.h>
 #include <osd/packet.h>
+#include "hostctrl_client.h"
 #include "osd-private.h"
+#include "packet_batch.h"
+#include "packet_ring.h"
 #include "worker.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 
+/**
+ * Maximum number of routing threads
+ *
+ * Each pair of routing threads is connected by two rings, i.e. the memory
+ * used by the rings grows quadratically with the number of threads (16
+ * threads: 240 rings, 60 MiB).
+ */
+#define HOSTCTRL_ROUTER_THREADS_MAX 16
+
+/**
+ * Capacity of the rings between two routing threads in uint16_t words
+ *
+ * packet_ring_new() requires room for at least two maximum-sized packets.
+ */
+#define HOSTCTRL_SHARD_RING_CAPACITY_WORDS (128 * 1024)
+
+/**
+ * Maximum number of packets taken out of a ring at once
+ */
+#define HOSTCTRL_SHARD_FORWARD_MAX_PKGS 64
+
+/**
+ * Maximum number of chunks of packets taken out of a ring before returning
+ * to the event loop
+ */
+#define HOSTCTRL_SHARD_FORWARD_MAX_ROUNDS 16
+
+/**
+ * Maximum size of a host address (a ZeroMQ routing id) in bytes
+ */
+#define HOSTCTRL_HOSTADDR_MAX_SIZE 255
+
+/**
+ * Number of 64 bit words in the bitmap of used local DI addresses
+ */
+#define HOSTCTRL_DIADDR_BITMAP_WORDS ((OSD_DIADDR_LOCAL_MAX + 64) / 64)
+
+/**
+ * Number of slots in the hash table of host addresses of a routing thread
+ *
+ * A power of two, and at least twice the number of local DI addresses to keep
+ * the probe sequences short.
+ */
+#define HOSTCTRL_HOSTADDR_HASH_SLOTS 2048
+
+/**
+ * Interval in which the subnets are sent to peers we connected to in ms
+ */
+#define HOSTCTRL_PEER_REFRESH_INTERVAL_MS 1000
+
+/**
+ * Routing thread handling all peers
+ */
+#define HOSTCTRL_PEER_SHARD 0
+
+/**
+ * Maximum number of event subscriptions
+ */
+#define HOSTCTRL_SUBSCRIPTIONS_MAX 64
+
+/**
+ * Number of 64 bit words in the bitmap of subscribed source DI addresses
+ */
+#define HOSTCTRL_SUBSCRIBED_SRCS_WORDS ((UINT16_MAX + 1) / 64)
+
+/**
+ * Peer host controller
+ */
+struct peer {
+    /** Thread context of the routing thread handling the peer */
+    struct worker_thread_ctx *thread_ctx;
+
+    /** DEALER socket connected to the peer, or NULL if the peer connected
+     *  to us */
+    zsock_t *link_socket;
+
+    /** Host address of the peer on our ROUTER socket, or NULL if we
+     *  connected to the peer */
+    zframe_t *hostaddr;
+
+    /** Name of the peer for log messages */
+    char *name;
+
+    /** Subnet of the host modules of the peer, -1 until it is known */
+    int subnet_addr;
+
+    /** Subnets sent to the peer, one bit per subnet */
+    uint64_t advertised_subnets;
+
+    /** Have subnets been sent to the peer? */
+    bool advertised;
+
+    /** Batch builder for packets sent to the peer */
+    struct packet_batch *tx_batch;
+};
+
+/**
+ * Route to a host module, gateway, or peer host controller
+ *
+ * The host address and the peer are only accessed by the routing thread
+ * owning the route.
+ */
+struct route {
+    /** Index of the owning routing thread plus one, 0 if the route is unused
+     *  (accessed atomically) */
+    unsigned int owner;
+    /** Peer host controller, or NULL if the route points to hostaddr */
+    struct peer *peer;
+    /** Size of hostaddr in bytes */
+    uint8_t hostaddr_size;
+    /** Host address (ZeroMQ routing id on the ROUTER socket of the owner) */
+    uint8_t hostaddr[HOSTCTRL_HOSTADDR_MAX_SIZE];
+};
+
+/**
+ * Subscription of a host module to the events of a source DI address
+ *
+ * The key is written with router_shared.lock held and read by all routing
+ * threads without a lock. All other fields are only accessed by the routing
+ * thread owning the subscriber.
+ */
+struct subscription {
+    /** subscription_key() of the subscription, 0 if unused (accessed
+     *  atomically) */
+    uint64_t key;
+    /** Number of copies dropped since the last copy was sent */
+    uint64_t dropped;
+};
+
+/**
+ * State shared between all routing threads
+ */
+struct router_shared {
+    /** Number of routing threads */
+    unsigned int shard_cnt;
+
+    /** Our DI subnet address */
+    unsigned int subnet_addr;
+
+    /** Serializes changes to the routing tables */
+    pthread_mutex_t lock;
+
+    /** Debug modules registered in this subnet, indexed by local address */
+    struct route *mods_in_subnet;
+
+    /** Gateways registered in this subnet, indexed by subnet address */
+    struct route *gateways;
+
+    /** Used local DI addresses, one bit per address */
+    uint64_t diaddr_used[HOSTCTRL_DIADDR_BITMAP_WORDS];
+
+    /** Words in diaddr_used with at least one unused address, one bit per
+     *  word */
+    uint64_t diaddr_free_words;
+
+    /** Subnets of gateways registered with this host controller (not through
+     *  a peer), one bit per subnet (accessed atomically) */
+    uint64_t gateway_subnets;
+
+    /** Addresses of the peers to connect to (char *) */
+    zlist_t *peer_addresses;
+
+    /** Batch policy for packets sent to peers */
+    struct osd_packet_batch_policy peer_batch_policy;
+
+    /** Event subscriptions */
+    struct subscription subscriptions[HOSTCTRL_SUBSCRIPTIONS_MAX];
+
+    /** Source DI addresses with at least one subscription, one bit per
+     *  address (accessed atomically) */
+    uint64_t subscribed_srcs[HOSTCTRL_SUBSCRIBED_SRCS_WORDS];
+
+    /**
+     * Rings between the routing threads: rings[src * shard_cnt + dest]
+     * carries packets from shard src to shard dest (NULL if src == dest)
+     */
+    struct packet_ring **rings;
+
+    /** Number of packets dropped because the ring to the routing thread
+     *  owning their destination was full (accessed atomically) */
+    uint64_t shard_ring_dropped;
+};
+
 /**
  * Host Controller context
  */
@@ -34,447 +332,2268 @@ struct osd_hostctrl_ctx {
     /** DI subnet address */
     unsigned int subnet_addr;
 
-    /** I/O worker context */
-    struct worker_ctx *ioworker_ctx;
+    /** State shared between the routing threads */
+    struct router_shared *shared;
+
+    /** Number of routing threads */
+    unsigned int router_thread_cnt;
+
+    /** I/O worker context of each routing thread */
+    struct worker_ctx **ioworker_ctxs;
+
+    /** Address each routing thread binds to */
+    char **router_addresses;
 
     /** Is the router running? */
     bool is_running;
 };
 
+/**
+ * Opcodes of messages exchanged between the main thread and the I/O thread
+ */
+enum iothread_opcode {
+    IOTHREAD_OP_START = WORKER_OP_USER,
+    IOTHREAD_OP_START_DONE,
+    IOTHREAD_OP_STOP,
+    IOTHREAD_OP_STOP_DONE,
+};
+
 struct iothread_usr_ctx {
     /** Host controller router socket */
     zsock_t *router_socket;
 
-    /** ZeroMQ address/URL this host controller is bound to */
+    /** ZeroMQ address/URL this routing thread is bound to */
     char *router_address;
 
-    /** Our DI subnet address */
-    unsigned int subnet_addr;
+    /** Index of this routing thread */
+    unsigned int shard;
+
+    /** State shared between the routing threads */
+    struct router_shared *shared;
+
+    /** Poll items of the rings from other routing threads */
+    zmq_pollitem_t *shard_ring_items;
+
+    /** Number of packets to each routing thread dropped since the last
+     *  packet was passed to it */
+    uint64_t shard_dropped[HOSTCTRL_ROUTER_THREADS_MAX];
+
+    /**
+     * Local DI addresses of the host modules owned by this routing thread,
+     * hashed by their host address (open addressing with linear probing,
+     * 0 marks an empty slot). The host addresses are not stored in the hash
+     * table, but taken from the routing table.
+     */
+    uint16_t *mods_by_hostaddr;
+
+    /** Peer host controllers (struct peer *, routing thread 0 only) */
+    zlist_t *peers;
+
+    /** zloop timer to send the subnets to peers */
+    int peer_timer_id;
+};
+
+/**
+ * Get the routing thread owning a route
+ *
+ * @param route the route
+ * @param[out] shard the index of the routing thread owning the route
+ * @return true if the route is used, false otherwise
+ */
+static bool route_get_owner(const struct route *route, unsigned int *shard)
+{
+    unsigned int owner = __atomic_load_n(&route->owner, __ATOMIC_ACQUIRE);
+    if (owner == 0) {
+        return false;
+    }
+    *shard = owner - 1;
+    return true;
+}
+
+/**
+ * Is a route used?
+ */
+static bool route_is_used(const struct route *route)
+{
+    return __atomic_load_n(&route->owner, __ATOMIC_ACQUIRE) != 0;
+}
+
+/**
+ * Set an unused route to a host address on the socket of the calling routing
+ * thread
+ *
+ * The caller must hold router_shared.lock.
+ */
+static void route_set(struct route *route, unsigned int shard,
+                      const zframe_t *hostaddr)
+{
+    assert(!route_is_used(route));
+
+    size_t hostaddr_size = zframe_size((zframe_t *)hostaddr);
+    assert(hostaddr_size <= HOSTCTRL_HOSTADDR_MAX_SIZE);
+    memcpy(route->hostaddr, zframe_data((zframe_t *)hostaddr), hostaddr_size);
+    route->hostaddr_size = hostaddr_size;
+    route->peer = NULL;
+
+    // publish the host address together with the owner
+    __atomic_store_n(&route->owner, shard + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Set an unused route to a peer host controller handled by the calling
+ * routing thread
+ *
+ * The caller must hold router_shared.lock.
+ */
+static void route_set_peer(struct route *route, unsigned int shard,
+                           struct peer *peer)
+{
+    assert(!route_is_used(route));
+
+    route->peer = peer;
+    route->hostaddr_size = 0;
+
+    __atomic_store_n(&route->owner, shard + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Remove a route owned by the calling routing thread
+ *
+ * The caller must hold router_shared.lock.
+ */
+static void route_clear(struct route *route)
+{
+    __atomic_store_n(&route->owner, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Is a route pointing to a host address on the socket of the calling routing
+ * thread?
+ */
+static bool route_eq(const struct route *route, unsigned int shard,
+                     const zframe_t *hostaddr)
+{
+    unsigned int route_shard;
+    if (!route_get_owner(route, &route_shard) || route_shard != shard ||
+        route->peer) {
+        return false;
+    }
+    return route->hostaddr_size == zframe_size((zframe_t *)hostaddr) &&
+           !memcmp(route->hostaddr, zframe_data((zframe_t *)hostaddr),
+                   route->hostaddr_size);
+}
+
+/**
+ * Do two routes owned by the calling routing thread point to the same host
+ * address?
+ */
+static bool route_same_hostaddr(const struct route *a, const struct route *b)
+{
+    if (a == b) {
+        return true;
+    }
+    if (a->peer || b->peer) {
+        return a->peer == b->peer;
+    }
+    return a->hostaddr_size == b->hostaddr_size &&
+           !memcmp(a->hostaddr, b->hostaddr, a->hostaddr_size);
+}
+
+/**
+ * Get the key of a subscription
+ *
+ * @param shard the routing thread owning the subscriber
+ * @param src the subscribed source DI address
+ * @param subscriber the DI address of the subscriber
+ */
+static uint64_t subscription_key(unsigned int shard, unsigned int src,
+                                 unsigned int subscriber)
+{
+    return (1ULL << 63) | ((uint64_t)shard << 32) | ((uint64_t)src << 16) |
+           subscriber;
+}
+
+static unsigned int subscription_key_shard(uint64_t key)
+{
+    return (key >> 32) & 0xff;
+}
+
+static unsigned int subscription_key_src(uint64_t key)
+{
+    return (key >> 16) & 0xffff;
+}
+
+static unsigned int subscription_key_subscriber(uint64_t key)
+{
+    return key & 0xffff;
+}
+
+/**
+ * Does a source DI address have subscribers?
+ */
+static bool subscriptions_has_src(struct router_shared *shared,
+                                  unsigned int src)
+{
+    return __atomic_load_n(&shared->subscribed_srcs[src / 64],
+                           __ATOMIC_ACQUIRE) &
+           (1ULL << (src % 64));
+}
+
+/**
+ * Update the bit of a source DI address in router_shared.subscribed_srcs
+ *
+ * The caller must hold router_shared.lock.
+ */
+static void subscriptions_update_src(struct router_shared *shared,
+                                     unsigned int src)
+{
+    bool has_subscribers = false;
+    for (unsigned int i = 0; i < HOSTCTRL_SUBSCRIPTIONS_MAX; i++) {
+        uint64_t key = shared->subscriptions[i].key;
+        if (key && subscription_key_src(key) == src) {
+            has_subscribers = true;
+            break;
+        }
+    }
+
+    uint64_t bit = 1ULL << (src % 64);
+    if (has_subscribers) {
+        __atomic_or_fetch(&shared->subscribed_srcs[src / 64], bit,
+                          __ATOMIC_RELEASE);
+    } else {
+        __atomic_and_fetch(&shared->subscribed_srcs[src / 64], ~bit,
+                           __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Subscribe a host module to the events of a source DI address
+ *
+ * Subscribing twice to the same source is not an error.
+ *
+ * The caller must hold router_shared.lock.
+ *
+ * @return OSD_OK on success, OSD_ERROR_FAILURE if all subscriptions are in
+ *         use
+ */
+static osd_result subscription_add(struct router_shared *shared,
+                                   unsigned int shard, unsigned int src,
+                                   unsigned int subscriber)
+{
+    uint64_t key = subscription_key(shard, src, subscriber);
+
+    struct subscription *free_sub = NULL;
+    for (unsigned int i = 0; i < HOSTCTRL_SUBSCRIPTIONS_MAX; i++) {
+        struct subscription *sub = &shared->subscriptions[i];
+        if (sub->key == key) {
+            return OSD_OK;
+        }
+        if (!sub->key && !free_sub) {
+            free_sub = sub;
+        }
+    }
+    if (!free_sub) {
+        return OSD_ERROR_FAILURE;
+    }
+
+    free_sub->dropped = 0;
+    __atomic_store_n(&free_sub->key, key, __ATOMIC_RELEASE);
+    subscriptions_update_src(shared, src);
+
+    return OSD_OK;
+}
+
+/**
+ * Remove subscriptions of a host module
+ *
+ * The caller must hold router_shared.lock.
+ *
+ * @param shared the shared state
+ * @param src the subscribed source DI address, or -1 to remove all
+ *            subscriptions of @p subscriber
+ * @param subscriber the DI address of the subscriber
+ * @return the number of removed subscriptions
+ */
+static unsigned int subscriptions_remove(struct router_shared *shared, int src,
+                                         unsigned int subscriber)
+{
+    unsigned int removed = 0;
+    for (unsigned int i = 0; i < HOSTCTRL_SUBSCRIPTIONS_MAX; i++) {
+        struct subscription *sub = &shared->subscriptions[i];
+        uint64_t key = sub->key;
+        if (!key || subscription_key_subscriber(key) != subscriber ||
+            (src != -1 && subscription_key_src(key) != (unsigned int)src)) {
+            continue;
+        }
+
+        __atomic_store_n(&sub->key, 0, __ATOMIC_RELEASE);
+        subscriptions_update_src(shared, subscription_key_src(key));
+        removed++;
+    }
+    return removed;
+}
+
+/**
+ * Mark a local DI address as used or unused
+ *
+ * The caller must hold router_shared.lock.
+ */
+static void diaddr_set_used(struct router_shared *shared,
+                            unsigned int localaddr, bool used)
+{
+    unsigned int word = localaddr / 64;
+    uint64_t bit = 1ULL << (localaddr % 64);
+
+    if (used) {
+        shared->diaddr_used[word] |= bit;
+    } else {
+        shared->diaddr_used[word] &= ~bit;
+    }
+
+    if (shared->diaddr_used[word] == UINT64_MAX) {
+        shared->diaddr_free_words &= ~(1ULL << word);
+    } else {
+        shared->diaddr_free_words |= 1ULL << word;
+    }
+}
+
+/**
+ * Get the lowest available address in the local subnet and mark it as used
+ *
+ * The caller must hold router_shared.lock.
+ *
+ * @return OSD_OK on success, OSD_ERROR_FAILURE if all addresses are in use
+ */
+static osd_result get_available_diaddr(struct worker_thread_ctx *thread_ctx,
+                                       unsigned int *diaddr)
+{
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    if (!shared->diaddr_free_words) {
+        return OSD_ERROR_FAILURE;
+    }
+
+    unsigned int word = __builtin_ctzll(shared->diaddr_free_words);
+    unsigned int bit = __builtin_ctzll(~shared->diaddr_used[word]);
+    unsigned int localaddr = word * 64 + bit;
+    assert(localaddr <= OSD_DIADDR_LOCAL_MAX);
+    diaddr_set_used(shared, localaddr, true);
+
+    *diaddr = osd_diaddr_build(shared->subnet_addr, localaddr);
+    return OSD_OK;
+}
+
+static size_t hostaddr_hash(const uint8_t *data, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Find the hash table slot of the host module with a given host address
+ *
+ * @return the slot index, or -1 if no host module with this host address is
+ *         owned by this routing thread
+ */
+static ssize_t mods_by_hostaddr_find(struct iothread_usr_ctx *usrctx,
+                                     const zframe_t *hostaddr)
+{
+    size_t mask = HOSTCTRL_HOSTADDR_HASH_SLOTS - 1;
+    size_t i = hostaddr_hash(zframe_data((zframe_t *)hostaddr),
+                             zframe_size((zframe_t *)hostaddr)) &
+               mask;
+    while (usrctx->mods_by_hostaddr[i]) {
+        unsigned int localaddr = usrctx->mods_by_hostaddr[i];
+        if (route_eq(&usrctx->shared->mods_in_subnet[localaddr],
+                     usrctx->shard, hostaddr)) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+/**
+ * Add a host module owned by this routing thread to the hash table
+ *
+ * The route to @p localaddr must be set before.
+ */
+static void mods_by_hostaddr_add(struct iothread_usr_ctx *usrctx,
+                                 unsigned int localaddr)
+{
+    const struct route *route = &usrctx->shared->mods_in_subnet[localaddr];
+    size_t mask = HOSTCTRL_HOSTADDR_HASH_SLOTS - 1;
+    size_t i = hostaddr_hash(route->hostaddr, route->hostaddr_size) & mask;
+    while (usrctx->mods_by_hostaddr[i]) {
+        i = (i + 1) & mask;
+    }
+    usrctx->mods_by_hostaddr[i] = localaddr;
+}
+
+/**
+ * Remove a host module from the hash table
+ *
+ * The following entries in the probe sequence are shifted back to close the
+ * gap, no tombstones are left behind. The routes of all host modules in the
+ * hash table must still be set.
+ *
+ * @param usrctx the routing thread context
+ * @param slot the slot of the host module, see mods_by_hostaddr_find()
+ */
+static void mods_by_hostaddr_remove(struct iothread_usr_ctx *usrctx,
+                                    size_t slot)
+{
+    uint16_t *slots = usrctx->mods_by_hostaddr;
+    size_t mask = HOSTCTRL_HOSTADDR_HASH_SLOTS - 1;
+    size_t gap = slot;
+    size_t i = slot;
+
+    while (1) {
+        i = (i + 1) & mask;
+        if (!slots[i]) {
+            break;
+        }
+
+        const struct route *route = &usrctx->shared->mods_in_subnet[slots[i]];
+        size_t home = hostaddr_hash(route->hostaddr, route->hostaddr_size) &
+                      mask;
+        // the entry can be moved into the gap if its home slot is not
+        // (cyclically) between the gap and the entry
+        bool stays = gap <= i ? (gap < home && home <= i)
+                              : (gap < home || home <= i);
+        if (!stays) {
+            slots[gap] = slots[i];
+            gap = i;
+        }
+    }
+    slots[gap] = 0;
+}
+
+/**
+ * Register a host address for a given DI address
+ *
+ * The caller must hold router_shared.lock.
+ */
+static osd_result register_diaddr(struct worker_thread_ctx *thread_ctx,
+                                  const zframe_t *hostaddr, unsigned int diaddr)
+{
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    unsigned int localaddr = osd_diaddr_localaddr(diaddr);
+    if (route_is_used(&shared->mods_in_subnet[localaddr])) {
+        return OSD_ERROR_FAILURE;
+    }
+    route_set(&shared->mods_in_subnet[localaddr], usrctx->shard, hostaddr);
+
+#ifdef DEBUG
+    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+    dbg(thread_ctx->log_ctx,
+        "Registered diaddr %u.%u (%u) for host module %s on routing thread %u",
+        osd_diaddr_subnet(diaddr), osd_diaddr_localaddr(diaddr), diaddr,
+        hostaddr_str, usrctx->shard);
+    free(hostaddr_str);
+#endif
+
+    return OSD_OK;
+}
+
+/**
+ * Send a message to a peer
+ *
+ * This function is also the send function of the peer's batch builder.
+ *
+ * @param msg_p the message (without host address), ownership is passed to
+ *              this function
+ * @param peer_void the peer
+ */
+static void peer_send_msg(zmsg_t **msg_p, void *peer_void)
+{
+    struct peer *peer = peer_void;
+    assert(peer);
+    struct iothread_usr_ctx *usrctx = peer->thread_ctx->usr;
+    assert(usrctx);
+
+    int zmq_rv;
+    if (peer->link_socket) {
+        zmq_rv = zmsg_send(msg_p, peer->link_socket);
+    } else {
+        zframe_t *hostaddr = zframe_dup(peer->hostaddr);
+        zmq_rv = zmsg_prepend(*msg_p, &hostaddr);
+        assert(zmq_rv == 0);
+        zmq_rv = zmsg_send(msg_p, usrctx->router_socket);
+    }
+    if (zmq_rv != 0) {
+        err(peer->thread_ctx->log_ctx, "Unable to send message to peer %s.",
+            peer->name);
+        zmsg_destroy(msg_p);
+    }
+}
+
+/**
+ * Send a data message to a peer, batching the packets in it if enabled
+ *
+ * @param peer the peer
+ * @param type the message type ("D" or "B")
+ * @param payload the payload
+ */
+static void peer_send(struct peer *peer, const char *type, zmq_msg_t *payload)
+{
+    if (!packet_batch_is_enabled(peer->tx_batch)) {
+        zmsg_t *msg = zmsg_new();
+        assert(msg);
+        zmsg_addstr(msg, type);
+        zmsg_addmem(msg, zmq_msg_data(payload), zmq_msg_size(payload));
+        peer_send_msg(&msg, peer);
+        return;
+    }
+
+    struct osd_packet_view pkg;
+    if (type[0] == 'D') {
+        pkg.data_raw = zmq_msg_data(payload);
+        pkg.data_size_words = zmq_msg_size(payload) / sizeof(uint16_t);
+        packet_batch_add(peer->tx_batch, &pkg);
+        return;
+    }
+
+    struct packet_batch_iter iter;
+    packet_batch_iter_init_data(&iter, zmq_msg_data(payload),
+                                zmq_msg_size(payload));
+    while (packet_batch_iter_next(&iter, &pkg)) {
+        packet_batch_add(peer->tx_batch, &pkg);
+    }
+}
+
+/**
+ * Get the subnets owned by this host controller, one bit per subnet
+ *
+ * These are the subnet of the host modules and the subnets of all gateways
+ * registered directly with this host controller.
+ */
+static uint64_t local_subnets(struct router_shared *shared)
+{
+    return (1ULL << shared->subnet_addr) |
+           __atomic_load_n(&shared->gateway_subnets, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Send the subnets owned by this host controller to a peer
+ */
+static void peer_advertise(struct peer *peer)
+{
+    struct iothread_usr_ctx *usrctx = peer->thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    uint64_t subnets = local_subnets(shared);
+
+    // our own subnet is always listed first
+    char request[sizeof("PEER_SUBNETS") + (OSD_DIADDR_SUBNET_MAX + 1) * 3];
+    int len = snprintf(request, sizeof(request), "PEER_SUBNETS %u",
+                       shared->subnet_addr);
+    for (unsigned int subnet = 0; subnet <= OSD_DIADDR_SUBNET_MAX; subnet++) {
+        if (subnet != shared->subnet_addr && (subnets & (1ULL << subnet))) {
+            len += snprintf(request + len, sizeof(request) - len, " %u",
+                            subnet);
+        }
+    }
+    assert(len < (int)sizeof(request));
+
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+    zmsg_addstr(msg, "M");
+    zmsg_addstr(msg, request);
+    peer_send_msg(&msg, peer);
+
+    peer->advertised_subnets = subnets;
+    peer->advertised = true;
+}
+
+/**
+ * Send the subnets owned by this host controller to peers
+ *
+ * @param thread_ctx the thread context of the routing thread handling peers
+ * @param refresh send the subnets to all peers we connected to, even if they
+ *                did not change. Peers which connected to us get the subnets
+ *                as response to their own.
+ */
+static void peers_sync(struct worker_thread_ctx *thread_ctx, bool refresh)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    if (!usrctx->peers) {
+        return;
+    }
+
+    uint64_t subnets = local_subnets(usrctx->shared);
+    struct peer *peer;
+    for (peer = zlist_first(usrctx->peers); peer;
+         peer = zlist_next(usrctx->peers)) {
+        if ((refresh && peer->link_socket) || !peer->advertised ||
+            peer->advertised_subnets != subnets) {
+            peer_advertise(peer);
+        }
+    }
+}
+
+/**
+ * Update the routes to a peer to match the subnets it owns
+ *
+ * @param peer the peer
+ * @param subnets the subnets owned by the peer, one bit per subnet
+ */
+static void peer_update_routes(struct peer *peer, uint64_t subnets)
+{
+    struct worker_thread_ctx *thread_ctx = peer->thread_ctx;
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    pthread_mutex_lock(&shared->lock);
+    for (unsigned int subnet = 0; subnet <= OSD_DIADDR_SUBNET_MAX; subnet++) {
+        struct route *route = &shared->gateways[subnet];
+        unsigned int shard;
+        bool used = route_get_owner(route, &shard);
+        bool via_peer = used && shard == usrctx->shard && route->peer == peer;
+        bool owned_by_peer = subnets & (1ULL << subnet);
+
+        if (owned_by_peer && !used) {
+            if (subnet == shared->subnet_addr) {
+                err(thread_ctx->log_ctx,
+                    "Peer %s claims our own subnet %u, ignoring it.",
+                    peer->name, subnet);
+                continue;
+            }
+            route_set_peer(route, usrctx->shard, peer);
+            info(thread_ctx->log_ctx, "Routing subnet %u to peer %s.", subnet,
+                 peer->name);
+        } else if (owned_by_peer && !via_peer) {
+            err(thread_ctx->log_ctx,
+                "Peer %s claims subnet %u, which is already routed elsewhere. "
+                "Ignoring it.",
+                peer->name, subnet);
+        } else if (!owned_by_peer && via_peer) {
+            route_clear(route);
+            info(thread_ctx->log_ctx, "No longer routing subnet %u to peer %s.",
+                 subnet, peer->name);
+        }
+    }
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/**
+ * Parse the parameters of a PEER_SUBNETS management message
+ *
+ * @param params the parameters: the subnet of the peer's host modules,
+ *               followed by the subnets of its gateways
+ * @param[out] subnet_addr the subnet of the peer's host modules
+ * @param[out] subnets all subnets, one bit per subnet
+ */
+static osd_result parse_peer_subnets(const char *params,
+                                     unsigned int *subnet_addr,
+                                     uint64_t *subnets)
+{
+    *subnets = 0;
+    bool first = true;
+    while (*params) {
+        char *end;
+        unsigned long subnet = strtoul(params, &end, 10);
+        if (end == params || subnet > OSD_DIADDR_SUBNET_MAX ||
+            (*end && *end != ' ')) {
+            return OSD_ERROR_FAILURE;
+        }
+        if (first) {
+            *subnet_addr = subnet;
+            first = false;
+        }
+        *subnets |= 1ULL << subnet;
+        params = *end ? end + 1 : end;
+    }
+    return first ? OSD_ERROR_FAILURE : OSD_OK;
+}
+
+static void peer_free(struct peer **peer_p)
+{
+    struct peer *peer = *peer_p;
+    if (!peer) {
+        return;
+    }
+
+    // remove all routes to the peer
+    peer_update_routes(peer, 0);
+
+    packet_batch_flush(peer->tx_batch);
+    packet_batch_free(&peer->tx_batch);
+    if (peer->link_socket) {
+        zloop_reader_end(peer->thread_ctx->zloop, peer->link_socket);
+        zsock_destroy(&peer->link_socket);
+    }
+    zframe_destroy(&peer->hostaddr);
+    free(peer->name);
+    free(peer);
+    *peer_p = NULL;
+}
+
+static struct peer *peer_new(struct worker_thread_ctx *thread_ctx)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    struct peer *peer = calloc(1, sizeof(struct peer));
+    assert(peer);
+    peer->thread_ctx = thread_ctx;
+    peer->subnet_addr = -1;
+
+    packet_batch_new(&peer->tx_batch, thread_ctx->zloop, peer_send_msg, peer);
+    packet_batch_set_policy(peer->tx_batch,
+                            &usrctx->shared->peer_batch_policy);
+
+    int rv = zlist_append(usrctx->peers, peer);
+    assert(rv == 0);
+
+    return peer;
+}
+
+static void mgmt_send_ack(struct worker_thread_ctx *thread_ctx,
+                          const zframe_t *dest)
+{
+    assert(thread_ctx);
+    assert(dest);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_add(msg, zframe_dup_c(dest));
+    zmsg_addstr(msg, "M");
+    zmsg_addstr(msg, "ACK");
+    zmsg_send(&msg, usrctx->router_socket);
+}
+
+static void mgmt_send_nack(struct worker_thread_ctx *thread_ctx,
+                           const zframe_t *dest)
+{
+    assert(thread_ctx);
+    assert(dest);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_add(msg, zframe_dup_c(dest));
+    zmsg_addstr(msg, "M");
+    zmsg_addstr(msg, "NACK");
+    zmsg_send(&msg, usrctx->router_socket);
+}
+
+/**
+ * Assign a new DI address to a host module in our subnet
+ */
+static void mgmt_diaddr_request(struct worker_thread_ctx *thread_ctx,
+                                const zframe_t *hostaddr)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    osd_result rv;
+    unsigned int diaddr;
+
+    pthread_mutex_lock(&shared->lock);
+    rv = get_available_diaddr(thread_ctx, &diaddr);
+    if (OSD_FAILED(rv)) {
+        pthread_mutex_unlock(&shared->lock);
+        err(thread_ctx->log_ctx,
+            "Unable to assign a DI address: all %u addresses in subnet %u "
+            "are in use.",
+            OSD_DIADDR_LOCAL_MAX, shared->subnet_addr);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    rv = register_diaddr(thread_ctx, hostaddr, diaddr);
+    assert(OSD_SUCCEEDED(rv));
+    pthread_mutex_unlock(&shared->lock);
+
+    mods_by_hostaddr_add(usrctx, osd_diaddr_localaddr(diaddr));
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_add(msg, zframe_dup_c(hostaddr));
+    zmsg_addstr(msg, "M");
+    zmsg_addstrf(msg, "%u", diaddr);
+    zmsg_send(&msg, usrctx->router_socket);
+}
+
+static void mgmt_diaddr_release(struct worker_thread_ctx *thread_ctx,
+                                const zframe_t *hostaddr)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    ssize_t slot = mods_by_hostaddr_find(usrctx, hostaddr);
+    if (slot == -1) {
+        err(thread_ctx->log_ctx,
+            "Trying to release address for host which "
+            "isn't registered.");
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+    unsigned int localaddr = usrctx->mods_by_hostaddr[slot];
+    mods_by_hostaddr_remove(usrctx, slot);
+
+    pthread_mutex_lock(&shared->lock);
+    route_clear(&shared->mods_in_subnet[localaddr]);
+    diaddr_set_used(shared, localaddr, false);
+    subscriptions_remove(shared, -1,
+                         osd_diaddr_build(shared->subnet_addr, localaddr));
+    pthread_mutex_unlock(&shared->lock);
+
+#ifdef DEBUG
+    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+    dbg(thread_ctx->log_ctx, "Releasing address %u for host module %s\n",
+        localaddr, hostaddr_str);
+    free(hostaddr_str);
+#endif
+
+    return mgmt_send_ack(thread_ctx, hostaddr);
+}
+
+static void mgmt_gw_register(struct worker_thread_ctx *thread_ctx,
+                             const zframe_t *hostaddr, const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    char *end;
+
+    unsigned int subnet = strtol(params, &end, 10);
+    assert(!*end);
+    assert(subnet <= OSD_DIADDR_SUBNET_MAX);
+
+    pthread_mutex_lock(&shared->lock);
+    if (route_is_used(&shared->gateways[subnet])) {
+        pthread_mutex_unlock(&shared->lock);
+        err(thread_ctx->log_ctx, "A gateway for subnet %u is already "
+            "registered.", subnet);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    route_set(&shared->gateways[subnet], usrctx->shard, hostaddr);
+    __atomic_or_fetch(&shared->gateway_subnets, 1ULL << subnet,
+                      __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shared->lock);
+
+    // Peers handled by other routing threads are updated by their timer.
+    peers_sync(thread_ctx, false);
+
+#ifdef DEBUG
+    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+    dbg(thread_ctx->log_ctx,
+        "Registered gateway %s for subnet %u on routing thread %u",
+        hostaddr_str, subnet, usrctx->shard);
+    free(hostaddr_str);
+#endif
+
+    mgmt_send_ack(thread_ctx, hostaddr);
+}
+
+static void mgmt_gw_unregister(struct worker_thread_ctx *thread_ctx,
+                               const zframe_t *hostaddr, const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    char *end;
+
+    unsigned int subnet = strtol(params, &end, 10);
+    assert(!*end);
+    assert(subnet <= OSD_DIADDR_SUBNET_MAX);
+
+    pthread_mutex_lock(&shared->lock);
+    struct route *route = &shared->gateways[subnet];
+    if (!route_is_used(route)) {
+        pthread_mutex_unlock(&shared->lock);
+        err(thread_ctx->log_ctx, "No gateway registered for subnet %d.",
+            subnet);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    if (!route_eq(route, usrctx->shard, hostaddr)) {
+        pthread_mutex_unlock(&shared->lock);
+        char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+        err(thread_ctx->log_ctx,
+            "Host address %s is not registered as gateway "
+            "for subnet %u.",
+            hostaddr_str, subnet);
+        free(hostaddr_str);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    route_clear(route);
+    __atomic_and_fetch(&shared->gateway_subnets, ~(1ULL << subnet),
+                       __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shared->lock);
+
+    peers_sync(thread_ctx, false);
+
+#ifdef DEBUG
+    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+    dbg(thread_ctx->log_ctx, "Unregistered gateway %s for subnet %u",
+        hostaddr_str, subnet);
+    free(hostaddr_str);
+#endif
+
+    mgmt_send_ack(thread_ctx, hostaddr);
+}
+
+/**
+ * Parse the source DI address of an EVENT_SUBSCRIBE or EVENT_UNSUBSCRIBE
+ * request, and get the DI address of the requesting host module
+ */
+static osd_result mgmt_parse_subscription(struct worker_thread_ctx *thread_ctx,
+                                          const zframe_t *hostaddr,
+                                          const char *params,
+                                          unsigned int *src,
+                                          unsigned int *subscriber)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    char *end;
+    unsigned long src_diaddr = strtoul(params, &end, 10);
+    if (end == params || *end || src_diaddr > UINT16_MAX) {
+        err(thread_ctx->log_ctx, "Invalid source DI address '%s'.", params);
+        return OSD_ERROR_FAILURE;
+    }
+
+    ssize_t slot = mods_by_hostaddr_find(usrctx, hostaddr);
+    if (slot == -1) {
+        err(thread_ctx->log_ctx,
+            "Only host modules with a DI address can subscribe to events.");
+        return OSD_ERROR_FAILURE;
+    }
+
+    *src = src_diaddr;
+    *subscriber = osd_diaddr_build(shared->subnet_addr,
+                                   usrctx->mods_by_hostaddr[slot]);
+    return OSD_OK;
+}
+
+/**
+ * Subscribe a host module to the events of a source DI address
+ */
+static void mgmt_event_subscribe(struct worker_thread_ctx *thread_ctx,
+                                 const zframe_t *hostaddr, const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    osd_result rv;
+    unsigned int src, subscriber;
+
+    rv = mgmt_parse_subscription(thread_ctx, hostaddr, params, &src,
+                                 &subscriber);
+    if (OSD_FAILED(rv)) {
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    pthread_mutex_lock(&shared->lock);
+    rv = subscription_add(shared, usrctx->shard, src, subscriber);
+    pthread_mutex_unlock(&shared->lock);
+    if (OSD_FAILED(rv)) {
+        err(thread_ctx->log_ctx,
+            "Unable to subscribe %u to the events of %u: all %u "
+            "subscriptions are in use.",
+            subscriber, src, HOSTCTRL_SUBSCRIPTIONS_MAX);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    dbg(thread_ctx->log_ctx, "Subscribed %u to the events of %u.", subscriber,
+        src);
+
+    mgmt_send_ack(thread_ctx, hostaddr);
+}
+
+/**
+ * Remove the subscription of a host module to a source DI address
+ */
+static void mgmt_event_unsubscribe(struct worker_thread_ctx *thread_ctx,
+                                   const zframe_t *hostaddr,
+                                   const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    osd_result rv;
+    unsigned int src, subscriber;
+
+    rv = mgmt_parse_subscription(thread_ctx, hostaddr, params, &src,
+                                 &subscriber);
+    if (OSD_FAILED(rv)) {
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    pthread_mutex_lock(&shared->lock);
+    unsigned int removed = subscriptions_remove(shared, src, subscriber);
+    pthread_mutex_unlock(&shared->lock);
+    if (!removed) {
+        err(thread_ctx->log_ctx, "%u is not subscribed to the events of %u.",
+            subscriber, src);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    dbg(thread_ctx->log_ctx, "Unsubscribed %u from the events of %u.",
+        subscriber, src);
+
+    mgmt_send_ack(thread_ctx, hostaddr);
+}
+
+/**
+ * Update the subnets owned by a peer which connected to us
+ */
+static void mgmt_peer_subnets(struct worker_thread_ctx *thread_ctx,
+                              const zframe_t *hostaddr, const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    osd_result rv;
+
+    if (usrctx->shard != HOSTCTRL_PEER_SHARD) {
+        err(thread_ctx->log_ctx,
+            "Ignoring peer connected to routing thread %u, peers must "
+            "connect to routing thread %u.",
+            usrctx->shard, HOSTCTRL_PEER_SHARD);
+        return;
+    }
+
+    unsigned int subnet_addr;
+    uint64_t subnets;
+    rv = parse_peer_subnets(params, &subnet_addr, &subnets);
+    if (OSD_FAILED(rv)) {
+        err(thread_ctx->log_ctx, "Ignoring malformed PEER_SUBNETS %s.",
+            params);
+        return;
+    }
+
+    struct peer *peer;
+    for (peer = zlist_first(usrctx->peers); peer;
+         peer = zlist_next(usrctx->peers)) {
+        if (peer->hostaddr && zframe_eq_c(peer->hostaddr, hostaddr)) {
+            break;
+        }
+    }
+
+    if (!peer) {
+        // A peer reconnecting after a restart has a new host address: drop
+        // the previous connection.
+        struct peer *old_peer;
+        for (old_peer = zlist_first(usrctx->peers); old_peer;
+             old_peer = zlist_next(usrctx->peers)) {
+            if (old_peer->hostaddr &&
+                old_peer->subnet_addr == (int)subnet_addr) {
+                zlist_remove(usrctx->peers, old_peer);
+                peer_free(&old_peer);
+                break;
+            }
+        }
+
+        peer = peer_new(thread_ctx);
+        peer->hostaddr = zframe_dup((zframe_t *)hostaddr);
+        char *hostaddr_str = zframe_strhex(peer->hostaddr);
+        int asprintf_rv =
+            asprintf(&peer->name, "%s (subnet %u)", hostaddr_str, subnet_addr);
+        assert(asprintf_rv != -1);
+        free(hostaddr_str);
+        info(thread_ctx->log_ctx, "Peer %s connected.", peer->name);
+    }
+    peer->subnet_addr = subnet_addr;
+
+    peer_update_routes(peer, subnets);
+    peer_advertise(peer);
+}
+
+/**
+ * Tell a client which routing thread serves a subnet
+ */
+static void mgmt_router_thread(struct worker_thread_ctx *thread_ctx,
+                               const zframe_t *hostaddr, const char *params)
+{
+    assert(thread_ctx);
+    assert(hostaddr);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    char *end;
+    unsigned long subnet = strtoul(params, &end, 10);
+    if (end == params || *end || subnet > OSD_DIADDR_SUBNET_MAX) {
+        err(thread_ctx->log_ctx, "Invalid subnet '%s'.", params);
+        return mgmt_send_nack(thread_ctx, hostaddr);
+    }
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_add(msg, zframe_dup_c(hostaddr));
+    zmsg_addstr(msg, "M");
+    zmsg_addstrf(msg, "%lu", subnet % shared->shard_cnt);
+    zmsg_send(&msg, usrctx->router_socket);
+}
+
+/**
+ * Process an incoming management message (from the host modules)
+ *
+ * This function gains ownership of the passed zframe_t arguments and is
+ * expected to destroy and NULL them.
+ */
+static void process_mgmt_msg(struct worker_thread_ctx *thread_ctx,
+                             zframe_t **src_p, zframe_t **payload_frame_p)
+{
+    assert(thread_ctx);
+    assert(src_p);
+    assert(payload_frame_p);
+
+    zframe_t *src = *src_p;
+    assert(src);
+    zframe_t *payload_frame = *payload_frame_p;
+    assert(payload_frame);
+
+    char *request = zframe_strdup(payload_frame);
+    dbg(thread_ctx->log_ctx, "Received management message %s", request);
+
+    if (!strcmp(request, "DIADDR_REQUEST")) {
+        mgmt_diaddr_request(thread_ctx, src);
+    } else if (!strcmp(request, "DIADDR_RELEASE")) {
+        mgmt_diaddr_release(thread_ctx, src);
+    } else if (!strncmp(request, "GW_REGISTER", strlen("GW_REGISTER"))) {
+        mgmt_gw_register(thread_ctx, src, request + strlen("GW_REGISTER "));
+    } else if (!strncmp(request, "GW_UNREGISTER", strlen("GW_UNREGISTER"))) {
+        mgmt_gw_unregister(thread_ctx, src, request + strlen("GW_UNREGISTER "));
+    } else if (!strncmp(request, "ROUTER_THREAD ",
+                        strlen("ROUTER_THREAD "))) {
+        mgmt_router_thread(thread_ctx, src, request + strlen("ROUTER_THREAD "));
+    } else if (!strncmp(request, "PEER_SUBNETS ", strlen("PEER_SUBNETS "))) {
+        // no acknowledgement, the peer gets our subnets as response
+        mgmt_peer_subnets(thread_ctx, src, request + strlen("PEER_SUBNETS "));
+    } else if (!strncmp(request, "EVENT_SUBSCRIBE ",
+                        strlen("EVENT_SUBSCRIBE "))) {
+        mgmt_event_subscribe(thread_ctx, src,
+                             request + strlen("EVENT_SUBSCRIBE "));
+    } else if (!strncmp(request, "EVENT_UNSUBSCRIBE ",
+                        strlen("EVENT_UNSUBSCRIBE "))) {
+        mgmt_event_unsubscribe(thread_ctx, src,
+                               request + strlen("EVENT_UNSUBSCRIBE "));
+    } else {
+        mgmt_send_ack(thread_ctx, src);
+    }
+
+    free(request);
+    zframe_destroy(src_p);
+    zframe_destroy(payload_frame_p);
+}
+
+/**
+ * Get the routing table entry of a DI address
+ *
+ * The entry is returned whether it is used or not.
+ */
+static const struct route *route_find(struct router_shared *shared,
+                                      unsigned int diaddr)
+{
+    if (osd_diaddr_subnet(diaddr) == shared->subnet_addr) {
+        return &shared->mods_in_subnet[osd_diaddr_localaddr(diaddr)];
+    }
+    return &shared->gateways[osd_diaddr_subnet(diaddr)];
+}
+
+/**
+ * Look up the route a DI packet needs to take
+ *
+ * @param thread_ctx the thread context
+ * @param src the host address of the source of the packet (used for logging
+ *            only), or NULL if the packet was passed by another routing thread
+ *            or received from a peer we connected to
+ * @param dest_diaddr the destination DI address of the packet
+ * @param[out] shard the routing thread owning the route
+ * @return the route to the destination, or NULL if no route exists
+ */
+static const struct route *route_lookup(struct worker_thread_ctx *thread_ctx,
+                                        zmq_msg_t *src,
+                                        unsigned int dest_diaddr,
+                                        unsigned int *shard)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    unsigned int dest_diaddr_subnet = osd_diaddr_subnet(dest_diaddr);
+    unsigned int dest_diaddr_local = osd_diaddr_localaddr(dest_diaddr);
+
+    dbg(thread_ctx->log_ctx,
+        "Routing lookup for packet with destination %u.%u. Local subnet is %u.",
+        dest_diaddr_subnet, dest_diaddr_local, shared->subnet_addr);
+
+    const struct route *route = route_find(shared, dest_diaddr);
+    if (dest_diaddr_subnet == shared->subnet_addr) {
+        // routing inside our subnet
+        if (!route_get_owner(route, shard)) {
+            err(thread_ctx->log_ctx,
+                "No destination module registered for DI address %u.%u",
+                dest_diaddr_subnet, dest_diaddr_local);
+            return NULL;
+        }
+        dbg(thread_ctx->log_ctx,
+            "Destination address is local, routing directly to destination.");
+    } else {
+        // routing through a gateway
+        if (!route_get_owner(route, shard)) {
+            char *src_str;
+            if (src) {
+                zframe_t *src_frame =
+                    zframe_new(zmq_msg_data(src), zmq_msg_size(src));
+                src_str = zframe_strhex(src_frame);
+                zframe_destroy(&src_frame);
+            } else {
+                src_str = strdup("(forwarded)");
+            }
+            err(thread_ctx->log_ctx,
+                "No gateway for subnet %u registered to route DI address %u.%u, "
+                "packet coming from %s",
+                dest_diaddr_subnet, dest_diaddr_subnet, dest_diaddr_local,
+                src_str);
+            free(src_str);
+            return NULL;
+        }
+        dbg(thread_ctx->log_ctx,
+            "Destination address is in a different subnet, routing through "
+            "gateway.");
+    }
+
+    dbg(thread_ctx->log_ctx, "Routing data packet through routing thread %u",
+        *shard);
+
+    return route;
+}
+
+/**
+ * Send a data message to the host address of a route
+ *
+ * The route must be owned by the calling routing thread.
+ *
+ * @param thread_ctx the thread context
+ * @param route the route to the destination
+ * @param type the message type ("D" or "B")
+ * @param payload the payload, which is moved into the sent message (unless
+ *                the route points to a peer)
+ */
+static void route_send(struct worker_thread_ctx *thread_ctx,
+                       const struct route *route, const char *type,
+                       zmq_msg_t *payload)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    if (route->peer) {
+        peer_send(route->peer, type, payload);
+        return;
+    }
+
+    void *router_socket = zsock_resolve(usrctx->router_socket);
+    assert(router_socket);
+
+    int zmq_rv;
+    zmq_rv = zmq_send(router_socket, route->hostaddr, route->hostaddr_size,
+                      ZMQ_SNDMORE);
+    assert(zmq_rv == route->hostaddr_size);
+    zmq_rv = zmq_send(router_socket, type, strlen(type), ZMQ_SNDMORE);
+    assert(zmq_rv == (int)strlen(type));
+    zmq_rv = zmq_msg_send(payload, router_socket, 0);
+    assert(zmq_rv != -1);
+}
+
+/**
+ * Send packets to the host address of a route as one data message
+ *
+ * A single packet is sent as regular data message, multiple packets as batch
+ * data message.
+ */
+static void route_send_pkgs(struct worker_thread_ctx *thread_ctx,
+                            const struct route *route,
+                            const struct osd_packet_view *pkgs, size_t pkg_cnt)
+{
+    int zmq_rv;
+    zmq_msg_t payload;
+
+    if (pkg_cnt == 1) {
+        size_t size = pkgs[0].data_size_words * sizeof(uint16_t);
+        zmq_rv = zmq_msg_init_size(&payload, size);
+        assert(zmq_rv == 0);
+        memcpy(zmq_msg_data(&payload), pkgs[0].data_raw, size);
+        route_send(thread_ctx, route, "D", &payload);
+        zmq_msg_close(&payload);
+        return;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        size += (1 + pkgs[i].data_size_words) * sizeof(uint16_t);
+    }
+    zmq_rv = zmq_msg_init_size(&payload, size);
+    assert(zmq_rv == 0);
+
+    uint8_t *data = zmq_msg_data(&payload);
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        uint16_t data_size_words = pkgs[i].data_size_words;
+        memcpy(data, &data_size_words, sizeof(uint16_t));
+        data += sizeof(uint16_t);
+        memcpy(data, pkgs[i].data_raw, data_size_words * sizeof(uint16_t));
+        data += data_size_words * sizeof(uint16_t);
+    }
+    route_send(thread_ctx, route, "B", &payload);
+    zmq_msg_close(&payload);
+}
+
+/**
+ * Copy a part of a batch data message into a new message
+ *
+ * A single packet is copied as regular data message (without size word).
+ *
+ * @param[out] part the new message, initialized by this function
+ * @param batch the batch
+ * @param offset start of the part of the batch in bytes
+ * @param size size of the part of the batch in bytes
+ * @param pkg_cnt number of packets in the part of the batch
+ * @return the message type of @p part ("D" or "B")
+ */
+static const char *batch_part_copy(zmq_msg_t *part, zmq_msg_t *batch,
+                                   size_t offset, size_t size,
+                                   unsigned int pkg_cnt)
+{
+    const uint8_t *data = (const uint8_t *)zmq_msg_data(batch) + offset;
+    const char *type = "B";
+    if (pkg_cnt == 1) {
+        data += sizeof(uint16_t);
+        size -= sizeof(uint16_t);
+        type = "D";
+    }
+
+    int zmq_rv = zmq_msg_init_size(part, size);
+    assert(zmq_rv == 0);
+    memcpy(zmq_msg_data(part), data, size);
+    return type;
+}
+
+/**
+ * Consecutive packets of a message going to one subscriber
+ */
+struct fanout_run {
+    /** Start of the packets in the message in bytes */
+    size_t offset;
+    /** Size of the packets in bytes */
+    size_t size;
+    /** Number of packets */
+    unsigned int pkg_cnt;
+};
+
+/**
+ * Copies of a message to subscribers, see fanout_add()
+ */
+struct fanout {
+    /** The received message, or NULL for packets from other routing threads */
+    zmq_msg_t *msg;
+    /** Message type of msg ("D" or "B") */
+    const char *type;
+    /** Subscriptions with a run, one bit per subscription */
+    uint64_t active_runs;
+    /** Packets of msg for each subscription */
+    struct fanout_run runs[HOSTCTRL_SUBSCRIPTIONS_MAX];
+};
+
+/**
+ * Send a copy of an event to a subscriber owned by the calling routing thread
+ *
+ * The copy is dropped if the subscriber's queue is full.
+ *
+ * @param thread_ctx the thread context
+ * @param sub the subscription
+ * @param key the key of the subscription
+ * @param type the message type ("D" or "B")
+ * @param payload the payload, which is moved into the sent message
+ */
+static void fanout_send(struct worker_thread_ctx *thread_ctx,
+                        struct subscription *sub, uint64_t key,
+                        const char *type, zmq_msg_t *payload)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    unsigned int subscriber = subscription_key_subscriber(key);
+    const struct route *route =
+        &shared->mods_in_subnet[osd_diaddr_localaddr(subscriber)];
+    unsigned int shard;
+    if (!route_get_owner(route, &shard) || shard != usrctx->shard) {
+        return;
+    }
 
-    /** Debug modules registered in this subnet */
-    zframe_t **mods_in_subnet;
+    void *router_socket = zsock_resolve(usrctx->router_socket);
+    assert(router_socket);
 
-    /** Gateways registered in this subnet */
-    zframe_t **gateways;
-};
+    // Never wait for a subscriber: the socket is in ZMQ_ROUTER_MANDATORY
+    // mode, a full queue is reported as EAGAIN instead of blocking.
+    int zmq_rv;
+    zmq_rv = zmq_send(router_socket, route->hostaddr, route->hostaddr_size,
+                      ZMQ_SNDMORE | ZMQ_DONTWAIT);
+    if (zmq_rv == -1) {
+        if (sub->dropped++ == 0) {
+            err(thread_ctx->log_ctx,
+                "Subscriber %u cannot keep up with the events of %u, "
+                "dropping copies.",
+                subscriber, subscription_key_src(key));
+        }
+        return;
+    }
+    // the remaining parts are queued together with the first one
+    zmq_rv = zmq_send(router_socket, type, strlen(type), ZMQ_SNDMORE);
+    assert(zmq_rv == (int)strlen(type));
+    zmq_rv = zmq_msg_send(payload, router_socket, 0);
+    assert(zmq_rv != -1);
+
+    if (sub->dropped) {
+        info(thread_ctx->log_ctx,
+             "Subscriber %u is receiving the events of %u again, %" PRIu64
+             " copies were dropped.",
+             subscriber, subscription_key_src(key), sub->dropped);
+        sub->dropped = 0;
+    }
+}
 
 /**
- * Get an available address in the local subnet
+ * Send the packets of a run to the subscriber
  */
-static osd_result get_available_diaddr(struct worker_thread_ctx *thread_ctx,
-                                       unsigned int *diaddr)
+static void fanout_flush_run(struct worker_thread_ctx *thread_ctx,
+                             struct fanout *fanout, unsigned int idx)
 {
-    assert(thread_ctx);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct subscription *sub = &usrctx->shared->subscriptions[idx];
+    uint64_t key = __atomic_load_n(&sub->key, __ATOMIC_ACQUIRE);
+    struct fanout_run *run = &fanout->runs[idx];
 
-    unsigned int localaddr;
-    for (localaddr = 1; localaddr <= OSD_DIADDR_LOCAL_MAX; localaddr++) {
-        if (usrctx->mods_in_subnet[localaddr] == NULL) {
-            *diaddr = osd_diaddr_build(usrctx->subnet_addr, localaddr);
-            return OSD_OK;
-        }
+    fanout->active_runs &= ~(1ULL << idx);
+    if (!key) {
+        return;  // unsubscribed while the message was processed
     }
 
-    return OSD_ERROR_FAILURE;
+    int zmq_rv;
+    zmq_msg_t copy;
+    const char *type;
+    if (run->offset == 0 && run->size == zmq_msg_size(fanout->msg)) {
+        // all packets go to the subscriber: share the payload
+        zmq_rv = zmq_msg_init(&copy);
+        assert(zmq_rv == 0);
+        zmq_rv = zmq_msg_copy(&copy, fanout->msg);
+        assert(zmq_rv == 0);
+        type = fanout->type;
+    } else {
+        type = batch_part_copy(&copy, fanout->msg, run->offset, run->size,
+                               run->pkg_cnt);
+    }
+    fanout_send(thread_ctx, sub, key, type, &copy);
+    zmq_msg_close(&copy);
 }
 
 /**
- * Register a host address for a given DI address
+ * Pass a packet to another routing thread for its subscribers
+ *
+ * The packet is dropped if the ring to the routing thread is full.
  */
-static osd_result register_diaddr(struct worker_thread_ctx *thread_ctx,
-                                  const zframe_t *hostaddr, unsigned int diaddr)
+static void fanout_to_shard(struct worker_thread_ctx *thread_ctx,
+                            unsigned int dest_shard,
+                            const struct osd_packet_view *pkg)
 {
-    assert(thread_ctx);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
 
-    unsigned int localaddr = osd_diaddr_localaddr(diaddr);
-    if (usrctx->mods_in_subnet[localaddr] != NULL) {
-        return OSD_ERROR_FAILURE;
-    }
-    usrctx->mods_in_subnet[localaddr] = zframe_dup_c(hostaddr);
+    struct packet_ring *ring =
+        shared->rings[usrctx->shard * shared->shard_cnt + dest_shard];
+    assert(ring);
 
-#ifdef DEBUG
-    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
-    dbg(thread_ctx->log_ctx, "Registered diaddr %u.%u (%u) for host module %s",
-        osd_diaddr_subnet(diaddr), osd_diaddr_localaddr(diaddr), diaddr,
-        hostaddr_str);
-    free(hostaddr_str);
-#endif
+    if (!packet_ring_try_push(ring, pkg)) {
+        dbg(thread_ctx->log_ctx,
+            "Dropping copy of event to the subscribers of routing thread %u.",
+            dest_shard);
+    }
+}
 
-    return OSD_OK;
+/**
+ * Initialize the copies of a message to subscribers
+ *
+ * @param fanout the copies
+ * @param msg the received message, or NULL if the packets were passed by
+ *            another routing thread
+ * @param type the message type of @p msg ("D" or "B")
+ */
+static void fanout_init(struct fanout *fanout, zmq_msg_t *msg,
+                        const char *type)
+{
+    fanout->msg = msg;
+    fanout->type = type;
+    fanout->active_runs = 0;
 }
 
-static void mgmt_send_ack(struct worker_thread_ctx *thread_ctx,
-                          const zframe_t *dest)
+/**
+ * Pass copies of a packet to its subscribers
+ *
+ * Packets of a received message are added to a run for each subscriber owned
+ * by this routing thread, the runs are sent by fanout_flush(). Subscribers
+ * owned by other routing threads get the packet through these threads.
+ * Packets passed by another routing thread are sent to the subscribers owned
+ * by this thread immediately.
+ *
+ * @param thread_ctx the thread context
+ * @param fanout the copies of the message containing the packet
+ * @param pkg the packet
+ * @param offset offset of the packet in the message in bytes (including the
+ *               size word in batch data messages)
+ * @param size size of the packet in the message in bytes
+ * @param dest_shard the routing thread the packet is passed to for delivery
+ *                   (which passes it to its own subscribers), or -1 if the
+ *                   packet is not delivered
+ * @return true if the packet has subscribers owned by this routing thread
+ */
+static bool fanout_add(struct worker_thread_ctx *thread_ctx,
+                       struct fanout *fanout,
+                       const struct osd_packet_view *pkg, size_t offset,
+                       size_t size, int dest_shard)
 {
-    assert(thread_ctx);
-    assert(dest);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
 
-    zmsg_t *msg = zmsg_new();
-    zmsg_add(msg, zframe_dup_c(dest));
-    zmsg_addstr(msg, "M");
-    zmsg_addstr(msg, "ACK");
-    zmsg_send(&msg, usrctx->router_socket);
+    if (osd_packet_view_get_type(pkg) != OSD_PACKET_TYPE_EVENT) {
+        return false;
+    }
+    unsigned int src = osd_packet_view_get_src(pkg);
+    if (!subscriptions_has_src(shared, src)) {
+        return false;
+    }
+    unsigned int dest = osd_packet_view_get_dest(pkg);
+
+    bool local_subscribers = false;
+    uint64_t passed_to_shards = 0;
+    for (unsigned int i = 0; i < HOSTCTRL_SUBSCRIPTIONS_MAX; i++) {
+        struct subscription *sub = &shared->subscriptions[i];
+        uint64_t key = __atomic_load_n(&sub->key, __ATOMIC_ACQUIRE);
+        if (!key || subscription_key_src(key) != src ||
+            subscription_key_subscriber(key) == dest) {
+            continue;
+        }
+
+        unsigned int shard = subscription_key_shard(key);
+        if (shard != usrctx->shard) {
+            if (fanout->msg && (int)shard != dest_shard &&
+                !(passed_to_shards & (1ULL << shard))) {
+                fanout_to_shard(thread_ctx, shard, pkg);
+                passed_to_shards |= 1ULL << shard;
+            }
+            continue;
+        }
+        local_subscribers = true;
+
+        if (!fanout->msg) {
+            int zmq_rv;
+            zmq_msg_t copy;
+            size_t copy_size = pkg->data_size_words * sizeof(uint16_t);
+            zmq_rv = zmq_msg_init_size(&copy, copy_size);
+            assert(zmq_rv == 0);
+            memcpy(zmq_msg_data(&copy), pkg->data_raw, copy_size);
+            fanout_send(thread_ctx, sub, key, "D", &copy);
+            zmq_msg_close(&copy);
+            continue;
+        }
+
+        struct fanout_run *run = &fanout->runs[i];
+        if (fanout->active_runs & (1ULL << i)) {
+            if (run->offset + run->size == offset) {
+                run->size += size;
+                run->pkg_cnt++;
+                continue;
+            }
+            fanout_flush_run(thread_ctx, fanout, i);
+        }
+        run->offset = offset;
+        run->size = size;
+        run->pkg_cnt = 1;
+        fanout->active_runs |= 1ULL << i;
+    }
+
+    return local_subscribers;
 }
 
-static void mgmt_send_nack(struct worker_thread_ctx *thread_ctx,
-                           const zframe_t *dest)
+/**
+ * Send all copies of a received message to the subscribers
+ *
+ * Must be called before the message is moved into an outgoing message.
+ */
+static void fanout_flush(struct worker_thread_ctx *thread_ctx,
+                         struct fanout *fanout)
+{
+    while (fanout->active_runs) {
+        fanout_flush_run(thread_ctx, fanout,
+                         __builtin_ctzll(fanout->active_runs));
+    }
+}
+
+/**
+ * Send the packets other routing threads passed to this thread
+ *
+ * Packets to the same destination are sent together as one batch data
+ * message.
+ *
+ * @param thread_ctx the thread context
+ * @param ring the ring from another routing thread
+ * @param max_rounds maximum number of chunks of packets to process
+ * @return true if the ring is empty, false if packets are left in the ring
+ */
+static bool shard_ring_forward(struct worker_thread_ctx *thread_ctx,
+                               struct packet_ring *ring,
+                               unsigned int max_rounds)
 {
-    assert(thread_ctx);
-    assert(dest);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    zmsg_t *msg = zmsg_new();
-    zmsg_add(msg, zframe_dup_c(dest));
-    zmsg_addstr(msg, "M");
-    zmsg_addstr(msg, "NACK");
-    zmsg_send(&msg, usrctx->router_socket);
+    struct osd_packet_view pkgs[HOSTCTRL_SHARD_FORWARD_MAX_PKGS];
+
+    struct fanout fanout;
+    fanout_init(&fanout, NULL, NULL);
+
+    for (unsigned int round = 0; round < max_rounds; round++) {
+        size_t pkg_cnt = packet_ring_peek(ring, pkgs,
+                                          HOSTCTRL_SHARD_FORWARD_MAX_PKGS);
+        if (pkg_cnt == 0) {
+            if (packet_ring_consumer_sleep(ring)) {
+                return true;
+            }
+            continue;
+        }
+
+        // consecutive packets with the same route
+        const struct route *part_route = NULL;
+        size_t part_start = 0;
+        for (size_t i = 0; i <= pkg_cnt; i++) {
+            const struct route *route = NULL;
+            if (i < pkg_cnt) {
+                unsigned int dest = osd_packet_view_get_dest(&pkgs[i]);
+                unsigned int shard;
+                if (fanout_add(thread_ctx, &fanout, &pkgs[i], 0, 0, -1)) {
+                    // The packet might have been passed to this thread only
+                    // for its subscribers.
+                    route = route_find(usrctx->shared, dest);
+                    if (!route_get_owner(route, &shard) ||
+                        shard != usrctx->shard) {
+                        route = NULL;
+                    }
+                } else {
+                    route = route_lookup(thread_ctx, NULL, dest, &shard);
+                }
+                if (route && shard != usrctx->shard) {
+                    // The destination moved to another routing thread while
+                    // the packet was in the ring.
+                    err(thread_ctx->log_ctx,
+                        "Dropping packet to module %u which is no longer "
+                        "connected to routing thread %u.",
+                        dest, usrctx->shard);
+                    route = NULL;
+                }
+            }
+            if (i < pkg_cnt && route && route == part_route) {
+                continue;
+            }
+
+            if (part_route) {
+                route_send_pkgs(thread_ctx, part_route, &pkgs[part_start],
+                                i - part_start);
+            }
+            part_route = route;
+            part_start = i;
+        }
+
+        packet_ring_release(ring);
+    }
+
+    return false;
 }
 
 /**
- * Assign a new DI address to a host module in our subnet
+ * Handler inside a routing thread: send packets from other routing threads
+ *
+ * To keep the routing thread responsive while other routing threads pass
+ * packets continuously, the handler returns to the event loop after
+ * HOSTCTRL_SHARD_FORWARD_MAX_ROUNDS chunks of packets; it is called again
+ * immediately after other events are processed.
  */
-static void mgmt_diaddr_request(struct worker_thread_ctx *thread_ctx,
-                                const zframe_t *hostaddr)
+static int iothread_handle_shard_ring(zloop_t *loop, zmq_pollitem_t *item,
+                                      void *thread_ctx_void)
 {
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
     assert(thread_ctx);
-    assert(hostaddr);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    for (unsigned int src = 0; src < shared->shard_cnt; src++) {
+        struct packet_ring *ring =
+            shared->rings[src * shared->shard_cnt + usrctx->shard];
+        if (ring && packet_ring_get_fd(ring) == item->fd) {
+            shard_ring_forward(thread_ctx, ring,
+                               HOSTCTRL_SHARD_FORWARD_MAX_ROUNDS);
+            break;
+        }
+    }
 
-    osd_result rv;
-    unsigned int diaddr;
-    rv = get_available_diaddr(thread_ctx, &diaddr);
-    // XXX: Return error to host module instead of failing hard
-    assert(OSD_SUCCEEDED(rv));
-
-    rv = register_diaddr(thread_ctx, hostaddr, diaddr);
-    assert(OSD_SUCCEEDED(rv));
-
-    zmsg_t *msg = zmsg_new();
-    zmsg_add(msg, zframe_dup_c(hostaddr));
-    zmsg_addstr(msg, "M");
-    zmsg_addstrf(msg, "%u", diaddr);
-    zmsg_send(&msg, usrctx->router_socket);
+    return 0;
 }
 
-static void mgmt_diaddr_release(struct worker_thread_ctx *thread_ctx,
-                                const zframe_t *hostaddr)
+/**
+ * Pass a packet to the routing thread owning its destination
+ *
+ * The packet is dropped if the ring to the routing thread is full, like a
+ * packet to a host module whose queue is full. Waiting for space instead
+ * would stall this routing thread (and all other routing threads passing
+ * packets to it) behind the slowest one.
+ */
+static void route_to_shard(struct worker_thread_ctx *thread_ctx,
+                           unsigned int dest_shard,
+                           const struct osd_packet_view *pkg)
 {
-    assert(thread_ctx);
-    assert(hostaddr);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
 
-    unsigned int i, localaddr;
-    int found = 0;
-    for (i = 1; i < OSD_DIADDR_SUBNET_MAX; i++) {
-        if (zframe_eq_c(usrctx->mods_in_subnet[i], hostaddr)) {
-            localaddr = i;
-            found = 1;
-            break;
+    struct packet_ring *ring =
+        shared->rings[usrctx->shard * shared->shard_cnt + dest_shard];
+    assert(ring);
+
+    if (!packet_ring_try_push(ring, pkg)) {
+        __atomic_fetch_add(&shared->shard_ring_dropped, 1, __ATOMIC_RELAXED);
+        if (usrctx->shard_dropped[dest_shard]++ == 0) {
+            err(thread_ctx->log_ctx,
+                "Routing thread %u cannot keep up, dropping packets to it.",
+                dest_shard);
         }
+        return;
     }
-    if (!found) {
-        err(thread_ctx->log_ctx,
-            "Trying to release address for host which "
-            "isn't registered.");
-        return mgmt_send_nack(thread_ctx, hostaddr);
+
+    if (usrctx->shard_dropped[dest_shard]) {
+        info(thread_ctx->log_ctx,
+             "Passing packets to routing thread %u again, %" PRIu64
+             " packets were dropped.",
+             dest_shard, usrctx->shard_dropped[dest_shard]);
+        usrctx->shard_dropped[dest_shard] = 0;
     }
+}
 
-    zframe_destroy(&usrctx->mods_in_subnet[localaddr]);
+/**
+ * Get a view on the packet contained in a received message part
+ *
+ * @see osd_packet_view_from_zframe()
+ */
+static osd_result packet_view_from_msg(struct osd_packet_view *view,
+                                       zmq_msg_t *msg)
+{
+    size_t data_size_bytes = zmq_msg_size(msg);
+    if (data_size_bytes % sizeof(uint16_t) != 0 ||
+        data_size_bytes <
+            osd_packet_sizeconv_payload2data(0) * sizeof(uint16_t) ||
+        data_size_bytes > UINT16_MAX * sizeof(uint16_t)) {
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
 
-#ifdef DEBUG
-    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
-    dbg(thread_ctx->log_ctx, "Releasing address %u for host module %s\n",
-        localaddr, hostaddr_str);
-    free(hostaddr_str);
-#endif
+    view->data_raw = zmq_msg_data(msg);
+    view->data_size_words = data_size_bytes / sizeof(uint16_t);
 
-    return mgmt_send_ack(thread_ctx, hostaddr);
+    return OSD_OK;
 }
 
-static void mgmt_gw_register(struct worker_thread_ctx *thread_ctx,
-                             const zframe_t *hostaddr, const char *params)
+/**
+ * Route a DI data message to its destination
+ *
+ * @param thread_ctx the thread context
+ * @param src the host address of the sender, or NULL if the message was
+ *            received from a peer we connected to
+ * @param payload the packet. It is moved into the outgoing message if the
+ *                destination is owned by this routing thread.
+ */
+static void process_data_msg(struct worker_thread_ctx *thread_ctx,
+                             zmq_msg_t *src, zmq_msg_t *payload)
 {
     assert(thread_ctx);
-    assert(hostaddr);
+    assert(payload);
+
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    char *end;
+    osd_result rv;
 
-    unsigned int subnet = strtol(params, &end, 10);
-    assert(!*end);
-    assert(subnet <= OSD_DIADDR_SUBNET_MAX);
+    // Only the destination is needed for routing: inspect the packet in place
+    // and forward the received payload without copying it.
+    struct osd_packet_view pkg;
+    rv = packet_view_from_msg(&pkg, payload);
+    if (OSD_FAILED(rv)) {
+        err(thread_ctx->log_ctx, "Dropping invalid data packet (%d)", rv);
+        return;
+    }
 
-    if (usrctx->gateways[subnet] != NULL) {
-        err(thread_ctx->log_ctx, "A gateway for subnet %u is already "
-            "registered.", subnet);
-        return mgmt_send_nack(thread_ctx, hostaddr);
+    unsigned int shard;
+    const struct route *route =
+        route_lookup(thread_ctx, src, osd_packet_view_get_dest(&pkg), &shard);
+
+    // copies to subscribers share the payload before it is moved
+    struct fanout fanout;
+    fanout_init(&fanout, payload, "D");
+    fanout_add(thread_ctx, &fanout, &pkg, 0, zmq_msg_size(payload),
+               route ? (int)shard : -1);
+    fanout_flush(thread_ctx, &fanout);
+
+    if (!route) {
+        return;
     }
 
-    usrctx->gateways[subnet] = zframe_dup_c(hostaddr);
+    if (shard == usrctx->shard) {
+        route_send(thread_ctx, route, "D", payload);
+    } else {
+        route_to_shard(thread_ctx, shard, &pkg);
+    }
+}
 
-#ifdef DEBUG
-    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
-    dbg(thread_ctx->log_ctx, "Registered gateway %s for subnet %u",
-        hostaddr_str, subnet);
-    free(hostaddr_str);
-#endif
+/**
+ * Send a part of a batch to a destination
+ *
+ * @param thread_ctx the thread context
+ * @param route the route to the destination
+ * @param batch the batch. If the whole batch is sent, it is moved into the
+ *              outgoing message.
+ * @param offset start of the part of the batch in bytes
+ * @param size size of the part of the batch in bytes
+ * @param pkg_cnt number of packets in the part of the batch
+ */
+static void route_send_batch_part(struct worker_thread_ctx *thread_ctx,
+                                  const struct route *route, zmq_msg_t *batch,
+                                  size_t offset, size_t size,
+                                  unsigned int pkg_cnt)
+{
+    if (offset == 0 && size == zmq_msg_size(batch)) {
+        // all packets go to the same destination: forward the batch as-is
+        route_send(thread_ctx, route, "B", batch);
+        return;
+    }
 
-    mgmt_send_ack(thread_ctx, hostaddr);
+    // a single packet is sent as regular data message (without size word)
+    zmq_msg_t part;
+    const char *type = batch_part_copy(&part, batch, offset, size, pkg_cnt);
+    route_send(thread_ctx, route, type, &part);
+    zmq_msg_close(&part);
 }
 
-static void mgmt_gw_unregister(struct worker_thread_ctx *thread_ctx,
-                               const zframe_t *hostaddr, const char *params)
+/**
+ * Route a batch data message to its destination(s)
+ *
+ * Consecutive packets in the batch going to the same destination are
+ * forwarded as one batch. The batch is only split if the packets in it go to
+ * different destinations. Packets to destinations owned by other routing
+ * threads are passed to these threads one by one.
+ *
+ * @param thread_ctx the thread context
+ * @param src the host address of the sender, or NULL if the message was
+ *            received from a peer we connected to
+ * @param batch the batch. It is moved into the outgoing message if all
+ *              packets go to the same destination.
+ */
+static void process_batch_msg(struct worker_thread_ctx *thread_ctx,
+                              zmq_msg_t *src, zmq_msg_t *batch)
 {
     assert(thread_ctx);
-    assert(hostaddr);
+    assert(batch);
+
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    char *end;
+    // currently accumulated part of the batch
+    const struct route *part_route = NULL;
+    size_t part_offset = 0;
+    size_t part_size = 0;
+    unsigned int part_pkg_cnt = 0;
+
+    struct fanout fanout;
+    fanout_init(&fanout, batch, "B");
+
+    struct packet_batch_iter iter;
+    struct osd_packet_view pkg;
+    packet_batch_iter_init_data(&iter, zmq_msg_data(batch),
+                                zmq_msg_size(batch));
+    size_t pkg_offset = iter.offset;
+    while (packet_batch_iter_next(&iter, &pkg)) {
+        size_t pkg_size = iter.offset - pkg_offset;
+
+        unsigned int shard;
+        const struct route *route = route_lookup(
+            thread_ctx, src, osd_packet_view_get_dest(&pkg), &shard);
+        fanout_add(thread_ctx, &fanout, &pkg, pkg_offset, pkg_size,
+                   route ? (int)shard : -1);
+        if (route && shard != usrctx->shard) {
+            route_to_shard(thread_ctx, shard, &pkg);
+            route = NULL;
+        }
 
-    unsigned int subnet = strtol(params, &end, 10);
-    assert(!*end);
-    assert(subnet <= OSD_DIADDR_SUBNET_MAX);
+        bool same_dest =
+            part_route && route && route_same_hostaddr(part_route, route);
+        if (!same_dest) {
+            if (part_route) {
+                route_send_batch_part(thread_ctx, part_route, batch,
+                                      part_offset, part_size, part_pkg_cnt);
+            }
+            part_route = route;
+            part_offset = pkg_offset;
+            part_size = 0;
+            part_pkg_cnt = 0;
+        }
+        if (route) {
+            part_size += pkg_size;
+            part_pkg_cnt++;
+        }
 
-    if (usrctx->gateways[subnet] == NULL) {
-        err(thread_ctx->log_ctx, "No gateway registered for subnet %d.",
-            subnet);
-        return mgmt_send_nack(thread_ctx, hostaddr);
+        pkg_offset = iter.offset;
     }
-
-    if (!zframe_eq_c(usrctx->gateways[subnet], hostaddr)) {
-        char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
+    if (iter.invalid) {
         err(thread_ctx->log_ctx,
-            "Host address %s is not registered as gateway "
-            "for subnet %u.",
-            hostaddr_str, subnet);
-        free(hostaddr_str);
-        return mgmt_send_nack(thread_ctx, hostaddr);
+            "Dropping malformed remainder of batch data message.");
     }
+    fanout_flush(thread_ctx, &fanout);
+    if (part_route) {
+        route_send_batch_part(thread_ctx, part_route, batch, part_offset,
+                              part_size, part_pkg_cnt);
+    }
+}
 
-    zframe_destroy(&usrctx->gateways[subnet]);
-    usrctx->gateways[subnet] = NULL;
-
-#ifdef DEBUG
-    char *hostaddr_str = zframe_strhex((zframe_t *)hostaddr);
-    dbg(thread_ctx->log_ctx, "Unregistered gateway %s for subnet %u",
-        hostaddr_str, subnet);
-    free(hostaddr_str);
-#endif
+/**
+ * Receive a multi-part message
+ *
+ * Message parts beyond @p max_part_cnt are received and discarded.
+ *
+ * @param socket the socket to receive from
+ * @param parts initialized message parts to receive into
+ * @param max_part_cnt the number of elements in @p parts
+ * @return the number of parts of the received message, or -1 if receiving
+ *         failed
+ */
+static int recv_msg_parts(void *socket, zmq_msg_t *parts, int max_part_cnt)
+{
+    int zmq_rv;
+    int part_cnt = 0;
+    bool more = true;
+
+    zmq_msg_t discarded_part;
+    zmq_msg_init(&discarded_part);
+    while (more) {
+        zmq_msg_t *part =
+            part_cnt < max_part_cnt ? &parts[part_cnt] : &discarded_part;
+        zmq_rv = zmq_msg_recv(part, socket, 0);
+        if (zmq_rv == -1) {
+            part_cnt = -1;
+            break;
+        }
+        more = zmq_msg_more(part);
+        part_cnt++;
+    }
+    zmq_msg_close(&discarded_part);
 
-    mgmt_send_ack(thread_ctx, hostaddr);
+    return part_cnt;
 }
 
 /**
- * Process an incoming management message (from the host modules)
+ * Process incoming messages
  *
- * This function gains ownership of the passed zframe_t arguments and is
- * expected to destroy and NULL them.
+ * @return 0 if the message was processed, -1 if @p loop should be terminated
  */
-static void process_mgmt_msg(struct worker_thread_ctx *thread_ctx,
-                             zframe_t **src_p, zframe_t **payload_frame_p)
+static int iothread_handle_ext_msg(zloop_t *loop, zsock_t *reader,
+                                   void *thread_ctx_void)
 {
+    struct worker_thread_ctx *thread_ctx =
+        (struct worker_thread_ctx *)thread_ctx_void;
     assert(thread_ctx);
-    assert(src_p);
-    assert(payload_frame_p);
 
-    zframe_t *src = *src_p;
-    assert(src);
-    zframe_t *payload_frame = *payload_frame_p;
-    assert(payload_frame);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
 
-    char *request = zframe_strdup(payload_frame);
-    dbg(thread_ctx->log_ctx, "Received management message %s", request);
+    int retval = 0;
+
+    // Receive the message parts (source host address, type, payload) on the
+    // stack: data messages are routed without allocating memory.
+    zmq_msg_t parts[3];
+    for (int i = 0; i < 3; i++) {
+        zmq_msg_init(&parts[i]);
+    }
+    zmq_msg_t *src = &parts[0];
+    zmq_msg_t *type = &parts[1];
+    zmq_msg_t *payload = &parts[2];
+
+    int part_cnt = recv_msg_parts(zsock_resolve(reader), parts, 3);
+    if (part_cnt == -1) {
+        retval = -1;  // process was interrupted, terminate zloop
+        goto free_return;
+    }
+    if (part_cnt < 3) {
+        err(thread_ctx->log_ctx, "Ignoring message with %d parts.", part_cnt);
+        goto free_return;
+    }
 
-    if (!strcmp(request, "DIADDR_REQUEST")) {
-        mgmt_diaddr_request(thread_ctx, src);
-    } else if (!strcmp(request, "DIADDR_RELEASE")) {
-        mgmt_diaddr_release(thread_ctx, src);
-    } else if (!strncmp(request, "GW_REGISTER", strlen("GW_REGISTER"))) {
-        mgmt_gw_register(thread_ctx, src, request + strlen("GW_REGISTER "));
-    } else if (!strncmp(request, "GW_UNREGISTER", strlen("GW_UNREGISTER"))) {
-        mgmt_gw_unregister(thread_ctx, src, request + strlen("GW_UNREGISTER "));
+    char type_char =
+        zmq_msg_size(type) > 0 ? *(const char *)zmq_msg_data(type) : '\0';
+    if (type_char == 'M') {
+        zframe_t *src_frame = zframe_new(zmq_msg_data(src), zmq_msg_size(src));
+        zframe_t *payload_frame =
+            zframe_new(zmq_msg_data(payload), zmq_msg_size(payload));
+        process_mgmt_msg(thread_ctx, &src_frame, &payload_frame);
+    } else if (type_char == 'D') {
+        process_data_msg(thread_ctx, src, payload);
+    } else if (type_char == 'B') {
+        process_batch_msg(thread_ctx, src, payload);
     } else {
-        mgmt_send_ack(thread_ctx, src);
+        err(thread_ctx->log_ctx, "Ignoring message of unknown type '%.*s'.",
+            (int)zmq_msg_size(type), (const char *)zmq_msg_data(type));
     }
 
-    free(request);
-    zframe_destroy(src_p);
-    zframe_destroy(payload_frame_p);
+free_return:
+    for (int i = 0; i < 3; i++) {
+        zmq_msg_close(&parts[i]);
+    }
+    return retval;
 }
 
 /**
- * Route a DI data message to its destination
+ * Process messages received from a peer we connected to
  *
- * This function gains ownership of the passed zframe_t arguments and is
- * expected to destroy and NULL them.
+ * @return 0 if the message was processed, -1 if @p loop should be terminated
  */
-static void process_data_msg(struct worker_thread_ctx *thread_ctx,
-                             zframe_t **src_p, zframe_t **payload_frame_p)
+static int iothread_handle_link_msg(zloop_t *loop, zsock_t *reader,
+                                    void *thread_ctx_void)
 {
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
     assert(thread_ctx);
-    assert(src_p);
-    assert(payload_frame_p);
-
-    zframe_t *src = *src_p;
-    assert(src);
-    zframe_t *payload_frame = *payload_frame_p;
-    assert(payload_frame);
-
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    osd_result rv;
-
-    struct osd_packet *pkg = NULL;
-    rv = osd_packet_new_from_zframe(&pkg, payload_frame);
-    if (OSD_FAILED(rv)) {
-        err(thread_ctx->log_ctx, "Dropping invalid data packet (%d)", rv);
-        goto free_return;
+    struct peer *peer;
+    for (peer = zlist_first(usrctx->peers); peer;
+         peer = zlist_next(usrctx->peers)) {
+        if (peer->link_socket == reader) {
+            break;
+        }
     }
+    assert(peer);
 
-    unsigned int dest_diaddr_subnet =
-        osd_diaddr_subnet(osd_packet_get_dest(pkg));
-    unsigned int dest_diaddr_local =
-        osd_diaddr_localaddr(osd_packet_get_dest(pkg));
+    int retval = 0;
 
-    dbg(thread_ctx->log_ctx,
-        "Routing lookup for packet with destination %u.%u. Local subnet is %u.",
-        dest_diaddr_subnet, dest_diaddr_local, usrctx->subnet_addr);
+    // type, payload
+    zmq_msg_t parts[2];
+    for (int i = 0; i < 2; i++) {
+        zmq_msg_init(&parts[i]);
+    }
+    zmq_msg_t *type = &parts[0];
+    zmq_msg_t *payload = &parts[1];
 
-    const zframe_t *dest_hostaddr;
-    if (dest_diaddr_subnet == usrctx->subnet_addr) {
-        // routing inside our subnet
-        dest_hostaddr = usrctx->mods_in_subnet[dest_diaddr_local];
-        if (dest_hostaddr == NULL) {
+    int part_cnt = recv_msg_parts(zsock_resolve(reader), parts, 2);
+    if (part_cnt == -1) {
+        retval = -1;  // process was interrupted, terminate zloop
+        goto free_return;
+    }
+    if (part_cnt < 2) {
+        err(thread_ctx->log_ctx, "Ignoring message with %d parts from peer %s.",
+            part_cnt, peer->name);
+        goto free_return;
+    }
+
+    char type_char =
+        zmq_msg_size(type) > 0 ? *(const char *)zmq_msg_data(type) : '\0';
+    if (type_char == 'M') {
+        char *request = strndup(zmq_msg_data(payload), zmq_msg_size(payload));
+        assert(request);
+        unsigned int subnet_addr;
+        uint64_t subnets;
+        if (strncmp(request, "PEER_SUBNETS ", strlen("PEER_SUBNETS ")) ||
+            OSD_FAILED(parse_peer_subnets(request + strlen("PEER_SUBNETS "),
+                                          &subnet_addr, &subnets))) {
             err(thread_ctx->log_ctx,
-                "No destination module registered for DI address %u.%u",
-                dest_diaddr_subnet, dest_diaddr_local);
-            goto free_return;
+                "Ignoring unexpected management message %s from peer %s.",
+                request, peer->name);
+        } else {
+            peer->subnet_addr = subnet_addr;
+            peer_update_routes(peer, subnets);
         }
-        dbg(thread_ctx->log_ctx,
-            "Destination address is local, routing directly to destination.");
+        free(request);
+    } else if (type_char == 'D') {
+        process_data_msg(thread_ctx, NULL, payload);
+    } else if (type_char == 'B') {
+        process_batch_msg(thread_ctx, NULL, payload);
     } else {
-        // routing through a gateway
-        dest_hostaddr = usrctx->gateways[dest_diaddr_subnet];
-        if (dest_hostaddr == NULL) {
-            char* src_str = zframe_strhex(src);
-            err(thread_ctx->log_ctx,
-                "No gateway for subnet %u registered to route DI address %u.%u, "
-                "packet coming from %s",
-                dest_diaddr_subnet, dest_diaddr_subnet, dest_diaddr_local,
-                src_str);
-            free(src_str);
-            goto free_return;
-        }
-        dbg(thread_ctx->log_ctx,
-            "Destination address is in a different subnet, routing through "
-            "gateway.");
+        err(thread_ctx->log_ctx,
+            "Ignoring message of unknown type '%.*s' from peer %s.",
+            (int)zmq_msg_size(type), (const char *)zmq_msg_data(type),
+            peer->name);
     }
 
-#ifdef DEBUG
-    char *dest_hostaddr_str = zframe_strhex((zframe_t *)dest_hostaddr);
-    dbg(thread_ctx->log_ctx, "Routing data packet to %s", dest_hostaddr_str);
-    free(dest_hostaddr_str);
-#endif
-
-    int zmq_rv;
-    zmsg_t *msg = zmsg_new();
-    assert(msg);
-    zframe_t *dest_hostaddr_dup = zframe_dup_c(dest_hostaddr);
-    zmq_rv = zmsg_append(msg, &dest_hostaddr_dup);
-    assert(zmq_rv == 0);
-    zmq_rv = zmsg_addstr(msg, "D");
-    assert(zmq_rv == 0);
-    zmsg_append(msg, payload_frame_p);
-    assert(zmq_rv == 0);
-    zmq_rv = zmsg_send(&msg, usrctx->router_socket);
-    assert(zmq_rv == 0);
-
 free_return:
-    zframe_destroy(src_p);
-    zframe_destroy(payload_frame_p);
-    osd_packet_free(&pkg);
+    for (int i = 0; i < 2; i++) {
+        zmq_msg_close(&parts[i]);
+    }
+    return retval;
 }
 
 /**
- * Process incoming messages
- *
- * @return 0 if the message was processed, -1 if @p loop should be terminated
+ * Timer handler: send our subnets to the peers
  */
-static int iothread_handle_ext_msg(zloop_t *loop, zsock_t *reader,
-                                   void *thread_ctx_void)
+static int iothread_handle_peer_timer(zloop_t *loop, int timer_id,
+                                      void *thread_ctx_void)
 {
-    struct worker_thread_ctx *thread_ctx =
-        (struct worker_thread_ctx *)thread_ctx_void;
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
     assert(thread_ctx);
 
+    peers_sync(thread_ctx, true);
+    return 0;
+}
+
+/**
+ * Connect to the configured peers and start exchanging subnets with them
+ */
+static osd_result peers_start(struct worker_thread_ctx *thread_ctx)
+{
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
+
+    usrctx->peers = zlist_new();
+    assert(usrctx->peers);
+
+    int zmq_rv;
+    const char *address;
+    for (address = zlist_first(shared->peer_addresses); address;
+         address = zlist_next(shared->peer_addresses)) {
+        zsock_t *link_socket = zsock_new_dealer(address);
+        if (!link_socket) {
+            err(thread_ctx->log_ctx, "Unable to connect to peer %s.", address);
+            return OSD_ERROR_CONNECTION_FAILED;
+        }
 
-    zmsg_t *msg = zmsg_recv(reader);
-    if (!msg) {
-        return -1;  // process was interrupted, terminate zloop
+        struct peer *peer = peer_new(thread_ctx);
+        peer->link_socket = link_socket;
+        peer->name = strdup(address);
+        assert(peer->name);
+
+        zmq_rv = zloop_reader(thread_ctx->zloop, peer->link_socket,
+                              iothread_handle_link_msg, thread_ctx);
+        assert(zmq_rv == 0);
+        zloop_reader_set_tolerant(thread_ctx->zloop, peer->link_socket);
     }
 
-    zframe_t *src_frame = zmsg_pop(msg);
-    zframe_t *type_frame = zmsg_pop(msg);
-    char *type_str = zframe_strdup(type_frame);
+    usrctx->peer_timer_id =
+        zloop_timer(thread_ctx->zloop, HOSTCTRL_PEER_REFRESH_INTERVAL_MS, 0,
+                    iothread_handle_peer_timer, thread_ctx);
+    assert(usrctx->peer_timer_id != -1);
 
-    if (type_str[0] == 'M') {
-        zframe_t *payload_frame = zmsg_pop(msg);
-        process_mgmt_msg(thread_ctx, &src_frame, &payload_frame);
-        zframe_destroy(&payload_frame);
-    } else if (type_str[0] == 'D') {
-        zframe_t *payload_frame = zmsg_pop(msg);
-        process_data_msg(thread_ctx, &src_frame, &payload_frame);
-        zframe_destroy(&payload_frame);
-    } else {
-        err(thread_ctx->log_ctx, "Ignoring message of unknown type '%s'.",
-            type_str);
+    // the subnets are sent once the ROUTER socket is ready
+    return OSD_OK;
+}
+
+/**
+ * Disconnect from all peers
+ */
+static void peers_stop(struct worker_thread_ctx *thread_ctx)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    if (!usrctx->peers) {
+        return;
     }
 
-    free(type_str);
-    zframe_destroy(&src_frame);
-    zframe_destroy(&type_frame);
-    zmsg_destroy(&msg);
+    if (usrctx->peer_timer_id != -1) {
+        zloop_timer_end(thread_ctx->zloop, usrctx->peer_timer_id);
+        usrctx->peer_timer_id = -1;
+    }
 
-    return 0;
+    struct peer *peer;
+    while ((peer = zlist_pop(usrctx->peers))) {
+        peer_free(&peer);
+    }
+    zlist_destroy(&usrctx->peers);
 }
 
 /**
  * Start host controller router function in I/O thread
  *
- * This function is called by the worker as response to a I-START message.
- * It create a new ZeroMQ ROUTER socket acting as host controller and registers
- * an event handler function if new packages are received. After all startup
- * tasks are done a I-START-DONE message is sent to the main thread.
+ * This function is called by the worker as response to a IOTHREAD_OP_START
+ * message. It create a new ZeroMQ ROUTER socket acting as host controller and
+ * registers an event handler function if new packages are received. After all
+ * startup tasks are done a IOTHREAD_OP_START_DONE message is sent to the main
+ * thread.
  */
 static void iothread_router_start(struct worker_thread_ctx *thread_ctx)
 {
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
 
     osd_result retval;
 
+    if (usrctx->shard == HOSTCTRL_PEER_SHARD) {
+        retval = peers_start(thread_ctx);
+        if (OSD_FAILED(retval)) {
+            peers_stop(thread_ctx);
+            goto free_return;
+        }
+    }
+
     // create new ROUTER socket for host controller
     usrctx->router_socket = zsock_new_router(usrctx->router_address);
     if (!usrctx->router_socket) {
         err(thread_ctx->log_ctx, "Unable to bind to %s",
             usrctx->router_address);
+        peers_stop(thread_ctx);
         retval = OSD_ERROR_CONNECTION_FAILED;
         goto free_return;
     }
     zsock_set_rcvtimeo(usrctx->router_socket, ZMQ_RCV_TIMEOUT);
+    if (usrctx->shard != 0) {
+        info(thread_ctx->log_ctx, "Routing thread %u listening at %s.",
+             usrctx->shard, usrctx->router_address);
+    }
 
     // Don't silently drop unroutable messages
     zsock_set_router_mandatory(usrctx->router_socket, 1);
@@ -486,9 +2605,30 @@ static void iothread_router_start(struct worker_thread_ctx *thread_ctx)
     assert(zmq_rv == 0);
     zloop_reader_set_tolerant(thread_ctx->zloop, usrctx->router_socket);
 
+    // register event handlers for packets from other routing threads
+    for (unsigned int src = 0; src < shared->shard_cnt; src++) {
+        struct packet_ring *ring =
+            shared->rings[src * shared->shard_cnt + usrctx->shard];
+        if (!ring) {
+            continue;
+        }
+        usrctx->shard_ring_items[src] = (zmq_pollitem_t){
+            .fd = packet_ring_get_fd(ring),
+            .events = ZMQ_POLLIN,
+        };
+        zmq_rv = zloop_poller(thread_ctx->zloop, &usrctx->shard_ring_items[src],
+                              iothread_handle_shard_ring, thread_ctx);
+        assert(zmq_rv == 0);
+        zloop_poller_set_tolerant(thread_ctx->zloop,
+                                  &usrctx->shard_ring_items[src]);
+    }
+
+    peers_sync(thread_ctx, true);
+
     retval = OSD_OK;
 free_return:
-    worker_send_status(thread_ctx->inproc_socket, "I-START-DONE", retval);
+    worker_send_status(thread_ctx->inproc_socket, IOTHREAD_OP_START_DONE,
+                       retval);
 }
 
 /**
@@ -498,101 +2638,222 @@ static void iothread_router_stop(struct worker_thread_ctx *thread_ctx)
 {
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
+    struct router_shared *shared = usrctx->shared;
 
     osd_result retval;
 
+    peers_stop(thread_ctx);
+
+    for (unsigned int src = 0; src < shared->shard_cnt; src++) {
+        if (shared->rings[src * shared->shard_cnt + usrctx->shard]) {
+            zloop_poller_end(thread_ctx->zloop,
+                             &usrctx->shard_ring_items[src]);
+        }
+    }
+
     zloop_reader_end(thread_ctx->zloop, usrctx->router_socket);
     zsock_destroy(&usrctx->router_socket);
 
     retval = OSD_OK;
 
-    worker_send_status(thread_ctx->inproc_socket, "I-STOP-DONE", retval);
+    worker_send_status(thread_ctx->inproc_socket, IOTHREAD_OP_STOP_DONE,
+                       retval);
 }
 
-static osd_result iothread_handle_inproc_msg(
-    struct worker_thread_ctx *thread_ctx, const char *name, zmsg_t *msg)
+static osd_result iothread_handle_start(struct worker_thread_ctx *thread_ctx,
+                                        zmsg_t **msg_p)
 {
-    struct thread_ctx_usr *usrctx = thread_ctx->usr;
-    assert(usrctx);
-
-    // we don't use |msg|, but we gained ownership -- destroy it!
-    zmsg_destroy(&msg);
-
-    if (!strcmp(name, "I-START")) {
-        iothread_router_start(thread_ctx);
-
-    } else if (!strcmp(name, "I-STOP")) {
-        iothread_router_stop(thread_ctx);
-
-    } else {
-        assert(0 && "Received unknown message from main thread.");
-    }
+    iothread_router_start(thread_ctx);
+    return OSD_OK;
+}
 
+static osd_result iothread_handle_stop(struct worker_thread_ctx *thread_ctx,
+                                       zmsg_t **msg_p)
+{
+    iothread_router_stop(thread_ctx);
     return OSD_OK;
 }
 
+/**
+ * Handlers for messages from the main thread
+ */
+static const struct worker_cmd_handler iothread_cmd_handlers[] = {
+    { IOTHREAD_OP_START, iothread_handle_start },
+    { IOTHREAD_OP_STOP, iothread_handle_stop },
+};
+
 static osd_result iothread_destroy(struct worker_thread_ctx *thread_ctx)
 {
     assert(thread_ctx);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    for (unsigned int l = 1; l <= OSD_DIADDR_LOCAL_MAX; l++) {
-        zframe_destroy(&usrctx->mods_in_subnet[l]);
-    }
-    free(usrctx->mods_in_subnet);
-
+    free(usrctx->mods_by_hostaddr);
+    free(usrctx->shard_ring_items);
     free(usrctx->router_address);
-    free(usrctx->gateways);
     free(usrctx);
     thread_ctx->usr = NULL;
 
     return OSD_OK;
 }
 
+static void router_shared_new(struct router_shared **shared_p,
+                              unsigned int shard_cnt)
+{
+    struct router_shared *shared = calloc(1, sizeof(struct router_shared));
+    assert(shared);
+
+    shared->shard_cnt = shard_cnt;
+
+    // Our subnet, see osd_hostctrl_set_subnet_addr()
+    shared->subnet_addr = 1;
+
+    int rv = pthread_mutex_init(&shared->lock, NULL);
+    assert(rv == 0);
+
+    // allocate routing lookup tables
+    // mods_in_subnet is 1024 * 260B = 260 kB
+    shared->mods_in_subnet =
+        calloc(OSD_DIADDR_LOCAL_MAX + 1, sizeof(struct route));
+    assert(shared->mods_in_subnet);
+    // gateways is 64 * 260B = 16 kB
+    shared->gateways = calloc(OSD_DIADDR_SUBNET_MAX + 1, sizeof(struct route));
+    assert(shared->gateways);
+
+    shared->peer_addresses = zlist_new();
+    assert(shared->peer_addresses);
+    zlist_autofree(shared->peer_addresses);
+    shared->peer_batch_policy = OSD_PACKET_BATCH_POLICY_NONE;
+
+    // local address 0 is never assigned
+    for (unsigned int w = 0; w < HOSTCTRL_DIADDR_BITMAP_WORDS; w++) {
+        diaddr_set_used(shared, w * 64, w == 0);
+    }
+
+    shared->rings = calloc(shard_cnt * shard_cnt, sizeof(struct packet_ring *));
+    assert(shared->rings);
+    for (unsigned int src = 0; src < shard_cnt; src++) {
+        for (unsigned int dest = 0; dest < shard_cnt; dest++) {
+            if (src != dest) {
+                packet_ring_new(&shared->rings[src * shard_cnt + dest],
+                                HOSTCTRL_SHARD_RING_CAPACITY_WORDS);
+            }
+        }
+    }
+
+    *shared_p = shared;
+}
+
+static void router_shared_free(struct router_shared **shared_p)
+{
+    struct router_shared *shared = *shared_p;
+    if (!shared) {
+        return;
+    }
+
+    free(shared->mods_in_subnet);
+    free(shared->gateways);
+    zlist_destroy(&shared->peer_addresses);
+
+    for (unsigned int i = 0; i < shared->shard_cnt * shared->shard_cnt; i++) {
+        packet_ring_free(&shared->rings[i]);
+    }
+    free(shared->rings);
+
+    pthread_mutex_destroy(&shared->lock);
+
+    free(shared);
+    *shared_p = NULL;
+}
+
 API_EXPORT
 osd_result osd_hostctrl_new(struct osd_hostctrl_ctx **ctx,
                             struct osd_log_ctx *log_ctx,
                             const char *router_address)
+{
+    return osd_hostctrl_new_with_options(ctx, log_ctx, router_address, NULL);
+}
+
+API_EXPORT
+osd_result osd_hostctrl_new_with_options(
+    struct osd_hostctrl_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *router_address, const struct osd_hostctrl_options *options)
 {
     osd_result rv;
 
+    struct osd_hostctrl_options default_options = {
+        .router_threads = 1,
+    };
+    if (!options) {
+        options = &default_options;
+    }
+    if (options->router_threads < 1 ||
+        options->router_threads > HOSTCTRL_ROUTER_THREADS_MAX) {
+        err(log_ctx, "The number of routing threads must be between 1 and %u.",
+            HOSTCTRL_ROUTER_THREADS_MAX);
+        return OSD_ERROR_FAILURE;
+    }
+
     struct osd_hostctrl_ctx *c = calloc(1, sizeof(struct osd_hostctrl_ctx));
     assert(c);
 
     c->log_ctx = log_ctx;
     c->is_running = false;
+    c->router_thread_cnt = options->router_threads;
+
+    c->router_addresses = calloc(c->router_thread_cnt, sizeof(char *));
+    assert(c->router_addresses);
+    for (unsigned int i = 0; i < c->router_thread_cnt; i++) {
+        rv = hostctrl_router_address(router_address, i,
+                                     &c->router_addresses[i]);
+        if (OSD_FAILED(rv)) {
+            err(log_ctx,
+                "Unable to derive the address of routing thread %u from %s.",
+                i, router_address);
+            goto err_free;
+        }
+    }
 
-    // prepare custom data passed to I/O thread
-    struct iothread_usr_ctx *iothread_usr_data =
-        calloc(1, sizeof(struct iothread_usr_ctx));
-    assert(iothread_usr_data);
-
-    iothread_usr_data->router_address = strdup(router_address);
-
-    // Our subnet: always 1 for now.
-    // XXX: make this dynamic
-    iothread_usr_data->subnet_addr = 1;
-
-    // allocate routing lookup tables
-    // mods_in_subnet is 1024 * 8B = 8 kB
-    iothread_usr_data->mods_in_subnet =
-        calloc(OSD_DIADDR_LOCAL_MAX + 1, sizeof(zframe_t *));
-    assert(iothread_usr_data->mods_in_subnet);
-    // gateways is 64 * 8B = 1 kB
-    iothread_usr_data->gateways =
-        calloc(OSD_DIADDR_SUBNET_MAX + 1, sizeof(zframe_t *));
-    assert(iothread_usr_data->gateways);
-
-    rv = worker_new(&c->ioworker_ctx, log_ctx, NULL, iothread_destroy,
-                    iothread_handle_inproc_msg, iothread_usr_data);
-    if (OSD_FAILED(rv)) {
-        return rv;
+    router_shared_new(&c->shared, c->router_thread_cnt);
+    c->subnet_addr = c->shared->subnet_addr;
+
+    c->ioworker_ctxs = calloc(c->router_thread_cnt, sizeof(struct worker_ctx *));
+    assert(c->ioworker_ctxs);
+    for (unsigned int i = 0; i < c->router_thread_cnt; i++) {
+        // prepare custom data passed to I/O thread
+        struct iothread_usr_ctx *iothread_usr_data =
+            calloc(1, sizeof(struct iothread_usr_ctx));
+        assert(iothread_usr_data);
+
+        iothread_usr_data->router_address = strdup(c->router_addresses[i]);
+        assert(iothread_usr_data->router_address);
+        iothread_usr_data->shard = i;
+        iothread_usr_data->shared = c->shared;
+        iothread_usr_data->shard_ring_items =
+            calloc(c->router_thread_cnt, sizeof(zmq_pollitem_t));
+        assert(iothread_usr_data->shard_ring_items);
+        iothread_usr_data->mods_by_hostaddr =
+            calloc(HOSTCTRL_HOSTADDR_HASH_SLOTS, sizeof(uint16_t));
+        assert(iothread_usr_data->mods_by_hostaddr);
+        iothread_usr_data->peer_timer_id = -1;
+
+        rv = worker_new(&c->ioworker_ctxs[i], log_ctx, NULL, iothread_destroy,
+                        iothread_cmd_handlers,
+                        sizeof(iothread_cmd_handlers) /
+                            sizeof(iothread_cmd_handlers[0]),
+                        iothread_usr_data);
+        if (OSD_FAILED(rv)) {
+            goto err_free;
+        }
     }
 
     *ctx = c;
 
     return OSD_OK;
+
+err_free:
+    osd_hostctrl_free(&c);
+    return rv;
 }
 
 API_EXPORT
@@ -606,12 +2867,57 @@ void osd_hostctrl_free(struct osd_hostctrl_ctx **ctx_p)
 
     assert(!ctx->is_running);
 
-    worker_free(&ctx->ioworker_ctx);
+    for (unsigned int i = 0; i < ctx->router_thread_cnt; i++) {
+        if (ctx->ioworker_ctxs && ctx->ioworker_ctxs[i]) {
+            worker_free(&ctx->ioworker_ctxs[i]);
+        }
+        free(ctx->router_addresses[i]);
+    }
+    free(ctx->ioworker_ctxs);
+    free(ctx->router_addresses);
+
+    router_shared_free(&ctx->shared);
 
     free(ctx);
     *ctx_p = NULL;
 }
 
+/**
+ * Stop the routing threads
+ *
+ * @param ctx the host controller
+ * @param started which routing threads have been started (all if NULL)
+ */
+static osd_result router_threads_stop(struct osd_hostctrl_ctx *ctx,
+                                      const bool *started)
+{
+    osd_result rv;
+    osd_result retval = OSD_OK;
+
+    for (unsigned int i = 0; i < ctx->router_thread_cnt; i++) {
+        if (started && !started[i]) {
+            continue;
+        }
+        worker_send_status(ctx->ioworker_ctxs[i]->inproc_socket,
+                           IOTHREAD_OP_STOP, 0);
+    }
+    for (unsigned int i = 0; i < ctx->router_thread_cnt; i++) {
+        if (started && !started[i]) {
+            continue;
+        }
+        int thread_retval;
+        rv = worker_wait_for_status(ctx->ioworker_ctxs[i]->inproc_socket,
+                                    IOTHREAD_OP_STOP_DONE, &thread_retval);
+        if (OSD_FAILED(rv)) {
+            retval = rv;
+        } else if (OSD_FAILED(thread_retval)) {
+            retval = thread_retval;
+        }
+    }
+
+    return retval;
+}
+
 API_EXPORT
 osd_result osd_hostctrl_start(struct osd_hostctrl_ctx *ctx)
 {
@@ -619,12 +2925,26 @@ osd_result osd_hostctrl_start(struct osd_hostctrl_ctx *ctx)
     assert(ctx);
     assert(!ctx->is_running);
 
-    worker_send_status(ctx->ioworker_ctx->inproc_socket, "I-START", 0);
-    int retval;
-    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
-                                "I-START-DONE", &retval);
-    if (OSD_FAILED(rv) || retval == -1) {
-        err(ctx->log_ctx, "Unable to start router functionality.");
+    for (unsigned int i = 0; i < ctx->router_thread_cnt; i++) {
+        worker_send_status(ctx->ioworker_ctxs[i]->inproc_socket,
+                           IOTHREAD_OP_START, 0);
+    }
+
+    bool started[HOSTCTRL_ROUTER_THREADS_MAX];
+    bool failed = false;
+    for (unsigned int i = 0; i < ctx->router_thread_cnt; i++) {
+        int retval;
+        rv = worker_wait_for_status(ctx->ioworker_ctxs[i]->inproc_socket,
+                                    IOTHREAD_OP_START_DONE, &retval);
+        started[i] = OSD_SUCCEEDED(rv) && OSD_SUCCEEDED(retval);
+        if (!started[i]) {
+            err(ctx->log_ctx, "Unable to start router functionality at %s.",
+                ctx->router_addresses[i]);
+            failed = true;
+        }
+    }
+    if (failed) {
+        router_threads_stop(ctx, started);
         return OSD_ERROR_CONNECTION_FAILED;
     }
 
@@ -646,16 +2966,10 @@ osd_result osd_hostctrl_stop(struct osd_hostctrl_ctx *ctx)
         return OSD_ERROR_NOT_CONNECTED;
     }
 
-    worker_send_status(ctx->ioworker_ctx->inproc_socket, "I-STOP", 0);
-    osd_result retval;
-    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket, "I-STOP-DONE",
-                                &retval);
+    rv = router_threads_stop(ctx, NULL);
     if (OSD_FAILED(rv)) {
         return rv;
     }
-    if (OSD_FAILED(retval)) {
-        return retval;
-    }
 
     ctx->is_running = false;
 
@@ -667,3 +2981,95 @@ bool osd_hostctrl_is_running(struct osd_hostctrl_ctx *ctx)
 {
     return ctx->is_running;
 }
+
+API_EXPORT
+unsigned int osd_hostctrl_get_router_thread_cnt(struct osd_hostctrl_ctx *ctx)
+{
+    assert(ctx);
+    return ctx->router_thread_cnt;
+}
+
+API_EXPORT
+void osd_hostctrl_get_stats(struct osd_hostctrl_ctx *ctx,
+                            struct osd_hostctrl_stats *stats)
+{
+    assert(ctx);
+    assert(stats);
+
+    stats->shard_ring_dropped =
+        __atomic_load_n(&ctx->shared->shard_ring_dropped, __ATOMIC_RELAXED);
+}
+
+API_EXPORT
+const char *osd_hostctrl_get_router_address(struct osd_hostctrl_ctx *ctx,
+                                            unsigned int thread_idx)
+{
+    assert(ctx);
+    assert(thread_idx < ctx->router_thread_cnt);
+    return ctx->router_addresses[thread_idx];
+}
+
+API_EXPORT
+osd_result osd_hostctrl_set_subnet_addr(struct osd_hostctrl_ctx *ctx,
+                                        unsigned int subnet_addr)
+{
+    assert(ctx);
+
+    if (ctx->is_running) {
+        err(ctx->log_ctx, "The subnet cannot be changed while the host "
+                          "controller is running.");
+        return OSD_ERROR_FAILURE;
+    }
+    if (subnet_addr > OSD_DIADDR_SUBNET_MAX) {
+        err(ctx->log_ctx, "Invalid subnet address %u.", subnet_addr);
+        return OSD_ERROR_FAILURE;
+    }
+
+    ctx->subnet_addr = subnet_addr;
+    ctx->shared->subnet_addr = subnet_addr;
+    return OSD_OK;
+}
+
+API_EXPORT
+unsigned int osd_hostctrl_get_subnet_addr(struct osd_hostctrl_ctx *ctx)
+{
+    assert(ctx);
+    return ctx->subnet_addr;
+}
+
+API_EXPORT
+osd_result osd_hostctrl_add_peer(struct osd_hostctrl_ctx *ctx,
+                                 const char *address)
+{
+    assert(ctx);
+    assert(address);
+
+    if (ctx->is_running) {
+        err(ctx->log_ctx, "Peers cannot be added while the host controller "
+                          "is running.");
+        return OSD_ERROR_FAILURE;
+    }
+
+    int rv = zlist_append(ctx->shared->peer_addresses, (void *)address);
+    assert(rv == 0);
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_hostctrl_set_peer_batch_policy(
+    struct osd_hostctrl_ctx *ctx, const struct osd_packet_batch_policy *policy)
+{
+    assert(ctx);
+    assert(policy);
+    assert((policy->max_packets <= 1 || policy->max_delay_us > 0) &&
+           "A maximum delay is required if batching is enabled.");
+
+    if (ctx->is_running) {
+        err(ctx->log_ctx, "The batch policy cannot be changed while the host "
+                          "controller is running.");
+        return OSD_ERROR_FAILURE;
+    }
+
+    ctx->shared->peer_batch_policy = *policy;
+    return OSD_OK;
+}
@@ -0,0 +1,169 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hostctrl_client.h"
+#include "osd-private.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+osd_result hostctrl_router_address(const char *base_address, unsigned int idx,
+                                   char **address)
+{
+    int rv;
+
+    if (idx == 0) {
+        *address = strdup(base_address);
+        assert(*address);
+        return OSD_OK;
+    }
+
+    if (!strncmp(base_address, "tcp://", strlen("tcp://"))) {
+        const char *port_str = strrchr(base_address, ':');
+        if (port_str < base_address + strlen("tcp://")) {
+            return OSD_ERROR_FAILURE;
+        }
+        char *end;
+        long port = strtol(port_str + 1, &end, 10);
+        if (*end || port <= 0 || port + idx > UINT16_MAX) {
+            return OSD_ERROR_FAILURE;
+        }
+        rv = asprintf(address, "%.*s:%ld", (int)(port_str - base_address),
+                      base_address, port + idx);
+    } else {
+        rv = asprintf(address, "%s-%u", base_address, idx);
+    }
+    assert(rv != -1);
+
+    return OSD_OK;
+}
+
+/**
+ * Ask the host controller which routing thread serves a subnet
+ *
+ * @param[out] thread_idx the index of the routing thread, 0 if the host
+ *                        controller does not know the request
+ */
+static osd_result request_router_thread(struct osd_log_ctx *log_ctx,
+                                        zsock_t *sock,
+                                        const char *base_address,
+                                        unsigned int subnet_addr,
+                                        unsigned int *thread_idx)
+{
+    int rv;
+
+    zmsg_t *msg_req = zmsg_new();
+    assert(msg_req);
+    rv = zmsg_addstr(msg_req, "M");
+    assert(rv == 0);
+    rv = zmsg_addstrf(msg_req, "ROUTER_THREAD %u", subnet_addr);
+    assert(rv == 0);
+    rv = zmsg_send(&msg_req, sock);
+    if (rv != 0) {
+        zmsg_destroy(&msg_req);
+        err(log_ctx, "Unable to send ROUTER_THREAD request to %s",
+            base_address);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    errno = 0;
+    zmsg_t *msg_resp = zmsg_recv(sock);
+    if (!msg_resp) {
+        err(log_ctx,
+            "No response received from host controller at %s: %s (%d)",
+            base_address, strerror(errno), errno);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    zframe_t *type_frame = zmsg_first(msg_resp);
+    zframe_t *resp_frame = zmsg_next(msg_resp);
+    if (!zframe_streq(type_frame, "M") || !resp_frame) {
+        err(log_ctx, "Received unexpected response from host controller at "
+            "%s.", base_address);
+        zmsg_destroy(&msg_resp);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    // Host controllers without multiple routing threads acknowledge the
+    // (unknown) request.
+    char *resp = zframe_strdup(resp_frame);
+    assert(resp);
+    char *end;
+    unsigned long idx = strtoul(resp, &end, 10);
+    *thread_idx = (end == resp || *end) ? 0 : idx;
+    free(resp);
+
+    zmsg_destroy(&msg_resp);
+    return OSD_OK;
+}
+
+osd_result hostctrl_connect(struct osd_log_ctx *log_ctx,
+                            const char *base_address, int subnet_addr,
+                            zsock_t **sock_p)
+{
+    osd_result rv;
+
+    zsock_t *sock = zsock_new_dealer(base_address);
+    if (!sock) {
+        err(log_ctx, "Unable to connect to %s", base_address);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+    zsock_set_rcvtimeo(sock, ZMQ_RCV_TIMEOUT);
+
+    if (subnet_addr < 0) {
+        *sock_p = sock;
+        return OSD_OK;
+    }
+
+    unsigned int thread_idx;
+    rv = request_router_thread(log_ctx, sock, base_address, subnet_addr,
+                               &thread_idx);
+    if (OSD_FAILED(rv)) {
+        zsock_destroy(&sock);
+        return rv;
+    }
+    if (thread_idx == 0) {
+        *sock_p = sock;
+        return OSD_OK;
+    }
+
+    zsock_destroy(&sock);
+
+    char *address;
+    rv = hostctrl_router_address(base_address, thread_idx, &address);
+    if (OSD_FAILED(rv)) {
+        err(log_ctx, "Unable to derive the address of routing thread %u from "
+            "%s.", thread_idx, base_address);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    sock = zsock_new_dealer(address);
+    if (!sock) {
+        err(log_ctx, "Unable to connect to %s", address);
+        free(address);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+    zsock_set_rcvtimeo(sock, ZMQ_RCV_TIMEOUT);
+
+    dbg(log_ctx, "Connected to routing thread %u at %s, serving subnet %u.",
+        thread_idx, address, subnet_addr);
+    free(address);
+
+    *sock_p = sock;
+    return OSD_OK;
+}
@@ -0,0 +1,70 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HOSTCTRL_CLIENT_H
+#define HOSTCTRL_CLIENT_H
+
+#include <osd/osd.h>
+
+#include <czmq.h>
+
+/**
+ * Connections of host modules and gateways to the host controller
+ *
+ * A host controller can have multiple routing threads, each listening at its
+ * own address (see osd_hostctrl_options.router_threads). A client which
+ * mostly exchanges packets with a certain subnet (e.g. the gateway of the
+ * subnet, or a trace logger of a module in the subnet) asks the host
+ * controller which routing thread serves this subnet, and connects to this
+ * routing thread. Packets between the client and the subnet are then never
+ * passed between routing threads.
+ */
+
+/**
+ * Get the address of a routing thread of a host controller
+ *
+ * Routing thread 0 listens at @p base_address. Thread n listens at the TCP
+ * port of @p base_address plus n for TCP addresses, and at @p base_address
+ * with the suffix "-n" for all other transports (e.g. inproc://hostctrl-1).
+ *
+ * @param base_address the address of the host controller
+ * @param idx index of the routing thread
+ * @param[out] address the address of the routing thread, free with free()
+ * @return OSD_OK on success, OSD_ERROR_FAILURE if no address can be derived
+ *         from @p base_address (a TCP address without a port number)
+ */
+osd_result hostctrl_router_address(const char *base_address, unsigned int idx,
+                                   char **address);
+
+/**
+ * Connect to the routing thread of a host controller serving a subnet
+ *
+ * Host controllers with a single routing thread, or which don't know which
+ * routing thread serves @p subnet_addr, are used at @p base_address.
+ *
+ * @param log_ctx the logging context
+ * @param base_address the address of the host controller
+ * @param subnet_addr the subnet, or -1 to connect to @p base_address without
+ *                    asking the host controller
+ * @param[out] sock_p a DEALER socket connected to the routing thread, with a
+ *                    receive timeout of ZMQ_RCV_TIMEOUT
+ * @return OSD_OK on success, OSD_ERROR_CONNECTION_FAILED if the host
+ *         controller cannot be reached
+ */
+osd_result hostctrl_connect(struct osd_log_ctx *log_ctx,
+                            const char *base_address, int subnet_addr,
+                            zsock_t **sock_p);
+
+#endif  // HOSTCTRL_CLIENT_H
@@ -19,12 +19,135 @@
 #include <osd/reg.h>
 #include <osd/module.h>
 
+#include "event_consumer.h"
+#include "event_reassembly.h"
+#include "hostctrl_client.h"
 #include "osd-private.h"
+#include "packet_batch.h"
+#include "packet_ring.h"
+#include "reg_cache.h"
 #include "worker.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+/**
+ * Maximum number of register accesses in flight in osd_hostmod_reg_batch()
+ *
+ * Debug modules only have small buffers for incoming requests. Sending more
+ * requests at once does not make the accesses faster, it only moves the
+ * queuing into the debug interconnect, where it blocks other traffic.
+ */
+#define HOSTMOD_REG_BATCH_WINDOW 16
+
+/**
+ * Interval in ms at which pending asynchronous register accesses are checked
+ * for timeouts
+ */
+#define HOSTMOD_REG_TIMEOUT_CHECK_INTERVAL_MS 100
+
+/**
+ * Interval in ms at which partial events are checked for timeouts
+ */
+#define HOSTMOD_EVENT_REASSEMBLY_CHECK_INTERVAL_MS 100
+
+/**
+ * Default capacity of the event queue in packets
+ *
+ * Matches the default ZeroMQ high water mark of the socket which carried
+ * event packets to the main thread before.
+ */
+#define HOSTMOD_EVENT_QUEUE_CAPACITY_DEFAULT 1000
+
+/**
+ * First line of a topology cache file
+ */
+#define HOSTMOD_TOPOLOGY_CACHE_HEADER "osd-topology-cache 1"
+
+/**
+ * Number of SCM registers identifying the device in a topology cache file
+ */
+#define HOSTMOD_TOPOLOGY_CACHE_ID_CNT 3
+
+/**
+ * Queue of event packets from the I/O thread to the main thread
+ *
+ * Event packets are kept apart from all other packets (like register access
+ * responses), which are sent to the main thread through the inproc socket of
+ * the I/O worker. Many events waiting to be received therefore never delay a
+ * register access.
+ */
+struct event_queue {
+    pthread_mutex_t lock;
+    /** Signaled when a packet is added to the queue */
+    pthread_cond_t not_empty;
+    /** Signaled when a packet is removed from the queue */
+    pthread_cond_t not_full;
+
+    /** Queued packets (struct osd_packet), oldest first */
+    zlist_t *pkgs;
+    /** Maximum number of packets in pkgs */
+    size_t capacity;
+    /** What to do with packets if the queue is full */
+    enum osd_hostmod_event_overflow_policy policy;
+    /**
+     * The host module is disconnecting: the I/O thread must not wait for free
+     * space in the queue
+     */
+    bool closed;
+
+    struct osd_hostmod_event_queue_stats stats;
+};
+
+/**
+ * State of the management requests of a host module (see mgmt_request())
+ *
+ * The host controller answers management requests in order, but does not tag
+ * its responses. Each request is therefore given a sequence number, which the
+ * I/O thread passes back with the response. A response arriving after its
+ * request timed out is discarded by comparing this number.
+ */
+struct mgmt_req_state {
+    pthread_mutex_t lock;
+    /** Signaled when a request completes or busy is cleared */
+    pthread_cond_t cond;
+    /** A thread is waiting for the response to request seq */
+    bool busy;
+    /** Sequence number of the most recent request */
+    uint64_t seq;
+    /** Sequence number of the most recently completed request */
+    uint64_t done_seq;
+    /** Result of request done_seq */
+    osd_result result;
+};
+
+/**
+ * Events collected for the batch event handler in the I/O thread
+ *
+ * All events are copied into one contiguous buffer, each stored as the number
+ * of data words followed by the data words (the memory layout of struct
+ * osd_packet). The buffers are reused for all batches, no memory is allocated
+ * per event.
+ */
+struct event_batch {
+    /** Collected events */
+    uint16_t *buf;
+    /** Allocated size of buf in words */
+    size_t buf_words;
+    /** Used size of buf in words */
+    size_t size_words;
+    /** Number of events in buf */
+    size_t pkg_cnt;
+
+    /** Views on the events in buf, passed to the batch event handler */
+    struct osd_packet_view *views;
+    /** Allocated number of entries in views */
+    size_t views_len;
+};
 
 /**
  * Host module context
@@ -41,770 +164,2562 @@ struct osd_hostmod_ctx {
 
     /** I/O worker */
     struct worker_ctx *ioworker_ctx;
-};
-
-/**
- * I/O thread user context
- */
-struct iothread_usr_ctx {
-    /** Communication socket with the host controller */
-    zsock_t *hostctrl_socket;
 
     /** ZeroMQ address/URL of the host controller */
     char *host_controller_address;
 
+    /**
+     * Connection to the host controller, used by the I/O thread while the
+     * host module is connected (see osd_hostmod_connect())
+     */
+    zsock_t *hostctrl_socket;
+
+    /**
+     * Subnet whose routing thread of the host controller the module connects
+     * to, -1 for the default routing thread
+     */
+    int target_subnet;
+
+    /** How synchronous register accesses are transported */
+    enum osd_hostmod_reg_access_mode reg_access_mode;
+
+    /**
+     * Connection of the calling thread to the host controller, used for
+     * synchronous register accesses in OSD_HOSTMOD_REG_ACCESS_DIRECT mode
+     * (NULL otherwise)
+     */
+    zsock_t *reg_socket;
+
+    /** DI address used as source of register accesses through reg_socket */
+    uint16_t reg_diaddr;
+
+    /**
+     * Packets received through reg_socket as part of a batch message, but not
+     * processed yet (struct osd_packet)
+     */
+    zlist_t *reg_socket_pkgs;
+
+    /**
+     * Serializes messages sent to the I/O thread by concurrently running
+     * application threads
+     */
+    pthread_mutex_t inproc_lock;
+
+    /** Management requests to the host controller */
+    struct mgmt_req_state mgmt_req;
+
+    /** ID of the next register access (atomic) */
+    uint64_t reg_req_next_id;
+
+    /** Cache of constant registers (see OSD_HOSTMOD_CACHED) */
+    struct reg_cache *reg_cache;
+
+    /** Protects reg_cache */
+    pthread_mutex_t reg_cache_lock;
+
+    /** Event packets received by the I/O thread */
+    struct event_queue *event_queue;
+
+    /** Reassembly of split events (used by the I/O thread) */
+    struct event_reassembly *event_reassembly;
+
     /** Event packet handler function */
     osd_hostmod_event_handler_fn event_handler;
 
     /** Argument passed to event_handler */
     void *event_handler_arg;
 
-    /** Event re-assembly buffer (used to recombine split transactions) */
-    zlist_t *event_reassembly_buf;
+    /** Batch event handler function, replaces event_handler if set */
+    osd_hostmod_event_batch_handler_fn event_batch_handler;
+
+    /** Argument passed to event_batch_handler */
+    void *event_batch_handler_arg;
+
+    /**
+     * Thread calling event_handler, NULL if event_handler is called in the I/O
+     * thread
+     */
+    struct event_consumer *event_consumer;
 };
 
 /**
- * Handle an EVENT packet received from the host controller
+ * Opcodes of messages exchanged between the main thread and the I/O thread
  *
- * Possible actions include forwarding the packet to the main thread,
- * storing it to be combined with other packets, or forwarded to the
- * registered event handler callback.
+ * DI packets are exchanged in WORKER_OP_DATA messages.
+ */
+enum iothread_opcode {
+    IOTHREAD_OP_CONNECT = WORKER_OP_USER,
+    IOTHREAD_OP_CONNECT_DONE,
+    IOTHREAD_OP_DISCONNECT,
+    IOTHREAD_OP_DISCONNECT_DONE,
+    IOTHREAD_OP_SET_BATCH_POLICY,
+    IOTHREAD_OP_REG_SUBMIT,
+    IOTHREAD_OP_SET_EVENT_CONSUMER,
+    IOTHREAD_OP_SET_EVENT_CONSUMER_DONE,
+    IOTHREAD_OP_SET_EVENT_REASSEMBLY_LIMITS,
+    IOTHREAD_OP_SET_EVENT_BATCH_HANDLER,
+    IOTHREAD_OP_MGMT_REQUEST,
+};
+
+/**
+ * Batch event handler
  *
- * @param usrctx the user context in the I/O thread
- * @param pkg the packet to be handled, ownership is passed to this function
- * @return a packet to be sent to the main thread (can be NULL)
+ * Sent from the main thread to the I/O thread with
+ * IOTHREAD_OP_SET_EVENT_BATCH_HANDLER.
  */
-static struct osd_packet* iothread_handle_in_eventpkg(struct iothread_usr_ctx *usrctx,
-                                                      struct osd_packet *pkg)
-{
-    int rv;
-    osd_result osd_rv;
+struct iothread_event_batch_handler {
+    osd_hostmod_event_batch_handler_fn handler;
+    void *handler_arg;
+};
 
-    assert(usrctx);
-    assert(pkg);
+/**
+ * Limits of the event reassembly
+ *
+ * Sent from the main thread to the I/O thread with
+ * IOTHREAD_OP_SET_EVENT_REASSEMBLY_LIMITS.
+ */
+struct iothread_event_reassembly_limits {
+    size_t max_bytes;
+    unsigned int timeout_ms;
+};
 
-    // record non-last EVENT packet in reassembly buffer and be done
-    if (osd_packet_get_type_sub(pkg) == EV_CONT) {
-        rv = zlist_append(usrctx->event_reassembly_buf, pkg);
-        assert(rv == 0);
+/**
+ * An asynchronous register access
+ *
+ * Sent from the main thread to the I/O thread with IOTHREAD_OP_REG_SUBMIT,
+ * and kept in the I/O thread until the access completes.
+ */
+struct iothread_reg_req {
+    /** The access, owned by the caller of osd_hostmod_reg_submit() */
+    struct osd_hostmod_reg_op *op;
+    /** Completion callback */
+    osd_hostmod_reg_cb_fn cb;
+    /** Argument passed to cb */
+    void *cb_arg;
+    /** Request ID passed to cb */
+    uint64_t req_id;
+    /** Flags passed to osd_hostmod_reg_submit() */
+    int flags;
+    /** zclock_mono() time at which the access times out (I/O thread only) */
+    int64_t deadline;
+};
 
-        return NULL;
-    }
+/**
+ * I/O thread user context
+ */
+struct iothread_usr_ctx {
+    /** Communication socket with the host controller */
+    zsock_t *hostctrl_socket;
 
-    struct osd_packet *fwd_pkg = NULL;
+    /** Event packet handler function */
+    osd_hostmod_event_handler_fn event_handler;
 
-    if (osd_packet_get_type_sub(pkg) != EV_LAST) {
-        // simply forward packet as-is
-        fwd_pkg = pkg;
-    } else {
-        // reassemble one packet out of the multiple EVENT packets in the
-        // reassembly buffer
-        struct osd_packet *pkg_inbuf;
-        pkg_inbuf = zlist_first(usrctx->event_reassembly_buf);
-        while (pkg_inbuf) {
-
-            if (osd_packet_get_src(pkg_inbuf) != osd_packet_get_src(pkg)) {
-                // packet belongs to a different transmission, skip
-                pkg_inbuf = zlist_next(usrctx->event_reassembly_buf);
-                continue;
-            }
+    /** Argument passed to event_handler */
+    void *event_handler_arg;
 
-            if (!fwd_pkg) {
-                // first packet
-                fwd_pkg = pkg_inbuf;
-                osd_rv = osd_packet_set_type_sub(fwd_pkg, EV_LAST);
-                assert(OSD_SUCCEEDED(osd_rv));
-            } else {
-                // subsequent packet: only take payload
-                osd_rv = osd_packet_combine(&fwd_pkg, pkg_inbuf);
-                assert(OSD_SUCCEEDED(osd_rv));
+    /** Batch event handler function, replaces event_handler if set */
+    osd_hostmod_event_batch_handler_fn event_batch_handler;
 
-                osd_packet_free(&pkg_inbuf);
-            }
+    /** Argument passed to event_batch_handler */
+    void *event_batch_handler_arg;
 
-            zlist_remove(usrctx->event_reassembly_buf, pkg_inbuf);
-            pkg_inbuf = zlist_next(usrctx->event_reassembly_buf);
-        }
+    /** Events collected for event_batch_handler */
+    struct event_batch event_batch;
 
-        // append/forward the current packet as well
-        if (!fwd_pkg) {
-            fwd_pkg = pkg;
-            // should not be necessary as this is the only packet in the
-            // transmission
-            osd_rv = osd_packet_set_type_sub(fwd_pkg, EV_LAST);
-            assert(OSD_SUCCEEDED(osd_rv));
-        } else {
-            osd_rv = osd_packet_combine(&fwd_pkg, pkg);
-            assert(OSD_SUCCEEDED(osd_rv));
-            osd_packet_free(&pkg);
-        }
-    }
+    /** Reassembly of split events (owned by main thread) */
+    struct event_reassembly *event_reassembly;
 
+    /**
+     * ID of the timer discarding timed out partial events, -1 if not running
+     */
+    int event_reassembly_timer_id;
 
-    if (usrctx->event_handler) {
-        // Forward EVENT packets to handler function.
-        // Ownership of |pkg| is transferred to the event handler.
-        osd_rv = usrctx->event_handler(usrctx->event_handler_arg, fwd_pkg);
-        if (OSD_FAILED(osd_rv)) {
-            // ignore (error in user logic, packet is possibly dropped)
-        }
-        return NULL;
-    }
+    /** Queue for events not passed to event_handler (owned by main thread) */
+    struct event_queue *event_queue;
 
-    return fwd_pkg;
-}
+    /**
+     * Thread calling event_handler (owned by main thread), NULL to call
+     * event_handler in the I/O thread
+     */
+    struct event_consumer *event_consumer;
 
-/**
- * Process an incoming data message from the host controller
- *
- * @return a message to be sent to the main thread (can be NULL)
- */
-static zmsg_t* iothread_handle_in_data_msg(struct iothread_usr_ctx *usrctx,
-                                           zmsg_t *msg)
+    /** Batch builder for packets sent to the host controller */
+    struct packet_batch *tx_batch;
+
+    /** Logging context */
+    struct osd_log_ctx *log_ctx;
+
+    /** Pending asynchronous register accesses (struct iothread_reg_req) */
+    zlist_t *reg_reqs;
+
+    /** ID of the timer checking reg_reqs for timeouts, -1 if not running */
+    int reg_timer_id;
+
+    /** Management request state (owned by the main thread) */
+    struct mgmt_req_state *mgmt_req;
+
+    /** Sequence numbers (uint64_t) of the management requests
+     *  (IOTHREAD_OP_MGMT_REQUEST) not answered by the host controller yet,
+     *  oldest first */
+    zlist_t *mgmt_req_seqs;
+};
+
+static void event_queue_new(struct event_queue **queue_p)
 {
     int rv;
-    osd_result osd_rv;
 
-    assert(usrctx);
-    assert(msg);
+    struct event_queue *queue = calloc(1, sizeof(struct event_queue));
+    assert(queue);
 
-    zmsg_first(msg);
-    zframe_t *data_frame = zmsg_next(msg);
-    assert(data_frame);
+    rv = pthread_mutex_init(&queue->lock, NULL);
+    assert(rv == 0);
 
-    struct osd_packet *pkg;
-    osd_rv = osd_packet_new_from_zframe(&pkg, data_frame);
-    assert(OSD_SUCCEEDED(osd_rv));
+    // wait with timeouts on a clock which isn't affected by time changes
+    pthread_condattr_t condattr;
+    rv = pthread_condattr_init(&condattr);
+    assert(rv == 0);
+    rv = pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    assert(rv == 0);
+    rv = pthread_cond_init(&queue->not_empty, &condattr);
+    assert(rv == 0);
+    rv = pthread_cond_init(&queue->not_full, &condattr);
+    assert(rv == 0);
+    pthread_condattr_destroy(&condattr);
 
-    if (osd_packet_get_type(pkg) == OSD_PACKET_TYPE_EVENT) {
-        zmsg_destroy(&msg);
+    queue->pkgs = zlist_new();
+    assert(queue->pkgs);
+    queue->capacity = HOSTMOD_EVENT_QUEUE_CAPACITY_DEFAULT;
+    queue->policy = OSD_HOSTMOD_EVENT_OVERFLOW_DROP_OLDEST;
 
-        struct osd_packet *fwd_pkg = iothread_handle_in_eventpkg(usrctx, pkg);
-        if (fwd_pkg) {
-            // Create new message to forward packet to main thread
-            zmsg_t *fwd_msg = zmsg_new();
-            rv = zmsg_addstr(fwd_msg, "D");
-            assert(rv == 0);
-            rv = zmsg_addmem(fwd_msg, fwd_pkg->data_raw,
-                             osd_packet_sizeof(fwd_pkg));
-            assert(rv == 0);
+    *queue_p = queue;
+}
 
-            osd_packet_free(&fwd_pkg);
-            return fwd_msg;
-        }
-        return NULL;
+static void event_queue_free(struct event_queue **queue_p)
+{
+    assert(queue_p);
+    struct event_queue *queue = *queue_p;
+    if (!queue) {
+        return;
+    }
+
+    struct osd_packet *pkg;
+    while ((pkg = zlist_pop(queue->pkgs))) {
+        osd_packet_free(&pkg);
     }
+    zlist_destroy(&queue->pkgs);
 
-    osd_packet_free(&pkg);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
 
-    // Forward all other data messages to the main thread
-    return msg;
+    free(queue);
+    *queue_p = NULL;
 }
 
 /**
- * Process incoming messages from the host controller
+ * Set the closed state of the queue
  *
- * @return 0 if the message was processed, -1 if @p loop should be terminated
+ * While the queue is closed, the I/O thread doesn't wait for free space in the
+ * queue but drops packets instead.
  */
-static int iothread_rcv_from_hostctrl(zloop_t *loop, zsock_t *reader,
-                                      void *thread_ctx_void)
+static void event_queue_set_closed(struct event_queue *queue, bool closed)
 {
-    struct worker_thread_ctx *thread_ctx =
-        (struct worker_thread_ctx *)thread_ctx_void;
-    assert(thread_ctx);
-
-    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
-    assert(usrctx);
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = closed;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
 
+/**
+ * Add a packet to the queue (I/O thread)
+ *
+ * @param queue the queue
+ * @param pkg the packet. Ownership is passed to this function.
+ */
+static void event_queue_push(struct event_queue *queue, struct osd_packet *pkg)
+{
     int rv;
 
-    zmsg_t *msg = zmsg_recv(reader);
-    if (!msg) {
-        return -1;  // process was interrupted, terminate zloop
-    }
-
-    zframe_t *type_frame = zmsg_first(msg);
-    assert(type_frame);
-    if (zframe_streq(type_frame, "D")) {
-        zmsg_t *out_msg = iothread_handle_in_data_msg(usrctx, msg);
+    pthread_mutex_lock(&queue->lock);
 
-        // possibly send a message to the main thread
-        if (out_msg) {
-            rv = zmsg_send(&out_msg, thread_ctx->inproc_socket);
-            assert(rv == 0);
+    if (zlist_size(queue->pkgs) >= queue->capacity) {
+        if (queue->policy == OSD_HOSTMOD_EVENT_OVERFLOW_BLOCK) {
+            queue->stats.stalls++;
+            while (zlist_size(queue->pkgs) >= queue->capacity &&
+                   !queue->closed) {
+                pthread_cond_wait(&queue->not_full, &queue->lock);
+            }
+        } else if (queue->policy == OSD_HOSTMOD_EVENT_OVERFLOW_DROP_OLDEST) {
+            while (zlist_size(queue->pkgs) >= queue->capacity) {
+                struct osd_packet *oldest_pkg = zlist_pop(queue->pkgs);
+                osd_packet_free(&oldest_pkg);
+                queue->stats.dropped++;
+            }
         }
 
-    } else if (zframe_streq(type_frame, "M")) {
-        assert(0 && "TODO: Handle incoming management messages.");
+        // OSD_HOSTMOD_EVENT_OVERFLOW_DROP_NEWEST, or closed while waiting
+        if (zlist_size(queue->pkgs) >= queue->capacity) {
+            osd_packet_free(&pkg);
+            queue->stats.dropped++;
+            pthread_mutex_unlock(&queue->lock);
+            return;
+        }
+    }
 
-    } else {
-        assert(0 && "Message of unknown type received.");
+    rv = zlist_append(queue->pkgs, pkg);
+    assert(rv == 0);
+    queue->stats.received++;
+    if (zlist_size(queue->pkgs) > queue->stats.len_max) {
+        queue->stats.len_max = zlist_size(queue->pkgs);
     }
+    pthread_cond_signal(&queue->not_empty);
 
-    return 0;
+    pthread_mutex_unlock(&queue->lock);
 }
 
 /**
- * Obtain a DI address for this host debug module from the host controller
+ * Take the oldest packet out of the queue (main thread)
+ *
+ * @param queue the queue
+ * @param[out] pkg_p the packet. Ownership is passed to the caller.
+ * @param timeout_ms time to wait for a packet, or -1 to wait forever
+ * @return OSD_OK if a packet was returned, OSD_ERROR_TIMEDOUT if no packet was
+ *         received within @p timeout_ms
  */
-static osd_result iothread_obtain_diaddr(struct worker_thread_ctx *thread_ctx,
-                                         uint16_t *di_addr)
+static osd_result event_queue_pop(struct event_queue *queue,
+                                  struct osd_packet **pkg_p, int timeout_ms)
 {
     int rv;
 
-    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
-    assert(usrctx);
-    zsock_t *sock = usrctx->hostctrl_socket;
-
-    // request
-    zmsg_t *msg_req = zmsg_new();
-    assert(msg_req);
-
-    rv = zmsg_addstr(msg_req, "M");
-    assert(rv == 0);
-    rv = zmsg_addstr(msg_req, "DIADDR_REQUEST");
-    assert(rv == 0);
-    rv = zmsg_send(&msg_req, sock);
-    if (rv != 0) {
-        err(thread_ctx->log_ctx,
-            "Unable to send DIADDR_REQUEST request to "
-            "host controller");
-        return OSD_ERROR_CONNECTION_FAILED;
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        rv = clock_gettime(CLOCK_MONOTONIC, &deadline);
+        assert(rv == 0);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
     }
 
-    // response
-    errno = 0;
-    zmsg_t *msg_resp = zmsg_recv(sock);
-    if (!msg_resp) {
-        err(thread_ctx->log_ctx,
-            "No response received from host controller at %s: %s (%d)",
-            usrctx->host_controller_address, strerror(errno), errno);
-        return OSD_ERROR_CONNECTION_FAILED;
+    pthread_mutex_lock(&queue->lock);
+    while (zlist_size(queue->pkgs) == 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        } else {
+            rv = pthread_cond_timedwait(&queue->not_empty, &queue->lock,
+                                        &deadline);
+            if (rv == ETIMEDOUT && zlist_size(queue->pkgs) == 0) {
+                pthread_mutex_unlock(&queue->lock);
+                return OSD_ERROR_TIMEDOUT;
+            }
+        }
     }
 
-    zframe_t *type_frame = zmsg_pop(msg_resp);
-    assert(zframe_streq(type_frame, "M"));
-    zframe_destroy(&type_frame);
+    *pkg_p = zlist_pop(queue->pkgs);
+    pthread_cond_signal(&queue->not_full);
 
-    char *addr_string = zmsg_popstr(msg_resp);
-    assert(addr_string);
-    char *end;
-    long int addr = strtol(addr_string, &end, 10);
-    assert(!*end);
-    assert(addr <= UINT16_MAX);
-    *di_addr = (uint16_t)addr;
-    free(addr_string);
+    pthread_mutex_unlock(&queue->lock);
+    return OSD_OK;
+}
 
-    zmsg_destroy(&msg_resp);
+static void mgmt_req_state_init(struct mgmt_req_state *state)
+{
+    int rv;
 
-    dbg(thread_ctx->log_ctx,
-        "Obtained DI address %u.%u (%u) from host controller.",
-        osd_diaddr_subnet(*di_addr), osd_diaddr_localaddr(*di_addr), *di_addr);
+    pthread_condattr_t condattr;
+    rv = pthread_condattr_init(&condattr);
+    assert(rv == 0);
+    rv = pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    assert(rv == 0);
+    rv = pthread_cond_init(&state->cond, &condattr);
+    assert(rv == 0);
+    pthread_condattr_destroy(&condattr);
 
-    return OSD_OK;
+    pthread_mutex_init(&state->lock, NULL);
+    state->busy = false;
+    state->seq = 0;
+    state->done_seq = 0;
+}
+
+static void mgmt_req_state_destroy(struct mgmt_req_state *state)
+{
+    pthread_cond_destroy(&state->cond);
+    pthread_mutex_destroy(&state->lock);
 }
 
 /**
- * Connect to the host controller in the I/O thread
+ * Complete the management request with the sequence number @p seq
  *
- * This function is called by the I/O worker thread as response to the I-CONNECT
- * message. It creates a new DEALER ZeroMQ socket and uses it to connect to the
- * host controller. After completion the function sends out a I-CONNECT-DONE
- * message. The message value is -1 if the connection failed for any reason,
- * or the DI address assigned to the host module if the connection was
- * successfully established.
+ * Called from the I/O thread. Nobody waits for a request which timed out.
  */
-static void iothread_connect_to_hostctrl(struct worker_thread_ctx *thread_ctx)
+static void mgmt_req_complete(struct mgmt_req_state *state, uint64_t seq,
+                              osd_result result)
 {
-    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
-    assert(usrctx);
-
-    osd_result retval;
-    osd_result osd_rv;
+    pthread_mutex_lock(&state->lock);
+    state->done_seq = seq;
+    state->result = result;
+    pthread_cond_broadcast(&state->cond);
+    pthread_mutex_unlock(&state->lock);
+}
 
-    // create new DEALER socket to connect with the host controller
-    usrctx->hostctrl_socket = zsock_new_dealer(usrctx->host_controller_address);
-    if (!usrctx->hostctrl_socket) {
-        err(thread_ctx->log_ctx, "Unable to connect to %s",
-            usrctx->host_controller_address);
-        retval = -1;
-        goto free_return;
-    }
-    zsock_set_rcvtimeo(usrctx->hostctrl_socket, ZMQ_RCV_TIMEOUT);
+static enum osd_packet_type_reg_subtype get_subtype_reg_read_req(
+    unsigned int reg_size_bit)
+{
+    return (reg_size_bit / 16) - 1;
+}
 
-    // Get our DI address
-    uint16_t di_addr;
-    osd_rv = iothread_obtain_diaddr(thread_ctx, &di_addr);
-    if (OSD_FAILED(osd_rv)) {
-        retval = -1;
-        goto free_return;
+static enum osd_packet_type_reg_subtype get_subtype_reg_read_success_resp(
+    unsigned int reg_size_bit)
+{
+    return get_subtype_reg_read_req(reg_size_bit) | 0b1000;
+}
+
+static enum osd_packet_type_reg_subtype get_subtype_reg_write_req(
+    unsigned int reg_size_bit)
+{
+    return ((reg_size_bit / 16) - 1) | 0b0100;
+}
+
+/**
+ * Validate the response to a register access and copy the read data
+ *
+ * @return the result of the register access
+ */
+static osd_result reg_op_handle_resp(struct osd_log_ctx *log_ctx,
+                                     struct osd_hostmod_reg_op *op,
+                                     const struct osd_packet *pkg_resp)
+{
+    bool is_write = (op->type == OSD_HOSTMOD_REG_OP_WRITE);
+
+    // handle register access error
+    if (osd_packet_get_type_sub(pkg_resp) == RESP_READ_REG_ERROR ||
+        osd_packet_get_type_sub(pkg_resp) == RESP_WRITE_REG_ERROR) {
+        err(log_ctx,
+            "Got %s when accessing register %u of module %d",
+            is_write ? "RESP_WRITE_REG_ERROR" : "RESP_READ_REG_ERROR",
+            op->reg_addr, op->diaddr);
+        return OSD_ERROR_DEVICE_ERROR;
     }
-    retval = di_addr;
 
-    // register handler for messages coming from the host controller
-    int zmq_rv;
-    zmq_rv = zloop_reader(thread_ctx->zloop, usrctx->hostctrl_socket,
-                          iothread_rcv_from_hostctrl, thread_ctx);
-    assert(zmq_rv == 0);
-    zloop_reader_set_tolerant(thread_ctx->zloop, usrctx->hostctrl_socket);
+    // validate response subtype
+    enum osd_packet_type_reg_subtype subtype_resp =
+        is_write ? RESP_WRITE_REG_SUCCESS
+                 : get_subtype_reg_read_success_resp(op->reg_size_bit);
+    if (osd_packet_get_type_sub(pkg_resp) != subtype_resp) {
+        err(log_ctx, "Expected register response of subtype %d, got %d",
+            subtype_resp, osd_packet_get_type_sub(pkg_resp));
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
 
-free_return:
-    if (retval == -1) {
-        zsock_destroy(&usrctx->hostctrl_socket);
+    // validate response size
+    unsigned int exp_data_size_words = osd_packet_sizeconv_payload2data(
+        is_write ? 0 : op->reg_size_bit / 16);
+    if (pkg_resp->data_size_words != exp_data_size_words) {
+        err(log_ctx,
+            "Invalid register access response received. Expected packet with "
+            "%u data words, got %u words.",
+            exp_data_size_words, pkg_resp->data_size_words);
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+
+    // make result available to caller
+    // XXX: this is broken for anything else than 16 bit registers due to
+    // endianness issues.
+    if (!is_write) {
+        memcpy(op->reg_val, pkg_resp->data.payload, op->reg_size_bit / 8);
     }
-    worker_send_status(thread_ctx->inproc_socket, "I-CONNECT-DONE", retval);
+
+    return OSD_OK;
 }
 
 /**
- * Disconnect from the host controller in the I/O thread
+ * Complete an asynchronous register access and call its callback
  *
- * This function is called when receiving a I-DISCONNECT message in the
- * I/O thread. After the disconnect is done a I-DISCONNECT-DONE message is sent
- * to the main thread.
+ * @param usrctx the user context in the I/O thread
+ * @param req the access, removed from the list of pending accesses and freed
+ * @param result the result of the access
  */
-static void iothread_disconnect_from_hostctrl(
-    struct worker_thread_ctx *thread_ctx)
+static void iothread_reg_req_complete(struct iothread_usr_ctx *usrctx,
+                                      struct iothread_reg_req *req,
+                                      osd_result result)
 {
-    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
-    assert(usrctx);
+    zlist_remove(usrctx->reg_reqs, req);
 
-    osd_result retval;
+    req->op->result = result;
+    req->cb(req->cb_arg, req->req_id, req->op);
+    free(req);
+}
 
-    zloop_reader_end(thread_ctx->zloop, usrctx->hostctrl_socket);
-    zsock_destroy(&usrctx->hostctrl_socket);
+/**
+ * Complete the asynchronous register access a response belongs to
+ *
+ * Modules respond to requests in the order they received them: a response
+ * belongs to the oldest pending access to the module it originates from.
+ *
+ * @return true if the response has been consumed, false if it does not belong
+ *         to an asynchronous access
+ */
+static bool iothread_reg_req_handle_resp(struct iothread_usr_ctx *usrctx,
+                                         const struct osd_packet_view *pkg_view)
+{
+    osd_result osd_rv;
 
-    retval = OSD_OK;
+    struct iothread_reg_req *req = zlist_first(usrctx->reg_reqs);
+    while (req && req->op->diaddr != osd_packet_view_get_src(pkg_view)) {
+        req = zlist_next(usrctx->reg_reqs);
+    }
+    if (!req) {
+        return false;
+    }
+
+    struct osd_packet *pkg_resp;
+    osd_rv = osd_packet_new_from_view(&pkg_resp, pkg_view);
+    assert(OSD_SUCCEEDED(osd_rv));
 
-    worker_send_status(thread_ctx->inproc_socket, "I-DISCONNECT-DONE", retval);
+    osd_rv = reg_op_handle_resp(usrctx->log_ctx, req->op, pkg_resp);
+    osd_packet_free(&pkg_resp);
+
+    iothread_reg_req_complete(usrctx, req, osd_rv);
+    return true;
 }
 
-static osd_result iothread_handle_inproc_request(
-    struct worker_thread_ctx *thread_ctx, const char *name, zmsg_t *msg)
+/**
+ * Fail all asynchronous register accesses which are past their deadline
+ *
+ * The timer stops itself once no accesses are pending any more.
+ */
+static int iothread_reg_req_check_timeouts(zloop_t *loop, int timer_id,
+                                           void *thread_ctx_void)
 {
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
+    assert(thread_ctx);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    int rv;
-
-    if (!strcmp(name, "I-CONNECT")) {
-        iothread_connect_to_hostctrl(thread_ctx);
-
-    } else if (!strcmp(name, "I-DISCONNECT")) {
-        iothread_disconnect_from_hostctrl(thread_ctx);
-
-    } else if (!strcmp(name, "D")) {
-        // Forward data packet to the host controller
-        rv = zmsg_send(&msg, usrctx->hostctrl_socket);
-        assert(rv == 0);
+    int64_t now = zclock_mono();
 
-    } else {
-        assert(0 && "Received unknown message from main thread.");
+    struct iothread_reg_req *req = zlist_first(usrctx->reg_reqs);
+    while (req) {
+        if (req->deadline != -1 && now >= req->deadline) {
+            err(usrctx->log_ctx,
+                "Access to register 0x%x of module 0x%x timed out.",
+                req->op->reg_addr, req->op->diaddr);
+            iothread_reg_req_complete(usrctx, req, OSD_ERROR_TIMEDOUT);
+        }
+        req = zlist_next(usrctx->reg_reqs);
     }
 
-    zmsg_destroy(&msg);
+    if (zlist_size(usrctx->reg_reqs) == 0) {
+        zloop_timer_end(loop, timer_id);
+        usrctx->reg_timer_id = -1;
+    }
 
-    return OSD_OK;
+    return 0;
 }
 
-static osd_result iothread_destroy(struct worker_thread_ctx *thread_ctx)
+/**
+ * Fail all pending asynchronous register accesses
+ */
+static void iothread_reg_req_fail_all(struct worker_thread_ctx *thread_ctx,
+                                      osd_result result)
 {
-    assert(thread_ctx);
     struct iothread_usr_ctx *usrctx = thread_ctx->usr;
     assert(usrctx);
 
-    zlist_destroy(&usrctx->event_reassembly_buf);
-    free(usrctx->host_controller_address);
-    free(usrctx);
-    thread_ctx->usr = NULL;
+    struct iothread_reg_req *req;
+    while ((req = zlist_first(usrctx->reg_reqs))) {
+        iothread_reg_req_complete(usrctx, req, result);
+    }
 
-    return OSD_OK;
+    if (usrctx->reg_timer_id != -1) {
+        zloop_timer_end(thread_ctx->zloop, usrctx->reg_timer_id);
+        usrctx->reg_timer_id = -1;
+    }
 }
 
 /**
- * Send a DI Packet to the host controller
+ * Add an event to the batch for the batch event handler
  *
- * The actual sending is done through the I/O worker.
+ * The event is copied.
  */
-static osd_result osd_hostmod_send_packet(struct osd_hostmod_ctx *ctx,
-                                          const struct osd_packet *packet)
+static void event_batch_add(struct event_batch *batch,
+                            const struct osd_packet_view *pkg)
 {
-    assert(ctx);
-    assert(ctx->ioworker_ctx);
-    assert(ctx->ioworker_ctx->inproc_socket);
+    size_t pkg_words = 1 + pkg->data_size_words;
 
-    int rv;
-    zmsg_t *msg = zmsg_new();
-    assert(msg);
+    if (batch->size_words + pkg_words > batch->buf_words) {
+        size_t buf_words = batch->buf_words * 2;
+        if (buf_words < batch->size_words + pkg_words) {
+            buf_words = batch->size_words + pkg_words;
+        }
+        batch->buf = realloc(batch->buf, buf_words * sizeof(uint16_t));
+        assert(batch->buf);
+        batch->buf_words = buf_words;
+    }
 
-    rv = zmsg_addstr(msg, "D");
-    assert(rv == 0);
-    rv = zmsg_addmem(msg, packet->data_raw, osd_packet_sizeof(packet));
-    assert(rv == 0);
+    batch->buf[batch->size_words] = pkg->data_size_words;
+    memcpy(&batch->buf[batch->size_words + 1], pkg->data_raw,
+           pkg->data_size_words * sizeof(uint16_t));
+    batch->size_words += pkg_words;
+    batch->pkg_cnt++;
+}
 
-    rv = zmsg_send(&msg, ctx->ioworker_ctx->inproc_socket);
-    if (rv != 0) {
-        return OSD_ERROR_COM;
+/**
+ * Pass all events in the batch to the batch event handler
+ *
+ * Ownership of the events stays with the batch, which is empty afterwards.
+ */
+static void iothread_event_batch_deliver(struct iothread_usr_ctx *usrctx)
+{
+    osd_result osd_rv;
+    struct event_batch *batch = &usrctx->event_batch;
+
+    if (batch->pkg_cnt == 0) {
+        return;
     }
 
-    return OSD_OK;
+    if (batch->pkg_cnt > batch->views_len) {
+        batch->views = realloc(batch->views,
+                               batch->pkg_cnt * sizeof(struct osd_packet_view));
+        assert(batch->views);
+        batch->views_len = batch->pkg_cnt;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < batch->pkg_cnt; i++) {
+        batch->views[i].data_size_words = batch->buf[offset];
+        batch->views[i].data_raw = &batch->buf[offset + 1];
+        offset += 1 + batch->buf[offset];
+    }
+    assert(offset == batch->size_words);
+
+    osd_rv = usrctx->event_batch_handler(usrctx->event_batch_handler_arg,
+                                         batch->views, batch->pkg_cnt);
+    if (OSD_FAILED(osd_rv)) {
+        // ignore (error in user logic, packets are possibly dropped)
+    }
+
+    batch->size_words = 0;
+    batch->pkg_cnt = 0;
 }
 
 /**
- * Receive a DI Packet
+ * Handle a (reassembled) event received from the host controller
+ *
+ * The event is passed to the registered event handler callback (possibly
+ * through the event handler thread), collected for the batch event handler, or
+ * added to the event queue of the main thread.
  *
- * @return OSD_OK if the operation was successful,
- *         OSD_ERROR_TIMEDOUT if the operation timed out.
- *         OSD_ERROR_FAILURE if the read operation was aborted
- *         Any other value indicates an error
+ * @param usrctx the user context in the I/O thread
+ * @param event the event, copied if needed
  */
-static osd_result osd_hostmod_receive_packet(struct osd_hostmod_ctx *ctx,
-                                             struct osd_packet **packet,
-                                             int flags)
+static void iothread_handle_in_event(struct iothread_usr_ctx *usrctx,
+                                     const struct osd_packet_view *event)
 {
     osd_result osd_rv;
 
-    // block register read indefinitely until response has been received
-    bool do_block = (flags & OSD_HOSTMOD_BLOCKING);
+    assert(usrctx);
+    assert(event);
 
-    errno = 0;
-    zmsg_t *msg;
-    do {
-        msg = zmsg_recv(ctx->ioworker_ctx->inproc_socket);
-    } while (!msg && errno == EAGAIN && do_block);
-    if (!msg && errno == EAGAIN) {
-        return OSD_ERROR_TIMEDOUT;
-    }
-    if (!msg) {
-        return OSD_ERROR_FAILURE;
+    if (usrctx->event_consumer) {
+        event_consumer_push(usrctx->event_consumer, event);
+        return;
     }
 
-    // ensure that the message we got from the I/O thread is packet data
-    // XXX: possibly extend to hand off non-packet messages to their appropriate
-    // handler
-    zframe_t *type_frame = zmsg_pop(msg);
-    assert(type_frame);
-    assert(zframe_streq(type_frame, "D"));
-    zframe_destroy(&type_frame);
+    if (usrctx->event_batch_handler) {
+        event_batch_add(&usrctx->event_batch, event);
+        return;
+    }
 
-    // get osd_packet from frame data
-    zframe_t *data_frame = zmsg_pop(msg);
-    assert(data_frame);
-    struct osd_packet *p;
-    osd_rv = osd_packet_new_from_zframe(&p, data_frame);
+    struct osd_packet *fwd_pkg;
+    osd_rv = osd_packet_new_from_view(&fwd_pkg, event);
     assert(OSD_SUCCEEDED(osd_rv));
 
-    zframe_destroy(&data_frame);
-    zmsg_destroy(&msg);
-
-    *packet = p;
+    if (usrctx->event_handler) {
+        // Forward EVENT packets to handler function.
+        // Ownership of |pkg| is transferred to the event handler.
+        osd_rv = usrctx->event_handler(usrctx->event_handler_arg, fwd_pkg);
+        if (OSD_FAILED(osd_rv)) {
+            // ignore (error in user logic, packet is possibly dropped)
+        }
+        return;
+    }
 
-    return OSD_OK;
+    event_queue_push(usrctx->event_queue, fwd_pkg);
 }
 
-API_EXPORT
-osd_result osd_hostmod_new(struct osd_hostmod_ctx **ctx,
-                           struct osd_log_ctx *log_ctx,
-                           const char *host_controller_address,
-                           osd_hostmod_event_handler_fn event_handler,
-                           void *event_handler_arg)
+/**
+ * Process a packet received from the host controller
+ *
+ * Events are reassembled and passed on, responses to register accesses
+ * complete the access they belong to. Register packets which do not belong to
+ * a pending access are dropped. All other packets are added to the event
+ * queue, as they were before events and register responses were separated.
+ */
+static void iothread_handle_in_pkg(struct iothread_usr_ctx *usrctx,
+                                   const struct osd_packet_view *pkg_view)
 {
-    osd_result rv;
+    if (osd_packet_view_get_type(pkg_view) == OSD_PACKET_TYPE_EVENT) {
+        struct osd_packet_view event;
+        if (event_reassembly_add(usrctx->event_reassembly, pkg_view,
+                                 zclock_mono(), &event)) {
+            iothread_handle_in_event(usrctx, &event);
+        }
+        return;
+    }
 
-    struct osd_hostmod_ctx *c = calloc(1, sizeof(struct osd_hostmod_ctx));
-    assert(c);
+    if (osd_packet_view_get_type(pkg_view) == OSD_PACKET_TYPE_REG) {
+        // events received before the response are handled before the caller
+        // of the register access continues
+        iothread_event_batch_deliver(usrctx);
+        if (iothread_reg_req_handle_resp(usrctx, pkg_view)) {
+            return;
+        }
 
-    c->log_ctx = log_ctx;
-    c->is_connected = false;
+        err(usrctx->log_ctx,
+            "Dropping unexpected register packet from module %u.",
+            osd_packet_view_get_src(pkg_view));
+        return;
+    }
 
-    // prepare custom data passed to I/O thread
-    struct iothread_usr_ctx *iothread_usr_data =
-        calloc(1, sizeof(struct iothread_usr_ctx));
-    assert(iothread_usr_data);
+    // all other packets are received through osd_hostmod_event_receive()
+    struct osd_packet *fwd_pkg;
+    osd_result osd_rv = osd_packet_new_from_view(&fwd_pkg, pkg_view);
+    assert(OSD_SUCCEEDED(osd_rv));
+    event_queue_push(usrctx->event_queue, fwd_pkg);
+}
 
-    iothread_usr_data->event_handler = event_handler;
-    iothread_usr_data->event_handler_arg = event_handler_arg;
-    iothread_usr_data->host_controller_address =
-        strdup(host_controller_address);
-    iothread_usr_data->event_reassembly_buf = zlist_new();
+/**
+ * Process an incoming data message from the host controller
+ */
+static void iothread_handle_in_data_msg(struct iothread_usr_ctx *usrctx,
+                                        zmsg_t *msg)
+{
+    osd_result osd_rv;
 
-    rv = worker_new(&c->ioworker_ctx, log_ctx, NULL, iothread_destroy,
-                    iothread_handle_inproc_request, iothread_usr_data);
-    if (OSD_FAILED(rv)) {
-        return rv;
+    assert(usrctx);
+    assert(msg);
+
+    zmsg_first(msg);
+    zframe_t *data_frame = zmsg_next(msg);
+    assert(data_frame);
+
+    struct osd_packet_view pkg_view;
+    osd_rv = osd_packet_view_from_zframe(&pkg_view, data_frame);
+    if (OSD_FAILED(osd_rv)) {
+        err(usrctx->log_ctx,
+            "Received malformed data message of %zu bytes, dropping it.",
+            zframe_size(data_frame));
+        return;
     }
 
-    *ctx = c;
+    iothread_handle_in_pkg(usrctx, &pkg_view);
+}
 
-    return OSD_OK;
+/**
+ * Process an incoming batch data message from the host controller
+ *
+ * All packets in the batch are processed individually.
+ */
+static void iothread_handle_in_batch_msg(struct worker_thread_ctx *thread_ctx,
+                                         zmsg_t *msg)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zmsg_first(msg);
+    zframe_t *batch_frame = zmsg_next(msg);
+    assert(batch_frame);
+
+    struct packet_batch_iter iter;
+    struct osd_packet_view pkg_view;
+    packet_batch_iter_init(&iter, batch_frame);
+    while (packet_batch_iter_next(&iter, &pkg_view)) {
+        iothread_handle_in_pkg(usrctx, &pkg_view);
+    }
+    if (iter.invalid) {
+        err(thread_ctx->log_ctx,
+            "Received malformed batch data message, dropping remaining "
+            "packets in batch.");
+    }
 }
 
-API_EXPORT
-uint16_t osd_hostmod_get_diaddr(struct osd_hostmod_ctx *ctx)
+/**
+ * Discard partial events which timed out
+ *
+ * The timer stops itself once no partial events are left.
+ */
+static int iothread_event_reassembly_check_timeouts(zloop_t *loop,
+                                                    int timer_id,
+                                                    void *thread_ctx_void)
 {
-    assert(ctx);
-    assert(ctx->is_connected);
-    return ctx->diaddr;
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    size_t expired_cnt =
+        event_reassembly_expire(usrctx->event_reassembly, zclock_mono());
+    if (expired_cnt > 0) {
+        err(thread_ctx->log_ctx,
+            "Discarded %zu incomplete event(s) after a timeout.", expired_cnt);
+    }
+
+    if (!event_reassembly_has_partial(usrctx->event_reassembly)) {
+        zloop_timer_end(loop, timer_id);
+        usrctx->event_reassembly_timer_id = -1;
+    }
+
+    return 0;
 }
 
-API_EXPORT
-osd_result osd_hostmod_connect(struct osd_hostmod_ctx *ctx)
+/**
+ * Start checking partial events for timeouts if necessary
+ */
+static void iothread_event_reassembly_start_timer(
+    struct worker_thread_ctx *thread_ctx)
 {
-    osd_result rv;
-    assert(ctx);
-    assert(!ctx->is_connected);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
 
-    worker_send_status(ctx->ioworker_ctx->inproc_socket, "I-CONNECT", 0);
-    int retval;
-    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
-                                "I-CONNECT-DONE", &retval);
-    if (OSD_FAILED(rv) || retval == -1) {
-        err(ctx->log_ctx, "Unable to establish connection to host controller.");
-        return OSD_ERROR_CONNECTION_FAILED;
+    if (usrctx->event_reassembly_timer_id != -1 ||
+        !event_reassembly_has_partial(usrctx->event_reassembly)) {
+        return;
     }
 
-    ctx->diaddr = retval;
-    ctx->is_connected = true;
+    usrctx->event_reassembly_timer_id = zloop_timer(
+        thread_ctx->zloop, HOSTMOD_EVENT_REASSEMBLY_CHECK_INTERVAL_MS, 0,
+        iothread_event_reassembly_check_timeouts, thread_ctx);
+    assert(usrctx->event_reassembly_timer_id != -1);
+}
 
-    dbg(ctx->log_ctx, "Connection established, DI address is %u.", ctx->diaddr);
+/**
+ * Handle a management message from the host controller in the I/O thread
+ *
+ * The only management messages received after the connection is established
+ * are responses to IOTHREAD_OP_MGMT_REQUEST, which are passed to the main
+ * thread.
+ */
+static void iothread_handle_in_mgmt_msg(struct worker_thread_ctx *thread_ctx,
+                                        zmsg_t *msg)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
 
-    return OSD_OK;
+    zframe_t *resp_frame = zmsg_next(msg);
+    uint64_t *seq = zlist_first(usrctx->mgmt_req_seqs);
+    if (!seq || !resp_frame) {
+        err(thread_ctx->log_ctx,
+            "Ignoring unexpected management message from the host "
+            "controller.");
+        return;
+    }
+
+    // the response belongs to the oldest request
+    zlist_remove(usrctx->mgmt_req_seqs, seq);
+    mgmt_req_complete(usrctx->mgmt_req, *seq,
+                      zframe_streq(resp_frame, "ACK") ? OSD_OK
+                                                      : OSD_ERROR_FAILURE);
+    free(seq);
+}
+
+/**
+ * Fail all management requests waiting for a response
+ */
+static void iothread_mgmt_req_fail_all(struct iothread_usr_ctx *usrctx,
+                                       osd_result result)
+{
+    uint64_t *seq;
+    while ((seq = zlist_pop(usrctx->mgmt_req_seqs))) {
+        mgmt_req_complete(usrctx->mgmt_req, *seq, result);
+        free(seq);
+    }
 }
 
-API_EXPORT
-bool osd_hostmod_is_connected(struct osd_hostmod_ctx *ctx)
-{
-    assert(ctx);
-    return ctx->is_connected;
+/**
+ * Process incoming messages from the host controller
+ *
+ * @return 0 if the message was processed, -1 if @p loop should be terminated
+ */
+static int iothread_rcv_from_hostctrl(zloop_t *loop, zsock_t *reader,
+                                      void *thread_ctx_void)
+{
+    struct worker_thread_ctx *thread_ctx =
+        (struct worker_thread_ctx *)thread_ctx_void;
+    assert(thread_ctx);
+
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zmsg_t *msg = zmsg_recv(reader);
+    if (!msg) {
+        return -1;  // process was interrupted, terminate zloop
+    }
+
+    zframe_t *type_frame = zmsg_first(msg);
+    assert(type_frame);
+    if (zframe_streq(type_frame, "D")) {
+        iothread_handle_in_data_msg(usrctx, msg);
+        zmsg_destroy(&msg);
+
+    } else if (zframe_streq(type_frame, "B")) {
+        iothread_handle_in_batch_msg(thread_ctx, msg);
+        zmsg_destroy(&msg);
+
+    } else if (zframe_streq(type_frame, "M")) {
+        iothread_handle_in_mgmt_msg(thread_ctx, msg);
+        zmsg_destroy(&msg);
+
+    } else {
+        assert(0 && "Message of unknown type received.");
+    }
+
+    // All events received in one message are passed to the batch event
+    // handler at once.
+    iothread_event_batch_deliver(usrctx);
+
+    iothread_event_reassembly_start_timer(thread_ctx);
+
+    return 0;
+}
+
+/**
+ * Obtain a DI address from the host controller
+ *
+ * @param log_ctx the logging context
+ * @param sock a DEALER socket connected to the host controller
+ * @param host_controller_address the address of the host controller (used
+ *                                for logging only)
+ * @param[out] di_addr the obtained DI address
+ */
+static osd_result obtain_diaddr(struct osd_log_ctx *log_ctx, zsock_t *sock,
+                                const char *host_controller_address,
+                                uint16_t *di_addr)
+{
+    int rv;
+
+    // request
+    zmsg_t *msg_req = zmsg_new();
+    assert(msg_req);
+
+    rv = zmsg_addstr(msg_req, "M");
+    assert(rv == 0);
+    rv = zmsg_addstr(msg_req, "DIADDR_REQUEST");
+    assert(rv == 0);
+    rv = zmsg_send(&msg_req, sock);
+    if (rv != 0) {
+        err(log_ctx,
+            "Unable to send DIADDR_REQUEST request to "
+            "host controller");
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    // response
+    errno = 0;
+    zmsg_t *msg_resp = zmsg_recv(sock);
+    if (!msg_resp) {
+        err(log_ctx,
+            "No response received from host controller at %s: %s (%d)",
+            host_controller_address, strerror(errno), errno);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    zframe_t *type_frame = zmsg_pop(msg_resp);
+    assert(zframe_streq(type_frame, "M"));
+    zframe_destroy(&type_frame);
+
+    char *addr_string = zmsg_popstr(msg_resp);
+    assert(addr_string);
+    if (!strcmp(addr_string, "NACK")) {
+        err(log_ctx, "The host controller at %s has no DI address available.",
+            host_controller_address);
+        free(addr_string);
+        zmsg_destroy(&msg_resp);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+    char *end;
+    long int addr = strtol(addr_string, &end, 10);
+    assert(!*end);
+    assert(addr <= UINT16_MAX);
+    *di_addr = (uint16_t)addr;
+    free(addr_string);
+
+    zmsg_destroy(&msg_resp);
+
+    dbg(log_ctx,
+        "Obtained DI address %u.%u (%u) from host controller.",
+        osd_diaddr_subnet(*di_addr), osd_diaddr_localaddr(*di_addr), *di_addr);
+
+    return OSD_OK;
+}
+
+/**
+ * Release the DI address obtained with obtain_diaddr()
+ *
+ * The host controller also removes all event subscriptions of the DI address.
+ * Data messages which are still in flight to the host module are discarded.
+ *
+ * @param log_ctx the logging context
+ * @param sock a DEALER socket connected to the host controller
+ * @param host_controller_address the address of the host controller (used
+ *                                for logging only)
+ */
+static osd_result release_diaddr(struct osd_log_ctx *log_ctx, zsock_t *sock,
+                                 const char *host_controller_address)
+{
+    int rv;
+
+    // request
+    zmsg_t *msg_req = zmsg_new();
+    assert(msg_req);
+
+    rv = zmsg_addstr(msg_req, "M");
+    assert(rv == 0);
+    rv = zmsg_addstr(msg_req, "DIADDR_RELEASE");
+    assert(rv == 0);
+    rv = zmsg_send(&msg_req, sock);
+    if (rv != 0) {
+        err(log_ctx,
+            "Unable to send DIADDR_RELEASE request to "
+            "host controller");
+        zmsg_destroy(&msg_req);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    // response
+    while (1) {
+        errno = 0;
+        zmsg_t *msg_resp = zmsg_recv(sock);
+        if (!msg_resp) {
+            err(log_ctx,
+                "No response received from host controller at %s: %s (%d)",
+                host_controller_address, strerror(errno), errno);
+            return OSD_ERROR_CONNECTION_FAILED;
+        }
+
+        zframe_t *type_frame = zmsg_first(msg_resp);
+        if (!zframe_streq(type_frame, "M")) {
+            zmsg_destroy(&msg_resp);
+            continue;
+        }
+        zframe_t *status_frame = zmsg_next(msg_resp);
+        bool acked = status_frame && zframe_streq(status_frame, "ACK");
+        zmsg_destroy(&msg_resp);
+
+        if (!acked) {
+            err(log_ctx, "The host controller at %s refused to release the "
+                "DI address.", host_controller_address);
+            return OSD_ERROR_FAILURE;
+        }
+        return OSD_OK;
+    }
+}
+
+/**
+ * Start using the connection to the host controller in the I/O thread
+ *
+ * This function is called by the I/O worker thread as response to the
+ * IOTHREAD_OP_CONNECT message, which carries the DEALER ZeroMQ socket
+ * connected to the host controller. The socket is set up by the calling
+ * thread in osd_hostmod_connect(), including the exchanges with the host
+ * controller which block until it responds: the I/O thread might be a thread
+ * of an I/O reactor shared with other host modules, which must not be blocked
+ * by an unreachable host controller. From now on the socket is only used by
+ * the I/O thread. After completion the function sends out a
+ * IOTHREAD_OP_CONNECT_DONE message.
+ */
+static void iothread_connect_to_hostctrl(struct worker_thread_ctx *thread_ctx,
+                                         zsock_t *hostctrl_socket)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+    assert(!usrctx->hostctrl_socket);
+
+    usrctx->hostctrl_socket = hostctrl_socket;
+
+    // register handler for messages coming from the host controller
+    int zmq_rv;
+    zmq_rv = zloop_reader(thread_ctx->zloop, usrctx->hostctrl_socket,
+                          iothread_rcv_from_hostctrl, thread_ctx);
+    assert(zmq_rv == 0);
+    zloop_reader_set_tolerant(thread_ctx->zloop, usrctx->hostctrl_socket);
+
+    worker_send_status(thread_ctx->inproc_socket, IOTHREAD_OP_CONNECT_DONE,
+                       OSD_OK);
+}
+
+/**
+ * Stop using the connection to the host controller in the I/O thread
+ *
+ * This function is called when receiving a IOTHREAD_OP_DISCONNECT message in
+ * the I/O thread. All pending packets are sent out, afterwards the socket is
+ * no longer used by the I/O thread and given back to the calling thread, which
+ * releases the DI address and closes the connection (see
+ * osd_hostmod_disconnect()). After the disconnect is done a
+ * IOTHREAD_OP_DISCONNECT_DONE message is sent to the main thread.
+ */
+static void iothread_disconnect_from_hostctrl(
+    struct worker_thread_ctx *thread_ctx)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    osd_result retval;
+
+    // send out all pending packets before closing the connection
+    packet_batch_flush(usrctx->tx_batch);
+
+    zloop_reader_end(thread_ctx->zloop, usrctx->hostctrl_socket);
+    usrctx->hostctrl_socket = NULL;
+
+    // no responses can be received any more
+    iothread_reg_req_fail_all(thread_ctx, OSD_ERROR_NOT_CONNECTED);
+    iothread_mgmt_req_fail_all(usrctx, OSD_ERROR_NOT_CONNECTED);
+
+    retval = OSD_OK;
+
+    worker_send_status(thread_ctx->inproc_socket, IOTHREAD_OP_DISCONNECT_DONE,
+                       retval);
+}
+
+static osd_result iothread_handle_connect(struct worker_thread_ctx *thread_ctx,
+                                          zmsg_t **msg_p)
+{
+    zframe_t *socket_frame = zmsg_last(*msg_p);
+    assert(zframe_size(socket_frame) == sizeof(zsock_t *));
+    zsock_t *hostctrl_socket;
+    memcpy(&hostctrl_socket, zframe_data(socket_frame), sizeof(zsock_t *));
+
+    iothread_connect_to_hostctrl(thread_ctx, hostctrl_socket);
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_disconnect(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    iothread_disconnect_from_hostctrl(thread_ctx);
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_set_batch_policy(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zframe_t *policy_frame = zmsg_last(*msg_p);
+    assert(zframe_size(policy_frame) ==
+           sizeof(struct osd_packet_batch_policy));
+    struct osd_packet_batch_policy policy;
+    memcpy(&policy, zframe_data(policy_frame), sizeof(policy));
+    packet_batch_set_policy(usrctx->tx_batch, &policy);
+
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_set_event_consumer(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zframe_t *consumer_frame = zmsg_last(*msg_p);
+    assert(zframe_size(consumer_frame) == sizeof(struct event_consumer *));
+    memcpy(&usrctx->event_consumer, zframe_data(consumer_frame),
+           sizeof(struct event_consumer *));
+
+    worker_send_status(thread_ctx->inproc_socket,
+                       IOTHREAD_OP_SET_EVENT_CONSUMER_DONE, OSD_OK);
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_set_event_batch_handler(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zframe_t *handler_frame = zmsg_last(*msg_p);
+    assert(zframe_size(handler_frame) ==
+           sizeof(struct iothread_event_batch_handler));
+    struct iothread_event_batch_handler handler;
+    memcpy(&handler, zframe_data(handler_frame), sizeof(handler));
+
+    iothread_event_batch_deliver(usrctx);
+    usrctx->event_batch_handler = handler.handler;
+    usrctx->event_batch_handler_arg = handler.handler_arg;
+
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_mgmt_request(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zframe_t *opcode_frame = zmsg_pop(*msg_p);
+    zframe_destroy(&opcode_frame);
+
+    zframe_t *seq_frame = zmsg_first(*msg_p);
+    assert(seq_frame && zframe_size(seq_frame) == sizeof(uint64_t));
+    uint64_t *seq = malloc(sizeof(uint64_t));
+    assert(seq);
+    memcpy(seq, zframe_data(seq_frame), sizeof(uint64_t));
+
+    if (!usrctx->hostctrl_socket) {
+        mgmt_req_complete(usrctx->mgmt_req, *seq, OSD_ERROR_NOT_CONNECTED);
+        free(seq);
+        return OSD_OK;
+    }
+
+    zframe_t *req_frame = zmsg_next(*msg_p);
+    assert(req_frame);
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+    zmsg_addstr(msg, "M");
+    zmsg_addmem(msg, zframe_data(req_frame), zframe_size(req_frame));
+    int rv = zmsg_send(&msg, usrctx->hostctrl_socket);
+    if (rv != 0) {
+        zmsg_destroy(&msg);
+        mgmt_req_complete(usrctx->mgmt_req, *seq,
+                          OSD_ERROR_CONNECTION_FAILED);
+        free(seq);
+        return OSD_OK;
+    }
+
+    // the response is passed on by iothread_handle_in_mgmt_msg()
+    rv = zlist_append(usrctx->mgmt_req_seqs, seq);
+    assert(rv == 0);
+    return OSD_OK;
+}
+
+static osd_result iothread_handle_set_event_reassembly_limits(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    zframe_t *limits_frame = zmsg_last(*msg_p);
+    assert(zframe_size(limits_frame) ==
+           sizeof(struct iothread_event_reassembly_limits));
+    struct iothread_event_reassembly_limits limits;
+    memcpy(&limits, zframe_data(limits_frame), sizeof(limits));
+    event_reassembly_set_limits(usrctx->event_reassembly, limits.max_bytes,
+                                limits.timeout_ms);
+
+    return OSD_OK;
+}
+
+/**
+ * Forward a data packet from the main thread to the host controller
+ */
+static osd_result iothread_handle_data(struct worker_thread_ctx *thread_ctx,
+                                       zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    int rv;
+
+    if (!packet_batch_is_enabled(usrctx->tx_batch)) {
+        // the message is a valid data message for the host controller
+        rv = zmsg_send(msg_p, usrctx->hostctrl_socket);
+        assert(rv == 0);
+    } else {
+        zframe_t *data_frame = zmsg_last(*msg_p);
+        struct osd_packet_view pkg;
+        osd_result osd_rv = osd_packet_view_from_zframe(&pkg, data_frame);
+        if (OSD_FAILED(osd_rv)) {
+            err(thread_ctx->log_ctx,
+                "Dropping malformed data packet of %zu bytes.",
+                zframe_size(data_frame));
+            return OSD_OK;
+        }
+        packet_batch_add(usrctx->tx_batch, &pkg);
+    }
+
+    return OSD_OK;
+}
+
+/**
+ * Start an asynchronous register access
+ *
+ * The message contains the struct iothread_reg_req and the request packet.
+ * The request is recorded as pending, and the packet is sent out like any
+ * other data packet.
+ */
+static osd_result iothread_handle_reg_submit(
+    struct worker_thread_ctx *thread_ctx, zmsg_t **msg_p)
+{
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    int rv;
+
+    zframe_t *opcode_frame = zmsg_pop(*msg_p);
+    zframe_destroy(&opcode_frame);
+
+    zframe_t *req_frame = zmsg_pop(*msg_p);
+    assert(zframe_size(req_frame) == sizeof(struct iothread_reg_req));
+    struct iothread_reg_req *req = malloc(sizeof(struct iothread_reg_req));
+    assert(req);
+    memcpy(req, zframe_data(req_frame), sizeof(struct iothread_reg_req));
+    zframe_destroy(&req_frame);
+
+    if (!usrctx->hostctrl_socket) {
+        // disconnected after the request was submitted
+        req->op->result = OSD_ERROR_NOT_CONNECTED;
+        req->cb(req->cb_arg, req->req_id, req->op);
+        free(req);
+        return OSD_OK;
+    }
+
+    if (req->flags & OSD_HOSTMOD_BLOCKING) {
+        req->deadline = -1;
+    } else {
+        req->deadline = zclock_mono() + ZMQ_RCV_TIMEOUT;
+    }
+    rv = zlist_append(usrctx->reg_reqs, req);
+    assert(rv == 0);
+
+    if (usrctx->reg_timer_id == -1) {
+        usrctx->reg_timer_id = zloop_timer(
+            thread_ctx->zloop, HOSTMOD_REG_TIMEOUT_CHECK_INTERVAL_MS, 0,
+            iothread_reg_req_check_timeouts, thread_ctx);
+        assert(usrctx->reg_timer_id != -1);
+    }
+
+    // the remaining frame is the request packet: send it as data message
+    rv = zmsg_pushstr(*msg_p, "D");
+    assert(rv == 0);
+    return iothread_handle_data(thread_ctx, msg_p);
+}
+
+/**
+ * Handlers for messages from the main thread
+ */
+static const struct worker_cmd_handler iothread_cmd_handlers[] = {
+    { IOTHREAD_OP_CONNECT, iothread_handle_connect },
+    { IOTHREAD_OP_DISCONNECT, iothread_handle_disconnect },
+    { IOTHREAD_OP_SET_BATCH_POLICY, iothread_handle_set_batch_policy },
+    { IOTHREAD_OP_REG_SUBMIT, iothread_handle_reg_submit },
+    { IOTHREAD_OP_SET_EVENT_CONSUMER, iothread_handle_set_event_consumer },
+    { IOTHREAD_OP_SET_EVENT_REASSEMBLY_LIMITS,
+      iothread_handle_set_event_reassembly_limits },
+    { IOTHREAD_OP_SET_EVENT_BATCH_HANDLER,
+      iothread_handle_set_event_batch_handler },
+    { IOTHREAD_OP_MGMT_REQUEST, iothread_handle_mgmt_request },
+    { WORKER_OP_DATA, iothread_handle_data },
+};
+
+/**
+ * Send a message from the batch builder to the host controller
+ */
+static void iothread_send_to_hostctrl(zmsg_t **msg_p, void *thread_ctx_void)
+{
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    int rv = zmsg_send(msg_p, usrctx->hostctrl_socket);
+    assert(rv == 0);
+}
+
+static osd_result iothread_init(struct worker_thread_ctx *thread_ctx)
+{
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    packet_batch_new(&usrctx->tx_batch, thread_ctx->zloop,
+                     iothread_send_to_hostctrl, thread_ctx);
+
+    usrctx->log_ctx = thread_ctx->log_ctx;
+    usrctx->reg_reqs = zlist_new();
+    assert(usrctx->reg_reqs);
+    usrctx->mgmt_req_seqs = zlist_new();
+    assert(usrctx->mgmt_req_seqs);
+    usrctx->reg_timer_id = -1;
+    usrctx->event_reassembly_timer_id = -1;
+
+    return OSD_OK;
+}
+
+static osd_result iothread_destroy(struct worker_thread_ctx *thread_ctx)
+{
+    assert(thread_ctx);
+    struct iothread_usr_ctx *usrctx = thread_ctx->usr;
+    assert(usrctx);
+
+    packet_batch_free(&usrctx->tx_batch);
+
+    iothread_reg_req_fail_all(thread_ctx, OSD_ERROR_NOT_CONNECTED);
+    zlist_destroy(&usrctx->reg_reqs);
+    iothread_mgmt_req_fail_all(usrctx, OSD_ERROR_NOT_CONNECTED);
+    zlist_destroy(&usrctx->mgmt_req_seqs);
+
+    // The zloop might be shared with other workers and outlive this one:
+    // remove the host controller connection if it is still open.
+    if (usrctx->hostctrl_socket) {
+        zloop_reader_end(thread_ctx->zloop, usrctx->hostctrl_socket);
+        zsock_destroy(&usrctx->hostctrl_socket);
+    }
+
+    if (usrctx->event_reassembly_timer_id != -1) {
+        zloop_timer_end(thread_ctx->zloop, usrctx->event_reassembly_timer_id);
+        usrctx->event_reassembly_timer_id = -1;
+    }
+
+    free(usrctx->event_batch.buf);
+    free(usrctx->event_batch.views);
+    free(usrctx);
+    thread_ctx->usr = NULL;
+
+    return OSD_OK;
+}
+
+/**
+ * Connect the calling thread to the host controller for register accesses
+ *
+ * The connection gets its own DI address: the host controller routes the
+ * responses to register accesses issued through it directly to the calling
+ * thread, bypassing the I/O thread.
+ */
+static osd_result reg_socket_connect(struct osd_hostmod_ctx *ctx)
+{
+    osd_result rv;
+
+    assert(!ctx->reg_socket);
+
+    rv = hostctrl_connect(ctx->log_ctx, ctx->host_controller_address,
+                          ctx->target_subnet, &ctx->reg_socket);
+    if (OSD_FAILED(rv)) {
+        return rv;
+    }
+
+    rv = obtain_diaddr(ctx->log_ctx, ctx->reg_socket,
+                       ctx->host_controller_address, &ctx->reg_diaddr);
+    if (OSD_FAILED(rv)) {
+        zsock_destroy(&ctx->reg_socket);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    dbg(ctx->log_ctx, "Direct register access enabled, DI address is %u.",
+        ctx->reg_diaddr);
+    return OSD_OK;
+}
+
+/**
+ * Close the connection used for direct register accesses (if any)
+ *
+ * The DI address of the connection is released.
+ */
+static void reg_socket_disconnect(struct osd_hostmod_ctx *ctx)
+{
+    struct osd_packet *pkg;
+    while ((pkg = zlist_pop(ctx->reg_socket_pkgs))) {
+        osd_packet_free(&pkg);
+    }
+
+    if (!ctx->reg_socket) {
+        return;
+    }
+
+    osd_result rv = release_diaddr(ctx->log_ctx, ctx->reg_socket,
+                                   ctx->host_controller_address);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx,
+            "Unable to release the DI address %u used for direct register "
+            "accesses, continuing anyway.", ctx->reg_diaddr);
+    }
+
+    zsock_destroy(&ctx->reg_socket);
+}
+
+/**
+ * Receive a DI packet through the direct register access connection
+ *
+ * Responses to register accesses are received in the calling thread. All
+ * other packets are dropped.
+ */
+static osd_result reg_socket_receive_packet(struct osd_hostmod_ctx *ctx,
+                                            struct osd_packet **packet,
+                                            int flags)
+{
+    osd_result osd_rv;
+
+    // block register read indefinitely until response has been received
+    bool do_block = (flags & OSD_HOSTMOD_BLOCKING);
+
+    while (zlist_size(ctx->reg_socket_pkgs) == 0) {
+        errno = 0;
+        zmsg_t *msg = zmsg_recv(ctx->reg_socket);
+        if (!msg && errno == EAGAIN && do_block) {
+            continue;
+        }
+        if (!msg && errno == EAGAIN) {
+            return OSD_ERROR_TIMEDOUT;
+        }
+        if (!msg) {
+            return OSD_ERROR_FAILURE;
+        }
+
+        zframe_t *type_frame = zmsg_first(msg);
+        zframe_t *data_frame = zmsg_next(msg);
+        if (zframe_streq(type_frame, "D") && data_frame) {
+            struct osd_packet_view pkg_view;
+            osd_rv = osd_packet_view_from_zframe(&pkg_view, data_frame);
+            if (OSD_SUCCEEDED(osd_rv)) {
+                struct osd_packet *pkg;
+                osd_rv = osd_packet_new_from_view(&pkg, &pkg_view);
+                assert(OSD_SUCCEEDED(osd_rv));
+                zlist_append(ctx->reg_socket_pkgs, pkg);
+            } else {
+                err(ctx->log_ctx, "Dropping invalid data packet (%d)", osd_rv);
+            }
+        } else if (zframe_streq(type_frame, "B") && data_frame) {
+            struct packet_batch_iter iter;
+            struct osd_packet_view pkg_view;
+            packet_batch_iter_init(&iter, data_frame);
+            while (packet_batch_iter_next(&iter, &pkg_view)) {
+                struct osd_packet *pkg;
+                osd_rv = osd_packet_new_from_view(&pkg, &pkg_view);
+                assert(OSD_SUCCEEDED(osd_rv));
+                zlist_append(ctx->reg_socket_pkgs, pkg);
+            }
+            if (iter.invalid) {
+                err(ctx->log_ctx,
+                    "Received malformed batch data message, dropping "
+                    "remaining packets in batch.");
+            }
+        } else {
+            err(ctx->log_ctx,
+                "Dropping unexpected message received through the direct "
+                "register access connection.");
+        }
+        zmsg_destroy(&msg);
+    }
+
+    *packet = zlist_pop(ctx->reg_socket_pkgs);
+    return OSD_OK;
+}
+
+/**
+ * Send a DI Packet as data message through a socket
+ */
+static osd_result send_packet(zsock_t *sock, const struct osd_packet *packet)
+{
+    int rv;
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+
+    rv = zmsg_addstr(msg, "D");
+    assert(rv == 0);
+    rv = zmsg_addmem(msg, packet->data_raw, osd_packet_sizeof(packet));
+    assert(rv == 0);
+
+    rv = zmsg_send(&msg, sock);
+    if (rv != 0) {
+        zmsg_destroy(&msg);
+        return OSD_ERROR_COM;
+    }
+
+    return OSD_OK;
+}
+
+/**
+ * Send a message to the I/O thread
+ *
+ * Can be called from any thread.
+ */
+static osd_result inproc_send(struct osd_hostmod_ctx *ctx, zmsg_t **msg_p)
+{
+    pthread_mutex_lock(&ctx->inproc_lock);
+    int rv = zmsg_send(msg_p, ctx->ioworker_ctx->inproc_socket);
+    pthread_mutex_unlock(&ctx->inproc_lock);
+    if (rv != 0) {
+        zmsg_destroy(msg_p);
+        return OSD_ERROR_COM;
+    }
+    return OSD_OK;
+}
+
+/**
+ * Send data to the I/O thread
+ *
+ * Same as worker_send_data(), but can be called from any thread.
+ */
+static void inproc_send_data(struct osd_hostmod_ctx *ctx, int type,
+                             const void *data, size_t size)
+{
+    pthread_mutex_lock(&ctx->inproc_lock);
+    worker_send_data(ctx->ioworker_ctx->inproc_socket, type, data, size);
+    pthread_mutex_unlock(&ctx->inproc_lock);
+}
+
+/**
+ * Send a DI Packet to the host controller
+ *
+ * The actual sending is done through the I/O worker. Can be called from any
+ * thread.
+ */
+static osd_result osd_hostmod_send_packet(struct osd_hostmod_ctx *ctx,
+                                          const struct osd_packet *packet)
+{
+    assert(ctx);
+    assert(ctx->ioworker_ctx);
+    assert(ctx->ioworker_ctx->inproc_socket);
+
+    int rv;
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+
+    rv = zmsg_addstr(msg, "D");
+    assert(rv == 0);
+    rv = zmsg_addmem(msg, packet->data_raw, osd_packet_sizeof(packet));
+    assert(rv == 0);
+
+    return inproc_send(ctx, &msg);
+}
+
+API_EXPORT
+osd_result osd_hostmod_new(struct osd_hostmod_ctx **ctx,
+                           struct osd_log_ctx *log_ctx,
+                           const char *host_controller_address,
+                           osd_hostmod_event_handler_fn event_handler,
+                           void *event_handler_arg)
+{
+    return osd_hostmod_new_with_reactor(ctx, log_ctx, host_controller_address,
+                                        event_handler, event_handler_arg, NULL);
+}
+
+API_EXPORT
+osd_result osd_hostmod_new_with_reactor(
+    struct osd_hostmod_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address,
+    osd_hostmod_event_handler_fn event_handler, void *event_handler_arg,
+    struct osd_ioreactor_ctx *reactor)
+{
+    osd_result rv;
+
+    struct osd_hostmod_ctx *c = calloc(1, sizeof(struct osd_hostmod_ctx));
+    assert(c);
+
+    c->log_ctx = log_ctx;
+    c->is_connected = false;
+    c->event_handler = event_handler;
+    c->event_handler_arg = event_handler_arg;
+    c->host_controller_address = strdup(host_controller_address);
+    assert(c->host_controller_address);
+    c->target_subnet = -1;
+    c->reg_access_mode = OSD_HOSTMOD_REG_ACCESS_IOTHREAD;
+    c->reg_socket_pkgs = zlist_new();
+    assert(c->reg_socket_pkgs);
+    pthread_mutex_init(&c->inproc_lock, NULL);
+    mgmt_req_state_init(&c->mgmt_req);
+    pthread_mutex_init(&c->reg_cache_lock, NULL);
+    reg_cache_new(&c->reg_cache);
+    event_queue_new(&c->event_queue);
+    event_reassembly_new(&c->event_reassembly,
+                         EVENT_REASSEMBLY_MAX_BYTES_DEFAULT,
+                         EVENT_REASSEMBLY_TIMEOUT_MS_DEFAULT);
+
+    // prepare custom data passed to I/O thread
+    struct iothread_usr_ctx *iothread_usr_data =
+        calloc(1, sizeof(struct iothread_usr_ctx));
+    assert(iothread_usr_data);
+
+    iothread_usr_data->event_handler = event_handler;
+    iothread_usr_data->event_handler_arg = event_handler_arg;
+    iothread_usr_data->event_reassembly = c->event_reassembly;
+    iothread_usr_data->event_queue = c->event_queue;
+    iothread_usr_data->mgmt_req = &c->mgmt_req;
+
+    rv = worker_new_with_reactor(&c->ioworker_ctx, reactor, log_ctx,
+                                 iothread_init, iothread_destroy,
+                                 iothread_cmd_handlers,
+                                 sizeof(iothread_cmd_handlers) /
+                                     sizeof(iothread_cmd_handlers[0]),
+                                 iothread_usr_data);
+    if (OSD_FAILED(rv)) {
+        reg_cache_free(&c->reg_cache);
+        event_queue_free(&c->event_queue);
+        event_reassembly_free(&c->event_reassembly);
+        zlist_destroy(&c->reg_socket_pkgs);
+        pthread_mutex_destroy(&c->inproc_lock);
+        mgmt_req_state_destroy(&c->mgmt_req);
+        pthread_mutex_destroy(&c->reg_cache_lock);
+        free(c->host_controller_address);
+        free(c);
+        return rv;
+    }
+
+    *ctx = c;
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_hostmod_set_target_subnet(struct osd_hostmod_ctx *ctx,
+                                   unsigned int subnet)
+{
+    assert(ctx);
+    assert(!ctx->is_connected);
+    assert(subnet <= OSD_DIADDR_SUBNET_MAX);
+
+    ctx->target_subnet = subnet;
+}
+
+API_EXPORT
+void osd_hostmod_set_reg_access_mode(struct osd_hostmod_ctx *ctx,
+                                     enum osd_hostmod_reg_access_mode mode)
+{
+    assert(ctx);
+    assert(!ctx->is_connected);
+
+    ctx->reg_access_mode = mode;
+}
+
+API_EXPORT
+osd_result osd_hostmod_set_batch_policy(
+    struct osd_hostmod_ctx *ctx, const struct osd_packet_batch_policy *policy)
+{
+    assert(ctx);
+    assert(policy);
+    assert((policy->max_packets <= 1 || policy->max_delay_us > 0) &&
+           "A maximum delay is required if batching is enabled.");
+
+    if (!ctx->ioworker_ctx->thread_is_running) {
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+    inproc_send_data(ctx, IOTHREAD_OP_SET_BATCH_POLICY, policy,
+                     sizeof(struct osd_packet_batch_policy));
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_hostmod_set_event_batch_handler(
+    struct osd_hostmod_ctx *ctx, osd_hostmod_event_batch_handler_fn handler,
+    void *handler_arg)
+{
+    assert(ctx);
+    assert(handler);
+    assert(!ctx->is_connected);
+    assert(!ctx->event_consumer &&
+           "Set the batch event handler before enabling the event handler "
+           "thread.");
+
+    ctx->event_batch_handler = handler;
+    ctx->event_batch_handler_arg = handler_arg;
+
+    struct iothread_event_batch_handler batch_handler = {
+        .handler = handler,
+        .handler_arg = handler_arg,
+    };
+    worker_send_data(ctx->ioworker_ctx->inproc_socket,
+                     IOTHREAD_OP_SET_EVENT_BATCH_HANDLER, &batch_handler,
+                     sizeof(batch_handler));
+}
+
+API_EXPORT
+osd_result osd_hostmod_set_event_handler_thread(struct osd_hostmod_ctx *ctx,
+                                                bool enable)
+{
+    osd_result rv;
+
+    assert(ctx);
+    assert((ctx->event_handler || ctx->event_batch_handler) &&
+           "An event handler or a batch event handler must be set.");
+    assert(!ctx->is_connected);
+
+    if (enable == (ctx->event_consumer != NULL)) {
+        return OSD_OK;
+    }
+
+    struct event_consumer *event_consumer = NULL;
+    if (enable && ctx->event_batch_handler) {
+        event_consumer_new_batch(&event_consumer,
+                                 PACKET_RING_CAPACITY_DEFAULT_WORDS,
+                                 ctx->event_batch_handler,
+                                 ctx->event_batch_handler_arg);
+    } else if (enable) {
+        event_consumer_new(&event_consumer, PACKET_RING_CAPACITY_DEFAULT_WORDS,
+                           ctx->event_handler, ctx->event_handler_arg);
+    }
+
+    worker_send_data(ctx->ioworker_ctx->inproc_socket,
+                     IOTHREAD_OP_SET_EVENT_CONSUMER, &event_consumer,
+                     sizeof(struct event_consumer *));
+    int retval;
+    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
+                                IOTHREAD_OP_SET_EVENT_CONSUMER_DONE, &retval);
+    if (OSD_FAILED(rv)) {
+        // The I/O thread might use either consumer: keep both of them.
+        err(ctx->log_ctx, "Unable to change the event handler thread.");
+        return rv;
+    }
+
+    if (enable) {
+        ctx->event_consumer = event_consumer;
+    } else {
+        event_consumer_free(&ctx->event_consumer);
+    }
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_hostmod_event_handler_flush(struct osd_hostmod_ctx *ctx)
+{
+    assert(ctx);
+
+    if (ctx->event_consumer) {
+        event_consumer_flush(ctx->event_consumer);
+    }
+}
+
+API_EXPORT
+osd_result osd_hostmod_get_event_handler_stats(
+    struct osd_hostmod_ctx *ctx, struct osd_hostmod_event_handler_stats *stats)
+{
+    assert(ctx);
+    assert(stats);
+
+    if (!ctx->event_consumer) {
+        return OSD_ERROR_FAILURE;
+    }
+
+    struct event_consumer_stats consumer_stats;
+    event_consumer_get_stats(ctx->event_consumer, &consumer_stats);
+    stats->events = consumer_stats.events;
+    stats->handler_time_total_ns = consumer_stats.handler_time_total_ns;
+    stats->handler_time_max_ns = consumer_stats.handler_time_max_ns;
+    stats->queue_fill_bytes = consumer_stats.queue_fill_bytes;
+    stats->queue_fill_max_bytes = consumer_stats.queue_fill_max_bytes;
+    stats->queue_stalls = consumer_stats.queue_stalls;
+
+    return OSD_OK;
+}
+
+API_EXPORT
+uint16_t osd_hostmod_get_diaddr(struct osd_hostmod_ctx *ctx)
+{
+    assert(ctx);
+    assert(ctx->is_connected);
+    return ctx->diaddr;
+}
+
+API_EXPORT
+osd_result osd_hostmod_connect(struct osd_hostmod_ctx *ctx)
+{
+    osd_result rv;
+    assert(ctx);
+    assert(!ctx->is_connected);
+
+    // Connect and obtain our DI address in the calling thread: waiting for
+    // the host controller must not block an I/O thread shared with other
+    // host modules (see iothread_connect_to_hostctrl()).
+    rv = hostctrl_connect(ctx->log_ctx, ctx->host_controller_address,
+                          ctx->target_subnet, &ctx->hostctrl_socket);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx, "Unable to establish connection to host controller.");
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    uint16_t di_addr;
+    rv = obtain_diaddr(ctx->log_ctx, ctx->hostctrl_socket,
+                       ctx->host_controller_address, &di_addr);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx, "Unable to establish connection to host controller.");
+        zsock_destroy(&ctx->hostctrl_socket);
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    event_queue_set_closed(ctx->event_queue, false);
+
+    // hand the connection over to the I/O thread
+    worker_send_data(ctx->ioworker_ctx->inproc_socket, IOTHREAD_OP_CONNECT,
+                     &ctx->hostctrl_socket, sizeof(zsock_t *));
+    int retval;
+    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
+                                IOTHREAD_OP_CONNECT_DONE, &retval);
+    if (OSD_FAILED(rv)) {
+        // The I/O thread might use the socket already: keep it (and the DI
+        // address).
+        err(ctx->log_ctx, "Unable to establish connection to host controller.");
+        ctx->hostctrl_socket = NULL;
+        return OSD_ERROR_CONNECTION_FAILED;
+    }
+
+    ctx->diaddr = di_addr;
+    ctx->is_connected = true;
+
+    dbg(ctx->log_ctx, "Connection established, DI address is %u.", ctx->diaddr);
+
+    if (ctx->reg_access_mode == OSD_HOSTMOD_REG_ACCESS_DIRECT) {
+        rv = reg_socket_connect(ctx);
+        if (OSD_FAILED(rv)) {
+            osd_hostmod_disconnect(ctx);
+            return rv;
+        }
+    }
+
+    return OSD_OK;
+}
+
+API_EXPORT
+bool osd_hostmod_is_connected(struct osd_hostmod_ctx *ctx)
+{
+    assert(ctx);
+    return ctx->is_connected;
+}
+
+API_EXPORT
+osd_result osd_hostmod_disconnect(struct osd_hostmod_ctx *ctx)
+{
+    osd_result rv;
+
+    assert(ctx);
+
+    if (!ctx->is_connected) {
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+
+    reg_socket_disconnect(ctx);
+
+    // The I/O thread might be waiting for space in the event queue, which
+    // nobody will make while we wait for the disconnect to complete.
+    event_queue_set_closed(ctx->event_queue, true);
+
+    worker_send_status(ctx->ioworker_ctx->inproc_socket,
+                       IOTHREAD_OP_DISCONNECT, 0);
+    osd_result retval;
+    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
+                                IOTHREAD_OP_DISCONNECT_DONE, &retval);
+    if (OSD_FAILED(rv)) {
+        return rv;
+    }
+    if (OSD_FAILED(retval)) {
+        return retval;
+    }
+
+    // The I/O thread doesn't use the socket any more. Give back the DI
+    // address, which also ends all event subscriptions.
+    rv = release_diaddr(ctx->log_ctx, ctx->hostctrl_socket,
+                        ctx->host_controller_address);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx,
+            "Unable to release the DI address, continuing anyway.");
+    }
+    zsock_destroy(&ctx->hostctrl_socket);
+
+    ctx->is_connected = false;
+
+    if (ctx->event_consumer) {
+        event_consumer_flush(ctx->event_consumer);
+    }
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_hostmod_free(struct osd_hostmod_ctx **ctx_p)
+{
+    assert(ctx_p);
+    struct osd_hostmod_ctx *ctx = *ctx_p;
+    if (!ctx) {
+        return;
+    }
+
+    assert(!ctx->is_connected);
+
+    worker_free(&ctx->ioworker_ctx);
+    event_consumer_free(&ctx->event_consumer);
+    reg_cache_free(&ctx->reg_cache);
+    event_queue_free(&ctx->event_queue);
+    event_reassembly_free(&ctx->event_reassembly);
+    zlist_destroy(&ctx->reg_socket_pkgs);
+    pthread_mutex_destroy(&ctx->inproc_lock);
+    mgmt_req_state_destroy(&ctx->mgmt_req);
+    pthread_mutex_destroy(&ctx->reg_cache_lock);
+    free(ctx->host_controller_address);
+
+    free(ctx);
+    *ctx_p = NULL;
+}
+
+/**
+ * Create the request packet for a register access
+ *
+ * @param src_diaddr the DI address the response is sent to
+ */
+static osd_result reg_op_build_req(struct osd_hostmod_ctx *ctx,
+                                   const struct osd_hostmod_reg_op *op,
+                                   uint16_t src_diaddr,
+                                   struct osd_packet **pkg_req_p)
+{
+    osd_result rv;
+
+    assert(op->reg_size_bit % 16 == 0 && op->reg_size_bit >= 16 &&
+           op->reg_size_bit <= 128);
+
+    bool is_write = (op->type == OSD_HOSTMOD_REG_OP_WRITE);
+    unsigned int wr_data_len_words = is_write ? op->reg_size_bit / 16 : 0;
+
+    dbg(ctx->log_ctx,
+        "Issuing %d bit %s request to register 0x%x of module 0x%x",
+        op->reg_size_bit, is_write ? "write" : "read", op->reg_addr,
+        op->diaddr);
+
+    // assemble request packet
+    struct osd_packet *pkg_req;
+    rv = osd_packet_new(&pkg_req,
+                        osd_packet_sizeconv_payload2data(1 + wr_data_len_words));
+    if (OSD_FAILED(rv)) {
+        return rv;
+    }
+
+    enum osd_packet_type_reg_subtype subtype_req =
+        is_write ? get_subtype_reg_write_req(op->reg_size_bit)
+                 : get_subtype_reg_read_req(op->reg_size_bit);
+    osd_packet_set_header(pkg_req, op->diaddr, src_diaddr, OSD_PACKET_TYPE_REG,
+                          subtype_req);
+    pkg_req->data.payload[0] = op->reg_addr;
+    if (is_write) {
+        memcpy(&pkg_req->data.payload[1], op->reg_val,
+               wr_data_len_words * sizeof(uint16_t));
+    }
+
+    *pkg_req_p = pkg_req;
+    return OSD_OK;
+}
+
+/**
+ * Send the request packet for a register access through the direct register
+ * access connection
+ */
+static osd_result reg_op_send_req(struct osd_hostmod_ctx *ctx,
+                                  const struct osd_hostmod_reg_op *op)
+{
+    osd_result rv;
+
+    // responses are routed to the DI address of the direct connection
+    struct osd_packet *pkg_req;
+    rv = reg_op_build_req(ctx, op, ctx->reg_diaddr, &pkg_req);
+    if (OSD_FAILED(rv)) {
+        return rv;
+    }
+
+    rv = send_packet(ctx->reg_socket, pkg_req);
+    osd_packet_free(&pkg_req);
+    return rv;
+}
+
+/**
+ * Can the result of a register access be taken from the register cache?
+ */
+static bool reg_op_is_cacheable(const struct osd_hostmod_reg_op *op, int flags)
+{
+    return (flags & OSD_HOSTMOD_CACHED) && op->type == OSD_HOSTMOD_REG_OP_READ;
+}
+
+/**
+ * Take the result of a cacheable register read from the register cache
+ *
+ * @return true if the register was found in the cache
+ */
+static bool reg_op_cache_lookup(struct osd_hostmod_ctx *ctx,
+                                struct osd_hostmod_reg_op *op)
+{
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    bool found = reg_cache_lookup(ctx->reg_cache, op->diaddr, op->reg_addr,
+                                  op->reg_size_bit, op->reg_val);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+
+    if (found) {
+        op->result = OSD_OK;
+    }
+    return found;
+}
+
+/**
+ * Store the result of a successful cacheable register read in the cache
+ */
+static void reg_op_cache_store(struct osd_hostmod_ctx *ctx,
+                               const struct osd_hostmod_reg_op *op)
+{
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    reg_cache_store(ctx->reg_cache, op->diaddr, op->reg_addr, op->reg_size_bit,
+                    op->reg_val);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+}
+
+/**
+ * Execute register accesses through the direct register access connection
+ *
+ * @see osd_hostmod_reg_batch()
+ */
+static void reg_batch_direct(struct osd_hostmod_ctx *ctx,
+                             struct osd_hostmod_reg_op *ops, size_t op_cnt,
+                             int flags)
+{
+    osd_result rv;
+
+    // Indices of the accesses waiting for a response, oldest first.
+    // Modules respond to requests in the order they received them: a
+    // response belongs to the oldest access to the module it originates from.
+    size_t inflight[HOSTMOD_REG_BATCH_WINDOW];
+    size_t inflight_cnt = 0;
+    size_t next_op = 0;
+
+    while (next_op < op_cnt || inflight_cnt > 0) {
+        // fill the window with new requests
+        while (next_op < op_cnt && inflight_cnt < HOSTMOD_REG_BATCH_WINDOW) {
+            if (reg_op_is_cacheable(&ops[next_op], flags) &&
+                reg_op_cache_lookup(ctx, &ops[next_op])) {
+                next_op++;
+                continue;
+            }
+
+            rv = reg_op_send_req(ctx, &ops[next_op]);
+            if (OSD_FAILED(rv)) {
+                ops[next_op].result = rv;
+            } else {
+                inflight[inflight_cnt++] = next_op;
+            }
+            next_op++;
+        }
+        if (inflight_cnt == 0) {
+            continue;
+        }
+
+        // wait for a response
+        struct osd_packet *pkg_resp;
+        rv = reg_socket_receive_packet(ctx, &pkg_resp, flags);
+        if (OSD_FAILED(rv)) {
+            // no response to any outstanding request: give up on all of them
+            for (size_t i = 0; i < inflight_cnt; i++) {
+                ops[inflight[i]].result = rv;
+            }
+            inflight_cnt = 0;
+            continue;
+        }
+
+        size_t i = 0;
+        if (osd_packet_get_type(pkg_resp) == OSD_PACKET_TYPE_REG) {
+            while (i < inflight_cnt &&
+                   ops[inflight[i]].diaddr != osd_packet_get_src(pkg_resp)) {
+                i++;
+            }
+        } else {
+            i = inflight_cnt;
+        }
+        if (i == inflight_cnt) {
+            err(ctx->log_ctx,
+                "Dropping unexpected packet from module %u received while "
+                "waiting for register access responses.",
+                osd_packet_get_src(pkg_resp));
+            osd_packet_free(&pkg_resp);
+            continue;
+        }
+
+        struct osd_hostmod_reg_op *op = &ops[inflight[i]];
+        op->result = reg_op_handle_resp(ctx->log_ctx, op, pkg_resp);
+        osd_packet_free(&pkg_resp);
+        if (OSD_SUCCEEDED(op->result) && reg_op_is_cacheable(op, flags)) {
+            reg_op_cache_store(ctx, op);
+        }
+
+        memmove(&inflight[i], &inflight[i + 1],
+                (inflight_cnt - i - 1) * sizeof(inflight[0]));
+        inflight_cnt--;
+    }
+}
+
+/**
+ * Completion state of register accesses started by reg_batch_iothread()
+ */
+struct reg_batch_waiter {
+    struct osd_hostmod_ctx *ctx;
+    /** Flags of the accesses */
+    int flags;
+
+    pthread_mutex_t lock;
+    /** Signaled when completed_cnt changes */
+    pthread_cond_t completed_cond;
+    /** Number of completed accesses */
+    size_t completed_cnt;
+};
+
+/**
+ * Completion callback of register accesses started by reg_batch_iothread()
+ *
+ * Called from the I/O thread.
+ */
+static void reg_batch_op_completed(void *waiter_void, uint64_t req_id,
+                                   struct osd_hostmod_reg_op *op)
+{
+    struct reg_batch_waiter *waiter = waiter_void;
+
+    if (OSD_SUCCEEDED(op->result) && reg_op_is_cacheable(op, waiter->flags)) {
+        reg_op_cache_store(waiter->ctx, op);
+    }
+
+    pthread_mutex_lock(&waiter->lock);
+    waiter->completed_cnt++;
+    pthread_cond_signal(&waiter->completed_cond);
+    pthread_mutex_unlock(&waiter->lock);
+}
+
+/**
+ * Execute register accesses through the I/O thread
+ *
+ * The accesses are submitted as asynchronous accesses. The I/O thread
+ * matches the responses to the pending accesses of all calling threads and
+ * completes each access through the waiter of the thread which issued it.
+ * Any number of threads can therefore use this function at the same time.
+ *
+ * @see osd_hostmod_reg_batch()
+ */
+static void reg_batch_iothread(struct osd_hostmod_ctx *ctx,
+                               struct osd_hostmod_reg_op *ops, size_t op_cnt,
+                               int flags)
+{
+    osd_result rv;
+
+    struct reg_batch_waiter waiter = {
+        .ctx = ctx,
+        .flags = flags,
+        .completed_cnt = 0,
+    };
+    pthread_mutex_init(&waiter.lock, NULL);
+    pthread_cond_init(&waiter.completed_cond, NULL);
+
+    size_t submitted_cnt = 0;
+    for (size_t i = 0; i < op_cnt; i++) {
+        if (reg_op_is_cacheable(&ops[i], flags) &&
+            reg_op_cache_lookup(ctx, &ops[i])) {
+            continue;
+        }
+
+        // limit the number of accesses in flight
+        pthread_mutex_lock(&waiter.lock);
+        while (submitted_cnt - waiter.completed_cnt >=
+               HOSTMOD_REG_BATCH_WINDOW) {
+            pthread_cond_wait(&waiter.completed_cond, &waiter.lock);
+        }
+        pthread_mutex_unlock(&waiter.lock);
+
+        rv = osd_hostmod_reg_submit(ctx, &ops[i], flags,
+                                    reg_batch_op_completed, &waiter, NULL);
+        if (OSD_FAILED(rv)) {
+            ops[i].result = rv;
+            continue;
+        }
+        submitted_cnt++;
+    }
+
+    pthread_mutex_lock(&waiter.lock);
+    while (waiter.completed_cnt < submitted_cnt) {
+        pthread_cond_wait(&waiter.completed_cond, &waiter.lock);
+    }
+    pthread_mutex_unlock(&waiter.lock);
+
+    pthread_cond_destroy(&waiter.completed_cond);
+    pthread_mutex_destroy(&waiter.lock);
 }
 
 API_EXPORT
-osd_result osd_hostmod_disconnect(struct osd_hostmod_ctx *ctx)
+osd_result osd_hostmod_reg_batch(struct osd_hostmod_ctx *ctx,
+                                 struct osd_hostmod_reg_op *ops, size_t op_cnt,
+                                 int flags)
 {
-    osd_result rv;
-
     assert(ctx);
+    assert(ops || op_cnt == 0);
 
     if (!ctx->is_connected) {
+        for (size_t i = 0; i < op_cnt; i++) {
+            ops[i].result = OSD_ERROR_NOT_CONNECTED;
+        }
         return OSD_ERROR_NOT_CONNECTED;
     }
 
-    worker_send_status(ctx->ioworker_ctx->inproc_socket, "I-DISCONNECT", 0);
-    osd_result retval;
-    rv = worker_wait_for_status(ctx->ioworker_ctx->inproc_socket,
-                                "I-DISCONNECT-DONE", &retval);
-    if (OSD_FAILED(rv)) {
-        return rv;
-    }
-    if (OSD_FAILED(retval)) {
-        return retval;
+    if (ctx->reg_socket) {
+        reg_batch_direct(ctx, ops, op_cnt, flags);
+    } else {
+        reg_batch_iothread(ctx, ops, op_cnt, flags);
     }
 
-    ctx->is_connected = false;
-
+    for (size_t i = 0; i < op_cnt; i++) {
+        if (OSD_FAILED(ops[i].result)) {
+            return ops[i].result;
+        }
+    }
     return OSD_OK;
 }
 
 API_EXPORT
-void osd_hostmod_free(struct osd_hostmod_ctx **ctx_p)
+osd_result osd_hostmod_reg_submit(struct osd_hostmod_ctx *ctx,
+                                  struct osd_hostmod_reg_op *op, int flags,
+                                  osd_hostmod_reg_cb_fn cb, void *cb_arg,
+                                  uint64_t *req_id)
 {
-    assert(ctx_p);
-    struct osd_hostmod_ctx *ctx = *ctx_p;
-    if (!ctx) {
-        return;
-    }
-
-    assert(!ctx->is_connected);
-
-    worker_free(&ctx->ioworker_ctx);
+    assert(ctx);
+    assert(op);
+    assert(cb);
 
-    free(ctx);
-    *ctx_p = NULL;
-}
+    osd_result rv;
+    int zmq_rv;
 
-static osd_result osd_hostmod_regaccess(
-    struct osd_hostmod_ctx *ctx, uint16_t module_addr, uint16_t reg_addr,
-    enum osd_packet_type_reg_subtype subtype_req,
-    enum osd_packet_type_reg_subtype subtype_resp, const uint16_t *wr_data,
-    size_t wr_data_len_words, struct osd_packet **response, int flags)
-{
-    assert(ctx);
     if (!ctx->is_connected) {
         return OSD_ERROR_NOT_CONNECTED;
     }
 
-    *response = NULL;
-    osd_result retval = OSD_ERROR_FAILURE;
-    osd_result rv;
-
-    // assemble request packet
     struct osd_packet *pkg_req;
-    unsigned int pkg_size_words =
-        osd_packet_sizeconv_payload2data(1 + wr_data_len_words);
-    rv = osd_packet_new(&pkg_req, pkg_size_words);
-    if (OSD_FAILED(rv)) {
-        retval = rv;
-        goto err_free_req;
-    }
-
-    osd_packet_set_header(pkg_req, module_addr, ctx->diaddr,
-                          OSD_PACKET_TYPE_REG, subtype_req);
-    pkg_req->data.payload[0] = reg_addr;
-    for (unsigned int i = 0; i < wr_data_len_words; i++) {
-        pkg_req->data.payload[1 + i] = wr_data[i];
-    }
-
-    // send register read request
-    rv = osd_hostmod_send_packet(ctx, pkg_req);
-    if (OSD_FAILED(rv)) {
-        retval = rv;
-        goto err_free_req;
-    }
-
-    // wait for response
-    struct osd_packet *pkg_resp;
-    rv = osd_hostmod_receive_packet(ctx, &pkg_resp, flags);
+    rv = reg_op_build_req(ctx, op, ctx->diaddr, &pkg_req);
     if (OSD_FAILED(rv)) {
-        retval = rv;
-        goto err_free_req;
+        return rv;
     }
 
-    // parse response
-    assert(osd_packet_get_type(pkg_resp) == OSD_PACKET_TYPE_REG);
+    struct iothread_reg_req req = {
+        .op = op,
+        .cb = cb,
+        .cb_arg = cb_arg,
+        .req_id = __atomic_fetch_add(&ctx->reg_req_next_id, 1,
+                                     __ATOMIC_RELAXED),
+        .flags = flags,
+    };
 
-    // handle register read error
-    if (osd_packet_get_type_sub(pkg_resp) == RESP_READ_REG_ERROR ||
-        osd_packet_get_type_sub(pkg_resp) == RESP_WRITE_REG_ERROR) {
-        err(ctx->log_ctx,
-            "Got RESP_WRITE_REG_ERROR when accessing register %u of module %d",
-            reg_addr, module_addr);
-        retval = OSD_ERROR_DEVICE_ERROR;
-        goto err_free_resp;
-    }
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+    uint8_t opcode = IOTHREAD_OP_REG_SUBMIT;
+    zmq_rv = zmsg_addmem(msg, &opcode, sizeof(opcode));
+    assert(zmq_rv == 0);
+    zmq_rv = zmsg_addmem(msg, &req, sizeof(req));
+    assert(zmq_rv == 0);
+    zmq_rv = zmsg_addmem(msg, pkg_req->data_raw, osd_packet_sizeof(pkg_req));
+    assert(zmq_rv == 0);
+    osd_packet_free(&pkg_req);
 
-    // validate response subtype
-    if (osd_packet_get_type_sub(pkg_resp) != subtype_resp) {
-        err(ctx->log_ctx, "Expected register response of subtype %d, got %d",
-            subtype_resp, osd_packet_get_type_sub(pkg_resp));
-        retval = OSD_ERROR_DEVICE_INVALID_DATA;
-        goto err_free_resp;
+    // the callback might be called before zmsg_send() returns
+    if (req_id) {
+        *req_id = req.req_id;
     }
 
-    retval = OSD_OK;
-    *response = pkg_resp;
-    goto err_free_req;
-
-err_free_resp:
-    free(pkg_resp);
+    return inproc_send(ctx, &msg);
+}
 
-err_free_req:
-    free(pkg_req);
+API_EXPORT
+osd_result osd_hostmod_reg_read(struct osd_hostmod_ctx *ctx, void *reg_val,
+                                uint16_t diaddr, uint16_t reg_addr,
+                                int reg_size_bit, int flags)
+{
+    struct osd_hostmod_reg_op op = {
+        .type = OSD_HOSTMOD_REG_OP_READ,
+        .diaddr = diaddr,
+        .reg_addr = reg_addr,
+        .reg_size_bit = reg_size_bit,
+        .reg_val = reg_val,
+    };
+    return osd_hostmod_reg_batch(ctx, &op, 1, flags);
+}
 
-    return retval;
+API_EXPORT
+osd_result osd_hostmod_reg_write(struct osd_hostmod_ctx *ctx,
+                                 const void *reg_val, uint16_t diaddr,
+                                 uint16_t reg_addr, int reg_size_bit, int flags)
+{
+    struct osd_hostmod_reg_op op = {
+        .type = OSD_HOSTMOD_REG_OP_WRITE,
+        .diaddr = diaddr,
+        .reg_addr = reg_addr,
+        .reg_size_bit = reg_size_bit,
+        // not modified for write accesses
+        .reg_val = (void *)reg_val,
+    };
+    return osd_hostmod_reg_batch(ctx, &op, 1, flags);
 }
 
-static enum osd_packet_type_reg_subtype get_subtype_reg_read_req(
-    unsigned int reg_size_bit)
+API_EXPORT
+void osd_hostmod_reg_cache_invalidate(struct osd_hostmod_ctx *ctx)
 {
-    return (reg_size_bit / 16) - 1;
+    assert(ctx);
+
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    reg_cache_invalidate(ctx->reg_cache);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+    dbg(ctx->log_ctx, "Register cache invalidated.");
 }
 
-static enum osd_packet_type_reg_subtype get_subtype_reg_read_success_resp(
-    unsigned int reg_size_bit)
+API_EXPORT
+void osd_hostmod_reg_cache_get_stats(struct osd_hostmod_ctx *ctx,
+                                     struct osd_hostmod_reg_cache_stats *stats)
 {
-    return get_subtype_reg_read_req(reg_size_bit) | 0b1000;
+    assert(ctx);
+    assert(stats);
+
+    struct reg_cache_stats cache_stats;
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    reg_cache_get_stats(ctx->reg_cache, &cache_stats);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+    stats->hits = cache_stats.hits;
+    stats->misses = cache_stats.misses;
+    stats->entries = cache_stats.entries;
 }
 
-static enum osd_packet_type_reg_subtype get_subtype_reg_write_req(
-    unsigned int reg_size_bit)
+/**
+ * Read the SCM registers identifying a device in a topology cache file
+ */
+static osd_result topology_cache_read_id(
+    struct osd_hostmod_ctx *ctx, unsigned int subnet_addr,
+    uint16_t id[HOSTMOD_TOPOLOGY_CACHE_ID_CNT], int flags)
 {
-    return ((reg_size_bit / 16) - 1) | 0b0100;
+    const uint16_t id_regs[HOSTMOD_TOPOLOGY_CACHE_ID_CNT] = {
+        OSD_REG_SCM_SYSTEM_VENDOR_ID, OSD_REG_SCM_SYSTEM_DEVICE_ID,
+        OSD_REG_SCM_NUM_MOD,
+    };
+
+    struct osd_hostmod_reg_op ops[HOSTMOD_TOPOLOGY_CACHE_ID_CNT];
+    for (unsigned int i = 0; i < HOSTMOD_TOPOLOGY_CACHE_ID_CNT; i++) {
+        ops[i] = (struct osd_hostmod_reg_op){
+            .type = OSD_HOSTMOD_REG_OP_READ,
+            .diaddr = osd_diaddr_build(subnet_addr, 0),
+            .reg_addr = id_regs[i],
+            .reg_size_bit = 16,
+            .reg_val = &id[i],
+        };
+    }
+    return osd_hostmod_reg_batch(ctx, ops, HOSTMOD_TOPOLOGY_CACHE_ID_CNT,
+                                 flags);
 }
 
 API_EXPORT
-osd_result osd_hostmod_reg_read(struct osd_hostmod_ctx *ctx, void *reg_val,
-                                uint16_t diaddr, uint16_t reg_addr,
-                                int reg_size_bit, int flags)
+osd_result osd_hostmod_topology_cache_save(struct osd_hostmod_ctx *ctx,
+                                           unsigned int subnet_addr,
+                                           const char *path)
 {
+    assert(ctx);
+    assert(path);
+
     osd_result rv;
     osd_result retval;
 
-    assert(reg_size_bit % 16 == 0 && reg_size_bit <= 128);
-
-    dbg(ctx->log_ctx,
-        "Issuing %d bit read request to register 0x%x of module 0x%x",
-        reg_size_bit, reg_addr, diaddr);
-
-    struct osd_packet *response_pkg;
-    rv = osd_hostmod_regaccess(ctx, diaddr, reg_addr,
-                               get_subtype_reg_read_req(reg_size_bit),
-                               get_subtype_reg_read_success_resp(reg_size_bit),
-                               NULL, 0, &response_pkg, flags);
+    uint16_t id[HOSTMOD_TOPOLOGY_CACHE_ID_CNT];
+    rv = topology_cache_read_id(ctx, subnet_addr, id, OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) {
         return rv;
     }
 
-    // validate response size
-    unsigned int exp_data_size_words =
-        osd_packet_sizeconv_payload2data(reg_size_bit / 16);
-    if (response_pkg->data_size_words != exp_data_size_words) {
-        err(ctx->log_ctx,
-            "Expected %d 16 bit data words in register read response, got %d.",
-            exp_data_size_words, response_pkg->data_size_words);
-        retval = OSD_ERROR_DEVICE_INVALID_DATA;
-        goto err_free_resp;
+    // write to a temporary file first: readers never see a partial file
+    size_t tmp_path_len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = malloc(tmp_path_len);
+    assert(tmp_path);
+    snprintf(tmp_path, tmp_path_len, "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        err(ctx->log_ctx, "Unable to open topology cache file %s: %s",
+            tmp_path, strerror(errno));
+        retval = OSD_ERROR_FILE;
+        goto free_return;
     }
 
-    // make result available to caller
-    // XXX: this is broken for anything else than 16 bit registers due to
-    // endianness issues.
-    memcpy(reg_val, response_pkg->data.payload, reg_size_bit / 8);
+    fprintf(f, "%s\n%x %x %x\n", HOSTMOD_TOPOLOGY_CACHE_HEADER, id[0], id[1],
+            id[2]);
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    retval = reg_cache_write(ctx->reg_cache, f);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+    if (fclose(f) != 0) {
+        retval = OSD_ERROR_FILE;
+    }
+    if (OSD_SUCCEEDED(retval) && rename(tmp_path, path) != 0) {
+        retval = OSD_ERROR_FILE;
+    }
+    if (OSD_FAILED(retval)) {
+        err(ctx->log_ctx, "Unable to write topology cache file %s", path);
+        remove(tmp_path);
+        goto free_return;
+    }
 
+    dbg(ctx->log_ctx, "Wrote topology cache file %s.", path);
     retval = OSD_OK;
 
-err_free_resp:
-    free(response_pkg);
-
+free_return:
+    free(tmp_path);
     return retval;
 }
 
 API_EXPORT
-osd_result osd_hostmod_reg_write(struct osd_hostmod_ctx *ctx,
-                                 const void *reg_val, uint16_t diaddr,
-                                 uint16_t reg_addr, int reg_size_bit, int flags)
+osd_result osd_hostmod_topology_cache_load(struct osd_hostmod_ctx *ctx,
+                                           unsigned int subnet_addr,
+                                           const char *path)
 {
-    assert(reg_size_bit % 16 == 0 && reg_size_bit <= 128);
+    assert(ctx);
+    assert(path);
 
     osd_result rv;
     osd_result retval;
 
-    dbg(ctx->log_ctx,
-        "Issuing %d bit write request to register 0x%x of module 0x%x",
-        reg_size_bit, reg_addr, diaddr);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        dbg(ctx->log_ctx, "Unable to open topology cache file %s: %s", path,
+            strerror(errno));
+        return OSD_ERROR_FILE;
+    }
+
+    char line[64];
+    unsigned int file_id[HOSTMOD_TOPOLOGY_CACHE_ID_CNT];
+    if (!fgets(line, sizeof(line), f) ||
+        strcmp(line, HOSTMOD_TOPOLOGY_CACHE_HEADER "\n") != 0 ||
+        !fgets(line, sizeof(line), f) ||
+        sscanf(line, "%x %x %x", &file_id[0], &file_id[1], &file_id[2]) !=
+            HOSTMOD_TOPOLOGY_CACHE_ID_CNT) {
+        err(ctx->log_ctx, "%s is not a valid topology cache file.", path);
+        retval = OSD_ERROR_FILE;
+        goto free_return;
+    }
 
-    struct osd_packet *response_pkg;
-    rv = osd_hostmod_regaccess(
-        ctx, diaddr, reg_addr, get_subtype_reg_write_req(reg_size_bit),
-        RESP_WRITE_REG_SUCCESS, reg_val, reg_size_bit / 16, &response_pkg, flags);
+    // the device might have changed since the file was written
+    uint16_t id[HOSTMOD_TOPOLOGY_CACHE_ID_CNT];
+    rv = topology_cache_read_id(ctx, subnet_addr, id, 0);
     if (OSD_FAILED(rv)) {
-        return rv;
+        retval = rv;
+        goto free_return;
+    }
+    for (unsigned int i = 0; i < HOSTMOD_TOPOLOGY_CACHE_ID_CNT; i++) {
+        if (file_id[i] != id[i]) {
+            info(ctx->log_ctx,
+                 "Topology cache file %s doesn't match the device, ignoring "
+                 "it.", path);
+            retval = OSD_ERROR_FILE;
+            goto free_return;
+        }
     }
 
-    // validate response size
-    unsigned int data_size_words_exp = osd_packet_sizeconv_payload2data(0);
-    if (response_pkg->data_size_words != data_size_words_exp) {
-        err(ctx->log_ctx,
-            "Invalid write response received. Expected packet with %u data "
-            "words, got %u words.",
-            data_size_words_exp, response_pkg->data_size_words);
-        retval = OSD_ERROR_DEVICE_INVALID_DATA;
-        goto err_free_resp;
+    // load into a separate cache to keep the existing cache on errors
+    struct reg_cache *file_cache;
+    reg_cache_new(&file_cache);
+    rv = reg_cache_read(file_cache, f);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx, "%s is not a valid topology cache file.", path);
+        reg_cache_free(&file_cache);
+        retval = rv;
+        goto free_return;
     }
+    pthread_mutex_lock(&ctx->reg_cache_lock);
+    reg_cache_merge(ctx->reg_cache, file_cache);
+    pthread_mutex_unlock(&ctx->reg_cache_lock);
+    reg_cache_free(&file_cache);
 
+    dbg(ctx->log_ctx, "Loaded topology cache file %s.", path);
     retval = OSD_OK;
 
-err_free_resp:
-    free(response_pkg);
-
+free_return:
+    fclose(f);
     return retval;
 }
 
@@ -852,27 +2767,224 @@ osd_result osd_hostmod_event_receive(struct osd_hostmod_ctx *ctx,
                                      struct osd_packet **event_pkg,
                                      int flags)
 {
-    /*
-     * This implementation is currently rather naive, as the exact requirements
-     * are not yet fixed.
-     *
-     * - It doesn't guarantee to return only event packets, but any packet
-     *   which happens to be received when calling.
-     * - Event packets are not treated differently from register access packets,
-     *   requiring the source(s) to send them exactly in the expected order.
-     * - It doesn't warn the user if he/she set a eventhandler in the
-     *   constructor, which takes precedence over this function (no data will be
-     *   returned ever).
-     *
-     * Once the exact requirements are fixed, this could be extended in a couple
-     * ways:
-     *
-     * - Queue event packets when they are received in the iothread, and pop
-     *   from this queue when this function is called; or
-     * - Use a separate socket for pushing event packets between the iothread
-     *   and the main thread, and receive from this socket here.
-     */
-    return osd_hostmod_receive_packet(ctx, event_pkg, flags);
+    assert(ctx);
+    assert(event_pkg);
+
+    int timeout_ms = (flags & OSD_HOSTMOD_BLOCKING) ? -1 : ZMQ_RCV_TIMEOUT;
+    return event_queue_pop(ctx->event_queue, event_pkg, timeout_ms);
+}
+
+/**
+ * Send a management request to the host controller and wait for the response
+ *
+ * Can be called from any thread. Concurrent requests are sent one after the
+ * other; inproc_lock is only held to send the request to the I/O thread.
+ *
+ * @return OSD_OK if the host controller acknowledged the request,
+ *         OSD_ERROR_TIMEDOUT if it did not respond within ZMQ_RCV_TIMEOUT
+ *         milliseconds, any other value indicates an error
+ */
+static osd_result mgmt_request(struct osd_hostmod_ctx *ctx,
+                               const char *request)
+{
+    int rv;
+    osd_result osd_rv;
+    struct mgmt_req_state *state = &ctx->mgmt_req;
+
+    if (!osd_hostmod_is_connected(ctx)) {
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    while (state->busy) {
+        pthread_cond_wait(&state->cond, &state->lock);
+    }
+    state->busy = true;
+    uint64_t seq = ++state->seq;
+    pthread_mutex_unlock(&state->lock);
+
+    uint8_t opcode = IOTHREAD_OP_MGMT_REQUEST;
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+    rv = zmsg_addmem(msg, &opcode, sizeof(opcode));
+    assert(rv == 0);
+    rv = zmsg_addmem(msg, &seq, sizeof(seq));
+    assert(rv == 0);
+    rv = zmsg_addstr(msg, request);
+    assert(rv == 0);
+
+    // the response might be received before inproc_send() returns
+    osd_rv = inproc_send(ctx, &msg);
+
+    struct timespec deadline;
+    rv = clock_gettime(CLOCK_MONOTONIC, &deadline);
+    assert(rv == 0);
+    deadline.tv_sec += ZMQ_RCV_TIMEOUT / 1000;
+    deadline.tv_nsec += (ZMQ_RCV_TIMEOUT % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    while (OSD_SUCCEEDED(osd_rv) && state->done_seq != seq) {
+        rv = pthread_cond_timedwait(&state->cond, &state->lock, &deadline);
+        if (rv == ETIMEDOUT && state->done_seq != seq) {
+            // a late response is discarded by its sequence number
+            osd_rv = OSD_ERROR_TIMEDOUT;
+        }
+    }
+    if (OSD_SUCCEEDED(osd_rv)) {
+        osd_rv = state->result;
+    }
+    state->busy = false;
+    pthread_cond_broadcast(&state->cond);
+    pthread_mutex_unlock(&state->lock);
+
+    return osd_rv;
+}
+
+API_EXPORT
+osd_result osd_hostmod_event_subscribe(struct osd_hostmod_ctx *ctx,
+                                       uint16_t di_addr)
+{
+    assert(ctx);
+
+    char request[sizeof("EVENT_SUBSCRIBE 65535")];
+    snprintf(request, sizeof(request), "EVENT_SUBSCRIBE %u", di_addr);
+    osd_result rv = mgmt_request(ctx, request);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx, "Unable to subscribe to the events of %u (%d)",
+            di_addr, rv);
+    }
+    return rv;
+}
+
+API_EXPORT
+osd_result osd_hostmod_event_unsubscribe(struct osd_hostmod_ctx *ctx,
+                                         uint16_t di_addr)
+{
+    assert(ctx);
+
+    char request[sizeof("EVENT_UNSUBSCRIBE 65535")];
+    snprintf(request, sizeof(request), "EVENT_UNSUBSCRIBE %u", di_addr);
+    osd_result rv = mgmt_request(ctx, request);
+    if (OSD_FAILED(rv)) {
+        err(ctx->log_ctx, "Unable to unsubscribe from the events of %u (%d)",
+            di_addr, rv);
+    }
+    return rv;
+}
+
+API_EXPORT
+void osd_hostmod_set_event_queue_policy(
+    struct osd_hostmod_ctx *ctx, size_t capacity,
+    enum osd_hostmod_event_overflow_policy policy)
+{
+    assert(ctx);
+    assert(capacity > 0);
+
+    struct event_queue *queue = ctx->event_queue;
+    pthread_mutex_lock(&queue->lock);
+    queue->capacity = capacity;
+    queue->policy = policy;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+API_EXPORT
+osd_result osd_hostmod_set_event_reassembly_limits(struct osd_hostmod_ctx *ctx,
+                                                   size_t max_bytes,
+                                                   unsigned int timeout_ms)
+{
+    assert(ctx);
+
+    // an event must at least fit a header and one payload word
+    if (max_bytes < osd_packet_sizeconv_payload2data(1) * sizeof(uint16_t)) {
+        err(ctx->log_ctx, "Event reassembly limit of %zu bytes is too small.",
+            max_bytes);
+        return OSD_ERROR_FAILURE;
+    }
+
+    if (!ctx->ioworker_ctx->thread_is_running) {
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+
+    struct iothread_event_reassembly_limits limits = {
+        .max_bytes = max_bytes,
+        .timeout_ms = timeout_ms,
+    };
+    inproc_send_data(ctx, IOTHREAD_OP_SET_EVENT_REASSEMBLY_LIMITS, &limits,
+                     sizeof(limits));
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_hostmod_get_event_reassembly_stats(
+    struct osd_hostmod_ctx *ctx,
+    struct osd_hostmod_event_reassembly_stats *stats)
+{
+    assert(ctx);
+    assert(stats);
+
+    struct event_reassembly_stats reassembly_stats;
+    event_reassembly_get_stats(ctx->event_reassembly, &reassembly_stats);
+    stats->completed = reassembly_stats.completed;
+    stats->timed_out = reassembly_stats.timed_out;
+    stats->overflowed = reassembly_stats.overflowed;
+    stats->partial_events = reassembly_stats.partial_events;
+    stats->partial_bytes = reassembly_stats.partial_bytes;
+}
+
+API_EXPORT
+void osd_hostmod_get_event_queue_stats(
+    struct osd_hostmod_ctx *ctx, struct osd_hostmod_event_queue_stats *stats)
+{
+    assert(ctx);
+    assert(stats);
+
+    struct event_queue *queue = ctx->event_queue;
+    pthread_mutex_lock(&queue->lock);
+    *stats = queue->stats;
+    stats->len = zlist_size(queue->pkgs);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Number of register reads needed to describe a module
+ */
+#define MOD_DESCRIBE_OP_CNT 3
+
+/**
+ * Prepare the register reads to describe a module
+ *
+ * @param di_addr the DI address of the module to describe
+ * @param[out] desc the module description, filled by the register reads
+ * @param[out] ops MOD_DESCRIBE_OP_CNT register accesses
+ */
+static void mod_describe_prepare_ops(uint16_t di_addr,
+                                     struct osd_module_desc *desc,
+                                     struct osd_hostmod_reg_op *ops)
+{
+    desc->addr = di_addr;
+
+    const uint16_t reg_addrs[MOD_DESCRIBE_OP_CNT] = {
+        OSD_REG_BASE_MOD_VENDOR, OSD_REG_BASE_MOD_TYPE,
+        OSD_REG_BASE_MOD_VERSION,
+    };
+    uint16_t *reg_vals[MOD_DESCRIBE_OP_CNT] = {
+        &desc->vendor, &desc->type, &desc->version,
+    };
+    for (unsigned int i = 0; i < MOD_DESCRIBE_OP_CNT; i++) {
+        ops[i] = (struct osd_hostmod_reg_op){
+            .type = OSD_HOSTMOD_REG_OP_READ,
+            .diaddr = di_addr,
+            .reg_addr = reg_addrs[i],
+            .reg_size_bit = 16,
+            .reg_val = reg_vals[i],
+        };
+    }
 }
 
 osd_result osd_hostmod_get_modules(struct osd_hostmod_ctx *ctx,
@@ -887,7 +2999,7 @@ osd_result osd_hostmod_get_modules(struct osd_hostmod_ctx *ctx,
 
     uint16_t num_modules;
     rv = osd_hostmod_reg_read(ctx, &num_modules, scm_diaddr,
-                              OSD_REG_SCM_NUM_MOD, 16, 0);
+                              OSD_REG_SCM_NUM_MOD, 16, OSD_HOSTMOD_CACHED);
     if (OSD_FAILED(rv)) {
         err(ctx->log_ctx, "Unable to read NUM_MOD from SCM in subnet %u",
             subnet_addr);
@@ -897,31 +3009,52 @@ osd_result osd_hostmod_get_modules(struct osd_hostmod_ctx *ctx,
 
     struct osd_module_desc *mods;
     mods = calloc(num_modules, sizeof(struct osd_module_desc));
+    assert(mods);
+
+    // describe all modules in one batch
+    struct osd_hostmod_reg_op *ops =
+        calloc(num_modules * MOD_DESCRIBE_OP_CNT,
+               sizeof(struct osd_hostmod_reg_op));
+    assert(ops);
+    for (uint16_t localaddr = 0; localaddr < num_modules; localaddr++) {
+        uint16_t module_addr = osd_diaddr_build(subnet_addr, localaddr);
+        mod_describe_prepare_ops(module_addr, &mods[localaddr],
+                                 &ops[localaddr * MOD_DESCRIBE_OP_CNT]);
+    }
+    osd_hostmod_reg_batch(ctx, ops, num_modules * MOD_DESCRIBE_OP_CNT,
+                          OSD_HOSTMOD_CACHED);
 
-    for (uint16_t localaddr = scm_diaddr; localaddr < num_modules;
-         localaddr++) {
+    for (uint16_t localaddr = 0; localaddr < num_modules; localaddr++) {
         uint16_t module_addr = osd_diaddr_build(subnet_addr, localaddr);
 
-        rv = osd_hostmod_mod_describe(ctx, module_addr, &mods[module_addr]);
+        rv = OSD_OK;
+        for (unsigned int i = 0; i < MOD_DESCRIBE_OP_CNT; i++) {
+            rv = ops[localaddr * MOD_DESCRIBE_OP_CNT + i].result;
+            if (OSD_FAILED(rv)) {
+                break;
+            }
+        }
+
         if (OSD_FAILED(rv)) {
             err(ctx->log_ctx, "Failed to obtain information about debug "
                 "module at address %u (rv=%d)", module_addr, rv);
-            mods[module_addr].addr = module_addr;
-            mods[module_addr].vendor = OSD_MODULE_VENDOR_UNKNOWN;
-            mods[module_addr].type = OSD_MODULE_TYPE_STD_UNKNOWN;
-            mods[module_addr].version = 0;
+            mods[localaddr].addr = module_addr;
+            mods[localaddr].vendor = OSD_MODULE_VENDOR_UNKNOWN;
+            mods[localaddr].type = OSD_MODULE_TYPE_STD_UNKNOWN;
+            mods[localaddr].version = 0;
             retval = OSD_ERROR_PARTIAL_RESULT;
             // continue with the next module anyways
         } else {
             const char* type_name =
-                osd_module_get_type_short_name(mods[module_addr].vendor,
-                                               mods[module_addr].type);
+                osd_module_get_type_short_name(mods[localaddr].vendor,
+                                               mods[localaddr].type);
             dbg(ctx->log_ctx,
                 "Found debug module at address %u of type %s (%u.%u, v%u)",
-                mods[module_addr].addr, type_name, mods[module_addr].vendor,
-                mods[module_addr].type, mods[module_addr].version);
+                mods[localaddr].addr, type_name, mods[localaddr].vendor,
+                mods[localaddr].type, mods[localaddr].version);
         }
     }
+    free(ops);
     dbg(ctx->log_ctx, "Enumerated of subnet %u completed.", subnet_addr);
 
     *modules = mods;
@@ -934,29 +3067,10 @@ osd_result osd_hostmod_mod_describe(struct osd_hostmod_ctx *ctx,
                                     uint16_t di_addr,
                                     struct osd_module_desc *desc)
 {
-    osd_result rv;
-
-    desc->addr = di_addr;
-
-    rv = osd_hostmod_reg_read(ctx, &desc->vendor, di_addr,
-                              OSD_REG_BASE_MOD_VENDOR, 16, 0);
-    if (OSD_FAILED(rv)) {
-        return rv;
-    }
-
-    rv = osd_hostmod_reg_read(ctx, &desc->type, di_addr, OSD_REG_BASE_MOD_TYPE,
-                              16, 0);
-    if (OSD_FAILED(rv)) {
-        return rv;
-    }
-
-    rv = osd_hostmod_reg_read(ctx, &desc->version, di_addr,
-                              OSD_REG_BASE_MOD_VERSION, 16, 0);
-    if (OSD_FAILED(rv)) {
-        return rv;
-    }
-
-    return OSD_OK;
+    struct osd_hostmod_reg_op ops[MOD_DESCRIBE_OP_CNT];
+    mod_describe_prepare_ops(di_addr, desc, ops);
+    return osd_hostmod_reg_batch(ctx, ops, MOD_DESCRIBE_OP_CNT,
+                                 OSD_HOSTMOD_CACHED);
 }
 
 API_EXPORT
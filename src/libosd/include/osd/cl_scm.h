@@ -54,6 +54,16 @@ osd_result osd_cl_scm_cpus_start(struct osd_hostmod_ctx *hostmod_ctx,
 osd_result osd_cl_scm_cpus_stop(struct osd_hostmod_ctx *hostmod_ctx,
                                 unsigned int subnet_addr);
 
+/**
+ * Reset the system in the SCM subnet
+ *
+ * The register cache of @p hostmod_ctx is invalidated.
+ *
+ * @see osd_hostmod_reg_cache_invalidate()
+ */
+osd_result osd_cl_scm_system_reset(struct osd_hostmod_ctx *hostmod_ctx,
+                                   unsigned int subnet_addr);
+
 /**
  * Get a description of a given subnet from the SCM
  */
@@ -42,11 +42,34 @@ osd_result osd_coretracelogger_new(struct osd_coretracelogger_ctx **ctx,
                                      const char *host_controller_address,
                                      uint16_t ctm_di_addr);
 
+/**
+ * Create a new context object using a shared I/O reactor
+ *
+ * @see osd_hostmod_new_with_reactor()
+ */
+osd_result osd_coretracelogger_new_with_reactor(
+    struct osd_coretracelogger_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address, uint16_t ctm_di_addr,
+    struct osd_ioreactor_ctx *reactor);
+
 /**
  * @copydoc osd_hostmod_connect()
  */
 osd_result osd_coretracelogger_connect(struct osd_coretracelogger_ctx *ctx);
 
+/**
+ * Write the log in a dedicated thread
+ *
+ * By default, the log is written in the I/O thread of the host module, which
+ * is shared by all host modules using the same I/O reactor. Enable the event
+ * handler thread if writing the log is slow, e.g. because it goes to a slow
+ * disk. Call this function before osd_coretracelogger_connect().
+ *
+ * @see osd_hostmod_set_event_handler_thread()
+ */
+osd_result osd_coretracelogger_set_event_handler_thread(
+    struct osd_coretracelogger_ctx *ctx, bool enable);
+
 /**
  * @copydoc osd_hostmod_disconnect()
  */
@@ -71,6 +94,9 @@ osd_result osd_coretracelogger_start(struct osd_coretracelogger_ctx *ctx);
 
 /**
  * Stop collecting system logs
+ *
+ * All events received until the module stopped sending them are written to
+ * the log before this function returns.
  */
 osd_result osd_coretracelogger_stop(struct osd_coretracelogger_ctx *ctx);
 
@@ -52,6 +52,16 @@ struct osd_gateway_transfer_stats {
     struct timespec connect_time;
     uint64_t bytes_from_device;
     uint64_t bytes_to_device;
+
+    //! capacity of the queue for packets read from the device
+    size_t rx_queue_capacity_bytes;
+    //! current fill level of the queue for packets read from the device
+    size_t rx_queue_fill_bytes;
+    //! maximum fill level of the queue since the gateway was created
+    size_t rx_queue_fill_max_bytes;
+    //! number of times reading from the device was stalled since the gateway
+    //! was created, because the queue was full
+    uint64_t rx_queue_stalls;
 };
 
 /**
@@ -64,6 +74,28 @@ struct osd_gateway_transfer_stats {
  */
 typedef osd_result (*packet_read_fn)(struct osd_packet **pkg, void *cb_arg);
 
+/**
+ * Read all packets currently available from the device
+ *
+ * The function blocks until at least one packet is available, and returns as
+ * many packets as are available without blocking (up to @p max_pkgs).
+ *
+ * The returned packets are views into memory owned by the called function.
+ * They must remain valid until the function is called again.
+ *
+ * @param pkgs array of packet views to fill
+ * @param max_pkgs number of entries in @p pkgs
+ * @param[out] pkg_cnt number of packets read into @p pkgs
+ * @param cb_arg an user-defined callback argument
+ * @return OSD_ERROR_NOT_CONNECTED if the not connected to the device
+ * @return OSD_OK if successful
+ *
+ * @see osd_gateway_set_packet_read_batch_fn()
+ */
+typedef osd_result (*packet_read_batch_fn)(struct osd_packet_view *pkgs,
+                                           size_t max_pkgs, size_t *pkg_cnt,
+                                           void *cb_arg);
+
 /**
  * Write a osd_packet to the device
  *
@@ -75,6 +107,23 @@ typedef osd_result (*packet_read_fn)(struct osd_packet **pkg, void *cb_arg);
 typedef osd_result (*packet_write_fn)(const struct osd_packet *pkg,
         void *cb_arg);
 
+/**
+ * Write multiple packets to the device
+ *
+ * The packets should be written in the given order, preferably with a single
+ * transfer to the device.
+ *
+ * @param pkgs the packets to write
+ * @param pkg_cnt number of packets in @p pkgs
+ * @param cb_arg an user-defined callback argument
+ * @return OSD_ERROR_NOT_CONNECTED if the not connected to the device
+ * @return OSD_OK if all packets were written
+ *
+ * @see osd_gateway_set_packet_write_batch_fn()
+ */
+typedef osd_result (*packet_write_batch_fn)(const struct osd_packet_view *pkgs,
+                                            size_t pkg_cnt, void *cb_arg);
+
 /**
  * Create new osd_gateway instance
  *
@@ -142,6 +191,61 @@ osd_result osd_gateway_disconnect(struct osd_gateway_ctx *ctx);
  */
 bool osd_gateway_is_connected(struct osd_gateway_ctx *ctx);
 
+/**
+ * Read packets from the device in batches
+ *
+ * If set, @p packet_read_batch is used instead of the packet_read function
+ * passed to osd_gateway_new() to read data from the device. Reading multiple
+ * packets at once reduces the per-packet overhead, both in the device
+ * communication and inside the gateway.
+ *
+ * This function must be called before osd_gateway_connect().
+ *
+ * @param ctx the context object
+ * @param packet_read_batch callback function to read packets from the device
+ *                          (called with the cb_arg passed to osd_gateway_new()),
+ *                          or NULL to use packet_read again
+ * @return OSD_OK on success, any other value indicates an error
+ */
+osd_result osd_gateway_set_packet_read_batch_fn(
+    struct osd_gateway_ctx *ctx, packet_read_batch_fn packet_read_batch);
+
+/**
+ * Write packets to the device in batches
+ *
+ * If set, all packets which are queued for the device when the gateway
+ * receives data from the host controller are passed to @p packet_write_batch
+ * at once, instead of calling the packet_write function passed to
+ * osd_gateway_new() for each packet.
+ *
+ * This function must be called before osd_gateway_connect().
+ *
+ * @param ctx the context object
+ * @param packet_write_batch callback function to write packets to the device
+ *                           (called with the cb_arg passed to
+ *                           osd_gateway_new()), or NULL to use packet_write
+ *                           again
+ * @return OSD_OK on success, any other value indicates an error
+ */
+osd_result osd_gateway_set_packet_write_batch_fn(
+    struct osd_gateway_ctx *ctx, packet_write_batch_fn packet_write_batch);
+
+/**
+ * Set the policy for batching packets sent to the host controller
+ *
+ * By default each packet read from the device is sent in its own message to
+ * the host controller. Batching multiple packets into one message increases
+ * the throughput, at the cost of a higher latency for individual packets.
+ *
+ * @param ctx the context object
+ * @param policy the batch policy
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see OSD_PACKET_BATCH_POLICY_NONE
+ */
+osd_result osd_gateway_set_batch_policy(
+    struct osd_gateway_ctx *ctx, const struct osd_packet_batch_policy *policy);
+
 /**
  * Get statistics about the data transferred through the gateway
  */
@@ -44,7 +44,14 @@ struct osd_gateway_glip_ctx;
  * @param[in] log_ctx the log context to be used. Set to NULL to disable logging
  * @param[in] host_controller_address ZeroMQ endpoint of the host controller
  * @param[in] device_subnet_addr Subnet address of the device
- * xxx
+ * @param[in] glip_backend_name name of the GLIP backend to connect to the
+ *                              device
+ * @param[in] glip_backend_options options passed to the GLIP backend. The
+ *                                 option "osd_rx_chunk_size" is not passed on,
+ *                                 it sets the maximum number of bytes read
+ *                                 from the device at once (default: 16 KiB).
+ * @param[in] glip_backend_options_len number of entries in
+ *                                     @p glip_backend_options
  * @return OSD_OK on success, any other value indicates an error
  *
  * @see osd_gateway_new()
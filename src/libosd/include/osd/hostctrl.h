@@ -17,6 +17,7 @@
 #define OSD_HOSTCTRL_H
 
 #include <osd/osd.h>
+#include <osd/packet.h>
 
 #include <czmq.h>
 #include <stdlib.h>
@@ -50,6 +51,53 @@ osd_result osd_hostctrl_new(struct osd_hostctrl_ctx **ctx,
                             struct osd_log_ctx *log_ctx,
                             const char *router_address);
 
+/**
+ * Options of a host controller
+ *
+ * @see osd_hostctrl_new_with_options()
+ */
+struct osd_hostctrl_options {
+    /**
+     * Number of routing threads (1 to 16, default: 1)
+     *
+     * ZeroMQ sockets cannot be shared between threads, therefore each routing
+     * thread listens at its own address: the first one at the address passed
+     * to osd_hostctrl_new_with_options(), thread n at the same TCP port plus n
+     * (e.g. tcp://0.0.0.0:9538 for thread 1 of tcp://0.0.0.0:9537), or at the
+     * address with the suffix "-n" for all other transports (e.g.
+     * ipc:///tmp/osd-1). Use osd_hostctrl_get_router_address() to obtain the
+     * addresses.
+     *
+     * With TCP, one additional port is bound for each routing thread beyond
+     * the first one.
+     *
+     * All messages to and from a host module or gateway are handled by the
+     * routing thread it is connected to, packets between modules connected to
+     * different routing threads are passed between these threads. Subnet n is
+     * served by routing thread n modulo router_threads: gateways connect to
+     * the routing thread of their subnet, as do host modules which set a
+     * target subnet (osd_hostmod_set_target_subnet(), done by the trace
+     * loggers). All other host modules connect to the first routing thread.
+     */
+    unsigned int router_threads;
+};
+
+/**
+ * Create new host controller with options
+ *
+ * Same as osd_hostctrl_new(), with additional options.
+ *
+ * @param ctx context object
+ * @param log_ctx logging context
+ * @param router_address ZeroMQ endpoint/URL the host controller will listen on
+ * @param options the options. Set to NULL to use the default options.
+ * @return OSD_OK if initialization was successful,
+ *         any other return code indicates an error
+ */
+osd_result osd_hostctrl_new_with_options(
+    struct osd_hostctrl_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *router_address, const struct osd_hostctrl_options *options);
+
 /**
  * Start host controller
  */
@@ -78,6 +126,109 @@ void osd_hostctrl_free(struct osd_hostctrl_ctx **ctx_p);
  */
 bool osd_hostctrl_is_running(struct osd_hostctrl_ctx *ctx);
 
+/**
+ * Get the number of routing threads
+ *
+ * @see osd_hostctrl_options.router_threads
+ */
+unsigned int osd_hostctrl_get_router_thread_cnt(struct osd_hostctrl_ctx *ctx);
+
+/**
+ * Statistics of a host controller
+ */
+struct osd_hostctrl_stats {
+    /**
+     * Number of packets dropped because the routing thread owning their
+     * destination could not keep up (the ring between the routing threads
+     * was full)
+     */
+    uint64_t shard_ring_dropped;
+};
+
+/**
+ * Get the statistics of the host controller
+ *
+ * @param ctx the context object
+ * @param[out] stats the statistics
+ */
+void osd_hostctrl_get_stats(struct osd_hostctrl_ctx *ctx,
+                            struct osd_hostctrl_stats *stats);
+
+/**
+ * Get the address a routing thread listens at
+ *
+ * @param ctx the context object
+ * @param thread_idx index of the routing thread
+ * @return the ZeroMQ endpoint/URL, valid until the host controller is freed
+ *
+ * @see osd_hostctrl_options.router_threads
+ */
+const char *osd_hostctrl_get_router_address(struct osd_hostctrl_ctx *ctx,
+                                            unsigned int thread_idx);
+
+/**
+ * Set the subnet of the host modules connected to this host controller
+ *
+ * The default subnet is 1. Host controllers which are connected as peers
+ * must use different subnets, which must also differ from the subnets of all
+ * gateways (devices conventionally use subnet 0).
+ *
+ * This function must be called before osd_hostctrl_start().
+ *
+ * @param ctx the context object
+ * @param subnet_addr the subnet address
+ * @return OSD_OK on success, any other value indicates an error
+ */
+osd_result osd_hostctrl_set_subnet_addr(struct osd_hostctrl_ctx *ctx,
+                                        unsigned int subnet_addr);
+
+/**
+ * Get the subnet of the host modules connected to this host controller
+ *
+ * @see osd_hostctrl_set_subnet_addr()
+ */
+unsigned int osd_hostctrl_get_subnet_addr(struct osd_hostctrl_ctx *ctx);
+
+/**
+ * Connect to another host controller as peer
+ *
+ * Peer host controllers, typically running on different machines, exchange
+ * the subnets they can reach: their own subnet and the subnets of the
+ * gateways connected to them. Packets to these subnets are then routed
+ * through the peer. A single connection is used in both directions, it is
+ * sufficient if one of the two host controllers connects to the other one.
+ *
+ * Subnets learned from a peer are not advertised to other peers: each host
+ * controller must be connected to all host controllers whose subnets it
+ * needs to reach.
+ *
+ * This function must be called before osd_hostctrl_start().
+ *
+ * @param ctx the context object
+ * @param address ZeroMQ endpoint/URL of the first routing thread of the peer
+ * @return OSD_OK on success, any other value indicates an error
+ */
+osd_result osd_hostctrl_add_peer(struct osd_hostctrl_ctx *ctx,
+                                 const char *address);
+
+/**
+ * Set the policy for batching packets sent to peers
+ *
+ * By default each packet is sent in its own message to a peer. Batching
+ * multiple packets into one message increases the throughput over slow
+ * links, at the cost of a higher latency for individual packets.
+ *
+ * This function must be called before osd_hostctrl_start().
+ *
+ * @param ctx the context object
+ * @param policy the batch policy
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see OSD_PACKET_BATCH_POLICY_NONE
+ */
+osd_result osd_hostctrl_set_peer_batch_policy(
+    struct osd_hostctrl_ctx *ctx, const struct osd_packet_batch_policy *policy);
+
 /**@}*/ /* end of doxygen group libosd-hostctrl */
 
 #ifdef __cplusplus
@@ -16,6 +16,7 @@
 #ifndef OSD_HOSTMOD_H
 #define OSD_HOSTMOD_H
 
+#include <osd/ioreactor.h>
 #include <osd/module.h>
 #include <osd/osd.h>
 #include <osd/packet.h>
@@ -37,11 +38,30 @@ extern "C" {
 /** Flag: fully blocking operation (i.e. wait forever) */
 #define OSD_HOSTMOD_BLOCKING 1
 
+/**
+ * Flag: the read registers are constant until the next system reset
+ *
+ * Register reads with this flag are answered from the register cache of the
+ * host module if possible, and stored in the cache otherwise.
+ *
+ * @see osd_hostmod_reg_cache_invalidate()
+ */
+#define OSD_HOSTMOD_CACHED 2
+
 /**
  * Opaque context object
  *
  * This object contains all state information. Create and initialize a new
  * object with osd_hostmod_new() and delete it with osd_hostmod_free().
+ *
+ * Once connected, a host module can be shared by multiple threads: the
+ * register access functions (osd_hostmod_reg_read(), osd_hostmod_reg_write(),
+ * osd_hostmod_reg_batch(), osd_hostmod_reg_submit() and the functions built on
+ * them), osd_hostmod_event_send() and the functions documented as such can be
+ * called from any thread at the same time. The I/O thread routes the response
+ * to each register access to the thread which issued it. All other functions
+ * (in particular connecting and disconnecting) must not be called
+ * concurrently with any other function of the same host module.
  */
 struct osd_hostmod_ctx;
 
@@ -53,6 +73,18 @@ struct osd_hostmod_ctx;
 typedef osd_result (*osd_hostmod_event_handler_fn)(
     void * /* arg */, struct osd_packet * /* packet */);
 
+/**
+ * Batch event handler function prototype
+ *
+ * Called with all events received at once. The packets are owned by the
+ * library and only valid until the function returns.
+ *
+ * @see osd_hostmod_set_event_batch_handler()
+ */
+typedef osd_result (*osd_hostmod_event_batch_handler_fn)(
+    void * /* arg */, const struct osd_packet_view * /* packets */,
+    size_t /* packet_cnt */);
+
 /**
  * Create new osd_hostmod instance
  *
@@ -64,6 +96,7 @@ typedef osd_result (*osd_hostmod_event_handler_fn)(
  * @return OSD_OK on success, any other value indicates an error
  *
  * @see osd_hostmod_free()
+ * @see osd_hostmod_new_with_reactor()
  */
 osd_result osd_hostmod_new(struct osd_hostmod_ctx **ctx,
                            struct osd_log_ctx *log_ctx,
@@ -71,6 +104,31 @@ osd_result osd_hostmod_new(struct osd_hostmod_ctx **ctx,
                            osd_hostmod_event_handler_fn event_handler,
                            void *event_handler_arg);
 
+/**
+ * Create new osd_hostmod instance using a shared I/O reactor
+ *
+ * Same as osd_hostmod_new(), but instead of starting an I/O thread for this
+ * host module alone, the I/O is done on a thread of @p reactor, which is
+ * shared with other host modules. The event handler is called from the
+ * reactor thread.
+ *
+ * @param[out] ctx the osd_hostmod_ctx context to be created
+ * @param[in] log_ctx the log context to be used. Set to NULL to disable logging
+ * @param[in] host_controller_address ZeroMQ endpoint of the host controller
+ * @param[in] event_handler function called when a new event packet is received
+ * @param[in] event_handler_arg argument passed to the event handler callback
+ * @param[in] reactor the I/O reactor. Must not be freed before this host
+ *                    module. Set to NULL to use a dedicated I/O thread.
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see osd_hostmod_new()
+ */
+osd_result osd_hostmod_new_with_reactor(
+    struct osd_hostmod_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address,
+    osd_hostmod_event_handler_fn event_handler, void *event_handler_arg,
+    struct osd_ioreactor_ctx *reactor);
+
 /**
  * Free and NULL a communication API context object
  *
@@ -80,6 +138,23 @@ osd_result osd_hostmod_new(struct osd_hostmod_ctx **ctx,
  */
 void osd_hostmod_free(struct osd_hostmod_ctx **ctx);
 
+/**
+ * Set the subnet the host module mostly communicates with
+ *
+ * A host controller with multiple routing threads (see
+ * osd_hostctrl_options.router_threads) serves each subnet in one of them. The
+ * host module connects to the routing thread serving @p subnet, which avoids
+ * passing its packets between routing threads. By default, the host module
+ * connects to the first routing thread.
+ *
+ * Call this function before osd_hostmod_connect().
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param subnet the subnet, e.g. osd_diaddr_subnet() of the traced module
+ */
+void osd_hostmod_set_target_subnet(struct osd_hostmod_ctx *ctx,
+                                   unsigned int subnet);
+
 /**
  * Connect to the host controller
  *
@@ -125,7 +200,8 @@ bool osd_hostmod_is_connected(struct osd_hostmod_ctx *ctx);
  * @param reg_size_bit size of the register in bit.
  *                     Supported values: 16, 32, 64 and 128.
  * @param flags flags. Set OSD_HOSTMOD_BLOCKING to block indefinitely until the
- *              access succeeds.
+ *              access succeeds. Set OSD_HOSTMOD_CACHED to use the register
+ *              cache.
  * @return OSD_OK on success, any other value indicates an error
  * @return OSD_ERROR_TIMEDOUT if the register read timed out (only if
  *         OSD_HOSTMOD_BLOCKING is not set)
@@ -157,6 +233,187 @@ osd_result osd_hostmod_reg_write(struct osd_hostmod_ctx *ctx,
                                  uint16_t reg_addr, int reg_size_bit,
                                  int flags);
 
+/**
+ * Type of a register access in osd_hostmod_reg_batch()
+ */
+enum osd_hostmod_reg_op_type {
+    /** Read a register */
+    OSD_HOSTMOD_REG_OP_READ,
+    /** Write a register */
+    OSD_HOSTMOD_REG_OP_WRITE,
+};
+
+/**
+ * A register access in osd_hostmod_reg_batch() or osd_hostmod_reg_submit()
+ */
+struct osd_hostmod_reg_op {
+    /** Read or write access */
+    enum osd_hostmod_reg_op_type type;
+    /** DI address of the accessed module */
+    uint16_t diaddr;
+    /** Address of the accessed register */
+    uint16_t reg_addr;
+    /** Size of the register in bit. Supported values: 16, 32, 64 and 128. */
+    int reg_size_bit;
+    /**
+     * Register value: the data to be written for write accesses (not
+     * modified), or the result of read accesses. Provide enough space for
+     * @p reg_size_bit bits.
+     */
+    void *reg_val;
+    /** Result of the access (set when the access completes) */
+    osd_result result;
+};
+
+/**
+ * Read and write multiple registers at once
+ *
+ * All accesses are sent to the debug system without waiting for the
+ * responses to previous accesses, up to a small number of accesses in flight
+ * at a time. This saves the round trip time to the device for all accesses
+ * but the first one.
+ *
+ * The accesses are issued in the order given in @p ops. Accesses to the same
+ * module are executed in this order, accesses to different modules may be
+ * executed in any order. Do not put accesses into one batch which depend on
+ * the result of another access (e.g. a read-modify-write cycle).
+ *
+ * A failing access does not stop the processing of the other accesses. The
+ * result of each access is available in osd_hostmod_reg_op.result.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param ops the register accesses
+ * @param op_cnt number of entries in @p ops
+ * @param flags flags. Set OSD_HOSTMOD_BLOCKING to block indefinitely until all
+ *              accesses succeeded. Set OSD_HOSTMOD_CACHED to use the register
+ *              cache for all read accesses.
+ * @return OSD_OK if all accesses succeeded, the result of the first failed
+ *         access otherwise
+ *
+ * @see osd_hostmod_reg_read()
+ * @see osd_hostmod_reg_write()
+ */
+osd_result osd_hostmod_reg_batch(struct osd_hostmod_ctx *ctx,
+                                 struct osd_hostmod_reg_op *ops, size_t op_cnt,
+                                 int flags);
+
+/**
+ * Completion callback of an asynchronous register access
+ *
+ * @param cb_arg the argument passed to osd_hostmod_reg_submit()
+ * @param req_id the request ID assigned by osd_hostmod_reg_submit()
+ * @param op the completed access. osd_hostmod_reg_op.result contains the
+ *           result of the access, osd_hostmod_reg_op.reg_val the read data.
+ */
+typedef void (*osd_hostmod_reg_cb_fn)(void *cb_arg, uint64_t req_id,
+                                      struct osd_hostmod_reg_op *op);
+
+/**
+ * Start a register access without waiting for its completion
+ *
+ * The access is sent to the debug system right away, and @p cb is called
+ * once the response has been received, or the access failed. Accesses to
+ * the same module complete in the order they were submitted, accesses to
+ * different modules may complete in any order.
+ *
+ * The callback is called from the I/O thread of the host module. It must
+ * return quickly and must not call any blocking function of this host module
+ * (such as osd_hostmod_reg_read()).
+ *
+ * Unless the flag OSD_HOSTMOD_BLOCKING has been set the access fails with
+ * OSD_ERROR_TIMEDOUT if the module does not reply within ZMQ_RCV_TIMEOUT
+ * milliseconds. Pending accesses fail with OSD_ERROR_NOT_CONNECTED if the host
+ * module is disconnected.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param op the register access. The data to be written is copied, but @p op
+ *           and the read buffer must stay valid until @p cb has been called.
+ * @param flags flags. Set OSD_HOSTMOD_BLOCKING to wait indefinitely for the
+ *              response.
+ * @param cb the completion callback
+ * @param cb_arg argument passed to @p cb
+ * @param[out] req_id ID of the request, passed to @p cb. Can be NULL.
+ * @return OSD_OK if the access was started (@p cb will be called),
+ *         any other value indicates an error (@p cb will not be called)
+ *
+ * @see osd_hostmod_reg_batch()
+ */
+osd_result osd_hostmod_reg_submit(struct osd_hostmod_ctx *ctx,
+                                  struct osd_hostmod_reg_op *op, int flags,
+                                  osd_hostmod_reg_cb_fn cb, void *cb_arg,
+                                  uint64_t *req_id);
+
+/**
+ * Statistics of the register cache of a host module
+ */
+struct osd_hostmod_reg_cache_stats {
+    /** Number of register reads answered from the cache */
+    uint64_t hits;
+    /** Number of cacheable register reads sent to the device */
+    uint64_t misses;
+    /** Number of registers currently in the cache */
+    size_t entries;
+};
+
+/**
+ * Remove all registers from the register cache
+ *
+ * Call this function whenever the values of cached registers might have
+ * changed, e.g. after a reset of the debug system.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ *
+ * @see OSD_HOSTMOD_CACHED
+ */
+void osd_hostmod_reg_cache_invalidate(struct osd_hostmod_ctx *ctx);
+
+/**
+ * Get statistics about the register cache
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param[out] stats the cache statistics
+ */
+void osd_hostmod_reg_cache_get_stats(struct osd_hostmod_ctx *ctx,
+                                     struct osd_hostmod_reg_cache_stats *stats);
+
+/**
+ * Save the register cache to a topology cache file
+ *
+ * The file contains all registers in the register cache (module
+ * descriptions, memory layouts, etc.), together with the vendor ID, device ID
+ * and number of modules read from the SCM in @p subnet_addr, which identify
+ * the device. Load the file with osd_hostmod_topology_cache_load() when
+ * connecting to the same device again to skip the enumeration of the debug
+ * system.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param subnet_addr the subnet described by the register cache
+ * @param path the file to write. An existing file is replaced.
+ * @return OSD_OK on success, any other value indicates an error
+ */
+osd_result osd_hostmod_topology_cache_save(struct osd_hostmod_ctx *ctx,
+                                           unsigned int subnet_addr,
+                                           const char *path);
+
+/**
+ * Load a topology cache file into the register cache
+ *
+ * The file is only used if the vendor ID, device ID and number of modules
+ * read from the SCM in @p subnet_addr match the values stored in the file.
+ * This check takes one round trip to the device.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param subnet_addr the subnet described by the file
+ * @param path the file written by osd_hostmod_topology_cache_save()
+ * @return OSD_OK if the file was loaded
+ * @return OSD_ERROR_FILE if the file cannot be read or doesn't match the
+ *         device. The register cache is not changed in this case.
+ * @return any other value indicates an error
+ */
+osd_result osd_hostmod_topology_cache_load(struct osd_hostmod_ctx *ctx,
+                                           unsigned int subnet_addr,
+                                           const char *path);
+
 /**
  * Set (or unset) a bit in a debug module configuration register
  *
@@ -181,6 +438,66 @@ osd_result osd_hostmod_reg_setbit(struct osd_hostmod_ctx *hostmod_ctx,
                                   uint16_t diaddr, uint16_t reg_addr,
                                   int reg_size_bit, int flags);
 
+/**
+ * How synchronous register accesses are transported to the host controller
+ *
+ * @see osd_hostmod_set_reg_access_mode()
+ */
+enum osd_hostmod_reg_access_mode {
+    /**
+     * Through the I/O thread of the host module (default)
+     *
+     * Requests and responses are passed between the calling thread and the
+     * I/O thread, which adds latency to every access. Register accesses can
+     * be issued from multiple threads at the same time.
+     */
+    OSD_HOSTMOD_REG_ACCESS_IOTHREAD,
+    /**
+     * Directly between the calling thread and the host controller
+     *
+     * The host module opens a second connection to the host controller, which
+     * is used by the calling thread for synchronous register accesses. This
+     * connection obtains its own DI address. Asynchronous register accesses
+     * (osd_hostmod_reg_submit()) and events still use the I/O thread.
+     */
+    OSD_HOSTMOD_REG_ACCESS_DIRECT,
+};
+
+/**
+ * Set how synchronous register accesses are transported
+ *
+ * Use OSD_HOSTMOD_REG_ACCESS_DIRECT for a lower latency of individual
+ * register accesses, e.g. for interactive debugging. The batch policy (see
+ * osd_hostmod_set_batch_policy()) does not apply to direct register accesses.
+ *
+ * Call this function before osd_hostmod_connect(). In the direct mode, all
+ * synchronous register accesses must be issued from the same thread (or
+ * serialized by the caller).
+ *
+ * @param ctx the hostmod context
+ * @param mode the register access mode
+ */
+void osd_hostmod_set_reg_access_mode(struct osd_hostmod_ctx *ctx,
+                                     enum osd_hostmod_reg_access_mode mode);
+
+/**
+ * Set the policy for batching packets sent to the host controller
+ *
+ * By default each packet is sent in its own message to the host controller.
+ * Batching multiple packets into one message increases the throughput, at the
+ * cost of a higher latency for individual packets. This includes register
+ * access requests. The policy can be changed at any time; packets which are
+ * waiting in a batch are sent out before the new policy is applied.
+ *
+ * @param ctx the hostmod context
+ * @param policy the batch policy
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see OSD_PACKET_BATCH_POLICY_NONE
+ */
+osd_result osd_hostmod_set_batch_policy(
+    struct osd_hostmod_ctx *ctx, const struct osd_packet_batch_policy *policy);
+
 /**
  * Get the DI address assigned to this host debug module
  *
@@ -215,9 +532,18 @@ osd_result osd_hostmod_event_send(struct osd_hostmod_ctx *ctx,
 /**
  * Receive an event packet
  *
- * By default, this function times out with OSD_ERROR_TIMEOUT if no packet
- * was received. Pass OSD_HOSTMOD_BLOCKING to @p flags to make the function
- * block until a packet is received.
+ * Event packets are queued in the event queue of the host module (unless an
+ * event handler was passed to osd_hostmod_new()), independent of all other
+ * packets. Receiving events therefore never interferes with register accesses
+ * and vice versa.
+ *
+ * Packets which are neither events nor register packets (e.g. packets of the
+ * reserved types) are queued in the event queue as well, even if an event
+ * handler is registered.
+ *
+ * By default, this function times out with OSD_ERROR_TIMEDOUT if no packet
+ * was received within ZMQ_RCV_TIMEOUT milliseconds. Pass OSD_HOSTMOD_BLOCKING
+ * to @p flags to make the function block until a packet is received.
  *
  * @param ctx the osd_hostmod_ctx context object
  * @param[out] event_pkg the received event packet. Allocated by this function,
@@ -229,6 +555,244 @@ osd_result osd_hostmod_event_receive(struct osd_hostmod_ctx *ctx,
                                      struct osd_packet **event_pkg,
                                      int flags);
 
+/**
+ * Receive a copy of all events sent by the module at DI address @p di_addr
+ *
+ * A module sends its events only to a single destination (see
+ * osd_hostmod_mod_set_event_dest()). Subscribing to the events of a module
+ * makes the host controller send a copy of each of its events to this host
+ * module as well, in addition to the destination configured in the module.
+ * The copies are received like all other events (through the event handler
+ * or osd_hostmod_event_receive()); their destination address is the one of
+ * the module's event destination.
+ *
+ * The host controller drops copies if this host module doesn't receive them
+ * fast enough, without affecting the event destination or other subscribers.
+ * All subscriptions end when the host module disconnects.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param di_addr the address of the module sending the events
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see osd_hostmod_event_unsubscribe()
+ */
+osd_result osd_hostmod_event_subscribe(struct osd_hostmod_ctx *ctx,
+                                       uint16_t di_addr);
+
+/**
+ * Stop receiving copies of the events of the module at DI address @p di_addr
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param di_addr the address of the module sending the events
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see osd_hostmod_event_subscribe()
+ */
+osd_result osd_hostmod_event_unsubscribe(struct osd_hostmod_ctx *ctx,
+                                         uint16_t di_addr);
+
+/**
+ * Receive events in batches
+ *
+ * Instead of calling the event handler passed to osd_hostmod_new() once for
+ * every event, @p handler is called once for all events received together
+ * (e.g. in one batch data message, or taken out of the queue of the event
+ * handler thread at once). The events are passed as views on memory owned by
+ * the library: neither an allocation nor a free is needed per event. Copy an
+ * event with osd_packet_new_from_view() to keep it after the handler returned.
+ *
+ * Call this function before osd_hostmod_set_event_handler_thread() and
+ * osd_hostmod_connect(). The batch event handler replaces the event handler
+ * passed to osd_hostmod_new() (if any) and the event queue.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param handler the batch event handler
+ * @param handler_arg argument passed to @p handler
+ */
+void osd_hostmod_set_event_batch_handler(
+    struct osd_hostmod_ctx *ctx, osd_hostmod_event_batch_handler_fn handler,
+    void *handler_arg);
+
+/**
+ * Call the event handler in a dedicated thread
+ *
+ * By default, the event handler passed to osd_hostmod_new() is called in the
+ * I/O thread, and a slow event handler (e.g. one writing to a file) delays
+ * all I/O of the host module. If the event handler thread is enabled, the I/O
+ * thread only copies received events into a queue, and the event handler is
+ * called for them in order in a separate thread. The I/O thread only waits
+ * for the event handler if this queue is full.
+ *
+ * Call this function before osd_hostmod_connect(). The event handler may be
+ * called from the event handler thread until osd_hostmod_disconnect() returns.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param enable true to call the event handler in a dedicated thread, false
+ *               to call it in the I/O thread
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see osd_hostmod_event_handler_flush()
+ * @see osd_hostmod_get_event_handler_stats()
+ */
+osd_result osd_hostmod_set_event_handler_thread(struct osd_hostmod_ctx *ctx,
+                                                bool enable);
+
+/**
+ * Wait until the event handler thread handled all queued events
+ *
+ * All events received before the response to the last register access have
+ * been queued. Does nothing if the event handler thread is not enabled.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ *
+ * @see osd_hostmod_set_event_handler_thread()
+ */
+void osd_hostmod_event_handler_flush(struct osd_hostmod_ctx *ctx);
+
+/**
+ * Statistics of the event handler thread of a host module
+ */
+struct osd_hostmod_event_handler_stats {
+    /** Number of events passed to the event handler */
+    uint64_t events;
+    /** Total time spent in the event handler in ns */
+    uint64_t handler_time_total_ns;
+    /**
+     * Longest time spent in a single call of the event handler in ns (a batch
+     * event handler is called for multiple events at once)
+     */
+    uint64_t handler_time_max_ns;
+    /** Number of bytes queued for the event handler thread */
+    size_t queue_fill_bytes;
+    /** Maximum number of bytes queued for the event handler thread */
+    size_t queue_fill_max_bytes;
+    /** Number of times the I/O thread waited for the event handler thread */
+    uint64_t queue_stalls;
+};
+
+/**
+ * Get statistics about the event handler thread
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param[out] stats the event handler statistics
+ * @return OSD_OK on success, OSD_ERROR_FAILURE if the event handler thread is
+ *         not enabled
+ */
+osd_result osd_hostmod_get_event_handler_stats(
+    struct osd_hostmod_ctx *ctx, struct osd_hostmod_event_handler_stats *stats);
+
+/**
+ * What to do with an event packet if the event queue is full
+ */
+enum osd_hostmod_event_overflow_policy {
+    /**
+     * Wait until osd_hostmod_event_receive() makes space in the queue
+     *
+     * No packets are lost, but all I/O of the host module stalls while the
+     * queue is full: register accesses time out until events are received.
+     * All other host modules sharing the I/O thread (see
+     * osd_hostmod_new_with_reactor()) stall as well. Only use this policy if
+     * events are received continuously.
+     */
+    OSD_HOSTMOD_EVENT_OVERFLOW_BLOCK,
+    /** Drop the oldest packet in the queue (default) */
+    OSD_HOSTMOD_EVENT_OVERFLOW_DROP_OLDEST,
+    /** Drop the received packet */
+    OSD_HOSTMOD_EVENT_OVERFLOW_DROP_NEWEST,
+};
+
+/**
+ * Statistics of the event queue of a host module
+ */
+struct osd_hostmod_event_queue_stats {
+    /** Number of packets currently in the queue */
+    size_t len;
+    /** Maximum number of packets in the queue at the same time */
+    size_t len_max;
+    /** Number of packets added to the queue */
+    uint64_t received;
+    /** Number of packets dropped because the queue was full */
+    uint64_t dropped;
+    /** Number of times the I/O thread waited for space in the queue */
+    uint64_t stalls;
+};
+
+/**
+ * Set the capacity and overflow policy of the event queue
+ *
+ * By default, the event queue holds up to 1000 packets and uses
+ * OSD_HOSTMOD_EVENT_OVERFLOW_DROP_OLDEST. The policy can be changed at any
+ * time.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param capacity maximum number of packets in the queue (at least 1)
+ * @param policy what to do with packets if the queue is full
+ *
+ * @see osd_hostmod_event_receive()
+ */
+void osd_hostmod_set_event_queue_policy(
+    struct osd_hostmod_ctx *ctx, size_t capacity,
+    enum osd_hostmod_event_overflow_policy policy);
+
+/**
+ * Get statistics about the event queue
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param[out] stats the queue statistics
+ */
+void osd_hostmod_get_event_queue_stats(
+    struct osd_hostmod_ctx *ctx, struct osd_hostmod_event_queue_stats *stats);
+
+/**
+ * Statistics of the reassembly of events split into multiple packets
+ */
+struct osd_hostmod_event_reassembly_stats {
+    /** Number of events reassembled from multiple packets */
+    uint64_t completed;
+    /** Number of partial events discarded after the timeout */
+    uint64_t timed_out;
+    /** Number of partial events discarded because they were too large */
+    uint64_t overflowed;
+    /** Number of sources with a partial event */
+    size_t partial_events;
+    /** Number of bytes in all partial events */
+    size_t partial_bytes;
+};
+
+/**
+ * Set the limits of the event reassembly
+ *
+ * Events split into multiple EVENT packets (EV_CONT, terminated by EV_LAST)
+ * are reassembled into a single packet before they are passed on. A partial
+ * event is discarded if it grows beyond @p max_bytes, or if no packet of it
+ * has been received for @p timeout_ms. By default, events can be up to 64 kB
+ * in size and time out after 1 s.
+ *
+ * The size of an event is also limited by the maximum size of a packet.
+ * @p max_bytes must allow for at least the packet header and one payload word
+ * (8 bytes); values above the maximum packet size (UINT16_MAX words) are
+ * capped to it.
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param max_bytes maximum size of an event (of one source) in bytes
+ * @param timeout_ms time after which a partial event is discarded
+ * @return OSD_OK on success, OSD_ERROR_NOT_CONNECTED if the host module is
+ *         not connected, OSD_ERROR_FAILURE if @p max_bytes is too small
+ */
+osd_result osd_hostmod_set_event_reassembly_limits(struct osd_hostmod_ctx *ctx,
+                                                   size_t max_bytes,
+                                                   unsigned int timeout_ms);
+
+/**
+ * Get statistics about the event reassembly
+ *
+ * @param ctx the osd_hostmod_ctx context object
+ * @param[out] stats the event reassembly statistics
+ */
+void osd_hostmod_get_event_reassembly_stats(
+    struct osd_hostmod_ctx *ctx,
+    struct osd_hostmod_event_reassembly_stats *stats);
+
 /**
  * Get a list of all debug modules in a given subnet
  *
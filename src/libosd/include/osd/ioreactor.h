@@ -0,0 +1,89 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OSD_IOREACTOR_H
+#define OSD_IOREACTOR_H
+
+#include <osd/osd.h>
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup libosd-ioreactor Shared I/O Reactor
+ * @ingroup libosd
+ *
+ * A small pool of I/O threads shared between many host modules.
+ *
+ * By default, every host module (and every tool built on top of it, like the
+ * trace loggers) runs its own I/O thread. Applications creating many host
+ * modules can instead create one I/O reactor and pass it to
+ * osd_hostmod_new_with_reactor(). All host modules created this way share
+ * the threads of the reactor: each module is assigned to the thread with the
+ * fewest modules at creation time and stays there until it is freed.
+ *
+ * All modules on one reactor thread are processed sequentially. Event handler
+ * callbacks of these modules are therefore called from the same thread, and a
+ * slow event handler delays the I/O of all other modules on its thread.
+ *
+ * @{
+ */
+
+/**
+ * Opaque context object
+ *
+ * Create and initialize a new object with osd_ioreactor_new() and delete it
+ * with osd_ioreactor_free().
+ */
+struct osd_ioreactor_ctx;
+
+/**
+ * Create a new I/O reactor
+ *
+ * @param[out] ctx the I/O reactor context to be created
+ * @param[in] log_ctx the log context to be used. Set to NULL to disable logging
+ * @param[in] thread_cnt number of I/O threads (at least 1)
+ * @return OSD_OK on success, any other value indicates an error
+ *
+ * @see osd_ioreactor_free()
+ */
+osd_result osd_ioreactor_new(struct osd_ioreactor_ctx **ctx,
+                             struct osd_log_ctx *log_ctx,
+                             unsigned int thread_cnt);
+
+/**
+ * Stop all I/O threads and free the I/O reactor
+ *
+ * All host modules using this reactor must have been freed before.
+ *
+ * @param ctx_p the I/O reactor context object
+ */
+void osd_ioreactor_free(struct osd_ioreactor_ctx **ctx_p);
+
+/**
+ * Get the number of I/O threads of the reactor
+ */
+unsigned int osd_ioreactor_get_thread_cnt(struct osd_ioreactor_ctx *ctx);
+
+/**@}*/ /* end of doxygen group libosd-ioreactor */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OSD_IOREACTOR_H
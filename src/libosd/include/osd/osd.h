@@ -69,6 +69,8 @@ typedef int osd_result;
 #define OSD_ERROR_MEM_VERIFY_FAILED -13
 /** Return code: unexpected module type */
 #define OSD_ERROR_WRONG_MODULE -14
+/** Return code: end of file reached */
+#define OSD_ERROR_EOF -15
 
 /**
  * Return true if |rv| is an error code
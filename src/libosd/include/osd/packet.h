@@ -49,6 +49,50 @@ struct osd_packet {
     };
 };
 
+/**
+ * A borrowed, read-only view on a packet stored in memory owned by someone else
+ *
+ * A packet view gives access to the contents of a DI packet without copying
+ * it, e.g. to inspect the header of a packet received in a zframe_t before it
+ * is forwarded. The view does not own the memory it references: it is only
+ * valid as long as the underlying memory (e.g. the zframe_t it was created
+ * from) exists and is not modified. Views need not be freed.
+ *
+ * If the packet needs to outlive the memory it was received in, create a copy
+ * with osd_packet_new_from_view().
+ *
+ * @see osd_packet_view_from_zframe()
+ */
+struct osd_packet_view {
+    uint16_t data_size_words;  //!< size of data_raw in uint16_t words
+    const uint16_t *data_raw;  //!< packet data, including the header words
+};
+
+/**
+ * Policy for batching multiple packets into one message on the host
+ *
+ * Packets are collected into a batch until one of the limits is reached, at
+ * which point the batch is sent as one message.
+ *
+ * @see OSD_PACKET_BATCH_POLICY_NONE
+ */
+struct osd_packet_batch_policy {
+    //! maximum number of packets in a batch. 0 or 1 disable batching.
+    unsigned int max_packets;
+    //! maximum size of the packet data in a batch in bytes, 0 for no limit
+    size_t max_bytes;
+    //! maximum time in microseconds the first packet in a batch waits until
+    //! the batch is sent. Must be larger than 0 if batching is enabled. The
+    //! flush timer has a resolution of one millisecond.
+    unsigned int max_delay_us;
+};
+
+/**
+ * Batch policy: send each packet in its own message (the default)
+ */
+#define OSD_PACKET_BATCH_POLICY_NONE \
+    ((struct osd_packet_batch_policy){ .max_packets = 1 })
+
 /**
  * Packet types
  */
@@ -108,6 +152,10 @@ enum osd_packet_type_event_subtype {
  *
  * The osd_packet.size field is set to the allocated size.
  *
+ * Packets up to a size of osd_packet_pool_stats.slot_words are taken from a
+ * packet pool, larger packets are allocated on the heap. In both cases the
+ * packet must be freed with osd_packet_free(), never with free().
+ *
  * @param[out] packet the packet to be allocated
  * @param[in]  size_data_words number of uint16_t words in the packet, including
  *             the header words.
@@ -143,11 +191,117 @@ osd_result osd_packet_realloc(struct osd_packet **packet_p,
 osd_result osd_packet_new_from_zframe(struct osd_packet **packet,
                                       const zframe_t *frame);
 
+/**
+ * Create a new packet from a packet view
+ *
+ * The data referenced by the view is copied into the new packet.
+ *
+ * @see osd_packet_new()
+ * @see osd_packet_view_from_zframe()
+ */
+osd_result osd_packet_new_from_view(struct osd_packet **packet,
+                                    const struct osd_packet_view *view);
+
+/**
+ * Create a packet view on the packet data contained in a zframe
+ *
+ * No data is copied, the view references the frame data directly and is valid
+ * as long as @p frame is not destroyed or modified.
+ *
+ * @param[out] view the packet view to populate
+ * @param frame the frame containing the packet data (including the header)
+ * @return OSD_OK if successful,
+ *         OSD_ERROR_DEVICE_INVALID_DATA if the frame does not contain a valid
+ *         packet
+ */
+osd_result osd_packet_view_from_zframe(struct osd_packet_view *view,
+                                       const zframe_t *frame);
+
+/**
+ * Extract the DEST field out of a packet view
+ */
+unsigned int osd_packet_view_get_dest(const struct osd_packet_view *view);
+
+/**
+ * Extract the SRC field out of a packet view
+ */
+unsigned int osd_packet_view_get_src(const struct osd_packet_view *view);
+
+/**
+ * Extract the TYPE field out of a packet view
+ */
+unsigned int osd_packet_view_get_type(const struct osd_packet_view *view);
+
+/**
+ * Extract the TYPE_SUB field out of a packet view
+ */
+unsigned int osd_packet_view_get_type_sub(const struct osd_packet_view *view);
+
+/**
+ * Get a pointer to the payload words of a packet view
+ *
+ * @see osd_packet_view_get_payload_words()
+ */
+const uint16_t *osd_packet_view_get_payload(
+    const struct osd_packet_view *view);
+
+/**
+ * Get the number of payload words in a packet view
+ */
+unsigned int osd_packet_view_get_payload_words(
+    const struct osd_packet_view *view);
+
+/**
+ * Size in bytes of the packet data referenced by a packet view
+ *
+ * This is the same value osd_packet_sizeof() returns for a copy of the packet.
+ */
+size_t osd_packet_view_sizeof(const struct osd_packet_view *view);
+
 /**
  * Free the memory associated with the packet and NULL the object
+ *
+ * Packets which have been taken from the packet pool are returned to it,
+ * all other packets are released with free().
  */
 void osd_packet_free(struct osd_packet **packet);
 
+/**
+ * Packet pool statistics
+ *
+ * @see osd_packet_pool_get_stats()
+ */
+struct osd_packet_pool_stats {
+    //! packet allocations served from the pool
+    uint64_t hits;
+    //! packet allocations which fit into a pool slot, but found the pool
+    //! exhausted (or the pool not available) and were served from the heap
+    uint64_t misses;
+    //! packet allocations larger than a pool slot, served from the heap
+    uint64_t oversize;
+    //! number of slots in the pool, 0 if the pool is disabled
+    uint64_t slots_total;
+    //! number of slots which have been in use at least once (high watermark)
+    uint64_t slots_carved;
+    //! maximum number of data words (including the header) in a pool slot
+    unsigned int slot_words;
+    //! maximum number of data words (including the header) in a slot of the
+    //! small size class, which holds single DI packets. Larger packets (up to
+    //! slot_words) are taken from the large size class.
+    unsigned int small_slot_words;
+};
+
+/**
+ * Get statistics about the packet pool
+ *
+ * All counters are global to the process and count since the start of the
+ * program. The packet pool can be disabled at build time by passing
+ * --disable-packet-pool to configure, e.g. to use memory debugging tools.
+ *
+ * @param[out] stats the statistics
+ */
+void osd_packet_pool_get_stats(struct osd_packet_pool_stats *stats);
+
 /**
  * Append the payload of the second packet into the first packet
  *
@@ -274,6 +428,9 @@ void osd_packet_to_string(const struct osd_packet *packet, char **str);
  *   the file type.
  * - No file integrity checks, such as checksums.
  *
+ * To record larger amounts of packets, use the capture files in
+ * <osd/packetcap.h> instead, which add timestamps, buffering and an index.
+ *
  * @param packet the packet to write
  * @param fd the open file descriptor to write to
  * @return bool operation successful?
@@ -0,0 +1,228 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OSD_PACKETCAP_H
+#define OSD_PACKETCAP_H
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup libosd-packetcap Packet Capture Files
+ * @ingroup libosd
+ *
+ * Write and read captures of DI packets.
+ *
+ * A capture file starts with a file header, followed by a sequence of
+ * records. Each record consists of the host timestamp (in ns), the direction
+ * of the packet and the DI packet itself. All values are stored in the
+ * native byte order of the host which wrote the capture.
+ *
+ * When a capture file is closed, a sidecar index file (capture file name with
+ * ".idx" appended) is written. It maps points in time and DI source addresses
+ * to offsets in the capture file. Readers use the index to seek within the
+ * capture without scanning it. If the index file is missing or doesn't match
+ * the capture (e.g. because the writer was not shut down properly), the
+ * reader re-creates the index in memory.
+ *
+ * @{
+ */
+
+/**
+ * Version of the capture file format written by this library
+ */
+#define OSD_PACKETCAP_VERSION 1
+
+/**
+ * Default number of records covered by one entry in the index
+ */
+#define OSD_PACKETCAP_INDEX_INTERVAL_DEFAULT 1024
+
+/**
+ * Timestamp value: use the current time
+ */
+#define OSD_PACKETCAP_TIMESTAMP_NOW 0
+
+/**
+ * Source address filter value: don't filter packets by their source
+ */
+#define OSD_PACKETCAP_SRC_ANY -1
+
+/**
+ * Direction of a captured packet (as seen by the host)
+ */
+enum osd_packetcap_dir {
+    /** Packet received by the host, i.e. sent by the device */
+    OSD_PACKETCAP_DIR_RX = 0,
+    /** Packet sent by the host, i.e. sent to the device */
+    OSD_PACKETCAP_DIR_TX = 1,
+};
+
+/**
+ * A record in a capture file
+ */
+struct osd_packetcap_record {
+    /** Host time the packet was captured (ns since the Unix epoch) */
+    uint64_t timestamp_ns;
+
+    /** Direction of the packet */
+    enum osd_packetcap_dir dir;
+
+    /**
+     * The captured packet
+     *
+     * The view points into the memory-mapped capture file and is valid until
+     * the reader is freed.
+     */
+    struct osd_packet_view pkg;
+
+    /** Offset of the record in the capture file */
+    uint64_t offset;
+};
+
+struct osd_packetcap_writer;
+struct osd_packetcap_reader;
+
+/**
+ * Create a new capture file
+ *
+ * An existing file at @p path is overwritten.
+ *
+ * @param[out] writer_p the created writer
+ * @param log_ctx the log context to use
+ * @param path the path of the capture file
+ * @param index_interval number of records covered by one index entry, use
+ *                       OSD_PACKETCAP_INDEX_INTERVAL_DEFAULT if unsure.
+ *                       Smaller values speed up seeking, but make the index
+ *                       larger.
+ * @return OSD_OK on success, OSD_ERROR_FILE if the file cannot be created
+ */
+osd_result osd_packetcap_writer_new(struct osd_packetcap_writer **writer_p,
+                                    struct osd_log_ctx *log_ctx,
+                                    const char *path,
+                                    unsigned int index_interval);
+
+/**
+ * Add a packet to the capture
+ *
+ * The record is buffered and written to the capture file in larger blocks.
+ * Timestamps should be non-decreasing; records are never re-ordered.
+ *
+ * @param writer the writer
+ * @param pkg the packet to capture
+ * @param dir the direction of the packet
+ * @param timestamp_ns the capture time (ns since the Unix epoch), or
+ *                     OSD_PACKETCAP_TIMESTAMP_NOW to use the current time
+ * @return OSD_OK on success, OSD_ERROR_FILE if writing the capture failed
+ */
+osd_result osd_packetcap_write(struct osd_packetcap_writer *writer,
+                               const struct osd_packet *pkg,
+                               enum osd_packetcap_dir dir,
+                               uint64_t timestamp_ns);
+
+/**
+ * Write all buffered records to the capture file
+ *
+ * @return OSD_OK on success, OSD_ERROR_FILE if writing the capture failed
+ */
+osd_result osd_packetcap_writer_flush(struct osd_packetcap_writer *writer);
+
+/**
+ * Close a capture file and write its index
+ *
+ * @param writer_p the writer, set to NULL afterwards
+ * @return OSD_OK on success, OSD_ERROR_FILE if writing the capture or the
+ *         index failed. The writer is freed in any case.
+ */
+osd_result osd_packetcap_writer_close(struct osd_packetcap_writer **writer_p);
+
+/**
+ * Open a capture file for reading
+ *
+ * The capture file is memory-mapped; records are returned without copying
+ * them.
+ *
+ * @param[out] reader_p the created reader
+ * @param log_ctx the log context to use
+ * @param path the path of the capture file
+ * @return OSD_OK on success,
+ *         OSD_ERROR_FILE if the file cannot be opened,
+ *         OSD_ERROR_DEVICE_INVALID_DATA if the file is not a capture file or
+ *         uses an unsupported version of the format
+ */
+osd_result osd_packetcap_reader_new(struct osd_packetcap_reader **reader_p,
+                                    struct osd_log_ctx *log_ctx,
+                                    const char *path);
+
+/**
+ * Free a reader
+ *
+ * All records obtained from this reader become invalid.
+ */
+void osd_packetcap_reader_free(struct osd_packetcap_reader **reader_p);
+
+/**
+ * Get the next record from the capture
+ *
+ * @param reader the reader
+ * @param[out] rec the record
+ * @return OSD_OK if a record was returned,
+ *         OSD_ERROR_EOF if the end of the capture was reached,
+ *         OSD_ERROR_DEVICE_INVALID_DATA if the capture contains a malformed
+ *         record (e.g. a truncated record at the end of the file)
+ */
+osd_result osd_packetcap_reader_next(struct osd_packetcap_reader *reader,
+                                     struct osd_packetcap_record *rec);
+
+/**
+ * Seek to the first record captured at or after @p timestamp_ns
+ *
+ * Seeking requires non-decreasing timestamps in the capture.
+ */
+void osd_packetcap_reader_seek_time(struct osd_packetcap_reader *reader,
+                                    uint64_t timestamp_ns);
+
+/**
+ * Seek to the start of the capture
+ */
+void osd_packetcap_reader_rewind(struct osd_packetcap_reader *reader);
+
+/**
+ * Only return packets from a given source DI address
+ *
+ * Parts of the capture not containing packets from @p src_diaddr are skipped
+ * using the index.
+ *
+ * @param reader the reader
+ * @param src_diaddr the source DI address, or OSD_PACKETCAP_SRC_ANY to return
+ *                   all packets
+ */
+void osd_packetcap_reader_set_src_filter(struct osd_packetcap_reader *reader,
+                                         int src_diaddr);
+
+/**@}*/ /* end of doxygen group libosd-packetcap */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OSD_PACKETCAP_H
@@ -42,11 +42,34 @@ osd_result osd_systracelogger_new(struct osd_systracelogger_ctx **ctx,
                                   const char *host_controller_address,
                                   uint16_t stm_di_addr);
 
+/**
+ * Create a new context object using a shared I/O reactor
+ *
+ * @see osd_hostmod_new_with_reactor()
+ */
+osd_result osd_systracelogger_new_with_reactor(
+    struct osd_systracelogger_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address, uint16_t stm_di_addr,
+    struct osd_ioreactor_ctx *reactor);
+
 /**
  * @copydoc osd_hostmod_connect()
  */
 osd_result osd_systracelogger_connect(struct osd_systracelogger_ctx *ctx);
 
+/**
+ * Write the log files in a dedicated thread
+ *
+ * By default, the logs are written in the I/O thread of the host module, which
+ * is shared by all host modules using the same I/O reactor. Enable the event
+ * handler thread if writing the logs is slow, e.g. because it goes to a slow
+ * disk. Call this function before osd_systracelogger_connect().
+ *
+ * @see osd_hostmod_set_event_handler_thread()
+ */
+osd_result osd_systracelogger_set_event_handler_thread(
+    struct osd_systracelogger_ctx *ctx, bool enable);
+
 /**
  * @copydoc osd_hostmod_disconnect()
  */
@@ -71,6 +94,9 @@ osd_result osd_systracelogger_start(struct osd_systracelogger_ctx *ctx);
 
 /**
  * Stop collecting system logs
+ *
+ * All events received until the module stopped sending them are written to
+ * the log before this function returns.
  */
 osd_result osd_systracelogger_stop(struct osd_systracelogger_ctx *ctx);
 
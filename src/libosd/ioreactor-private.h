@@ -0,0 +1,66 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OSD_IOREACTOR_PRIVATE_H
+#define OSD_IOREACTOR_PRIVATE_H
+
+#include <osd/ioreactor.h>
+#include <osd/osd.h>
+
+struct worker_thread_ctx;
+
+/**
+ * Attach a worker to the least used thread of an I/O reactor
+ *
+ * The worker is set up asynchronously in the reactor thread, which sends a
+ * WORKER_OP_THREADINIT_DONE message to the main thread of the worker when
+ * done (see worker_thread_attach()).
+ *
+ * This function is thread-safe.
+ *
+ * @param reactor the I/O reactor
+ * @param thread_ctx the worker thread context. The caller keeps the ownership,
+ *                   but must not use or free the context until it is
+ *                   detached with ioreactor_detach().
+ * @param[out] thread_idx index of the reactor thread the worker is attached
+ *                        to. Pass it to ioreactor_detach().
+ * @return OSD_OK on success
+ *         OSD_ERROR_NOT_CONNECTED if the reactor thread is not running
+ */
+osd_result ioreactor_attach(struct osd_ioreactor_ctx *reactor,
+                            struct worker_thread_ctx *thread_ctx,
+                            unsigned int *thread_idx);
+
+/**
+ * Detach a worker from a reactor thread
+ *
+ * The reactor thread removes the worker from its zloop (see
+ * worker_thread_detach()) and acknowledges this. This function waits for the
+ * acknowledgement, the caller can free @p thread_ctx afterwards. Detaching a
+ * worker whose setup failed or is still queued in the reactor thread is
+ * possible as well.
+ *
+ * This function is thread-safe.
+ *
+ * @param reactor the I/O reactor
+ * @param thread_idx index of the reactor thread, as returned by
+ *                   ioreactor_attach()
+ * @param thread_ctx the worker thread context passed to ioreactor_attach()
+ */
+void ioreactor_detach(struct osd_ioreactor_ctx *reactor,
+                      unsigned int thread_idx,
+                      struct worker_thread_ctx *thread_ctx);
+
+#endif  // OSD_IOREACTOR_PRIVATE_H
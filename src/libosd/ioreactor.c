@@ -0,0 +1,248 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <osd/ioreactor.h>
+#include <osd/osd.h>
+
+#include "ioreactor-private.h"
+#include "osd-private.h"
+#include "worker.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * I/O reactor context
+ *
+ * Each reactor thread is a worker without any user context of its own. Other
+ * workers are attached to it by sending their worker_thread_ctx to the
+ * reactor thread, which then adds them to its zloop.
+ */
+struct osd_ioreactor_ctx {
+    /** Logging context */
+    struct osd_log_ctx *log_ctx;
+
+    /** Number of reactor threads */
+    unsigned int thread_cnt;
+
+    /** Reactor threads */
+    struct worker_ctx **threads;
+
+    /** Number of workers attached to each reactor thread */
+    unsigned int *attached_cnt;
+
+    /**
+     * Lock protecting attached_cnt and the main thread side of the reactor
+     * threads, which are used from all threads creating workers
+     */
+    pthread_mutex_t lock;
+};
+
+/**
+ * Opcodes of messages exchanged with the reactor threads
+ */
+enum reactor_opcode {
+    REACTOR_OP_ATTACH = WORKER_OP_USER,
+    REACTOR_OP_DETACH,
+    REACTOR_OP_DETACH_DONE,
+};
+
+/**
+ * Attach a worker to this reactor thread
+ */
+static osd_result reactor_handle_attach(struct worker_thread_ctx *thread_ctx,
+                                        zmsg_t **msg_p)
+{
+    zframe_t *ctx_frame = zmsg_last(*msg_p);
+    assert(zframe_size(ctx_frame) == sizeof(struct worker_thread_ctx *));
+    struct worker_thread_ctx *attached_thread_ctx;
+    memcpy(&attached_thread_ctx, zframe_data(ctx_frame),
+           sizeof(struct worker_thread_ctx *));
+
+    worker_thread_attach(attached_thread_ctx, thread_ctx->zloop);
+
+    return OSD_OK;
+}
+
+/**
+ * Detach a worker from this reactor thread
+ *
+ * Messages are processed in order: the worker was attached (or its setup
+ * failed) before.
+ */
+static osd_result reactor_handle_detach(struct worker_thread_ctx *thread_ctx,
+                                        zmsg_t **msg_p)
+{
+    zframe_t *ctx_frame = zmsg_last(*msg_p);
+    assert(zframe_size(ctx_frame) == sizeof(struct worker_thread_ctx *));
+    struct worker_thread_ctx *detached_thread_ctx;
+    memcpy(&detached_thread_ctx, zframe_data(ctx_frame),
+           sizeof(struct worker_thread_ctx *));
+
+    worker_thread_detach(detached_thread_ctx);
+
+    worker_send_status(thread_ctx->inproc_socket, REACTOR_OP_DETACH_DONE,
+                       OSD_OK);
+
+    return OSD_OK;
+}
+
+static const struct worker_cmd_handler reactor_cmd_handlers[] = {
+    { REACTOR_OP_ATTACH, reactor_handle_attach },
+    { REACTOR_OP_DETACH, reactor_handle_detach },
+};
+
+API_EXPORT
+osd_result osd_ioreactor_new(struct osd_ioreactor_ctx **ctx,
+                             struct osd_log_ctx *log_ctx,
+                             unsigned int thread_cnt)
+{
+    osd_result rv;
+    int irv;
+
+    assert(thread_cnt > 0);
+
+    struct osd_ioreactor_ctx *c = calloc(1, sizeof(struct osd_ioreactor_ctx));
+    assert(c);
+
+    c->log_ctx = log_ctx;
+    c->thread_cnt = thread_cnt;
+    c->threads = calloc(thread_cnt, sizeof(struct worker_ctx *));
+    assert(c->threads);
+    c->attached_cnt = calloc(thread_cnt, sizeof(unsigned int));
+    assert(c->attached_cnt);
+
+    irv = pthread_mutex_init(&c->lock, NULL);
+    assert(irv == 0);
+
+    for (unsigned int i = 0; i < thread_cnt; i++) {
+        rv = worker_new(&c->threads[i], log_ctx, NULL, NULL,
+                        reactor_cmd_handlers,
+                        sizeof(reactor_cmd_handlers) /
+                            sizeof(reactor_cmd_handlers[0]),
+                        NULL);
+        if (OSD_FAILED(rv)) {
+            err(log_ctx, "Unable to start I/O reactor thread %u.", i);
+            osd_ioreactor_free(&c);
+            return rv;
+        }
+    }
+
+    *ctx = c;
+
+    return OSD_OK;
+}
+
+API_EXPORT
+void osd_ioreactor_free(struct osd_ioreactor_ctx **ctx_p)
+{
+    assert(ctx_p);
+    struct osd_ioreactor_ctx *ctx = *ctx_p;
+    if (!ctx) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < ctx->thread_cnt; i++) {
+        assert(ctx->attached_cnt[i] == 0 &&
+               "Free all host modules using the I/O reactor before freeing "
+               "the I/O reactor itself.");
+        worker_free(&ctx->threads[i]);
+    }
+
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->attached_cnt);
+    free(ctx->threads);
+    free(ctx);
+    *ctx_p = NULL;
+}
+
+API_EXPORT
+unsigned int osd_ioreactor_get_thread_cnt(struct osd_ioreactor_ctx *ctx)
+{
+    assert(ctx);
+    return ctx->thread_cnt;
+}
+
+osd_result ioreactor_attach(struct osd_ioreactor_ctx *reactor,
+                            struct worker_thread_ctx *thread_ctx,
+                            unsigned int *thread_idx)
+{
+    assert(reactor);
+    assert(thread_ctx);
+
+    pthread_mutex_lock(&reactor->lock);
+
+    unsigned int idx = 0;
+    for (unsigned int i = 1; i < reactor->thread_cnt; i++) {
+        if (reactor->attached_cnt[i] < reactor->attached_cnt[idx]) {
+            idx = i;
+        }
+    }
+
+    struct worker_ctx *reactor_thread = reactor->threads[idx];
+    if (!reactor_thread->thread_is_running) {
+        pthread_mutex_unlock(&reactor->lock);
+        return OSD_ERROR_NOT_CONNECTED;
+    }
+
+    worker_send_data(reactor_thread->inproc_socket, REACTOR_OP_ATTACH,
+                     &thread_ctx, sizeof(struct worker_thread_ctx *));
+    reactor->attached_cnt[idx]++;
+
+    pthread_mutex_unlock(&reactor->lock);
+
+    *thread_idx = idx;
+    return OSD_OK;
+}
+
+void ioreactor_detach(struct osd_ioreactor_ctx *reactor,
+                      unsigned int thread_idx,
+                      struct worker_thread_ctx *thread_ctx)
+{
+    osd_result rv;
+
+    assert(reactor);
+    assert(thread_idx < reactor->thread_cnt);
+    assert(thread_ctx);
+
+    pthread_mutex_lock(&reactor->lock);
+    assert(reactor->attached_cnt[thread_idx] > 0);
+
+    // The acknowledgement is received on the main thread side of the reactor
+    // thread, which is protected by the lock.
+    struct worker_ctx *reactor_thread = reactor->threads[thread_idx];
+    if (reactor_thread->thread_is_running) {
+        worker_send_data(reactor_thread->inproc_socket, REACTOR_OP_DETACH,
+                         &thread_ctx, sizeof(struct worker_thread_ctx *));
+
+        // The worker context must not be freed while the reactor thread might
+        // use it: wait as long as it takes (e.g. for a handler of another
+        // worker blocking the reactor thread).
+        int retval;
+        while (1) {
+            rv = worker_wait_for_status(reactor_thread->inproc_socket,
+                                        REACTOR_OP_DETACH_DONE, &retval);
+            if (OSD_SUCCEEDED(rv) || !reactor_thread->thread_is_running) {
+                break;
+            }
+            err(reactor->log_ctx, "Still waiting for I/O reactor thread %u to "
+                "detach a worker.", thread_idx);
+        }
+    }
+
+    reactor->attached_cnt[thread_idx]--;
+    pthread_mutex_unlock(&reactor->lock);
+}
@@ -19,6 +19,7 @@
 #include <osd/packet.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include "osd-private.h"
 
 #define MACROSTR(k) #k
@@ -26,6 +27,342 @@
 // the number of header words in a DI packet (SRC, DEST and FLAGS)
 #define PACKET_HEADER_WORD_CNT 3
 
+/*
+ * Packet pool
+ *
+ * Almost all packets in the system have a very short lifetime: they are
+ * created when receiving data from a socket or a device and freed right after
+ * they have been forwarded or decoded. Serving them from malloc() makes the
+ * allocator one of the most expensive parts of the receive paths.
+ *
+ * The pool reserves one contiguous memory region (the arena) and cuts it into
+ * slots of two size classes: small slots, which hold a single DI packet of up
+ * to OSD_MAX_PKG_LEN_WORDS words, and large slots, which hold the events
+ * created by combining multiple DI packets (e.g. trace events spanning
+ * multiple packets). Since all slots are part of the arena a simple address
+ * range check tells us if a packet is owned by the pool or by the heap, and to
+ * which size class it belongs; no per-packet header is needed.
+ *
+ * Free slots are kept in a per-thread cache per size class, which serves
+ * allocations and frees without any locking. If a cache runs empty it is
+ * refilled with a batch of slots from the global free list of the class; if it
+ * grows too large a batch of slots is returned. Slots are carved from the
+ * arena lazily, i.e. memory for slots is only touched once it is actually
+ * needed.
+ *
+ * Packets which do not fit into a large slot and allocations while the pool
+ * is exhausted are served from the heap.
+ */
+
+// size of a small pool slot in bytes
+#define POOL_SMALL_SLOT_SIZE 32
+
+// number of small slots in the arena
+#define POOL_SMALL_SLOT_CNT (64 * 1024)
+
+// size of a large pool slot in bytes
+#define POOL_LARGE_SLOT_SIZE 512
+
+// number of large slots in the arena
+#define POOL_LARGE_SLOT_CNT (8 * 1024)
+
+// number of size classes
+#define POOL_CLASS_CNT 2
+
+// number of data words which fit into a pool slot of the given size
+#define POOL_SLOT_WORDS(slot_size) \
+    (((slot_size) - sizeof(uint16_t)) / sizeof(uint16_t))
+
+// maximum number of free slots of a size class cached by a single thread
+#define POOL_CACHE_MAX 512
+
+// number of slots moved between a thread cache and the global free list
+#define POOL_CACHE_BATCH 128
+
+#ifdef USE_PACKET_POOL
+_Static_assert(POOL_SLOT_WORDS(POOL_SMALL_SLOT_SIZE) >= OSD_MAX_PKG_LEN_WORDS,
+               "A small pool slot must be able to hold a maximum-sized "
+               "packet.");
+#endif
+
+struct pool_slot {
+    struct pool_slot *next;
+};
+
+/**
+ * A size class of the pool
+ */
+struct pool_class {
+    //! size of a slot in bytes
+    size_t slot_size;
+    //! number of slots
+    size_t slot_cnt;
+    //! first slot in the arena
+    char *base;
+    //! number of slots which have been carved from the arena
+    size_t slots_carved;
+    //! global list of free slots
+    struct pool_slot *free_list;
+};
+
+/**
+ * Free slots cached by a thread
+ */
+struct pool_cache {
+    struct pool_slot *head;
+    unsigned int cnt;
+};
+
+static struct {
+    pthread_once_t init_once;
+    pthread_mutex_t lock;
+
+    //! thread-specific key to return a thread cache on thread exit
+    pthread_key_t cache_key;
+
+    //! start of the arena, NULL if the pool is not available
+    char *arena;
+    //! size of the arena in bytes
+    size_t arena_size;
+
+    //! size classes, smallest first
+    struct pool_class classes[POOL_CLASS_CNT];
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t oversize;
+} pool = {
+    .init_once = PTHREAD_ONCE_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .classes = {
+        { .slot_size = POOL_SMALL_SLOT_SIZE,
+          .slot_cnt = POOL_SMALL_SLOT_CNT },
+        { .slot_size = POOL_LARGE_SLOT_SIZE,
+          .slot_cnt = POOL_LARGE_SLOT_CNT },
+    },
+};
+
+/**
+ * Slot caches of a thread, one per size class
+ */
+static __thread struct {
+    struct pool_cache classes[POOL_CLASS_CNT];
+    bool registered;
+} pool_thread_cache;
+
+static inline void pool_stat_inc(uint64_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+static inline bool pool_owns(const void *ptr)
+{
+    return pool.arena && (const char *)ptr >= pool.arena &&
+           (const char *)ptr < pool.arena + pool.arena_size;
+}
+
+/**
+ * Get the size class of a slot owned by the pool
+ */
+static unsigned int pool_class_of(const void *ptr)
+{
+    assert(pool_owns(ptr));
+
+    unsigned int class_idx = 0;
+    while ((const char *)ptr >= pool.classes[class_idx].base +
+                                    pool.classes[class_idx].slot_cnt *
+                                        pool.classes[class_idx].slot_size) {
+        class_idx++;
+    }
+    return class_idx;
+}
+
+/**
+ * Return a batch of slots from a thread cache to the global free list
+ *
+ * @param class_idx the size class of the cache
+ * @param cache the cache to drain
+ * @param cnt number of slots to return, or all slots if cnt is 0
+ */
+static void pool_cache_drain(unsigned int class_idx, struct pool_cache *cache,
+                             unsigned int cnt)
+{
+    if (cnt == 0 || cnt > cache->cnt) {
+        cnt = cache->cnt;
+    }
+    if (cnt == 0) {
+        return;
+    }
+
+    struct pool_slot *first = cache->head;
+    struct pool_slot *last = first;
+    for (unsigned int i = 1; i < cnt; i++) {
+        last = last->next;
+    }
+    cache->head = last->next;
+    cache->cnt -= cnt;
+
+    struct pool_class *class = &pool.classes[class_idx];
+    pthread_mutex_lock(&pool.lock);
+    last->next = class->free_list;
+    class->free_list = first;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_cache_destructor(void *arg)
+{
+    struct pool_cache *caches = arg;
+    for (unsigned int i = 0; i < POOL_CLASS_CNT; i++) {
+        pool_cache_drain(i, &caches[i], 0);
+    }
+}
+
+static void pool_init(void)
+{
+    int rv = pthread_key_create(&pool.cache_key, pool_cache_destructor);
+    if (rv != 0) {
+        return;
+    }
+
+    size_t arena_size = 0;
+    for (unsigned int i = 0; i < POOL_CLASS_CNT; i++) {
+        arena_size += pool.classes[i].slot_cnt * pool.classes[i].slot_size;
+    }
+
+    // Only reserve address space, memory is allocated by the kernel when
+    // slots are carved from the arena.
+    void *arena = mmap(NULL, arena_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED) {
+        return;
+    }
+
+    char *base = arena;
+    for (unsigned int i = 0; i < POOL_CLASS_CNT; i++) {
+        pool.classes[i].base = base;
+        base += pool.classes[i].slot_cnt * pool.classes[i].slot_size;
+    }
+    pool.arena_size = arena_size;
+    pool.arena = arena;
+}
+
+/**
+ * Get the slot cache of a size class of the calling thread
+ *
+ * The caches are registered to be returned to the global free lists when the
+ * thread exits.
+ */
+static struct pool_cache *pool_cache_get(unsigned int class_idx)
+{
+    if (!pool_thread_cache.registered) {
+        pthread_setspecific(pool.cache_key, pool_thread_cache.classes);
+        pool_thread_cache.registered = true;
+    }
+    return &pool_thread_cache.classes[class_idx];
+}
+
+/**
+ * Refill a cache of the calling thread with up to POOL_CACHE_BATCH slots
+ */
+static void pool_cache_refill(unsigned int class_idx, struct pool_cache *cache)
+{
+    struct pool_class *class = &pool.classes[class_idx];
+
+    pthread_mutex_lock(&pool.lock);
+    unsigned int cnt = 0;
+    while (cnt < POOL_CACHE_BATCH && class->free_list) {
+        struct pool_slot *slot = class->free_list;
+        class->free_list = slot->next;
+        slot->next = cache->head;
+        cache->head = slot;
+        cnt++;
+    }
+    while (cnt < POOL_CACHE_BATCH && class->slots_carved < class->slot_cnt) {
+        struct pool_slot *slot =
+            (struct pool_slot *)(class->base +
+                                 class->slots_carved * class->slot_size);
+        class->slots_carved++;
+        slot->next = cache->head;
+        cache->head = slot;
+        cnt++;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    cache->cnt += cnt;
+}
+
+/**
+ * Get a zeroed packet of the given size from the pool
+ *
+ * The packet is taken from the smallest size class it fits into.
+ *
+ * @return the packet, or NULL if the packet must be allocated from the heap
+ */
+static struct osd_packet *pool_alloc(size_t size_bytes)
+{
+#ifdef USE_PACKET_POOL
+    unsigned int class_idx = 0;
+    while (class_idx < POOL_CLASS_CNT &&
+           size_bytes > pool.classes[class_idx].slot_size) {
+        class_idx++;
+    }
+    if (class_idx == POOL_CLASS_CNT) {
+        pool_stat_inc(&pool.oversize);
+        return NULL;
+    }
+
+    pthread_once(&pool.init_once, pool_init);
+    if (!pool.arena) {
+        pool_stat_inc(&pool.misses);
+        return NULL;
+    }
+
+    struct pool_cache *cache = pool_cache_get(class_idx);
+    if (!cache->head) {
+        pool_cache_refill(class_idx, cache);
+    }
+    if (!cache->head) {
+        pool_stat_inc(&pool.misses);
+        return NULL;
+    }
+
+    struct pool_slot *slot = cache->head;
+    cache->head = slot->next;
+    cache->cnt--;
+    pool_stat_inc(&pool.hits);
+
+    memset(slot, 0, size_bytes);
+    return (struct osd_packet *)slot;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Return a packet to the pool
+ *
+ * @return true if the packet was owned by the pool, false if it must be
+ *         returned to the heap
+ */
+static bool pool_free(struct osd_packet *packet)
+{
+    if (!pool_owns(packet)) {
+        return false;
+    }
+
+    unsigned int class_idx = pool_class_of(packet);
+    struct pool_cache *cache = pool_cache_get(class_idx);
+    struct pool_slot *slot = (struct pool_slot *)packet;
+    slot->next = cache->head;
+    cache->head = slot;
+    cache->cnt++;
+
+    if (cache->cnt > POOL_CACHE_MAX) {
+        pool_cache_drain(class_idx, cache, POOL_CACHE_BATCH);
+    }
+    return true;
+}
+
 API_EXPORT
 unsigned int osd_packet_sizeconv_payload2data(unsigned int payload_words)
 {
@@ -46,7 +383,10 @@ osd_result osd_packet_new(struct osd_packet **packet, size_t data_size_words)
 {
     ssize_t size = sizeof(uint16_t) * 1  // osd_packet.data_size_words
                    + sizeof(uint16_t) * data_size_words;  // osd_packet.data
-    struct osd_packet *pkg = calloc(1, size);
+    struct osd_packet *pkg = pool_alloc(size);
+    if (!pkg) {
+        pkg = calloc(1, size);
+    }
     assert(pkg);
 
     pkg->data_size_words = data_size_words;
@@ -62,7 +402,29 @@ osd_result osd_packet_realloc(struct osd_packet **packet_p,
 {
     ssize_t size_new = sizeof(uint16_t) * 1  // data_size_words
                        + sizeof(uint16_t) * data_size_words_new; // data
-    struct osd_packet *pkg_new = realloc(*packet_p, size_new);
+    struct osd_packet *pkg_new;
+    if (pool_owns(*packet_p)) {
+        size_t slot_size = pool.classes[pool_class_of(*packet_p)].slot_size;
+        if ((size_t)size_new <= slot_size) {
+            // the slot is large enough, resize in place
+            pkg_new = *packet_p;
+        } else {
+            // the packet outgrew its slot, move it to a larger slot or to the
+            // heap
+            pkg_new = NULL;
+            if ((size_t)size_new <= POOL_LARGE_SLOT_SIZE) {
+                pkg_new = pool_alloc(size_new);
+            }
+            if (!pkg_new) {
+                pkg_new = malloc(size_new);
+                assert(pkg_new);
+            }
+            memcpy(pkg_new, *packet_p, slot_size);
+            pool_free(*packet_p);
+        }
+    } else {
+        pkg_new = realloc(*packet_p, size_new);
+    }
     assert(pkg_new);
 
     pkg_new->data_size_words = data_size_words_new;
@@ -77,15 +439,45 @@ osd_result osd_packet_new_from_zframe(struct osd_packet **packet,
                                       const zframe_t *frame)
 {
     assert(frame);
-    uint16_t *data = (uint16_t *)zframe_data((zframe_t *)frame);
-    size_t data_size_bytes = zframe_size((zframe_t *)frame);
-    size_t data_size_words = data_size_bytes / sizeof(uint16_t);
-    assert(data);
-    assert(data_size_words >= PACKET_HEADER_WORD_CNT);
 
-    osd_result rv = osd_packet_new(packet, data_size_words);
+    struct osd_packet_view view;
+    osd_result rv = osd_packet_view_from_zframe(&view, frame);
     assert(OSD_SUCCEEDED(rv));
-    memcpy((*packet)->data_raw, data, data_size_bytes);
+
+    return osd_packet_new_from_view(packet, &view);
+}
+
+API_EXPORT
+osd_result osd_packet_new_from_view(struct osd_packet **packet,
+                                    const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_raw);
+
+    osd_result rv = osd_packet_new(packet, view->data_size_words);
+    assert(OSD_SUCCEEDED(rv));
+    memcpy((*packet)->data_raw, view->data_raw,
+           view->data_size_words * sizeof(uint16_t));
+
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_packet_view_from_zframe(struct osd_packet_view *view,
+                                       const zframe_t *frame)
+{
+    assert(view);
+    assert(frame);
+
+    size_t data_size_bytes = zframe_size((zframe_t *)frame);
+    if (data_size_bytes % sizeof(uint16_t) != 0 ||
+        data_size_bytes < PACKET_HEADER_WORD_CNT * sizeof(uint16_t) ||
+        data_size_bytes > UINT16_MAX * sizeof(uint16_t)) {
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+
+    view->data_raw = (const uint16_t *)zframe_data((zframe_t *)frame);
+    view->data_size_words = data_size_bytes / sizeof(uint16_t);
 
     return OSD_OK;
 }
@@ -96,10 +488,36 @@ void osd_packet_free(struct osd_packet **packet_p)
     assert(packet_p);
     struct osd_packet *packet = *packet_p;
 
-    free(packet);
+    if (!pool_free(packet)) {
+        free(packet);
+    }
     *packet_p = NULL;
 }
 
+API_EXPORT
+void osd_packet_pool_get_stats(struct osd_packet_pool_stats *stats)
+{
+    assert(stats);
+
+    stats->hits = __atomic_load_n(&pool.hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&pool.misses, __ATOMIC_RELAXED);
+    stats->oversize = __atomic_load_n(&pool.oversize, __ATOMIC_RELAXED);
+
+    stats->slots_total = 0;
+    stats->slots_carved = 0;
+    pthread_mutex_lock(&pool.lock);
+    for (unsigned int i = 0; i < POOL_CLASS_CNT; i++) {
+        if (pool.arena) {
+            stats->slots_total += pool.classes[i].slot_cnt;
+        }
+        stats->slots_carved += pool.classes[i].slots_carved;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    stats->small_slot_words = POOL_SLOT_WORDS(POOL_SMALL_SLOT_SIZE);
+    stats->slot_words = POOL_SLOT_WORDS(POOL_LARGE_SLOT_SIZE);
+}
+
 API_EXPORT
 osd_result osd_packet_combine(struct osd_packet** first_p,
                               const struct osd_packet *second)
@@ -130,6 +548,30 @@ osd_result osd_packet_combine(struct osd_packet** first_p,
     return OSD_OK;
 }
 
+/*
+ * Header field extraction from the raw packet data words, shared between
+ * packets and packet views.
+ */
+static inline unsigned int hdr_get_dest(const uint16_t *data_raw)
+{
+    return (data_raw[0] >> DP_HEADER_DEST_SHIFT) & DP_HEADER_DEST_MASK;
+}
+
+static inline unsigned int hdr_get_src(const uint16_t *data_raw)
+{
+    return (data_raw[1] >> DP_HEADER_SRC_SHIFT) & DP_HEADER_SRC_MASK;
+}
+
+static inline unsigned int hdr_get_type(const uint16_t *data_raw)
+{
+    return (data_raw[2] >> DP_HEADER_TYPE_SHIFT) & DP_HEADER_TYPE_MASK;
+}
+
+static inline unsigned int hdr_get_type_sub(const uint16_t *data_raw)
+{
+    return (data_raw[2] >> DP_HEADER_TYPE_SUB_SHIFT) & DP_HEADER_TYPE_SUB_MASK;
+}
+
 API_EXPORT
 unsigned int osd_packet_get_dest(const struct osd_packet *packet)
 {
@@ -137,7 +579,7 @@ unsigned int osd_packet_get_dest(const struct osd_packet *packet)
     assert((packet->data_size_words >= PACKET_HEADER_WORD_CNT) &&
            "The packet must be large enough for the header words.");
 
-    return (packet->data.dest >> DP_HEADER_DEST_SHIFT) & DP_HEADER_DEST_MASK;
+    return hdr_get_dest(packet->data_raw);
 }
 
 API_EXPORT
@@ -147,7 +589,7 @@ unsigned int osd_packet_get_src(const struct osd_packet *packet)
     assert((packet->data_size_words >= PACKET_HEADER_WORD_CNT) &&
            "The packet must be large enough for the header words.");
 
-    return (packet->data.src >> DP_HEADER_SRC_SHIFT) & DP_HEADER_SRC_MASK;
+    return hdr_get_src(packet->data_raw);
 }
 
 API_EXPORT
@@ -157,7 +599,7 @@ unsigned int osd_packet_get_type(const struct osd_packet *packet)
     assert((packet->data_size_words >= PACKET_HEADER_WORD_CNT) &&
            "The packet must be large enough for the header words.");
 
-    return (packet->data.flags >> DP_HEADER_TYPE_SHIFT) & DP_HEADER_TYPE_MASK;
+    return hdr_get_type(packet->data_raw);
 }
 
 API_EXPORT
@@ -167,8 +609,67 @@ unsigned int osd_packet_get_type_sub(const struct osd_packet *packet)
     assert((packet->data_size_words >= PACKET_HEADER_WORD_CNT) &&
            "The packet must be large enough for the header words.");
 
-    return (packet->data.flags >> DP_HEADER_TYPE_SUB_SHIFT) &
-           DP_HEADER_TYPE_SUB_MASK;
+    return hdr_get_type_sub(packet->data_raw);
+}
+
+API_EXPORT
+unsigned int osd_packet_view_get_dest(const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_size_words >= PACKET_HEADER_WORD_CNT);
+
+    return hdr_get_dest(view->data_raw);
+}
+
+API_EXPORT
+unsigned int osd_packet_view_get_src(const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_size_words >= PACKET_HEADER_WORD_CNT);
+
+    return hdr_get_src(view->data_raw);
+}
+
+API_EXPORT
+unsigned int osd_packet_view_get_type(const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_size_words >= PACKET_HEADER_WORD_CNT);
+
+    return hdr_get_type(view->data_raw);
+}
+
+API_EXPORT
+unsigned int osd_packet_view_get_type_sub(const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_size_words >= PACKET_HEADER_WORD_CNT);
+
+    return hdr_get_type_sub(view->data_raw);
+}
+
+API_EXPORT
+const uint16_t *osd_packet_view_get_payload(const struct osd_packet_view *view)
+{
+    assert(view);
+    assert(view->data_size_words >= PACKET_HEADER_WORD_CNT);
+
+    return view->data_raw + PACKET_HEADER_WORD_CNT;
+}
+
+API_EXPORT
+unsigned int osd_packet_view_get_payload_words(
+    const struct osd_packet_view *view)
+{
+    assert(view);
+    return osd_packet_sizeconv_data2payload(view->data_size_words);
+}
+
+API_EXPORT
+size_t osd_packet_view_sizeof(const struct osd_packet_view *view)
+{
+    assert(view);
+    return view->data_size_words * sizeof(uint16_t);
 }
 
 API_EXPORT
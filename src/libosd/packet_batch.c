@@ -0,0 +1,295 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "packet_batch.h"
+
+#include <assert.h>
+#include <osd/osd.h>
+#include <osd/packet.h>
+#include "osd-private.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * Initial size of the batch buffer in bytes
+ */
+#define BATCH_BUF_INITIAL_SIZE 1024
+
+/**
+ * Batch builder context
+ */
+struct packet_batch {
+    /** Currently active batch policy */
+    struct osd_packet_batch_policy policy;
+
+    /** Batch data: records of packets (size word + data words) */
+    uint8_t *buf;
+
+    /** Allocated size of buf */
+    size_t buf_size;
+
+    /** Used bytes in buf */
+    size_t buf_used;
+
+    /** Number of packets in the batch */
+    unsigned int pkg_cnt;
+
+    /** Point in time when the first packet was added to the batch (in us) */
+    uint64_t first_pkg_time_us;
+
+    /** zloop driving the flush timer */
+    zloop_t *zloop;
+
+    /** ID of the flush timer, -1 if no timer is active */
+    int timer_id;
+
+    /** Send function */
+    packet_batch_send_fn send_fn;
+
+    /** Argument passed to send_fn */
+    void *send_fn_arg;
+};
+
+static uint64_t time_now_us(void)
+{
+    struct timespec ts;
+    int rv = clock_gettime(CLOCK_MONOTONIC, &ts);
+    assert(rv == 0);
+    return (uint64_t)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+static int batch_timer_expired(zloop_t *loop, int timer_id, void *batch_void)
+{
+    struct packet_batch *batch = batch_void;
+    assert(batch);
+
+    // the timer is a one-shot timer, which is removed by zloop
+    batch->timer_id = -1;
+    packet_batch_flush(batch);
+
+    return 0;
+}
+
+void packet_batch_new(struct packet_batch **batch_p, zloop_t *zloop,
+                      packet_batch_send_fn send_fn, void *send_fn_arg)
+{
+    assert(zloop);
+    assert(send_fn);
+
+    struct packet_batch *batch = calloc(1, sizeof(struct packet_batch));
+    assert(batch);
+
+    batch->policy = OSD_PACKET_BATCH_POLICY_NONE;
+    batch->zloop = zloop;
+    batch->timer_id = -1;
+    batch->send_fn = send_fn;
+    batch->send_fn_arg = send_fn_arg;
+
+    *batch_p = batch;
+}
+
+void packet_batch_free(struct packet_batch **batch_p)
+{
+    assert(batch_p);
+    struct packet_batch *batch = *batch_p;
+    if (!batch) {
+        return;
+    }
+
+    if (batch->timer_id != -1) {
+        zloop_timer_end(batch->zloop, batch->timer_id);
+    }
+    free(batch->buf);
+    free(batch);
+    *batch_p = NULL;
+}
+
+void packet_batch_set_policy(struct packet_batch *batch,
+                             const struct osd_packet_batch_policy *policy)
+{
+    assert(batch);
+    assert(policy);
+    assert((policy->max_packets <= 1 || policy->max_delay_us > 0) &&
+           "A maximum delay is required if batching is enabled.");
+
+    packet_batch_flush(batch);
+    batch->policy = *policy;
+}
+
+bool packet_batch_is_enabled(const struct packet_batch *batch)
+{
+    return batch->policy.max_packets > 1;
+}
+
+/**
+ * Send a single packet as data message
+ */
+static void send_single(struct packet_batch *batch,
+                        const struct osd_packet_view *pkg)
+{
+    int rv;
+    zmsg_t *msg = zmsg_new();
+    assert(msg);
+    rv = zmsg_addstr(msg, "D");
+    assert(rv == 0);
+    rv = zmsg_addmem(msg, pkg->data_raw, osd_packet_view_sizeof(pkg));
+    assert(rv == 0);
+
+    batch->send_fn(&msg, batch->send_fn_arg);
+}
+
+void packet_batch_add(struct packet_batch *batch,
+                      const struct osd_packet_view *pkg)
+{
+    assert(batch);
+    assert(pkg);
+
+    if (!packet_batch_is_enabled(batch)) {
+        send_single(batch, pkg);
+        return;
+    }
+
+    size_t record_size = sizeof(uint16_t) + osd_packet_view_sizeof(pkg);
+
+    // a packet which would exceed the size limit goes into the next batch
+    if (batch->policy.max_bytes &&
+        batch->buf_used + record_size > batch->policy.max_bytes) {
+        packet_batch_flush(batch);
+    }
+
+    if (batch->buf_used + record_size > batch->buf_size) {
+        size_t new_size = batch->buf_size;
+        if (new_size == 0) {
+            new_size = BATCH_BUF_INITIAL_SIZE;
+        }
+        while (new_size < batch->buf_used + record_size) {
+            new_size *= 2;
+        }
+        batch->buf = realloc(batch->buf, new_size);
+        assert(batch->buf);
+        batch->buf_size = new_size;
+    }
+
+    uint16_t data_size_words = pkg->data_size_words;
+    memcpy(batch->buf + batch->buf_used, &data_size_words, sizeof(uint16_t));
+    memcpy(batch->buf + batch->buf_used + sizeof(uint16_t), pkg->data_raw,
+           osd_packet_view_sizeof(pkg));
+    batch->buf_used += record_size;
+    batch->pkg_cnt++;
+
+    uint64_t now_us = time_now_us();
+    if (batch->pkg_cnt == 1) {
+        batch->first_pkg_time_us = now_us;
+        batch->timer_id = zloop_timer(
+            batch->zloop, INT_DIV_CEIL(batch->policy.max_delay_us, 1000), 1,
+            batch_timer_expired, batch);
+        assert(batch->timer_id != -1);
+    }
+
+    if (batch->pkg_cnt >= batch->policy.max_packets ||
+        (batch->policy.max_bytes &&
+         batch->buf_used >= batch->policy.max_bytes) ||
+        now_us - batch->first_pkg_time_us >= batch->policy.max_delay_us) {
+        packet_batch_flush(batch);
+    }
+}
+
+void packet_batch_flush(struct packet_batch *batch)
+{
+    assert(batch);
+
+    if (batch->timer_id != -1) {
+        zloop_timer_end(batch->zloop, batch->timer_id);
+        batch->timer_id = -1;
+    }
+
+    if (batch->pkg_cnt == 0) {
+        return;
+    }
+
+    if (batch->pkg_cnt == 1) {
+        // a batch of one is sent as regular data message
+        struct osd_packet_view pkg;
+        memcpy(&pkg.data_size_words, batch->buf, sizeof(uint16_t));
+        pkg.data_raw = (const uint16_t *)(batch->buf + sizeof(uint16_t));
+        send_single(batch, &pkg);
+    } else {
+        int rv;
+        zmsg_t *msg = zmsg_new();
+        assert(msg);
+        rv = zmsg_addstr(msg, "B");
+        assert(rv == 0);
+        rv = zmsg_addmem(msg, batch->buf, batch->buf_used);
+        assert(rv == 0);
+
+        batch->send_fn(&msg, batch->send_fn_arg);
+    }
+
+    batch->buf_used = 0;
+    batch->pkg_cnt = 0;
+}
+
+void packet_batch_iter_init(struct packet_batch_iter *iter,
+                            const zframe_t *frame)
+{
+    assert(frame);
+
+    packet_batch_iter_init_data(iter, zframe_data((zframe_t *)frame),
+                                zframe_size((zframe_t *)frame));
+}
+
+void packet_batch_iter_init_data(struct packet_batch_iter *iter,
+                                 const void *data, size_t size)
+{
+    assert(iter);
+
+    iter->data = data;
+    iter->size = size;
+    iter->offset = 0;
+    iter->invalid = false;
+}
+
+bool packet_batch_iter_next(struct packet_batch_iter *iter,
+                            struct osd_packet_view *pkg)
+{
+    assert(iter);
+    assert(pkg);
+
+    if (iter->offset == iter->size) {
+        return false;
+    }
+
+    uint16_t data_size_words;
+    if (iter->size - iter->offset < sizeof(uint16_t)) {
+        iter->invalid = true;
+        return false;
+    }
+    memcpy(&data_size_words, iter->data + iter->offset, sizeof(uint16_t));
+
+    size_t data_size_bytes = data_size_words * sizeof(uint16_t);
+    if (data_size_words < osd_packet_sizeconv_payload2data(0) ||
+        iter->size - iter->offset - sizeof(uint16_t) < data_size_bytes) {
+        iter->invalid = true;
+        return false;
+    }
+
+    pkg->data_size_words = data_size_words;
+    pkg->data_raw =
+        (const uint16_t *)(iter->data + iter->offset + sizeof(uint16_t));
+    iter->offset += sizeof(uint16_t) + data_size_bytes;
+
+    return true;
+}
@@ -0,0 +1,134 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PACKET_BATCH_H
+#define PACKET_BATCH_H
+
+#include <czmq.h>
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+/**
+ * Batching of DI packets in data messages
+ *
+ * A batch data message (type "B") carries multiple DI packets in a single
+ * payload frame. Each packet is stored as one record: the number of data words
+ * (uint16_t), followed by the packet data words. This is the memory layout of
+ * struct osd_packet, all values are in native byte order.
+ *
+ * The batch builder collects outgoing packets and hands them to a send
+ * function once the batch policy requires it. It is designed to be used on
+ * a worker thread, the flush timer is driven by the worker's zloop.
+ */
+
+/**
+ * Send a message created by the batch builder
+ *
+ * @param msg the message to be sent, ownership is passed to the function
+ * @param arg the send_fn_arg passed to packet_batch_new()
+ */
+typedef void (*packet_batch_send_fn)(zmsg_t ** /* msg */, void * /* arg */);
+
+/**
+ * Batch builder
+ */
+struct packet_batch;
+
+/**
+ * Create a new batch builder
+ *
+ * The builder starts with OSD_PACKET_BATCH_POLICY_NONE, i.e. each packet is
+ * sent as separate data message ("D").
+ *
+ * @param[out] batch_p the created batch builder
+ * @param zloop the zloop used to drive the flush timer
+ * @param send_fn function called to send a message
+ * @param send_fn_arg argument passed to @p send_fn
+ */
+void packet_batch_new(struct packet_batch **batch_p, zloop_t *zloop,
+                      packet_batch_send_fn send_fn, void *send_fn_arg);
+
+/**
+ * Free a batch builder, discarding all packets which have not been sent
+ */
+void packet_batch_free(struct packet_batch **batch_p);
+
+/**
+ * Change the batch policy
+ *
+ * All pending packets are sent before the new policy is applied.
+ */
+void packet_batch_set_policy(struct packet_batch *batch,
+                             const struct osd_packet_batch_policy *policy);
+
+/**
+ * Is batching enabled, i.e. can a batch contain more than one packet?
+ */
+bool packet_batch_is_enabled(const struct packet_batch *batch);
+
+/**
+ * Add a packet to the batch
+ *
+ * The packet data is copied. If the batch is full afterwards it is sent.
+ */
+void packet_batch_add(struct packet_batch *batch,
+                      const struct osd_packet_view *pkg);
+
+/**
+ * Send all pending packets
+ */
+void packet_batch_flush(struct packet_batch *batch);
+
+/**
+ * Iterator over the packets in a batch frame
+ */
+struct packet_batch_iter {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+
+    /** The batch frame contains malformed data after the last valid packet */
+    bool invalid;
+};
+
+/**
+ * Start iterating over the packets contained in a batch payload frame
+ *
+ * The iterator references the frame data, which must not be destroyed while
+ * the iterator (and the packet views obtained from it) are in use.
+ */
+void packet_batch_iter_init(struct packet_batch_iter *iter,
+                            const zframe_t *frame);
+
+/**
+ * Start iterating over the packets contained in a batch payload buffer
+ *
+ * @see packet_batch_iter_init()
+ */
+void packet_batch_iter_init_data(struct packet_batch_iter *iter,
+                                 const void *data, size_t size);
+
+/**
+ * Get the next packet out of a batch frame
+ *
+ * @param iter the iterator
+ * @param[out] pkg a view on the next packet
+ * @return true if a packet was returned, false if the end of the batch was
+ *         reached or the remaining data is malformed (iter->invalid is set).
+ */
+bool packet_batch_iter_next(struct packet_batch_iter *iter,
+                            struct osd_packet_view *pkg);
+
+#endif  // PACKET_BATCH_H
@@ -0,0 +1,278 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "packet_ring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * Marker in place of a packet size: the rest of the ring up to the wrap-around
+ * is unused
+ */
+#define PACKET_RING_PAD 0
+
+/**
+ * Packet ring
+ *
+ * The ring stores packets as records: a size word (data_size_words), followed
+ * by the packet data. Records never wrap around, unused space at the end of
+ * the ring is marked with PACKET_RING_PAD.
+ *
+ * head and tail are running positions in words; the position in the buffer is
+ * obtained by masking them. The producer owns head, the consumer owns tail.
+ *
+ * Notifications use "waiting" flags: a thread sets its flag before it checks
+ * the ring one last time and goes to sleep; the other thread signals the
+ * eventfd if it finds the flag set after updating the ring. All accesses to
+ * the flags and positions involved in this handshake are sequentially
+ * consistent, which ensures that no wakeup is lost.
+ */
+struct packet_ring {
+    uint16_t *buf;
+    size_t capacity_words;
+    uint64_t mask;
+
+    uint64_t head;
+    uint64_t tail;
+
+    /** Position after the last packet returned by packet_ring_peek() */
+    uint64_t peek_pos;
+
+    bool consumer_waiting;
+    bool producer_waiting;
+
+    /** eventfd signaling new packets to the consumer */
+    int data_fd;
+    /** eventfd signaling free space to the producer */
+    int space_fd;
+
+    uint64_t fill_max_words;
+    uint64_t producer_stalls;
+};
+
+static void signal_fd(int fd)
+{
+    uint64_t one = 1;
+    ssize_t rv;
+    do {
+        rv = write(fd, &one, sizeof(one));
+    } while (rv == -1 && errno == EINTR);
+    assert(rv == sizeof(one));
+}
+
+static void clear_fd(int fd)
+{
+    uint64_t cnt;
+    ssize_t rv;
+    do {
+        rv = read(fd, &cnt, sizeof(cnt));
+    } while (rv == -1 && errno == EINTR);
+    assert(rv == sizeof(cnt) || (rv == -1 && errno == EAGAIN));
+}
+
+void packet_ring_new(struct packet_ring **ring_p, size_t capacity_words)
+{
+    assert((capacity_words & (capacity_words - 1)) == 0);
+    assert(capacity_words >= 2 * (1 + UINT16_MAX));
+
+    struct packet_ring *ring = calloc(1, sizeof(struct packet_ring));
+    assert(ring);
+
+    ring->capacity_words = capacity_words;
+    ring->mask = capacity_words - 1;
+    ring->buf = malloc(capacity_words * sizeof(uint16_t));
+    assert(ring->buf);
+
+    // the consumer starts out waiting for the first notification
+    ring->consumer_waiting = true;
+
+    ring->data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(ring->data_fd != -1);
+    ring->space_fd = eventfd(0, EFD_CLOEXEC);
+    assert(ring->space_fd != -1);
+
+    *ring_p = ring;
+}
+
+void packet_ring_free(struct packet_ring **ring_p)
+{
+    assert(ring_p);
+    struct packet_ring *ring = *ring_p;
+    if (!ring) {
+        return;
+    }
+
+    close(ring->data_fd);
+    close(ring->space_fd);
+    free(ring->buf);
+    free(ring);
+    *ring_p = NULL;
+}
+
+bool packet_ring_try_push(struct packet_ring *ring,
+                          const struct osd_packet_view *pkg)
+{
+    assert(ring);
+    assert(pkg->data_size_words != PACKET_RING_PAD);
+
+    size_t record_words = 1 + pkg->data_size_words;
+
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+    size_t idx = head & ring->mask;
+    size_t contig_words = ring->capacity_words - idx;
+
+    size_t required_words = record_words;
+    if (record_words > contig_words) {
+        required_words += contig_words;
+    }
+    if (required_words > ring->capacity_words - (head - tail)) {
+        return false;
+    }
+
+    if (record_words > contig_words) {
+        ring->buf[idx] = PACKET_RING_PAD;
+        head += contig_words;
+        idx = 0;
+    }
+    ring->buf[idx] = pkg->data_size_words;
+    memcpy(&ring->buf[idx + 1], pkg->data_raw,
+           pkg->data_size_words * sizeof(uint16_t));
+    head += record_words;
+
+    __atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+
+    if (head - tail > ring->fill_max_words) {
+        __atomic_store_n(&ring->fill_max_words, head - tail, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&ring->consumer_waiting, false,
+                            __ATOMIC_SEQ_CST)) {
+        signal_fd(ring->data_fd);
+    }
+
+    return true;
+}
+
+void packet_ring_push(struct packet_ring *ring,
+                      const struct osd_packet_view *pkg)
+{
+    while (!packet_ring_try_push(ring, pkg)) {
+        __atomic_add_fetch(&ring->producer_stalls, 1, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&ring->producer_waiting, true, __ATOMIC_SEQ_CST);
+        if (packet_ring_try_push(ring, pkg)) {
+            __atomic_store_n(&ring->producer_waiting, false, __ATOMIC_SEQ_CST);
+            return;
+        }
+
+        // blocking read, and a cancellation point
+        uint64_t cnt;
+        ssize_t rv = read(ring->space_fd, &cnt, sizeof(cnt));
+        assert(rv == sizeof(cnt) || (rv == -1 && errno == EINTR));
+    }
+}
+
+int packet_ring_get_fd(const struct packet_ring *ring)
+{
+    return ring->data_fd;
+}
+
+size_t packet_ring_peek(struct packet_ring *ring, struct osd_packet_view *pkgs,
+                        size_t max_pkgs)
+{
+    assert(ring);
+
+    uint64_t pos = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    size_t pkg_cnt = 0;
+    while (pkg_cnt < max_pkgs && pos != head) {
+        size_t idx = pos & ring->mask;
+        uint16_t data_size_words = ring->buf[idx];
+        if (data_size_words == PACKET_RING_PAD) {
+            pos += ring->capacity_words - idx;
+            continue;
+        }
+
+        pkgs[pkg_cnt].data_size_words = data_size_words;
+        pkgs[pkg_cnt].data_raw = &ring->buf[idx + 1];
+        pkg_cnt++;
+        pos += 1 + data_size_words;
+    }
+
+    ring->peek_pos = pos;
+    return pkg_cnt;
+}
+
+void packet_ring_release(struct packet_ring *ring)
+{
+    assert(ring);
+
+    __atomic_store_n(&ring->tail, ring->peek_pos, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&ring->producer_waiting, false,
+                            __ATOMIC_SEQ_CST)) {
+        signal_fd(ring->space_fd);
+    }
+}
+
+void packet_ring_discard(struct packet_ring *ring)
+{
+    assert(ring);
+
+    ring->peek_pos = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    packet_ring_release(ring);
+}
+
+bool packet_ring_consumer_sleep(struct packet_ring *ring)
+{
+    assert(ring);
+
+    clear_fd(ring->data_fd);
+    __atomic_store_n(&ring->consumer_waiting, true, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != ring->tail) {
+        // keep the file descriptor readable until the consumer sleeps
+        __atomic_store_n(&ring->consumer_waiting, false, __ATOMIC_SEQ_CST);
+        signal_fd(ring->data_fd);
+        return false;
+    }
+    return true;
+}
+
+void packet_ring_get_stats(const struct packet_ring *ring,
+                           struct packet_ring_stats *stats)
+{
+    assert(ring);
+    assert(stats);
+
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+
+    stats->capacity_bytes = ring->capacity_words * sizeof(uint16_t);
+    stats->fill_bytes = (head - tail) * sizeof(uint16_t);
+    stats->fill_max_bytes =
+        __atomic_load_n(&ring->fill_max_words, __ATOMIC_RELAXED) *
+        sizeof(uint16_t);
+    stats->producer_stalls =
+        __atomic_load_n(&ring->producer_stalls, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,148 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bounded lock-free queue of packets between exactly two threads
+ *
+ * One thread (the producer) adds packets to the ring, another thread (the
+ * consumer) takes them out again. Packets are copied into the ring, no memory
+ * is allocated after the ring has been created.
+ *
+ * The consumer is notified of new packets through a file descriptor (an
+ * eventfd), which can be added to a poll loop (e.g. with zloop_poller()).
+ * The consumer must follow this protocol:
+ * 1. Wait until the file descriptor returned by packet_ring_get_fd() becomes
+ *    readable.
+ * 2. Call packet_ring_peek() to get the available packets, process them and
+ *    call packet_ring_release().
+ * 3. Repeat step 2 until no more packets are available and
+ *    packet_ring_consumer_sleep() returns true, then continue with step 1.
+ *    The consumer may also continue with step 1 at any time without calling
+ *    packet_ring_consumer_sleep(); the file descriptor then stays readable.
+ *
+ * If the ring is full the producer blocks in packet_ring_push() until the
+ * consumer releases enough space.
+ */
+
+/**
+ * Default capacity of a ring in uint16_t words
+ */
+#define PACKET_RING_CAPACITY_DEFAULT_WORDS (512 * 1024)
+
+struct packet_ring;
+
+/**
+ * Statistics of a packet ring
+ */
+struct packet_ring_stats {
+    //! capacity of the ring in bytes
+    size_t capacity_bytes;
+    //! number of bytes currently used
+    size_t fill_bytes;
+    //! maximum number of bytes used at the same time
+    size_t fill_max_bytes;
+    //! number of times the producer had to wait for free space
+    uint64_t producer_stalls;
+};
+
+/**
+ * Create a new packet ring
+ *
+ * @param[out] ring_p the created ring
+ * @param capacity_words capacity of the ring in uint16_t words. Must be a power
+ *                       of two, and large enough to hold two packets of the
+ *                       maximum size.
+ */
+void packet_ring_new(struct packet_ring **ring_p, size_t capacity_words);
+
+/**
+ * Free a packet ring
+ */
+void packet_ring_free(struct packet_ring **ring_p);
+
+/**
+ * Add a packet to the ring (producer)
+ *
+ * Blocks until enough space is available in the ring.
+ */
+void packet_ring_push(struct packet_ring *ring,
+                      const struct osd_packet_view *pkg);
+
+/**
+ * Add a packet to the ring if enough space is available (producer)
+ *
+ * @return true if the packet was added, false if the ring is full
+ */
+bool packet_ring_try_push(struct packet_ring *ring,
+                          const struct osd_packet_view *pkg);
+
+/**
+ * Get the file descriptor signaling new packets to the consumer
+ */
+int packet_ring_get_fd(const struct packet_ring *ring);
+
+/**
+ * Get packets from the ring without removing them (consumer)
+ *
+ * @param ring the ring
+ * @param[out] pkgs views on the packets in the ring. They are valid until
+ *                  packet_ring_release() is called.
+ * @param max_pkgs maximum number of packets to return
+ * @return number of packets written to @p pkgs
+ */
+size_t packet_ring_peek(struct packet_ring *ring, struct osd_packet_view *pkgs,
+                        size_t max_pkgs);
+
+/**
+ * Remove all packets returned by packet_ring_peek() from the ring (consumer)
+ */
+void packet_ring_release(struct packet_ring *ring);
+
+/**
+ * Remove all packets from the ring (consumer)
+ *
+ * Packets pushed concurrently by the producer may or may not be removed.
+ */
+void packet_ring_discard(struct packet_ring *ring);
+
+/**
+ * Prepare to wait for a notification (consumer)
+ *
+ * Acknowledges all notifications received through the file descriptor.
+ *
+ * @return true if the ring is empty and the consumer can wait for the next
+ *         notification, false if packets are available
+ */
+bool packet_ring_consumer_sleep(struct packet_ring *ring);
+
+/**
+ * Get statistics about the ring
+ *
+ * This function can be called from any thread.
+ */
+void packet_ring_get_stats(const struct packet_ring *ring,
+                           struct packet_ring_stats *stats);
+
+#endif  // PACKET_RING_H
@@ -0,0 +1,1023 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+#include <osd/packetcap.h>
+#include "osd-private.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PCAP_FILE_MAGIC "OSDPCAP"
+#define PCAP_IDX_MAGIC "OSDPIDX"
+
+/**
+ * Marker to detect captures written on hosts with a different byte order
+ */
+#define PCAP_BYTE_ORDER_MAGIC 0x0a0b0c0d
+
+/**
+ * Records are aligned to this number of bytes in the capture file
+ */
+#define PCAP_REC_ALIGN 8
+
+/**
+ * Size of the write buffer in bytes
+ */
+#define PCAP_WRITE_BUF_SIZE (1024 * 1024)
+
+/**
+ * Number of possible DI addresses
+ */
+#define PCAP_DIADDR_CNT (UINT16_MAX + 1)
+
+/**
+ * Header of capture files and index files
+ */
+struct pcap_file_hdr {
+    char magic[8];
+    uint32_t byte_order;
+    uint16_t version;
+    uint16_t hdr_size;
+    uint64_t reserved;
+};
+
+/**
+ * Header of each record in the capture file
+ *
+ * The record header is directly followed by the packet data words. The
+ * record is padded to PCAP_REC_ALIGN bytes.
+ */
+struct pcap_rec_hdr {
+    uint64_t timestamp_ns;
+    uint32_t reserved;
+    uint8_t dir;
+    uint8_t reserved2;
+    uint16_t data_size_words;
+};
+
+/**
+ * Index file header, following the struct pcap_file_hdr
+ *
+ * The header is followed by idx_block_cnt entries of struct pcap_idx_block,
+ * and src_cnt source entries. Each source entry consists of a struct
+ * pcap_idx_src, followed by block_cnt block numbers (uint32_t).
+ */
+struct pcap_idx_hdr {
+    uint64_t capture_size;
+    uint32_t interval;
+    uint32_t block_cnt;
+    uint32_t src_cnt;
+    uint32_t reserved;
+};
+
+/**
+ * An index block: a range of @p interval records in the capture
+ */
+struct pcap_idx_block {
+    uint64_t offset;
+    uint64_t first_timestamp_ns;
+};
+
+struct pcap_idx_src {
+    uint16_t diaddr;
+    uint16_t reserved;
+    uint32_t block_cnt;
+};
+
+/**
+ * Blocks containing packets from a given source
+ */
+struct pcap_src_blocks {
+    uint16_t diaddr;
+    uint32_t *blocks;
+    size_t block_cnt;
+    size_t block_alloc;
+};
+
+/**
+ * In-memory representation of the capture index
+ */
+struct pcap_index {
+    unsigned int interval;
+
+    struct pcap_idx_block *blocks;
+    size_t block_cnt;
+    size_t block_alloc;
+
+    /** Entries for all sources found in the capture */
+    struct pcap_src_blocks *srcs;
+    size_t src_cnt;
+    size_t src_alloc;
+
+    /** Map from a DI address to its index in srcs (plus one), 0 if unused */
+    uint32_t *src_map;
+};
+
+struct osd_packetcap_writer {
+    struct osd_log_ctx *log_ctx;
+    char *idx_path;
+    int fd;
+
+    uint8_t *buf;
+    size_t buf_used;
+
+    /** Capture file offset of the next record */
+    uint64_t offset;
+
+    /** Number of records in the capture */
+    uint64_t rec_cnt;
+
+    struct pcap_index idx;
+};
+
+struct osd_packetcap_reader {
+    struct osd_log_ctx *log_ctx;
+    char *idx_path;
+
+    const uint8_t *data;
+    size_t size;
+
+    /** Offset of the next record to be read */
+    uint64_t pos;
+
+    /** Index block containing pos (only valid if the index is loaded) */
+    size_t cur_block;
+
+    struct pcap_index idx;
+    bool idx_loaded;
+
+    /** Source filter, or OSD_PACKETCAP_SRC_ANY */
+    int src_filter;
+};
+
+static size_t pcap_rec_size(uint16_t data_size_words)
+{
+    size_t size = sizeof(struct pcap_rec_hdr) +
+                  data_size_words * sizeof(uint16_t);
+    return (size + PCAP_REC_ALIGN - 1) & ~(size_t)(PCAP_REC_ALIGN - 1);
+}
+
+static void pcap_file_hdr_init(struct pcap_file_hdr *hdr, const char *magic,
+                               size_t hdr_size)
+{
+    memset(hdr, 0, sizeof(struct pcap_file_hdr));
+    strncpy(hdr->magic, magic, sizeof(hdr->magic));
+    hdr->byte_order = PCAP_BYTE_ORDER_MAGIC;
+    hdr->version = OSD_PACKETCAP_VERSION;
+    hdr->hdr_size = hdr_size;
+}
+
+static osd_result pcap_file_hdr_check(struct osd_log_ctx *log_ctx,
+                                      const struct pcap_file_hdr *hdr,
+                                      const char *magic)
+{
+    if (memcmp(hdr->magic, magic, strlen(magic) + 1)) {
+        err(log_ctx, "Not a packet capture file.");
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+    if (hdr->byte_order != PCAP_BYTE_ORDER_MAGIC) {
+        err(log_ctx, "Packet capture was written on a host with different "
+            "byte order, which is not supported.");
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+    if (hdr->version != OSD_PACKETCAP_VERSION) {
+        err(log_ctx, "Unsupported packet capture format version %u.",
+            hdr->version);
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+    return OSD_OK;
+}
+
+static void pcap_index_init(struct pcap_index *idx, unsigned int interval)
+{
+    memset(idx, 0, sizeof(struct pcap_index));
+    idx->interval = interval;
+    idx->src_map = calloc(PCAP_DIADDR_CNT, sizeof(uint32_t));
+    assert(idx->src_map);
+}
+
+static void pcap_index_clear(struct pcap_index *idx)
+{
+    for (size_t i = 0; i < idx->src_cnt; i++) {
+        free(idx->srcs[i].blocks);
+    }
+    free(idx->srcs);
+    free(idx->blocks);
+    free(idx->src_map);
+    memset(idx, 0, sizeof(struct pcap_index));
+}
+
+static void pcap_index_add_block(struct pcap_index *idx, uint64_t offset,
+                                 uint64_t first_timestamp_ns)
+{
+    if (idx->block_cnt == idx->block_alloc) {
+        idx->block_alloc = idx->block_alloc ? idx->block_alloc * 2 : 64;
+        idx->blocks = realloc(idx->blocks,
+                              idx->block_alloc * sizeof(struct pcap_idx_block));
+        assert(idx->blocks);
+    }
+    idx->blocks[idx->block_cnt].offset = offset;
+    idx->blocks[idx->block_cnt].first_timestamp_ns = first_timestamp_ns;
+    idx->block_cnt++;
+}
+
+static struct pcap_src_blocks *pcap_index_get_src(struct pcap_index *idx,
+                                                  uint16_t diaddr, bool create)
+{
+    uint32_t src_idx = idx->src_map[diaddr];
+    if (src_idx) {
+        return &idx->srcs[src_idx - 1];
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (idx->src_cnt == idx->src_alloc) {
+        idx->src_alloc = idx->src_alloc ? idx->src_alloc * 2 : 16;
+        idx->srcs = realloc(idx->srcs,
+                            idx->src_alloc * sizeof(struct pcap_src_blocks));
+        assert(idx->srcs);
+    }
+    struct pcap_src_blocks *src = &idx->srcs[idx->src_cnt];
+    memset(src, 0, sizeof(struct pcap_src_blocks));
+    src->diaddr = diaddr;
+    idx->src_cnt++;
+    idx->src_map[diaddr] = idx->src_cnt;
+    return src;
+}
+
+static void pcap_src_add_block(struct pcap_src_blocks *src, uint32_t block)
+{
+    if (src->block_cnt && src->blocks[src->block_cnt - 1] == block) {
+        return;
+    }
+    if (src->block_cnt == src->block_alloc) {
+        src->block_alloc = src->block_alloc ? src->block_alloc * 2 : 16;
+        src->blocks = realloc(src->blocks, src->block_alloc * sizeof(uint32_t));
+        assert(src->blocks);
+    }
+    src->blocks[src->block_cnt++] = block;
+}
+
+/**
+ * Add a record to the index
+ *
+ * @param idx the index
+ * @param rec_num the number of the record in the capture (starting at 0)
+ * @param offset the offset of the record in the capture file
+ * @param timestamp_ns the timestamp of the record
+ * @param src_diaddr the source DI address of the packet in the record
+ */
+static void pcap_index_add_record(struct pcap_index *idx, uint64_t rec_num,
+                                  uint64_t offset, uint64_t timestamp_ns,
+                                  uint16_t src_diaddr)
+{
+    if (rec_num % idx->interval == 0) {
+        pcap_index_add_block(idx, offset, timestamp_ns);
+    }
+    struct pcap_src_blocks *src = pcap_index_get_src(idx, src_diaddr, true);
+    pcap_src_add_block(src, idx->block_cnt - 1);
+}
+
+static uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    int rv = clock_gettime(CLOCK_REALTIME, &ts);
+    assert(rv == 0);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Write a buffer to a file descriptor, retrying on short writes
+ */
+static osd_result write_all(int fd, const void *buf, size_t size)
+{
+    const uint8_t *p = buf;
+    while (size) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return OSD_ERROR_FILE;
+        }
+        p += written;
+        size -= written;
+    }
+    return OSD_OK;
+}
+
+static osd_result pcap_index_write(struct osd_log_ctx *log_ctx,
+                                   const struct pcap_index *idx,
+                                   const char *path, uint64_t capture_size)
+{
+    osd_result retval;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        err(log_ctx, "Unable to open index file %s: %s", path,
+            strerror(errno));
+        return OSD_ERROR_FILE;
+    }
+
+    struct pcap_file_hdr file_hdr;
+    pcap_file_hdr_init(&file_hdr, PCAP_IDX_MAGIC,
+                       sizeof(struct pcap_file_hdr) +
+                           sizeof(struct pcap_idx_hdr));
+    struct pcap_idx_hdr idx_hdr = {
+        .capture_size = capture_size,
+        .interval = idx->interval,
+        .block_cnt = idx->block_cnt,
+        .src_cnt = idx->src_cnt,
+    };
+
+    if (fwrite(&file_hdr, sizeof(file_hdr), 1, fp) != 1 ||
+        fwrite(&idx_hdr, sizeof(idx_hdr), 1, fp) != 1) {
+        goto err_write;
+    }
+    if (idx->block_cnt &&
+        fwrite(idx->blocks, sizeof(struct pcap_idx_block), idx->block_cnt,
+               fp) != idx->block_cnt) {
+        goto err_write;
+    }
+    for (size_t i = 0; i < idx->src_cnt; i++) {
+        struct pcap_idx_src src_hdr = {
+            .diaddr = idx->srcs[i].diaddr,
+            .block_cnt = idx->srcs[i].block_cnt,
+        };
+        if (fwrite(&src_hdr, sizeof(src_hdr), 1, fp) != 1 ||
+            fwrite(idx->srcs[i].blocks, sizeof(uint32_t),
+                   idx->srcs[i].block_cnt, fp) != idx->srcs[i].block_cnt) {
+            goto err_write;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        err(log_ctx, "Unable to write index file %s", path);
+        return OSD_ERROR_FILE;
+    }
+    return OSD_OK;
+
+err_write:
+    err(log_ctx, "Unable to write index file %s", path);
+    retval = OSD_ERROR_FILE;
+    fclose(fp);
+    return retval;
+}
+
+/**
+ * Read an index file
+ *
+ * @return OSD_OK if the index was read and matches a capture of size
+ *         @p capture_size, an error otherwise (@p idx is unchanged then).
+ */
+static osd_result pcap_index_read(struct osd_log_ctx *log_ctx,
+                                  struct pcap_index *idx, const char *path,
+                                  uint64_t capture_size)
+{
+    osd_result rv;
+    osd_result retval;
+    struct pcap_index new_idx;
+    bool new_idx_init = false;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return OSD_ERROR_FILE;
+    }
+
+    struct pcap_file_hdr file_hdr;
+    struct pcap_idx_hdr idx_hdr;
+    if (fread(&file_hdr, sizeof(file_hdr), 1, fp) != 1 ||
+        fread(&idx_hdr, sizeof(idx_hdr), 1, fp) != 1) {
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_free_return;
+    }
+    rv = pcap_file_hdr_check(log_ctx, &file_hdr, PCAP_IDX_MAGIC);
+    if (OSD_FAILED(rv)) {
+        retval = rv;
+        goto err_free_return;
+    }
+    if (idx_hdr.capture_size != capture_size || idx_hdr.interval == 0) {
+        info(log_ctx, "Index file %s is outdated.", path);
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_free_return;
+    }
+
+    // the counts are untrusted: check them against the size of the index file
+    // and of the capture before allocating memory for them
+    struct stat st;
+    long int pos = ftell(fp);
+    if (fstat(fileno(fp), &st) != 0 || pos < 0 || st.st_size < pos) {
+        retval = OSD_ERROR_FILE;
+        goto err_free_return;
+    }
+    uint64_t remaining = st.st_size - pos;
+    uint64_t block_cnt_max =
+        (capture_size + PCAP_REC_ALIGN - 1) / PCAP_REC_ALIGN;
+    if (idx_hdr.block_cnt > block_cnt_max ||
+        idx_hdr.block_cnt > remaining / sizeof(struct pcap_idx_block)) {
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_free_return;
+    }
+    remaining -= (uint64_t)idx_hdr.block_cnt * sizeof(struct pcap_idx_block);
+
+    pcap_index_init(&new_idx, idx_hdr.interval);
+    new_idx_init = true;
+
+    new_idx.blocks = calloc(idx_hdr.block_cnt ? idx_hdr.block_cnt : 1,
+                            sizeof(struct pcap_idx_block));
+    assert(new_idx.blocks);
+    new_idx.block_alloc = idx_hdr.block_cnt;
+    if (fread(new_idx.blocks, sizeof(struct pcap_idx_block),
+              idx_hdr.block_cnt, fp) != idx_hdr.block_cnt) {
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_free_return;
+    }
+    new_idx.block_cnt = idx_hdr.block_cnt;
+
+    for (uint32_t i = 0; i < idx_hdr.src_cnt; i++) {
+        struct pcap_idx_src src_hdr;
+        if (fread(&src_hdr, sizeof(src_hdr), 1, fp) != 1 ||
+            pcap_index_get_src(&new_idx, src_hdr.diaddr, false)) {
+            retval = OSD_ERROR_DEVICE_INVALID_DATA;
+            goto err_free_return;
+        }
+        if (remaining < sizeof(src_hdr)) {
+            retval = OSD_ERROR_DEVICE_INVALID_DATA;
+            goto err_free_return;
+        }
+        remaining -= sizeof(src_hdr);
+        if (src_hdr.block_cnt > new_idx.block_cnt ||
+            src_hdr.block_cnt > remaining / sizeof(uint32_t)) {
+            retval = OSD_ERROR_DEVICE_INVALID_DATA;
+            goto err_free_return;
+        }
+        remaining -= (uint64_t)src_hdr.block_cnt * sizeof(uint32_t);
+        struct pcap_src_blocks *src =
+            pcap_index_get_src(&new_idx, src_hdr.diaddr, true);
+        src->blocks = calloc(src_hdr.block_cnt ? src_hdr.block_cnt : 1,
+                             sizeof(uint32_t));
+        assert(src->blocks);
+        src->block_alloc = src_hdr.block_cnt;
+        if (fread(src->blocks, sizeof(uint32_t), src_hdr.block_cnt, fp) !=
+            src_hdr.block_cnt) {
+            retval = OSD_ERROR_DEVICE_INVALID_DATA;
+            goto err_free_return;
+        }
+        src->block_cnt = src_hdr.block_cnt;
+        // the block numbers are searched with a binary search
+        for (size_t b = 0; b < src->block_cnt; b++) {
+            if (src->blocks[b] >= new_idx.block_cnt ||
+                (b > 0 && src->blocks[b] <= src->blocks[b - 1])) {
+                retval = OSD_ERROR_DEVICE_INVALID_DATA;
+                goto err_free_return;
+            }
+        }
+    }
+    // the offsets and timestamps are searched with a binary search
+    for (size_t b = 0; b < new_idx.block_cnt; b++) {
+        const struct pcap_idx_block *block = &new_idx.blocks[b];
+        const struct pcap_idx_block *prev = b > 0 ? block - 1 : NULL;
+        if (block->offset >= capture_size || block->offset % PCAP_REC_ALIGN ||
+            (prev && (block->offset <= prev->offset ||
+                      block->first_timestamp_ns < prev->first_timestamp_ns))) {
+            retval = OSD_ERROR_DEVICE_INVALID_DATA;
+            goto err_free_return;
+        }
+    }
+
+    fclose(fp);
+    *idx = new_idx;
+    return OSD_OK;
+
+err_free_return:
+    if (new_idx_init) {
+        pcap_index_clear(&new_idx);
+    }
+    fclose(fp);
+    return retval;
+}
+
+static char *pcap_idx_path(const char *path)
+{
+    size_t len = strlen(path) + strlen(".idx") + 1;
+    char *idx_path = malloc(len);
+    assert(idx_path);
+    snprintf(idx_path, len, "%s.idx", path);
+    return idx_path;
+}
+
+API_EXPORT
+osd_result osd_packetcap_writer_new(struct osd_packetcap_writer **writer_p,
+                                    struct osd_log_ctx *log_ctx,
+                                    const char *path,
+                                    unsigned int index_interval)
+{
+    osd_result rv;
+
+    assert(index_interval > 0);
+
+    struct osd_packetcap_writer *writer =
+        calloc(1, sizeof(struct osd_packetcap_writer));
+    assert(writer);
+
+    writer->log_ctx = log_ctx;
+
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd == -1) {
+        err(log_ctx, "Unable to open capture file %s: %s", path,
+            strerror(errno));
+        free(writer);
+        return OSD_ERROR_FILE;
+    }
+
+    // remove a stale index file; it is re-written when closing the capture
+    writer->idx_path = pcap_idx_path(path);
+    unlink(writer->idx_path);
+
+    writer->buf = malloc(PCAP_WRITE_BUF_SIZE);
+    assert(writer->buf);
+
+    pcap_index_init(&writer->idx, index_interval);
+
+    struct pcap_file_hdr hdr;
+    pcap_file_hdr_init(&hdr, PCAP_FILE_MAGIC, sizeof(struct pcap_file_hdr));
+    memcpy(writer->buf, &hdr, sizeof(hdr));
+    writer->buf_used = sizeof(hdr);
+    writer->offset = sizeof(hdr);
+
+    rv = osd_packetcap_writer_flush(writer);
+    if (OSD_FAILED(rv)) {
+        osd_packetcap_writer_close(&writer);
+        return rv;
+    }
+
+    *writer_p = writer;
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_packetcap_write(struct osd_packetcap_writer *writer,
+                               const struct osd_packet *pkg,
+                               enum osd_packetcap_dir dir,
+                               uint64_t timestamp_ns)
+{
+    osd_result rv;
+
+    assert(writer);
+    assert(pkg);
+
+    if (timestamp_ns == OSD_PACKETCAP_TIMESTAMP_NOW) {
+        timestamp_ns = time_now_ns();
+    }
+
+    size_t rec_size = pcap_rec_size(pkg->data_size_words);
+    assert(rec_size <= PCAP_WRITE_BUF_SIZE);
+    if (writer->buf_used + rec_size > PCAP_WRITE_BUF_SIZE) {
+        rv = osd_packetcap_writer_flush(writer);
+        if (OSD_FAILED(rv)) {
+            return rv;
+        }
+    }
+
+    uint8_t *rec = writer->buf + writer->buf_used;
+    struct pcap_rec_hdr hdr = {
+        .timestamp_ns = timestamp_ns,
+        .dir = dir,
+        .data_size_words = pkg->data_size_words,
+    };
+    memcpy(rec, &hdr, sizeof(hdr));
+    memcpy(rec + sizeof(hdr), pkg->data_raw, osd_packet_sizeof(pkg));
+    size_t used_size = sizeof(hdr) + osd_packet_sizeof(pkg);
+    memset(rec + used_size, 0, rec_size - used_size);
+    writer->buf_used += rec_size;
+
+    pcap_index_add_record(&writer->idx, writer->rec_cnt, writer->offset,
+                          timestamp_ns, osd_packet_get_src(pkg));
+    writer->rec_cnt++;
+    writer->offset += rec_size;
+
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_packetcap_writer_flush(struct osd_packetcap_writer *writer)
+{
+    osd_result rv;
+
+    assert(writer);
+
+    if (writer->buf_used == 0) {
+        return OSD_OK;
+    }
+
+    rv = write_all(writer->fd, writer->buf, writer->buf_used);
+    if (OSD_FAILED(rv)) {
+        err(writer->log_ctx, "Unable to write to capture file: %s",
+            strerror(errno));
+        return rv;
+    }
+    writer->buf_used = 0;
+
+    return OSD_OK;
+}
+
+API_EXPORT
+osd_result osd_packetcap_writer_close(struct osd_packetcap_writer **writer_p)
+{
+    osd_result rv;
+    osd_result retval = OSD_OK;
+
+    assert(writer_p);
+    struct osd_packetcap_writer *writer = *writer_p;
+    if (!writer) {
+        return OSD_OK;
+    }
+
+    rv = osd_packetcap_writer_flush(writer);
+    if (OSD_FAILED(rv)) {
+        retval = rv;
+    }
+
+    if (close(writer->fd) != 0) {
+        err(writer->log_ctx, "Unable to close capture file: %s",
+            strerror(errno));
+        retval = OSD_ERROR_FILE;
+    }
+
+    // only write an index which matches the capture
+    if (OSD_SUCCEEDED(retval)) {
+        retval = pcap_index_write(writer->log_ctx, &writer->idx,
+                                  writer->idx_path, writer->offset);
+    }
+
+    pcap_index_clear(&writer->idx);
+    free(writer->idx_path);
+    free(writer->buf);
+    free(writer);
+    *writer_p = NULL;
+
+    return retval;
+}
+
+API_EXPORT
+osd_result osd_packetcap_reader_new(struct osd_packetcap_reader **reader_p,
+                                    struct osd_log_ctx *log_ctx,
+                                    const char *path)
+{
+    osd_result rv;
+    osd_result retval;
+
+    struct osd_packetcap_reader *reader =
+        calloc(1, sizeof(struct osd_packetcap_reader));
+    assert(reader);
+
+    reader->log_ctx = log_ctx;
+    reader->src_filter = OSD_PACKETCAP_SRC_ANY;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        err(log_ctx, "Unable to open capture file %s: %s", path,
+            strerror(errno));
+        retval = OSD_ERROR_FILE;
+        goto err_free_reader;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        err(log_ctx, "Unable to stat capture file %s: %s", path,
+            strerror(errno));
+        retval = OSD_ERROR_FILE;
+        goto err_close_fd;
+    }
+    if ((size_t)st.st_size < sizeof(struct pcap_file_hdr)) {
+        err(log_ctx, "Capture file %s is too small.", path);
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_close_fd;
+    }
+    reader->size = st.st_size;
+
+    void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        err(log_ctx, "Unable to map capture file %s: %s", path,
+            strerror(errno));
+        retval = OSD_ERROR_FILE;
+        goto err_close_fd;
+    }
+    reader->data = data;
+
+    // the mapping stays valid after closing the file
+    close(fd);
+
+    // records are read sequentially
+    madvise(data, reader->size, MADV_SEQUENTIAL);
+
+    const struct pcap_file_hdr *hdr = (const struct pcap_file_hdr *)data;
+    rv = pcap_file_hdr_check(log_ctx, hdr, PCAP_FILE_MAGIC);
+    if (OSD_FAILED(rv)) {
+        retval = rv;
+        goto err_unmap;
+    }
+    if (hdr->hdr_size < sizeof(struct pcap_file_hdr) ||
+        hdr->hdr_size > reader->size || hdr->hdr_size % PCAP_REC_ALIGN) {
+        err(log_ctx, "Invalid header in capture file %s.", path);
+        retval = OSD_ERROR_DEVICE_INVALID_DATA;
+        goto err_unmap;
+    }
+
+    reader->pos = hdr->hdr_size;
+    reader->idx_path = pcap_idx_path(path);
+
+    *reader_p = reader;
+    return OSD_OK;
+
+err_unmap:
+    munmap((void *)reader->data, reader->size);
+    free(reader);
+    return retval;
+
+err_close_fd:
+    close(fd);
+err_free_reader:
+    free(reader);
+    return retval;
+}
+
+API_EXPORT
+void osd_packetcap_reader_free(struct osd_packetcap_reader **reader_p)
+{
+    assert(reader_p);
+    struct osd_packetcap_reader *reader = *reader_p;
+    if (!reader) {
+        return;
+    }
+
+    munmap((void *)reader->data, reader->size);
+    if (reader->idx_loaded) {
+        pcap_index_clear(&reader->idx);
+    }
+    free(reader->idx_path);
+    free(reader);
+    *reader_p = NULL;
+}
+
+/**
+ * Parse the record at a given offset
+ *
+ * @return OSD_OK on success, OSD_ERROR_EOF if @p offset is at the end of the
+ *         capture, OSD_ERROR_DEVICE_INVALID_DATA if the record is malformed
+ */
+static osd_result reader_parse_record(const struct osd_packetcap_reader *reader,
+                                      uint64_t offset,
+                                      struct osd_packetcap_record *rec,
+                                      size_t *rec_size)
+{
+    if (offset == reader->size) {
+        return OSD_ERROR_EOF;
+    }
+    if (reader->size - offset < sizeof(struct pcap_rec_hdr)) {
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+
+    // records are aligned, the header can be accessed in place
+    const struct pcap_rec_hdr *hdr =
+        (const struct pcap_rec_hdr *)(reader->data + offset);
+    size_t size = pcap_rec_size(hdr->data_size_words);
+    if (reader->size - offset < size ||
+        hdr->data_size_words < osd_packet_sizeconv_payload2data(0)) {
+        return OSD_ERROR_DEVICE_INVALID_DATA;
+    }
+
+    rec->timestamp_ns = hdr->timestamp_ns;
+    rec->dir = hdr->dir;
+    rec->pkg.data_size_words = hdr->data_size_words;
+    rec->pkg.data_raw = (const uint16_t *)(hdr + 1);
+    rec->offset = offset;
+    *rec_size = size;
+
+    return OSD_OK;
+}
+
+/**
+ * Load the index of the capture, or create it if no valid index file exists
+ */
+static void reader_load_index(struct osd_packetcap_reader *reader)
+{
+    osd_result rv;
+
+    if (reader->idx_loaded) {
+        return;
+    }
+
+    rv = pcap_index_read(reader->log_ctx, &reader->idx, reader->idx_path,
+                         reader->size);
+    if (OSD_SUCCEEDED(rv)) {
+        reader->idx_loaded = true;
+        return;
+    }
+
+    dbg(reader->log_ctx, "No valid index file found, creating index.");
+
+    pcap_index_init(&reader->idx, OSD_PACKETCAP_INDEX_INTERVAL_DEFAULT);
+    uint64_t offset = ((const struct pcap_file_hdr *)reader->data)->hdr_size;
+    uint64_t rec_num = 0;
+    struct osd_packetcap_record rec;
+    size_t rec_size;
+    while (OSD_SUCCEEDED(reader_parse_record(reader, offset, &rec,
+                                             &rec_size))) {
+        pcap_index_add_record(&reader->idx, rec_num, offset, rec.timestamp_ns,
+                              osd_packet_view_get_src(&rec.pkg));
+        offset += rec_size;
+        rec_num++;
+    }
+    reader->idx_loaded = true;
+}
+
+/**
+ * Find the index block containing a capture file offset
+ */
+static size_t reader_find_block(const struct osd_packetcap_reader *reader,
+                                uint64_t offset)
+{
+    const struct pcap_index *idx = &reader->idx;
+
+    // find the last block starting at or before offset
+    size_t lo = 0;
+    size_t hi = idx->block_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->blocks[mid].offset <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo ? lo - 1 : 0;
+}
+
+/**
+ * Skip over blocks not containing packets from the filtered source
+ *
+ * @return true if the reader is positioned within a block containing packets
+ *         from the source, false if no further packets from the source exist
+ */
+static bool reader_skip_filtered_blocks(struct osd_packetcap_reader *reader)
+{
+    const struct pcap_index *idx = &reader->idx;
+
+    // advance cur_block if pos has moved into the next block
+    while (reader->cur_block + 1 < idx->block_cnt &&
+           idx->blocks[reader->cur_block + 1].offset <= reader->pos) {
+        reader->cur_block++;
+    }
+
+    const struct pcap_src_blocks *src =
+        pcap_index_get_src((struct pcap_index *)idx, reader->src_filter, false);
+    if (!src) {
+        return false;
+    }
+
+    // find the first block at or after cur_block containing the source
+    size_t lo = 0;
+    size_t hi = src->block_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (src->blocks[mid] < reader->cur_block) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == src->block_cnt) {
+        return false;
+    }
+
+    if (src->blocks[lo] != reader->cur_block) {
+        reader->cur_block = src->blocks[lo];
+        reader->pos = idx->blocks[reader->cur_block].offset;
+    }
+    return true;
+}
+
+API_EXPORT
+osd_result osd_packetcap_reader_next(struct osd_packetcap_reader *reader,
+                                     struct osd_packetcap_record *rec)
+{
+    osd_result rv;
+
+    assert(reader);
+    assert(rec);
+
+    while (1) {
+        if (reader->src_filter != OSD_PACKETCAP_SRC_ANY) {
+            if (!reader_skip_filtered_blocks(reader)) {
+                reader->pos = reader->size;
+                return OSD_ERROR_EOF;
+            }
+        }
+
+        size_t rec_size;
+        rv = reader_parse_record(reader, reader->pos, rec, &rec_size);
+        if (OSD_FAILED(rv)) {
+            if (rv == OSD_ERROR_DEVICE_INVALID_DATA) {
+                err(reader->log_ctx, "Malformed record at offset %" PRIu64
+                    " in capture file.", reader->pos);
+            }
+            return rv;
+        }
+        reader->pos += rec_size;
+
+        if (reader->src_filter == OSD_PACKETCAP_SRC_ANY ||
+            osd_packet_view_get_src(&rec->pkg) ==
+                (unsigned int)reader->src_filter) {
+            return OSD_OK;
+        }
+    }
+}
+
+API_EXPORT
+void osd_packetcap_reader_seek_time(struct osd_packetcap_reader *reader,
+                                    uint64_t timestamp_ns)
+{
+    assert(reader);
+
+    reader_load_index(reader);
+    const struct pcap_index *idx = &reader->idx;
+
+    if (idx->block_cnt == 0) {
+        reader->pos = reader->size;
+        return;
+    }
+
+    // find the last block starting before timestamp_ns: it may contain
+    // records at or after timestamp_ns
+    size_t lo = 0;
+    size_t hi = idx->block_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->blocks[mid].first_timestamp_ns < timestamp_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    reader->cur_block = lo ? lo - 1 : 0;
+
+    // scan the block for the first matching record
+    uint64_t offset = idx->blocks[reader->cur_block].offset;
+    struct osd_packetcap_record rec;
+    size_t rec_size;
+    while (OSD_SUCCEEDED(reader_parse_record(reader, offset, &rec,
+                                             &rec_size)) &&
+           rec.timestamp_ns < timestamp_ns) {
+        offset += rec_size;
+    }
+    reader->pos = offset;
+    reader->cur_block = reader_find_block(reader, offset);
+}
+
+API_EXPORT
+void osd_packetcap_reader_rewind(struct osd_packetcap_reader *reader)
+{
+    assert(reader);
+
+    reader->pos = ((const struct pcap_file_hdr *)reader->data)->hdr_size;
+    reader->cur_block = 0;
+}
+
+API_EXPORT
+void osd_packetcap_reader_set_src_filter(struct osd_packetcap_reader *reader,
+                                         int src_diaddr)
+{
+    assert(reader);
+    assert(src_diaddr == OSD_PACKETCAP_SRC_ANY ||
+           (src_diaddr >= 0 && src_diaddr <= UINT16_MAX));
+
+    reader->src_filter = src_diaddr;
+    if (src_diaddr != OSD_PACKETCAP_SRC_ANY) {
+        reader_load_index(reader);
+        reader->cur_block = reader_find_block(reader, reader->pos);
+    }
+}
@@ -0,0 +1,260 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "reg_cache.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Initial number of slots in the hash table (a power of two)
+ */
+#define REG_CACHE_INITIAL_SLOTS 64
+
+/**
+ * Maximum register size in 16 bit words
+ */
+#define REG_CACHE_MAX_REG_WORDS (128 / 16)
+
+struct reg_cache_entry {
+    bool used;
+    uint8_t reg_size_bit;
+    //! DI address in the upper 16 bit, register address in the lower 16 bit
+    uint32_t key;
+    uint16_t reg_val[REG_CACHE_MAX_REG_WORDS];
+};
+
+/**
+ * Register cache
+ *
+ * The registers are stored in a hash table with open addressing and linear
+ * probing. Entries are never removed individually, which keeps the probing
+ * simple: the table is only grown or cleared as a whole.
+ */
+struct reg_cache {
+    struct reg_cache_entry *slots;
+    size_t slot_cnt;
+    size_t entry_cnt;
+
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static uint32_t build_key(uint16_t diaddr, uint16_t reg_addr)
+{
+    return ((uint32_t)diaddr << 16) | reg_addr;
+}
+
+static size_t key_hash(uint32_t key)
+{
+    // multiplicative hashing (Knuth), spreads consecutive keys
+    return (size_t)(key * 2654435761u);
+}
+
+/**
+ * Find the slot of a key, or the free slot it would be stored in
+ */
+static struct reg_cache_entry *find_slot(struct reg_cache_entry *slots,
+                                         size_t slot_cnt, uint32_t key)
+{
+    size_t mask = slot_cnt - 1;
+    size_t i = key_hash(key) & mask;
+    while (slots[i].used && slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+static void grow(struct reg_cache *cache)
+{
+    size_t new_slot_cnt = cache->slot_cnt * 2;
+    struct reg_cache_entry *new_slots =
+        calloc(new_slot_cnt, sizeof(struct reg_cache_entry));
+    assert(new_slots);
+
+    for (size_t i = 0; i < cache->slot_cnt; i++) {
+        if (!cache->slots[i].used) {
+            continue;
+        }
+        *find_slot(new_slots, new_slot_cnt, cache->slots[i].key) =
+            cache->slots[i];
+    }
+
+    free(cache->slots);
+    cache->slots = new_slots;
+    cache->slot_cnt = new_slot_cnt;
+}
+
+void reg_cache_new(struct reg_cache **cache_p)
+{
+    struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
+    assert(cache);
+
+    cache->slot_cnt = REG_CACHE_INITIAL_SLOTS;
+    cache->slots = calloc(cache->slot_cnt, sizeof(struct reg_cache_entry));
+    assert(cache->slots);
+
+    *cache_p = cache;
+}
+
+void reg_cache_free(struct reg_cache **cache_p)
+{
+    assert(cache_p);
+    struct reg_cache *cache = *cache_p;
+    if (!cache) {
+        return;
+    }
+
+    free(cache->slots);
+    free(cache);
+    *cache_p = NULL;
+}
+
+bool reg_cache_lookup(struct reg_cache *cache, uint16_t diaddr,
+                      uint16_t reg_addr, int reg_size_bit, void *reg_val)
+{
+    assert(cache);
+    assert(reg_size_bit % 16 == 0 && reg_size_bit >= 16 &&
+           reg_size_bit <= 128);
+
+    struct reg_cache_entry *entry =
+        find_slot(cache->slots, cache->slot_cnt, build_key(diaddr, reg_addr));
+    if (!entry->used || entry->reg_size_bit != reg_size_bit) {
+        cache->misses++;
+        return false;
+    }
+
+    memcpy(reg_val, entry->reg_val, reg_size_bit / 8);
+    cache->hits++;
+    return true;
+}
+
+void reg_cache_store(struct reg_cache *cache, uint16_t diaddr,
+                     uint16_t reg_addr, int reg_size_bit, const void *reg_val)
+{
+    assert(cache);
+    assert(reg_size_bit % 16 == 0 && reg_size_bit >= 16 &&
+           reg_size_bit <= 128);
+
+    // keep the load factor below 1/2
+    if (2 * (cache->entry_cnt + 1) > cache->slot_cnt) {
+        grow(cache);
+    }
+
+    uint32_t key = build_key(diaddr, reg_addr);
+    struct reg_cache_entry *entry =
+        find_slot(cache->slots, cache->slot_cnt, key);
+    if (!entry->used) {
+        entry->used = true;
+        entry->key = key;
+        cache->entry_cnt++;
+    }
+    entry->reg_size_bit = reg_size_bit;
+    memcpy(entry->reg_val, reg_val, reg_size_bit / 8);
+}
+
+void reg_cache_merge(struct reg_cache *dest, const struct reg_cache *src)
+{
+    assert(dest);
+    assert(src);
+
+    for (size_t i = 0; i < src->slot_cnt; i++) {
+        const struct reg_cache_entry *entry = &src->slots[i];
+        if (!entry->used) {
+            continue;
+        }
+        reg_cache_store(dest, entry->key >> 16, entry->key & 0xffff,
+                        entry->reg_size_bit, entry->reg_val);
+    }
+}
+
+void reg_cache_invalidate(struct reg_cache *cache)
+{
+    assert(cache);
+
+    memset(cache->slots, 0, cache->slot_cnt * sizeof(struct reg_cache_entry));
+    cache->entry_cnt = 0;
+}
+
+osd_result reg_cache_write(const struct reg_cache *cache, FILE *f)
+{
+    assert(cache);
+    assert(f);
+
+    for (size_t i = 0; i < cache->slot_cnt; i++) {
+        const struct reg_cache_entry *entry = &cache->slots[i];
+        if (!entry->used) {
+            continue;
+        }
+
+        fprintf(f, "%x %x %x", entry->key >> 16, entry->key & 0xffff,
+                entry->reg_size_bit);
+        for (int w = 0; w < entry->reg_size_bit / 16; w++) {
+            fprintf(f, " %x", entry->reg_val[w]);
+        }
+        fprintf(f, "\n");
+    }
+
+    return ferror(f) ? OSD_ERROR_FILE : OSD_OK;
+}
+
+osd_result reg_cache_read(struct reg_cache *cache, FILE *f)
+{
+    assert(cache);
+    assert(f);
+
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int diaddr, reg_addr, reg_size_bit;
+        int pos;
+        if (sscanf(line, "%x %x %x%n", &diaddr, &reg_addr, &reg_size_bit,
+                   &pos) != 3) {
+            return OSD_ERROR_FILE;
+        }
+        if (diaddr > UINT16_MAX || reg_addr > UINT16_MAX ||
+            reg_size_bit % 16 != 0 || reg_size_bit < 16 ||
+            reg_size_bit > 128) {
+            return OSD_ERROR_FILE;
+        }
+
+        uint16_t reg_val[REG_CACHE_MAX_REG_WORDS];
+        for (unsigned int w = 0; w < reg_size_bit / 16; w++) {
+            unsigned int word;
+            int word_len;
+            if (sscanf(line + pos, "%x%n", &word, &word_len) != 1 ||
+                word > UINT16_MAX) {
+                return OSD_ERROR_FILE;
+            }
+            reg_val[w] = word;
+            pos += word_len;
+        }
+
+        reg_cache_store(cache, diaddr, reg_addr, reg_size_bit, reg_val);
+    }
+
+    return ferror(f) ? OSD_ERROR_FILE : OSD_OK;
+}
+
+void reg_cache_get_stats(const struct reg_cache *cache,
+                         struct reg_cache_stats *stats)
+{
+    assert(cache);
+    assert(stats);
+
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->entries = cache->entry_cnt;
+}
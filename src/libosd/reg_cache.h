@@ -0,0 +1,120 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REG_CACHE_H
+#define REG_CACHE_H
+
+#include <osd/osd.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Cache of register values, keyed by DI address and register address
+ *
+ * Only registers which don't change while the system is running (like the
+ * module type or the memory layout of a MAM module) may be stored in the
+ * cache. The cache is not thread-safe.
+ */
+
+struct reg_cache;
+
+/**
+ * Statistics of a register cache
+ */
+struct reg_cache_stats {
+    //! number of lookups which found the register in the cache
+    uint64_t hits;
+    //! number of lookups which didn't find the register in the cache
+    uint64_t misses;
+    //! number of registers in the cache
+    size_t entries;
+};
+
+/**
+ * Create a new, empty register cache
+ */
+void reg_cache_new(struct reg_cache **cache_p);
+
+/**
+ * Free a register cache
+ */
+void reg_cache_free(struct reg_cache **cache_p);
+
+/**
+ * Look up a register in the cache
+ *
+ * @param cache the cache
+ * @param diaddr DI address of the module
+ * @param reg_addr address of the register
+ * @param reg_size_bit size of the register in bit (16, 32, 64 or 128)
+ * @param[out] reg_val the cached register value, if found
+ * @return true if the register was found in the cache
+ */
+bool reg_cache_lookup(struct reg_cache *cache, uint16_t diaddr,
+                      uint16_t reg_addr, int reg_size_bit, void *reg_val);
+
+/**
+ * Store a register value in the cache
+ *
+ * An existing entry for the same register is replaced.
+ */
+void reg_cache_store(struct reg_cache *cache, uint16_t diaddr,
+                     uint16_t reg_addr, int reg_size_bit, const void *reg_val);
+
+/**
+ * Copy all registers from @p src into @p dest
+ *
+ * Existing entries in @p dest for the same registers are replaced.
+ */
+void reg_cache_merge(struct reg_cache *dest, const struct reg_cache *src);
+
+/**
+ * Remove all registers from the cache
+ *
+ * The statistics are not reset.
+ */
+void reg_cache_invalidate(struct reg_cache *cache);
+
+/**
+ * Write all registers in the cache to a file
+ *
+ * Each register is written as one line of hexadecimal numbers: the DI
+ * address, the register address, the register size in bit, and the register
+ * value as 16 bit words.
+ *
+ * @return OSD_OK on success, OSD_ERROR_FILE if writing failed
+ */
+osd_result reg_cache_write(const struct reg_cache *cache, FILE *f);
+
+/**
+ * Add registers written by reg_cache_write() to the cache
+ *
+ * The file is read until its end.
+ *
+ * @return OSD_OK on success, OSD_ERROR_FILE if the file is malformed. Some
+ *         registers might have been added to the cache in this case.
+ */
+osd_result reg_cache_read(struct reg_cache *cache, FILE *f);
+
+/**
+ * Get statistics about the cache
+ */
+void reg_cache_get_stats(const struct reg_cache *cache,
+                         struct reg_cache_stats *stats);
+
+#endif  // REG_CACHE_H
@@ -112,6 +112,16 @@ osd_result osd_systracelogger_new(struct osd_systracelogger_ctx **ctx,
                                   struct osd_log_ctx *log_ctx,
                                   const char *host_controller_address,
                                   uint16_t stm_di_addr)
+{
+    return osd_systracelogger_new_with_reactor(
+        ctx, log_ctx, host_controller_address, stm_di_addr, NULL);
+}
+
+API_EXPORT
+osd_result osd_systracelogger_new_with_reactor(
+    struct osd_systracelogger_ctx **ctx, struct osd_log_ctx *log_ctx,
+    const char *host_controller_address, uint16_t stm_di_addr,
+    struct osd_ioreactor_ctx *reactor)
 {
     osd_result rv;
 
@@ -128,10 +138,13 @@ osd_result osd_systracelogger_new(struct osd_systracelogger_ctx **ctx,
     c->stats.sysprint_events = 0;
 
     struct osd_hostmod_ctx *hostmod_ctx;
-    rv =
-        osd_hostmod_new(&hostmod_ctx, log_ctx, host_controller_address,
-                        osd_cl_stm_handle_event, (void *)&c->stm_event_handler);
+    rv = osd_hostmod_new_with_reactor(&hostmod_ctx, log_ctx,
+                                      host_controller_address,
+                                      osd_cl_stm_handle_event,
+                                      (void *)&c->stm_event_handler, reactor);
     assert(OSD_SUCCEEDED(rv));
+    // all traffic of the logger is exchanged with the subnet of the STM
+    osd_hostmod_set_target_subnet(hostmod_ctx, osd_diaddr_subnet(stm_di_addr));
     c->hostmod_ctx = hostmod_ctx;
 
     *ctx = c;
@@ -145,6 +158,13 @@ osd_result osd_systracelogger_connect(struct osd_systracelogger_ctx *ctx)
     return osd_hostmod_connect(ctx->hostmod_ctx);
 }
 
+API_EXPORT
+osd_result osd_systracelogger_set_event_handler_thread(
+    struct osd_systracelogger_ctx *ctx, bool enable)
+{
+    return osd_hostmod_set_event_handler_thread(ctx->hostmod_ctx, enable);
+}
+
 API_EXPORT
 osd_result osd_systracelogger_disconnect(struct osd_systracelogger_ctx *ctx)
 {
@@ -222,6 +242,10 @@ osd_result osd_systracelogger_stop(struct osd_systracelogger_ctx *ctx)
     if (rv == OSD_ERROR_TIMEDOUT) {
         rv = OSD_OK;
     }
+
+    // write out all events received until now
+    osd_hostmod_event_handler_flush(ctx->hostmod_ctx);
+
     return rv;
 }
 
@@ -17,6 +17,7 @@
 
 #include <assert.h>
 #include <osd/osd.h>
+#include "ioreactor-private.h"
 #include "osd-private.h"
 
 /**
@@ -28,7 +29,6 @@ static int thread_inproc_rcv(zloop_t *loop, zsock_t *reader,
     struct worker_thread_ctx *thread_ctx = thread_ctx_void;
     assert(thread_ctx);
 
-    int retval;
     osd_result rv;
 
     zmsg_t *msg = zmsg_recv(reader);
@@ -36,45 +36,48 @@ static int thread_inproc_rcv(zloop_t *loop, zsock_t *reader,
         return -1;  // process was interrupted, terminate zloop
     }
 
-    zframe_t *type_frame = zmsg_first(msg);
-    assert(type_frame);
+    int opcode = worker_msg_get_opcode(msg);
+    assert(opcode != -1);
 
-    char *type_str = zframe_strdup(type_frame);
-    assert(type_str);
-
-    if (!strcmp(type_str, "I-SHUTDOWN")) {
-        // End thread by returning -1, which will terminate zloop
-        retval = -1;
+    if (opcode == WORKER_OP_SHUTDOWN) {
         zmsg_destroy(&msg);
-        goto free_return;
+
+        // Workers in a shared zloop are detached by the reactor thread (see
+        // ioreactor_detach()), other workers end their thread by returning -1,
+        // which will terminate zloop
+        assert(!thread_ctx->zloop_is_shared);
+        return -1;
+    }
+
+    worker_cmd_handler_fn handler = thread_ctx->cmd_handlers[opcode];
+    if (!handler) {
+        err(thread_ctx->log_ctx, "No handler for inproc message 0x%02x set.",
+            opcode);
     } else {
-        if (!thread_ctx->cmd_handler_fn) {
-            err(thread_ctx->log_ctx, "No handler for inproc message set.");
-            zmsg_destroy(&msg);
-        }
-        rv = thread_ctx->cmd_handler_fn(thread_ctx, type_str, msg);
+        rv = handler(thread_ctx, &msg);
         if (OSD_FAILED(rv)) {
             err(thread_ctx->log_ctx, "Handler for inproc message failed.");
         }
     }
+    zmsg_destroy(&msg);
 
-    retval = 0;
-
-free_return:
-    free(type_str);
-    return retval;
+    return 0;
 }
 
-static void *thread_main(void *thread_ctx_void)
+/**
+ * Connect the worker to the main thread and register it in its zloop
+ *
+ * This function does not inform the main thread about the result. If the
+ * connection to the main thread cannot be established, inproc_socket is NULL
+ * afterwards.
+ *
+ * @return OSD_OK if the worker is ready to process messages
+ */
+static osd_result thread_setup(struct worker_thread_ctx *thread_ctx)
 {
-    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
-    assert(thread_ctx);
-
     int zmq_rv;
     osd_result osd_rv;
 
-    *thread_ctx->thread_is_running = 1;
-
     // create new PAIR socket for the communication of the main thread
     thread_ctx->inproc_socket = zsock_new(ZMQ_PAIR);
     assert(thread_ctx->inproc_socket);
@@ -84,17 +87,10 @@ static void *thread_main(void *thread_ctx_void)
         err(thread_ctx->log_ctx,
             "Unable to connect to ZeroMQ socket inproc://%s",
             thread_ctx->inproc_socket_name);
-        goto free_return;
+        zsock_destroy(&thread_ctx->inproc_socket);
+        return OSD_ERROR_FAILURE;
     }
 
-    // prepare processing loop
-    thread_ctx->zloop = zloop_new();
-    assert(thread_ctx->zloop);
-
-#ifdef ZMQ_DEBUG
-    zloop_set_verbose(thread_ctx->zloop, 1);
-#endif
-
     zmq_rv = zloop_reader(thread_ctx->zloop, thread_ctx->inproc_socket,
                           thread_inproc_rcv, thread_ctx);
     assert(zmq_rv == 0);
@@ -104,14 +100,58 @@ static void *thread_main(void *thread_ctx_void)
     if (thread_ctx->init_fn) {
         osd_rv = thread_ctx->init_fn(thread_ctx);
         if (OSD_FAILED(osd_rv)) {
-            worker_send_status(thread_ctx->inproc_socket, "I-THREADINIT-DONE",
-                               osd_rv);
+            zloop_reader_end(thread_ctx->zloop, thread_ctx->inproc_socket);
+            return osd_rv;
+        }
+    }
+
+    return OSD_OK;
+}
+
+/**
+ * Clean up the user part of the worker after it stopped processing messages
+ */
+static void thread_teardown(struct worker_thread_ctx *thread_ctx)
+{
+    // extension point: thread destruction
+    if (thread_ctx->destroy_fn) {
+        thread_ctx->destroy_fn(thread_ctx);
+    }
+
+    assert(thread_ctx->usr == NULL &&
+           "You need to free() and NULL the user context in a thread function "
+           "to prevent memory leaks.");
+}
+
+static void *thread_main(void *thread_ctx_void)
+{
+    struct worker_thread_ctx *thread_ctx = thread_ctx_void;
+    assert(thread_ctx);
+
+    int zmq_rv;
+    osd_result osd_rv;
+
+    *thread_ctx->thread_is_running = 1;
+
+    // prepare processing loop
+    thread_ctx->zloop = zloop_new();
+    assert(thread_ctx->zloop);
+
+#ifdef ZMQ_DEBUG
+    zloop_set_verbose(thread_ctx->zloop, 1);
+#endif
 
-            goto free_return;
+    osd_rv = thread_setup(thread_ctx);
+    if (OSD_FAILED(osd_rv)) {
+        if (thread_ctx->inproc_socket) {
+            worker_send_status(thread_ctx->inproc_socket,
+                               WORKER_OP_THREADINIT_DONE, osd_rv);
         }
+        goto free_return;
     }
     // connection successful: inform main thread
-    worker_send_status(thread_ctx->inproc_socket, "I-THREADINIT-DONE", OSD_OK);
+    worker_send_status(thread_ctx->inproc_socket, WORKER_OP_THREADINIT_DONE,
+                       OSD_OK);
 
     // we shut down the thread manually through other means, disable zloop
     // listening on signals itself
@@ -127,16 +167,10 @@ static void *thread_main(void *thread_ctx_void)
         err(thread_ctx->log_ctx, "ZeroMQ zloop did not shut down properly.");
     }
 
-    // extension point: thread destruction
-    if (thread_ctx->destroy_fn) {
-        thread_ctx->destroy_fn(thread_ctx);
-    }
+    thread_teardown(thread_ctx);
 
-    worker_send_status(thread_ctx->inproc_socket, "I-SHUTDOWN-DONE", OSD_OK);
-
-    assert(thread_ctx->usr == NULL &&
-           "You need to free() and NULL the user context in a thread function "
-           "to prevent memory leaks.");
+    worker_send_status(thread_ctx->inproc_socket, WORKER_OP_SHUTDOWN_DONE,
+                       OSD_OK);
 
 free_return:
     zsock_destroy(&thread_ctx->inproc_socket);
@@ -151,6 +185,51 @@ free_return:
     return NULL;
 }
 
+void worker_thread_attach(struct worker_thread_ctx *thread_ctx,
+                          zloop_t *zloop)
+{
+    assert(thread_ctx);
+    assert(zloop);
+
+    osd_result osd_rv;
+
+    thread_ctx->zloop = zloop;
+    thread_ctx->zloop_is_shared = true;
+    *thread_ctx->thread_is_running = 1;
+
+    osd_rv = thread_setup(thread_ctx);
+    if (OSD_FAILED(osd_rv)) {
+        *thread_ctx->thread_is_running = 0;
+    }
+    if (thread_ctx->inproc_socket) {
+        worker_send_status(thread_ctx->inproc_socket,
+                           WORKER_OP_THREADINIT_DONE, osd_rv);
+    }
+    // The main thread might have given up waiting for the status already.
+    // It frees the context only after detaching it (see ioreactor_detach()),
+    // which marks a failed worker by the missing inproc_socket.
+    if (OSD_FAILED(osd_rv)) {
+        zsock_destroy(&thread_ctx->inproc_socket);
+    }
+}
+
+void worker_thread_detach(struct worker_thread_ctx *thread_ctx)
+{
+    assert(thread_ctx);
+
+    if (!thread_ctx->inproc_socket) {
+        return;
+    }
+
+    zloop_reader_end(thread_ctx->zloop, thread_ctx->inproc_socket);
+
+    thread_teardown(thread_ctx);
+
+    *thread_ctx->thread_is_running = 0;
+
+    zsock_destroy(&thread_ctx->inproc_socket);
+}
+
 /**
  * Generate a 32-character unique identifier
  *
@@ -171,10 +250,24 @@ static void generate_unique_inproc_name(char* socket_name)
 osd_result worker_new(struct worker_ctx **ctx, struct osd_log_ctx *log_ctx,
                       worker_thread_init_fn thread_init_fn,
                       worker_thread_destroy_fn thread_destroy_fn,
-                      worker_cmd_handler_fn cmd_handler_fn,
-                      void *thread_ctx_usr)
+                      const struct worker_cmd_handler *cmd_handlers,
+                      size_t cmd_handler_cnt, void *thread_ctx_usr)
+{
+    return worker_new_with_reactor(ctx, NULL, log_ctx, thread_init_fn,
+                                   thread_destroy_fn, cmd_handlers,
+                                   cmd_handler_cnt, thread_ctx_usr);
+}
+
+osd_result worker_new_with_reactor(struct worker_ctx **ctx,
+                                   struct osd_ioreactor_ctx *reactor,
+                                   struct osd_log_ctx *log_ctx,
+                                   worker_thread_init_fn thread_init_fn,
+                                   worker_thread_destroy_fn thread_destroy_fn,
+                                   const struct worker_cmd_handler *cmd_handlers,
+                                   size_t cmd_handler_cnt, void *thread_ctx_usr)
 {
     int rv;
+    osd_result osd_rv;
     char inproc_socket_name[33];
 
     struct worker_ctx *c = calloc(1, sizeof(struct worker_ctx));
@@ -183,12 +276,14 @@ osd_result worker_new(struct worker_ctx **ctx, struct osd_log_ctx *log_ctx,
     generate_unique_inproc_name(inproc_socket_name);
 
     c->thread_is_running = 0;
+    c->reactor = reactor;
     c->inproc_socket = zsock_new(ZMQ_PAIR);
     assert(c->inproc_socket);
     rv = zsock_bind(c->inproc_socket, "inproc://%s", inproc_socket_name);
     if (rv == -1) {
         err(log_ctx, "Unable to bind to ZeroMQ socket inproc://%s",
             inproc_socket_name);
+        zsock_destroy(&c->inproc_socket);
         free(c);
         return OSD_ERROR_FAILURE;
     }
@@ -213,19 +308,42 @@ osd_result worker_new(struct worker_ctx **ctx, struct osd_log_ctx *log_ctx,
     thread_ctx->log_ctx = log_ctx;
     thread_ctx->init_fn = thread_init_fn;
     thread_ctx->destroy_fn = thread_destroy_fn;
-    thread_ctx->cmd_handler_fn = cmd_handler_fn;
+    for (size_t i = 0; i < cmd_handler_cnt; i++) {
+        assert(cmd_handlers[i].opcode != WORKER_OP_SHUTDOWN);
+        assert(!thread_ctx->cmd_handlers[cmd_handlers[i].opcode]);
+        thread_ctx->cmd_handlers[cmd_handlers[i].opcode] = cmd_handlers[i].fn;
+    }
 
-    rv = pthread_create(&c->thread, 0, thread_main, (void *)thread_ctx);
-    assert(rv == 0);
+    if (reactor) {
+        osd_rv = ioreactor_attach(reactor, thread_ctx, &c->reactor_thread_idx);
+        if (OSD_FAILED(osd_rv)) {
+            err(log_ctx, "Unable to attach worker to I/O reactor.");
+            free(thread_ctx);
+            zsock_destroy(&c->inproc_socket);
+            free(c);
+            return osd_rv;
+        }
+        c->reactor_thread_ctx = thread_ctx;
+    } else {
+        rv = pthread_create(&c->thread, 0, thread_main, (void *)thread_ctx);
+        assert(rv == 0);
+    }
 
     // wait for thread setup to be completed
-    int retval;
-    worker_wait_for_status(c->inproc_socket, "I-THREADINIT-DONE", &retval);
+    int retval = OSD_ERROR_FAILURE;
+    worker_wait_for_status(c->inproc_socket, WORKER_OP_THREADINIT_DONE, &retval);
     if (OSD_FAILED(retval)) {
-        pthread_join(c->thread, NULL);
+        if (reactor) {
+            // The reactor thread might still be setting up the worker (if
+            // waiting for the status timed out).
+            ioreactor_detach(reactor, c->reactor_thread_idx, thread_ctx);
+            free(thread_ctx);
+        } else {
+            pthread_join(c->thread, NULL);
+        }
         zsock_destroy(&c->inproc_socket);
         free(c);
-        return rv;
+        return retval;
     }
 
     *ctx = c;
@@ -243,27 +361,34 @@ void worker_free(struct worker_ctx **ctx_p)
         return;
     }
 
-    // shut down thread (if it has not been terminated abnormally during its
-    // runtime)
-    if (ctx->thread_is_running) {
-        worker_send_status(ctx->inproc_socket, "I-SHUTDOWN", 0);
-
-        // wait for shutdown to happen
-        int retvalue;
-        osd_rv = worker_wait_for_status(ctx->inproc_socket, "I-SHUTDOWN-DONE",
-                                        &retvalue);
-        if (OSD_FAILED(osd_rv)) {
-            // If the thread shutting down properly by itself, we force a
-            // shutdown
-            pthread_cancel(ctx->thread);
+    if (ctx->reactor) {
+        // Returns only after the reactor thread stopped using the worker.
+        ioreactor_detach(ctx->reactor, ctx->reactor_thread_idx,
+                         ctx->reactor_thread_ctx);
+        free(ctx->reactor_thread_ctx);
+    } else {
+        // shut down thread (if it has not been terminated abnormally during
+        // its runtime)
+        if (ctx->thread_is_running) {
+            worker_send_status(ctx->inproc_socket, WORKER_OP_SHUTDOWN, 0);
+
+            // wait for shutdown to happen
+            int retvalue;
+            osd_rv = worker_wait_for_status(ctx->inproc_socket,
+                                            WORKER_OP_SHUTDOWN_DONE, &retvalue);
+            if (OSD_FAILED(osd_rv)) {
+                // If the thread shutting down properly by itself, we force a
+                // shutdown
+                pthread_cancel(ctx->thread);
+            }
         }
-    }
 
-    // Wait until control I/O thread has finished its cleanup and free all
-    // associated resources. pthread_join() acts as free() for the
-    // pthread_thread_t struct. To avoid memory leaks, call it even if the
-    // thread terminated on its own (indicated by !thread_is_running).
-    pthread_join(ctx->thread, NULL);
+        // Wait until control I/O thread has finished its cleanup and free all
+        // associated resources. pthread_join() acts as free() for the
+        // pthread_thread_t struct. To avoid memory leaks, call it even if the
+        // thread terminated on its own (indicated by !thread_is_running).
+        pthread_join(ctx->thread, NULL);
+    }
 
     zsock_destroy(&ctx->inproc_socket);
 
@@ -271,7 +396,16 @@ void worker_free(struct worker_ctx **ctx_p)
     *ctx_p = NULL;
 }
 
-void worker_send_data(zsock_t *socket, const char *name, const void *data,
+int worker_msg_get_opcode(zmsg_t *msg)
+{
+    zframe_t *opcode_frame = zmsg_first(msg);
+    if (!opcode_frame || zframe_size(opcode_frame) != 1) {
+        return -1;
+    }
+    return zframe_data(opcode_frame)[0];
+}
+
+void worker_send_data(zsock_t *socket, uint8_t opcode, const void *data,
                       size_t size)
 {
     int zmq_rv;
@@ -280,7 +414,7 @@ void worker_send_data(zsock_t *socket, const char *name, const void *data,
 
     zmsg_t *msg = zmsg_new();
     assert(msg);
-    zmq_rv = zmsg_addstr(msg, name);
+    zmq_rv = zmsg_addmem(msg, &opcode, sizeof(opcode));
     assert(zmq_rv == 0);
     if (data != NULL && size > 0) {
         zmq_rv = zmsg_addmem(msg, data, size);
@@ -290,25 +424,25 @@ void worker_send_data(zsock_t *socket, const char *name, const void *data,
     assert(zmq_rv == 0);
 }
 
-void worker_send_status(zsock_t *socket, const char *name, int value)
+void worker_send_status(zsock_t *socket, uint8_t opcode, int value)
 {
-    worker_send_data(socket, name, &value, sizeof(int));
+    worker_send_data(socket, opcode, &value, sizeof(int));
 }
 
-osd_result worker_main_send_status(struct worker_ctx *ctx, const char *name,
+osd_result worker_main_send_status(struct worker_ctx *ctx, uint8_t opcode,
                                    int value)
 {
     if (!ctx->thread_is_running) {
         return OSD_ERROR_NOT_CONNECTED;
     }
-    worker_send_status(ctx->inproc_socket, name, value);
+    worker_send_status(ctx->inproc_socket, opcode, value);
     return OSD_OK;
 }
 
-osd_result worker_wait_for_status(zsock_t *socket, const char *name,
+osd_result worker_wait_for_status(zsock_t *socket, uint8_t opcode,
                                   int *retvalue)
 {
-    assert(name[0] == 'I' && name[1] == '-' && "|name| must start with 'I-'");
+    assert(opcode != WORKER_OP_DATA);
 
     bool status_received = false;
 
@@ -322,28 +456,23 @@ osd_result worker_wait_for_status(zsock_t *socket, const char *name,
             }
         }
 
-        zframe_t *name_frame = zmsg_pop(msg);
-        char* status_received_name = zframe_strdup(name_frame);
-        zframe_destroy(&name_frame);
-        status_received = (strncmp("I-", status_received_name, 2) == 0);
+        int opcode_received = worker_msg_get_opcode(msg);
+        status_received = (opcode_received != WORKER_OP_DATA);
         if (!status_received) {
-            free(status_received_name);
             zmsg_destroy(&msg);
             continue;
         }
 
-        if (strcmp(status_received_name, name) != 0) {
-            printf("Got status %s, expected %s.\n", status_received_name, name);
-            free(status_received_name);
+        if (opcode_received != opcode) {
+            printf("Got status 0x%02x, expected 0x%02x.\n", opcode_received,
+                   opcode);
             zmsg_destroy(&msg);
             return OSD_ERROR_FAILURE;
         }
-        free(status_received_name);
 
-        zframe_t *data_frame = zmsg_pop(msg);
+        zframe_t *data_frame = zmsg_last(msg);
         assert(zframe_size(data_frame) == sizeof(int));
         memcpy(retvalue, zframe_data(data_frame), sizeof(int));
-        zframe_destroy(&data_frame);
 
         zmsg_destroy(&msg);
     } while (!status_received);
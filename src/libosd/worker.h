@@ -17,23 +17,78 @@
 #define WORKER_H
 
 #include <czmq.h>
+#include <osd/ioreactor.h>
 #include <osd/osd.h>
 
+#include <stdint.h>
+
 /**
  * Reactive In-Process Worker with ZeroMQ Communication
  *
  * This helper class provides a reactive worker based on the CZMQ zloop. It
  * handles the setup and teardown of the worker thread and provides means to
  * communicate with the thread in a safe and easy manner.
+ *
+ * Messages exchanged between the main thread and the worker thread start with
+ * a one-byte frame containing an opcode, which identifies the message. The
+ * worker thread dispatches incoming messages to handler functions through a
+ * table indexed by the opcode.
+ *
+ * A worker either runs its own thread, or it is attached to a thread of a
+ * shared I/O reactor (see worker_new_with_reactor()). In the latter case the
+ * worker shares the zloop with all other workers on the same reactor thread,
+ * but is otherwise used in exactly the same way.
+ */
+
+/**
+ * Opcodes of messages exchanged with the worker thread
+ *
+ * Users of the worker define their own opcodes, starting at WORKER_OP_USER.
  */
+enum worker_opcode {
+    /** Shut down the worker thread (main -> worker) */
+    WORKER_OP_SHUTDOWN = 0x01,
+    /** Shutdown complete (worker -> main) */
+    WORKER_OP_SHUTDOWN_DONE = 0x02,
+    /** Worker thread initialization complete (worker -> main) */
+    WORKER_OP_THREADINIT_DONE = 0x03,
+
+    /**
+     * DI packet data
+     *
+     * Data messages use the same type frame ("D") as data messages exchanged
+     * with the host controller, which allows forwarding them without copying.
+     */
+    WORKER_OP_DATA = 'D',
+
+    /** First opcode available for users of the worker */
+    WORKER_OP_USER = 0x80,
+};
+
+/**
+ * Number of possible opcodes
+ */
+#define WORKER_OPCODE_CNT (UINT8_MAX + 1)
 
 /**
  * Worker context object (to be used on main thread)
  */
 struct worker_ctx {
-    /** Worker thread */
+    /** Worker thread (not used if the worker is attached to a reactor) */
     pthread_t thread;
 
+    /** I/O reactor the worker is attached to (NULL: own worker thread) */
+    struct osd_ioreactor_ctx* reactor;
+
+    /** Index of the reactor thread the worker is attached to */
+    unsigned int reactor_thread_idx;
+
+    /**
+     * Context of the worker attached to the reactor thread (NULL: own worker
+     * thread). It is owned by this object, see ioreactor_detach().
+     */
+    struct worker_thread_ctx* reactor_thread_ctx;
+
     /** Worker thread is running */
     volatile int thread_is_running;
 
@@ -53,14 +108,23 @@ typedef osd_result (*worker_thread_destroy_fn)(
  * Handle a message received in the worker thread from the main thread
  *
  * @param thread_ctx the thread context
- * @param type_str message type
- * @param inproc_msg the whole message. The ownership of the message is passed
- *                   on to the handler function, which is responsible for
- *                   destroying it after use.
+ * @param inproc_msg_p the whole message, including the opcode frame. The
+ *                     handler can take ownership of the message (e.g. to
+ *                     forward it) and set the pointer to NULL; otherwise the
+ *                     worker destroys the message after the handler returns.
  */
 typedef osd_result (*worker_cmd_handler_fn)(
-    struct worker_thread_ctx* /* thread_ctx */, const char* /* type_str */,
-    zmsg_t* /* inproc_msg */);
+    struct worker_thread_ctx* /* thread_ctx */, zmsg_t** /* inproc_msg_p */);
+
+/**
+ * Handler function for messages with a given opcode
+ */
+struct worker_cmd_handler {
+    /** Opcode of the handled messages */
+    uint8_t opcode;
+    /** Handler function */
+    worker_cmd_handler_fn fn;
+};
 
 /**
  * Worker context object (to be used in the worker thread)
@@ -80,6 +144,11 @@ struct worker_thread_ctx {
     /** Event processing zloop */
     zloop_t* zloop;
 
+    /**
+     * The zloop is owned by a reactor thread and shared with other workers
+     */
+    bool zloop_is_shared;
+
     /** In-process socket for communication with main thread */
     zsock_t* inproc_socket;
 
@@ -106,14 +175,15 @@ struct worker_thread_ctx {
     worker_thread_init_fn destroy_fn;
 
     /**
-     * Handler function for inter-thread messages (extension point)
+     * Handler functions for inter-thread messages, indexed by opcode
+     * (extension point)
      *
-     * This function is called whenever an in-process command message is received
-     * (messages of "I" type), which are not handled by the worker itself. Use
-     * this extension point as dispatcher for custom functionality which is
-     * triggered from the main thread and should be executed in the I/O thread.
+     * A handler function is called whenever an in-process message with its
+     * opcode is received, which is not handled by the worker itself. Use this
+     * extension point for custom functionality which is triggered from the
+     * main thread and should be executed in the I/O thread.
      */
-    worker_cmd_handler_fn cmd_handler_fn;
+    worker_cmd_handler_fn cmd_handlers[WORKER_OPCODE_CNT];
 };
 
 /**
@@ -125,9 +195,10 @@ struct worker_thread_ctx {
  *                       of the worker thread.
  * @param thread_destroy_fn extension point: function called during destruction
  *                          of the worker thread.
- * @param cmd_handler_fn extension point: handle a custom message sent to the
- *                       worker thread using worker_send_data() or
- *                       worker_send_status().
+ * @param cmd_handlers extension point: handlers for custom messages sent to
+ *                     the worker thread using worker_send_data() or
+ *                     worker_send_status().
+ * @param cmd_handler_cnt number of entries in @p cmd_handlers
  * @param thread_ctx_usr user data passed to the worker thread. The ownership
  *                       of this pointer is passed on to the worker. The
  *                       user data must be freed and set to NULL in the
@@ -136,65 +207,122 @@ struct worker_thread_ctx {
 osd_result worker_new(struct worker_ctx** ctx, struct osd_log_ctx* log_ctx,
                       worker_thread_init_fn thread_init_fn,
                       worker_thread_destroy_fn thread_destroy_fn,
-                      worker_cmd_handler_fn cmd_handler_fn,
-                      void* thread_ctx_usr);
+                      const struct worker_cmd_handler* cmd_handlers,
+                      size_t cmd_handler_cnt, void* thread_ctx_usr);
+
+/**
+ * Initialize a worker running on a thread of a shared I/O reactor
+ *
+ * Same as worker_new(), but instead of starting a new thread the worker is
+ * attached to the least used thread of @p reactor.
+ *
+ * @param reactor the I/O reactor. Set to NULL to run the worker on its own
+ *                thread, as worker_new() does.
+ *
+ * @see worker_new()
+ */
+osd_result worker_new_with_reactor(struct worker_ctx** ctx,
+                                   struct osd_ioreactor_ctx* reactor,
+                                   struct osd_log_ctx* log_ctx,
+                                   worker_thread_init_fn thread_init_fn,
+                                   worker_thread_destroy_fn thread_destroy_fn,
+                                   const struct worker_cmd_handler* cmd_handlers,
+                                   size_t cmd_handler_cnt, void* thread_ctx_usr);
 
 /**
  * Free all resources
  */
 void worker_free(struct worker_ctx** ctx_p);
 
+/**
+ * Start processing a worker in a zloop of an already running thread
+ *
+ * This function must be called from the thread running @p zloop. It performs
+ * the same setup as a newly started worker thread (including the call to the
+ * thread_init_fn and informing the main thread), but processes all messages
+ * of the worker in the given zloop. The worker is detached again with
+ * worker_thread_detach() when the main thread frees it.
+ *
+ * The main thread keeps the ownership of @p thread_ctx, even if the setup
+ * fails.
+ *
+ * @param thread_ctx the worker thread context, as passed to
+ *                   ioreactor_attach()
+ * @param zloop the zloop to run the worker in
+ */
+void worker_thread_attach(struct worker_thread_ctx* thread_ctx,
+                          zloop_t* zloop);
+
+/**
+ * Stop processing a worker in the zloop it was attached to
+ *
+ * This function must be called from the thread running the zloop passed to
+ * worker_thread_attach(). It removes the worker from the zloop and calls the
+ * thread_destroy_fn. Afterwards the worker thread context isn't used by the
+ * zloop any more. Nothing is done if the worker isn't attached, i.e. if
+ * worker_thread_attach() failed.
+ *
+ * @param thread_ctx the worker thread context
+ */
+void worker_thread_detach(struct worker_thread_ctx* thread_ctx);
+
+/**
+ * Get the opcode of a message exchanged with the worker thread
+ *
+ * @return the opcode, or -1 if the message has no valid opcode frame
+ */
+int worker_msg_get_opcode(zmsg_t* msg);
+
 /**
  * Send a data message to another thread over a ZeroMQ socket
  *
  * @param socket ZeroMQ socket to send the status message to.
- * @param name name identifying the message
+ * @param opcode opcode identifying the message
  * @param data data to be sent
  * @param size size of @p data (bytes)
  *
  * @see worker_send_status()
  */
-void worker_send_data(zsock_t* socket, const char* name, const void* data,
+void worker_send_data(zsock_t* socket, uint8_t opcode, const void* data,
                       size_t size);
 
 /**
  * Send data from the main thread to the worker thread
  *
  * @param ctx the worker thread context
- * @param name name identifying the message
+ * @param opcode opcode identifying the message
  * @param value status value
  * @return OSD_OK if the status was sent successfully
  *         OSD_ERROR_NOT_CONNECTED if the thread doesn't exist anymore.
  */
-osd_result worker_main_send_status(struct worker_ctx *ctx, const char *name,
+osd_result worker_main_send_status(struct worker_ctx *ctx, uint8_t opcode,
                                    int value);
 
 /**
  * Send a status message to another thread over a ZeroMQ socket
  *
  * @param socket ZeroMQ socket to send the status message to.
- * @param name name identifying the message
+ * @param opcode opcode identifying the message
  * @param value status value
  *
  * @see worker_send_data()
  */
-void worker_send_status(zsock_t* socket, const char* name, int value);
+void worker_send_status(zsock_t* socket, uint8_t opcode, int value);
 
 /**
- * Wait for a status message of a given name and return its value
+ * Wait for a status message with a given opcode and return its value
  *
- * Status messages are expected to start with "I-". All received messages which
- * are not starting with "I-" are discarded.
+ * All received data messages (WORKER_OP_DATA) are discarded.
  *
  * @param socket ZeroMQ socket to listen on for the status message
- * @param name the expected status message, must start with "I-"
+ * @param opcode the opcode of the expected status message
  * @param[out] retvalue a pointer to an int variable where the return value is
  *             stored.
  * @return OSD_ERROR_FAILURE if an error happened,
  *         OSD_ERROR_TIMEOUT if the wait timeout was exceeded
  *         OSD_OK if operation was successful.
  */
-osd_result worker_wait_for_status(zsock_t* socket, const char* name,
+osd_result worker_wait_for_status(zsock_t* socket, uint8_t opcode,
                                   int* retvalue);
 
 #endif  // WORKER_H
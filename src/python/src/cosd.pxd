@@ -192,6 +192,10 @@ cdef extern from "osd/gateway.h" nogil:
         timespec connect_time
         uint64_t bytes_from_device
         uint64_t bytes_to_device
+        size_t rx_queue_capacity_bytes
+        size_t rx_queue_fill_bytes
+        size_t rx_queue_fill_max_bytes
+        uint64_t rx_queue_stalls
 
 cdef extern from "osd/gateway_glip.h" nogil:
     struct osd_gateway_glip_ctx:
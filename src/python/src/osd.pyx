@@ -190,6 +190,7 @@ class Result(IntEnum):
     FILE = -12
     MEM_VERIFY_FAILED = -13
     WRONG_MODULE = -14
+    EOF = -15
 
     def __str__(self):
         # String representations from osd.h, keep in sync!
@@ -207,7 +208,8 @@ class Result(IntEnum):
             self.OOM: 'Out of memory',
             self.FILE: 'file operation failed',
             self.MEM_VERIFY_FAILED: 'memory verification failed ',
-            self.WRONG_MODULE: 'unexpected module type'
+            self.WRONG_MODULE: 'unexpected module type',
+            self.EOF: 'end of file reached'
         }
 
         try:
@@ -642,6 +644,10 @@ cdef class GatewayGlip:
 
         return { 'bytes_from_device': stats.bytes_from_device,
                  'bytes_to_device': stats.bytes_to_device,
+                 'rx_queue_capacity_bytes': stats.rx_queue_capacity_bytes,
+                 'rx_queue_fill_bytes': stats.rx_queue_fill_bytes,
+                 'rx_queue_fill_max_bytes': stats.rx_queue_fill_max_bytes,
+                 'rx_queue_stalls': stats.rx_queue_stalls,
                  'connected_secs': time_elapsed }
 
 
@@ -26,8 +26,15 @@
 
 #include <unistd.h>
 
+/** Maximum time a packet is held back in a batch to a peer in us */
+#define PEER_BATCH_MAX_DELAY_US 1000
+
 // command line arguments
 struct arg_str *a_bind_ep;
+struct arg_int *a_router_threads;
+struct arg_int *a_subnet;
+struct arg_str *a_peers;
+struct arg_int *a_peer_batch_packets;
 
 osd_result setup(void)
 {
@@ -37,6 +44,32 @@ osd_result setup(void)
     a_bind_ep->sval[0] = DEFAULT_HOSTCTRL_BIND_EP;
     osd_tool_add_arg(a_bind_ep);
 
+    a_router_threads = arg_int0(
+        "t", "router-threads", "<n>",
+        "number of routing threads, each listening at its own address (n "
+        "consecutive TCP ports starting at the bind address). Gateways "
+        "connect to the thread of their subnet. (default: 1)");
+    a_router_threads->ival[0] = 1;
+    osd_tool_add_arg(a_router_threads);
+
+    a_subnet = arg_int0("s", "subnet", "<subnet>",
+                        "subnet of the host modules connected to this host "
+                        "controller (default: 1)");
+    a_subnet->ival[0] = 1;
+    osd_tool_add_arg(a_subnet);
+
+    a_peers = arg_strn("p", "peer", "<URL>", 0, 64,
+                       "ZeroMQ endpoint address of a peer host controller to "
+                       "connect to (can be given multiple times)");
+    osd_tool_add_arg(a_peers);
+
+    a_peer_batch_packets = arg_int0(
+        NULL, "peer-batch-packets", "<n>",
+        "batch up to n packets into one message to peers (default: 1, i.e. "
+        "no batching)");
+    a_peer_batch_packets->ival[0] = 1;
+    osd_tool_add_arg(a_peer_batch_packets);
+
     return OSD_OK;
 }
 
@@ -51,14 +84,47 @@ int run(void)
     rv = osd_log_new(&osd_log_ctx, cfg.log_level, &osd_log_handler);
     assert(OSD_SUCCEEDED(rv));
 
-    struct osd_hostctrl_ctx *hostctrl_ctx;
-    rv = osd_hostctrl_new(&hostctrl_ctx, osd_log_ctx, a_bind_ep->sval[0]);
+    struct osd_hostctrl_ctx *hostctrl_ctx = NULL;
+    struct osd_hostctrl_options options = {
+        .router_threads = a_router_threads->ival[0],
+    };
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, osd_log_ctx,
+                                       a_bind_ep->sval[0], &options);
     if (OSD_FAILED(rv)) {
         fatal("Unable to initialize host controller (%d)", rv);
         exitcode = 1;
         goto free_return;
     }
 
+    rv = osd_hostctrl_set_subnet_addr(hostctrl_ctx, a_subnet->ival[0]);
+    if (OSD_FAILED(rv)) {
+        fatal("Unable to set subnet %d (%d)", a_subnet->ival[0], rv);
+        exitcode = 1;
+        goto free_return;
+    }
+
+    for (int i = 0; i < a_peers->count; i++) {
+        rv = osd_hostctrl_add_peer(hostctrl_ctx, a_peers->sval[i]);
+        if (OSD_FAILED(rv)) {
+            fatal("Unable to add peer %s (%d)", a_peers->sval[i], rv);
+            exitcode = 1;
+            goto free_return;
+        }
+    }
+
+    if (a_peer_batch_packets->ival[0] > 1) {
+        struct osd_packet_batch_policy batch_policy = {
+            .max_packets = a_peer_batch_packets->ival[0],
+            .max_delay_us = PEER_BATCH_MAX_DELAY_US,
+        };
+        rv = osd_hostctrl_set_peer_batch_policy(hostctrl_ctx, &batch_policy);
+        if (OSD_FAILED(rv)) {
+            fatal("Unable to set the batch policy for peers (%d)", rv);
+            exitcode = 1;
+            goto free_return;
+        }
+    }
+
     rv = osd_hostctrl_start(hostctrl_ctx);
     if (OSD_FAILED(rv)) {
         fatal("Unable to start host controller (%d)", rv);
@@ -66,8 +132,13 @@ int run(void)
         goto free_return;
     }
 
-    info("Host controller up and running, listening at %s for connections",
-         a_bind_ep->sval[0]);
+    for (unsigned int i = 0; i < osd_hostctrl_get_router_thread_cnt(hostctrl_ctx);
+         i++) {
+        info("Host controller up and running, listening at %s for connections",
+             osd_hostctrl_get_router_address(hostctrl_ctx, i));
+    }
+    info("Host modules are in subnet %u.",
+         osd_hostctrl_get_subnet_addr(hostctrl_ctx));
     while (!zsys_interrupted) {
         pause();
     }
@@ -24,6 +24,7 @@
 #include <osd/coretracelogger.h>
 #include <osd/gateway_glip.h>
 #include <osd/hostctrl.h>
+#include <osd/ioreactor.h>
 #include <osd/memaccess.h>
 #include <osd/packet.h>
 #include <osd/systracelogger.h>
@@ -53,6 +54,8 @@ struct arg_lit *a_coretrace;
 struct arg_lit *a_systrace;
 struct arg_lit *a_verify_memload;
 struct arg_lit *a_terminal;
+struct arg_int *a_io_threads;
+struct arg_file *a_topology_cache;
 struct arg_file *a_elf_file;
 
 // global objects
@@ -61,6 +64,7 @@ struct osd_log_ctx *osd_log_ctx;
 struct osd_hostctrl_ctx *hostctrl_ctx;
 struct osd_gateway_glip_ctx *gateway_glip_ctx;
 struct osd_terminal_ctx *terminal_ctx;
+struct osd_ioreactor_ctx *ioreactor_ctx;
 
 zlist_t *ctloggers;
 zlist_t *stloggers;
@@ -86,6 +90,19 @@ osd_result setup(void)
     a_terminal = arg_lit0(NULL, "terminal", "create pseudo-terminal device");
     osd_tool_add_arg(a_terminal);
 
+    a_io_threads = arg_int0(
+        NULL, "io-threads", "<n>",
+        "number of I/O threads shared by all trace loggers (default: 0, one "
+        "I/O thread per trace logger)");
+    a_io_threads->ival[0] = 0;
+    osd_tool_add_arg(a_io_threads);
+
+    a_topology_cache = arg_file0(
+        NULL, "topology-cache", "<file>",
+        "cache the enumerated debug system in this file to speed up the next "
+        "start with the same device");
+    osd_tool_add_arg(a_topology_cache);
+
     a_glip_backend =
         arg_str0("b", "glip-backend", "<name>", "GLIP backend name");
     a_glip_backend->sval[0] = GLIP_DEFAULT_BACKEND;
@@ -160,8 +177,9 @@ static osd_result run_systrace(uint16_t stm_di_addr)
     int irv;
 
     struct osd_systracelogger_ctx *systracelogger_ctx = NULL;
-    rv = osd_systracelogger_new(&systracelogger_ctx, osd_log_ctx, HOSTCTRL_EP,
-                                stm_di_addr);
+    rv = osd_systracelogger_new_with_reactor(&systracelogger_ctx, osd_log_ctx,
+                                             HOSTCTRL_EP, stm_di_addr,
+                                             ioreactor_ctx);
     if (OSD_FAILED(rv)) {
         retval = rv;
         goto free_return;
@@ -251,8 +269,9 @@ static osd_result run_coretrace(uint16_t ctm_di_addr)
     int irv;
 
     struct osd_coretracelogger_ctx *coretracelogger_ctx = NULL;
-    rv = osd_coretracelogger_new(&coretracelogger_ctx, osd_log_ctx, HOSTCTRL_EP,
-                                 ctm_di_addr);
+    rv = osd_coretracelogger_new_with_reactor(&coretracelogger_ctx,
+                                              osd_log_ctx, HOSTCTRL_EP,
+                                              ctm_di_addr, ioreactor_ctx);
     if (OSD_FAILED(rv)) {
         retval = rv;
         goto free_return;
@@ -318,13 +337,23 @@ free_return:
     return retval;
 }
 
-static osd_result run_tracing(void)
+/**
+ * Enumerate all debug modules in the target subnet
+ *
+ * @param[out] modules the modules found, must be freed by the caller
+ * @param[out] modules_len number of entries in @p modules
+ */
+static osd_result enumerate_modules(struct osd_module_desc **modules,
+                                    size_t *modules_len)
 {
     osd_result rv;
     osd_result retval;
 
+    *modules = NULL;
+
     struct osd_hostmod_ctx *hostmod_enum = NULL;
-    rv = osd_hostmod_new(&hostmod_enum, osd_log_ctx, HOSTCTRL_EP, NULL, NULL);
+    rv = osd_hostmod_new_with_reactor(&hostmod_enum, osd_log_ctx, HOSTCTRL_EP,
+                                      NULL, NULL, ioreactor_ctx);
     if (OSD_FAILED(rv)) {
         retval = rv;
         goto free_return;
@@ -336,15 +365,43 @@ static osd_result run_tracing(void)
         goto free_return;
     }
 
-    struct osd_module_desc *modules = NULL;
-    size_t modules_len;
-    rv = osd_hostmod_get_modules(hostmod_enum, DEVICE_SUBNET_ADDRESS, &modules,
-                                 &modules_len);
-    if (OSD_FAILED(rv)) {
+    if (a_topology_cache->count) {
+        // a missing or outdated file isn't an error: enumerate the device
+        osd_hostmod_topology_cache_load(hostmod_enum, DEVICE_SUBNET_ADDRESS,
+                                        a_topology_cache->filename[0]);
+    }
+
+    retval = osd_hostmod_get_modules(hostmod_enum, DEVICE_SUBNET_ADDRESS,
+                                     modules, modules_len);
+
+    if (OSD_SUCCEEDED(retval) && a_topology_cache->count) {
+        rv = osd_hostmod_topology_cache_save(hostmod_enum,
+                                             DEVICE_SUBNET_ADDRESS,
+                                             a_topology_cache->filename[0]);
+        if (OSD_FAILED(rv)) {
+            err("Unable to write topology cache file (%d). Ignoring.", rv);
+        }
+    }
+
+    rv = osd_hostmod_disconnect(hostmod_enum);
+    if (OSD_SUCCEEDED(retval) && OSD_FAILED(rv)) {
         retval = rv;
-        goto free_return;
     }
 
+free_return:
+    if (OSD_FAILED(retval)) {
+        free(*modules);
+        *modules = NULL;
+    }
+    osd_hostmod_free(&hostmod_enum);
+    return retval;
+}
+
+static osd_result run_tracing(const struct osd_module_desc *modules,
+                              size_t modules_len)
+{
+    osd_result rv;
+
     for (size_t i = 0; i < modules_len; i++) {
         if (a_coretrace->count && modules[i].vendor == OSD_MODULE_VENDOR_OSD &&
             modules[i].type == OSD_MODULE_TYPE_STD_CTM) {
@@ -358,44 +415,19 @@ static osd_result run_tracing(void)
         }
     }
 
-    rv = osd_hostmod_disconnect(hostmod_enum);
-    if (OSD_FAILED(rv)) return rv;
-
-    retval = OSD_OK;
-free_return:
-    free(modules);
-    osd_hostmod_free(&hostmod_enum);
-    return retval;
+    return OSD_OK;
 }
 
-static osd_result run_terminal(void)
+static osd_result run_terminal(const struct osd_module_desc *modules,
+                               size_t modules_len)
 {
-    struct osd_module_desc *modules;
-    struct osd_hostmod_ctx *hostmod_enum;
     osd_result rv;
-    size_t modules_len;
 
     // We only create the pseudo-terminal if it was explicitly specified
     if (!a_terminal->count) {
         return OSD_OK;
     }
 
-    rv = osd_hostmod_new(&hostmod_enum, osd_log_ctx, HOSTCTRL_EP, NULL, NULL);
-    if (OSD_FAILED(rv)) {
-        goto free_return;
-    }
-
-    rv = osd_hostmod_connect(hostmod_enum);
-    if (OSD_FAILED(rv)) {
-        goto free_return;
-    }
-
-    rv = osd_hostmod_get_modules(hostmod_enum, DEVICE_SUBNET_ADDRESS, &modules,
-                                 &modules_len);
-    if (OSD_FAILED(rv)) {
-        goto free_return;
-    }
-
     for (size_t i = 0; i < modules_len; i++) {
         if (modules[i].vendor == OSD_MODULE_VENDOR_OSD &&
             modules[i].type == OSD_MODULE_TYPE_STD_DEM_UART) {
@@ -403,7 +435,7 @@ static osd_result run_terminal(void)
                                   modules[i].addr);
             if (OSD_FAILED(rv)) {
                 fatal("osd_terminal_new() failed with code: %i", rv);
-                goto free_return;
+                return rv;
             }
 
             rv = osd_terminal_connect(terminal_ctx);
@@ -415,7 +447,7 @@ static osd_result run_terminal(void)
                 }
 
                 osd_terminal_free(&terminal_ctx);
-                goto free_return;
+                return rv;
             }
 
             rv = osd_terminal_start(terminal_ctx);
@@ -424,7 +456,7 @@ static osd_result run_terminal(void)
 
                 osd_terminal_disconnect(terminal_ctx);
                 osd_terminal_free(&terminal_ctx);
-                goto free_return;
+                return rv;
             }
 
             // Currently, we can only handle a single osd_terminal.
@@ -432,16 +464,7 @@ static osd_result run_terminal(void)
         }
     }
 
-    rv = osd_hostmod_disconnect(hostmod_enum);
-    if (OSD_FAILED(rv)) {
-        goto free_return;
-    }
-
-    rv = OSD_OK;
-free_return:
-    free(modules);
-    osd_hostmod_free(&hostmod_enum);
-    return rv;
+    return OSD_OK;
 }
 
 int run(void)
@@ -475,6 +498,22 @@ int run(void)
         goto free_return;
     }
 
+    // shared I/O threads for all trace loggers
+    if (a_io_threads->ival[0] < 0) {
+        fatal("The number of I/O threads cannot be negative.");
+        exitcode = -1;
+        goto free_return;
+    }
+    if (a_io_threads->ival[0] > 0) {
+        rv = osd_ioreactor_new(&ioreactor_ctx, osd_log_ctx,
+                               a_io_threads->ival[0]);
+        if (OSD_FAILED(rv)) {
+            fatal("Unable to start I/O threads (%d)", rv);
+            exitcode = -1;
+            goto free_return;
+        }
+    }
+
     // setup memory access helper
     struct osd_memaccess_ctx *memaccess_ctx = NULL;
     rv = osd_memaccess_new(&memaccess_ctx, osd_log_ctx, HOSTCTRL_EP);
@@ -497,17 +536,29 @@ int run(void)
         goto free_return;
     }
 
+    // enumerate the debug modules once for tracing and the terminal
+    struct osd_module_desc *modules;
+    size_t modules_len;
+    rv = enumerate_modules(&modules, &modules_len);
+    if (OSD_FAILED(rv)) {
+        fatal("Unable to enumerate debug modules on target (%d)", rv);
+        exitcode = -1;
+        goto free_return;
+    }
+
     // setup tracing
     info("Setting up tracing");
-    rv = run_tracing();
+    rv = run_tracing(modules, modules_len);
     if (OSD_FAILED(rv)) {
+        free(modules);
         exitcode = -1;
         goto free_return;
     }
 
     // setup terminal
     info("Setting up terminal");
-    rv = run_terminal();
+    rv = run_terminal(modules, modules_len);
+    free(modules);
     if (OSD_FAILED(rv)) {
         exitcode = -1;
         goto free_return;
@@ -603,6 +654,8 @@ free_return:;
     }
     zlist_destroy(&ctloggers);
 
+    osd_ioreactor_free(&ioreactor_ctx);
+
     dbg("Closing open files");
     FILE *f = zlist_first(open_files);
     while (f) {
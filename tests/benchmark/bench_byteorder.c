@@ -0,0 +1,79 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Microbenchmark: byte order conversion of 16 bit word arrays
+ *
+ * Measures the throughput of all byte swapping implementations supported by
+ * the CPU, for buffer sizes typical for single DI packets up to large bulk
+ * transfers.
+ */
+
+#include "byteorder.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/** Number of words converted per implementation and buffer size */
+#define BENCH_TOTAL_WORDS (256UL * 1024 * 1024)
+
+static double time_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t buf_sizes_words[] = { 4, 8, 64, 1024, 64 * 1024 };
+    const size_t buf_sizes_cnt =
+        sizeof(buf_sizes_words) / sizeof(buf_sizes_words[0]);
+    const size_t buf_words_max = buf_sizes_words[buf_sizes_cnt - 1];
+
+    uint16_t *buf = malloc(buf_words_max * sizeof(uint16_t));
+    assert(buf);
+    for (size_t w = 0; w < buf_words_max; w++) {
+        buf[w] = w;
+    }
+
+    size_t impl_cnt;
+    const struct byteorder_bswap16_impl *impls =
+        byteorder_bswap16_get_impls(&impl_cnt);
+
+    printf("%-8s %10s %16s\n", "impl", "words/buf", "Mwords/s");
+    for (size_t i = 0; i < impl_cnt; i++) {
+        for (size_t s = 0; s < buf_sizes_cnt; s++) {
+            size_t words = buf_sizes_words[s];
+            size_t iterations = BENCH_TOTAL_WORDS / words;
+
+            double start = time_now_s();
+            for (size_t it = 0; it < iterations; it++) {
+                impls[i].fn(buf, buf, words);
+                // prevent the compiler from optimizing away the conversion
+                __asm__ volatile("" : : "r"(buf) : "memory");
+            }
+            double duration = time_now_s() - start;
+
+            printf("%-8s %10zu %16.1f\n", impls[i].name, words,
+                   iterations * words / duration / 1e6);
+        }
+    }
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,266 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Benchmark: packet throughput of the host controller
+ *
+ * Multiple pairs of host modules stream batches of EVENT packets through the
+ * host controller, which is run with an increasing number of routing threads.
+ * The sender and receiver of a pair are either connected to the same routing
+ * thread ("local"), or to different routing threads ("cross").
+ *
+ * The host controller drops packets if a receiver cannot keep up, the
+ * throughput is therefore calculated from the number of received packets.
+ */
+
+#include <osd/hostctrl.h>
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <assert.h>
+#include <czmq.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Address of the host controller */
+#define BENCH_HOSTCTRL_ADDRESS "inproc://bench-hostctrl"
+
+/** Maximum number of routing threads */
+#define BENCH_ROUTER_THREADS_MAX 4
+
+/** Number of sender/receiver pairs */
+#define BENCH_PAIR_CNT 4
+
+/** Number of batch messages sent by each sender */
+#define BENCH_BATCH_CNT 5000
+
+/** Number of packets in a batch message */
+#define BENCH_BATCH_PKGS 32
+
+/** Number of payload words of each packet */
+#define BENCH_PAYLOAD_WORDS 8
+
+struct bench_pair {
+    zsock_t *sender;
+    unsigned int sender_diaddr;
+    zsock_t *receiver;
+    unsigned int receiver_diaddr;
+
+    pthread_t sender_thread;
+    pthread_t receiver_thread;
+
+    /** Number of packets received by the receiver */
+    uint64_t received;
+    /** Time the last packet was received */
+    uint64_t last_received_ns;
+};
+
+static uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Connect a host module to a routing thread and obtain a DI address
+ */
+static zsock_t *connect_module(const char *address, unsigned int *diaddr)
+{
+    int rv;
+
+    zsock_t *sock = zsock_new_dealer(address);
+    assert(sock);
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_addstr(msg, "M");
+    zmsg_addstr(msg, "DIADDR_REQUEST");
+    rv = zmsg_send(&msg, sock);
+    assert(rv == 0);
+
+    msg = zmsg_recv(sock);
+    assert(msg);
+    char *type = zmsg_popstr(msg);
+    char *diaddr_str = zmsg_popstr(msg);
+    assert(type && !strcmp(type, "M") && diaddr_str);
+    *diaddr = strtoul(diaddr_str, NULL, 10);
+    free(type);
+    free(diaddr_str);
+    zmsg_destroy(&msg);
+
+    // stop receiving when the host controller dropped the remaining packets
+    zsock_set_rcvtimeo(sock, 500);
+
+    return sock;
+}
+
+static void *sender_thread(void *pair_void)
+{
+    struct bench_pair *pair = pair_void;
+    osd_result osd_rv;
+    int rv;
+
+    struct osd_packet *pkg;
+    osd_rv = osd_packet_new(
+        &pkg, osd_packet_sizeconv_payload2data(BENCH_PAYLOAD_WORDS));
+    assert(OSD_SUCCEEDED(osd_rv));
+    osd_packet_set_header(pkg, pair->receiver_diaddr, pair->sender_diaddr,
+                          OSD_PACKET_TYPE_EVENT, EV_LAST);
+
+    // a batch frame contains each packet prefixed by its size in words
+    size_t rec_size = sizeof(uint16_t) + osd_packet_sizeof(pkg);
+    uint8_t *data = malloc(BENCH_BATCH_PKGS * rec_size);
+    assert(data);
+    for (size_t i = 0; i < BENCH_BATCH_PKGS; i++) {
+        memcpy(data + i * rec_size, &pkg->data_size_words, sizeof(uint16_t));
+        memcpy(data + i * rec_size + sizeof(uint16_t), pkg->data_raw,
+               osd_packet_sizeof(pkg));
+    }
+
+    for (size_t i = 0; i < BENCH_BATCH_CNT; i++) {
+        zmsg_t *msg = zmsg_new();
+        zmsg_addstr(msg, "B");
+        zmsg_addmem(msg, data, BENCH_BATCH_PKGS * rec_size);
+        rv = zmsg_send(&msg, pair->sender);
+        assert(rv == 0);
+    }
+
+    free(data);
+    osd_packet_free(&pkg);
+    return NULL;
+}
+
+static void *receiver_thread(void *pair_void)
+{
+    struct bench_pair *pair = pair_void;
+    const uint64_t expected = (uint64_t)BENCH_BATCH_CNT * BENCH_BATCH_PKGS;
+
+    while (pair->received < expected) {
+        zmsg_t *msg = zmsg_recv(pair->receiver);
+        if (!msg) {
+            break;
+        }
+
+        zframe_t *type_frame = zmsg_first(msg);
+        zframe_t *data_frame = zmsg_next(msg);
+        if (zframe_streq(type_frame, "D")) {
+            pair->received++;
+        } else {
+            const uint8_t *data = zframe_data(data_frame);
+            size_t offset = 0;
+            while (offset + sizeof(uint16_t) <= zframe_size(data_frame)) {
+                uint16_t data_size_words;
+                memcpy(&data_size_words, data + offset, sizeof(uint16_t));
+                offset += (1 + data_size_words) * sizeof(uint16_t);
+                pair->received++;
+            }
+        }
+        pair->last_received_ns = time_now_ns();
+        zmsg_destroy(&msg);
+    }
+
+    return NULL;
+}
+
+static void bench_router(struct osd_log_ctx *log_ctx,
+                         unsigned int router_threads, bool cross)
+{
+    osd_result rv;
+    int pthread_rv;
+
+    struct osd_hostctrl_options options = {
+        .router_threads = router_threads,
+    };
+    struct osd_hostctrl_ctx *hostctrl_ctx;
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, log_ctx,
+                                       BENCH_HOSTCTRL_ADDRESS, &options);
+    assert(OSD_SUCCEEDED(rv));
+    rv = osd_hostctrl_start(hostctrl_ctx);
+    assert(OSD_SUCCEEDED(rv));
+
+    struct bench_pair pairs[BENCH_PAIR_CNT];
+    memset(pairs, 0, sizeof(pairs));
+    for (unsigned int i = 0; i < BENCH_PAIR_CNT; i++) {
+        unsigned int sender_shard = i % router_threads;
+        unsigned int receiver_shard =
+            cross ? (i + 1) % router_threads : sender_shard;
+        pairs[i].sender = connect_module(
+            osd_hostctrl_get_router_address(hostctrl_ctx, sender_shard),
+            &pairs[i].sender_diaddr);
+        pairs[i].receiver = connect_module(
+            osd_hostctrl_get_router_address(hostctrl_ctx, receiver_shard),
+            &pairs[i].receiver_diaddr);
+    }
+
+    uint64_t start_ns = time_now_ns();
+    for (unsigned int i = 0; i < BENCH_PAIR_CNT; i++) {
+        pthread_rv = pthread_create(&pairs[i].receiver_thread, NULL,
+                                    receiver_thread, &pairs[i]);
+        assert(pthread_rv == 0);
+        pthread_rv = pthread_create(&pairs[i].sender_thread, NULL,
+                                    sender_thread, &pairs[i]);
+        assert(pthread_rv == 0);
+    }
+
+    uint64_t received = 0;
+    uint64_t end_ns = start_ns;
+    for (unsigned int i = 0; i < BENCH_PAIR_CNT; i++) {
+        pthread_rv = pthread_join(pairs[i].sender_thread, NULL);
+        assert(pthread_rv == 0);
+        pthread_rv = pthread_join(pairs[i].receiver_thread, NULL);
+        assert(pthread_rv == 0);
+
+        received += pairs[i].received;
+        if (pairs[i].last_received_ns > end_ns) {
+            end_ns = pairs[i].last_received_ns;
+        }
+        zsock_destroy(&pairs[i].sender);
+        zsock_destroy(&pairs[i].receiver);
+    }
+
+    osd_hostctrl_stop(hostctrl_ctx);
+    osd_hostctrl_free(&hostctrl_ctx);
+
+    uint64_t sent = (uint64_t)BENCH_PAIR_CNT * BENCH_BATCH_CNT * BENCH_BATCH_PKGS;
+    double duration_s = (end_ns - start_ns) / 1e9;
+    printf("%-8u %-6s %14.0f %9.1f\n", router_threads, cross ? "cross" : "local",
+           duration_s > 0 ? received / duration_s : 0.0,
+           100.0 * received / sent);
+}
+
+int main(int argc, char **argv)
+{
+    osd_result rv;
+
+    struct osd_log_ctx *log_ctx;
+    rv = osd_log_new(&log_ctx, LOG_ERR, NULL);
+    assert(OSD_SUCCEEDED(rv));
+
+    printf("%-8s %-6s %14s %9s\n", "threads", "mode", "pkgs/s",
+           "recv [%]");
+    for (unsigned int t = 1; t <= BENCH_ROUTER_THREADS_MAX; t *= 2) {
+        bench_router(log_ctx, t, false);
+        if (t > 1) {
+            bench_router(log_ctx, t, true);
+        }
+    }
+
+    osd_log_free(&log_ctx);
+    return 0;
+}
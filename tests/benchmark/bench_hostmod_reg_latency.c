@@ -0,0 +1,206 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Benchmark: latency of synchronous register reads
+ *
+ * Compares register reads through the I/O thread of the host module with
+ * direct register accesses (OSD_HOSTMOD_REG_ACCESS_DIRECT). A host controller
+ * routes the requests to a simulated device, which is registered as gateway
+ * for subnet 0 and answers each read request immediately.
+ */
+
+#include <osd/hostctrl.h>
+#include <osd/hostmod.h>
+#include <osd/osd.h>
+#include <osd/packet.h>
+
+#include <assert.h>
+#include <czmq.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Address of the host controller */
+#define BENCH_HOSTCTRL_ADDRESS "inproc://bench-hostctrl"
+
+/** Subnet of the simulated device */
+#define BENCH_DEVICE_SUBNET 0
+
+/** Number of register reads per mode */
+#define BENCH_READ_CNT 20000
+
+static volatile int device_ready;
+static volatile int device_stop;
+
+static uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_uint64(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a;
+    uint64_t vb = *(const uint64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+/**
+ * Simulated device: respond to all 16 bit register read requests
+ */
+static void *device_thread(void *arg)
+{
+    osd_result osd_rv;
+    int rv;
+
+    zsock_t *sock = zsock_new_dealer(BENCH_HOSTCTRL_ADDRESS);
+    assert(sock);
+    zsock_set_rcvtimeo(sock, 100);
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_addstr(msg, "M");
+    zmsg_addstrf(msg, "GW_REGISTER %u", BENCH_DEVICE_SUBNET);
+    rv = zmsg_send(&msg, sock);
+    assert(rv == 0);
+    zmsg_t *ack = zmsg_recv(sock);
+    assert(ack);
+    zmsg_destroy(&ack);
+    device_ready = 1;
+
+    struct osd_packet *resp;
+    osd_rv = osd_packet_new(&resp, osd_packet_sizeconv_payload2data(1));
+    assert(OSD_SUCCEEDED(osd_rv));
+
+    while (!device_stop) {
+        msg = zmsg_recv(sock);
+        if (!msg) {
+            continue;
+        }
+
+        zframe_t *type_frame = zmsg_first(msg);
+        zframe_t *data_frame = zmsg_next(msg);
+        struct osd_packet_view req;
+        if (!zframe_streq(type_frame, "D") ||
+            OSD_FAILED(osd_packet_view_from_zframe(&req, data_frame))) {
+            zmsg_destroy(&msg);
+            continue;
+        }
+
+        osd_packet_set_header(resp, osd_packet_view_get_src(&req),
+                              osd_packet_view_get_dest(&req),
+                              OSD_PACKET_TYPE_REG, RESP_READ_REG_SUCCESS_16);
+        resp->data.payload[0] = osd_packet_view_get_payload(&req)[0];
+        zmsg_destroy(&msg);
+
+        msg = zmsg_new();
+        zmsg_addstr(msg, "D");
+        zmsg_addmem(msg, resp->data_raw, osd_packet_sizeof(resp));
+        rv = zmsg_send(&msg, sock);
+        assert(rv == 0);
+    }
+
+    osd_packet_free(&resp);
+    zsock_destroy(&sock);
+    return NULL;
+}
+
+static void bench_mode(struct osd_log_ctx *log_ctx, const char *name,
+                       enum osd_hostmod_reg_access_mode mode,
+                       uint64_t *latencies_ns)
+{
+    osd_result rv;
+    struct osd_hostmod_ctx *hostmod_ctx;
+
+    rv = osd_hostmod_new(&hostmod_ctx, log_ctx, BENCH_HOSTCTRL_ADDRESS, NULL,
+                         NULL);
+    assert(OSD_SUCCEEDED(rv));
+    osd_hostmod_set_reg_access_mode(hostmod_ctx, mode);
+    rv = osd_hostmod_connect(hostmod_ctx);
+    assert(OSD_SUCCEEDED(rv));
+
+    uint16_t diaddr = osd_diaddr_build(BENCH_DEVICE_SUBNET, 0);
+    for (size_t i = 0; i < BENCH_READ_CNT; i++) {
+        uint16_t reg_val;
+        uint64_t start_ns = time_now_ns();
+        rv = osd_hostmod_reg_read(hostmod_ctx, &reg_val, diaddr, i & 0xffff,
+                                  16, 0);
+        latencies_ns[i] = time_now_ns() - start_ns;
+        assert(OSD_SUCCEEDED(rv));
+        assert(reg_val == (i & 0xffff));
+    }
+
+    rv = osd_hostmod_disconnect(hostmod_ctx);
+    assert(OSD_SUCCEEDED(rv));
+    osd_hostmod_free(&hostmod_ctx);
+
+    uint64_t total_ns = 0;
+    for (size_t i = 0; i < BENCH_READ_CNT; i++) {
+        total_ns += latencies_ns[i];
+    }
+    qsort(latencies_ns, BENCH_READ_CNT, sizeof(uint64_t), cmp_uint64);
+
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", name,
+           total_ns / 1e3 / BENCH_READ_CNT,
+           latencies_ns[BENCH_READ_CNT / 2] / 1e3,
+           latencies_ns[BENCH_READ_CNT * 99 / 100] / 1e3,
+           latencies_ns[BENCH_READ_CNT - 1] / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+    osd_result rv;
+    int pthread_rv;
+
+    struct osd_log_ctx *log_ctx;
+    rv = osd_log_new(&log_ctx, LOG_ERR, NULL);
+    assert(OSD_SUCCEEDED(rv));
+
+    struct osd_hostctrl_ctx *hostctrl_ctx;
+    rv = osd_hostctrl_new(&hostctrl_ctx, log_ctx, BENCH_HOSTCTRL_ADDRESS);
+    assert(OSD_SUCCEEDED(rv));
+    rv = osd_hostctrl_start(hostctrl_ctx);
+    assert(OSD_SUCCEEDED(rv));
+
+    pthread_t thread;
+    pthread_rv = pthread_create(&thread, NULL, device_thread, NULL);
+    assert(pthread_rv == 0);
+    while (!device_ready) {
+        usleep(1000);
+    }
+
+    uint64_t *latencies_ns = malloc(BENCH_READ_CNT * sizeof(uint64_t));
+    assert(latencies_ns);
+
+    printf("%-10s %10s %10s %10s %10s\n", "mode", "avg [us]", "p50 [us]",
+           "p99 [us]", "max [us]");
+    bench_mode(log_ctx, "iothread", OSD_HOSTMOD_REG_ACCESS_IOTHREAD,
+               latencies_ns);
+    bench_mode(log_ctx, "direct", OSD_HOSTMOD_REG_ACCESS_DIRECT, latencies_ns);
+
+    free(latencies_ns);
+
+    device_stop = 1;
+    pthread_rv = pthread_join(thread, NULL);
+    assert(pthread_rv == 0);
+
+    osd_hostctrl_stop(hostctrl_ctx);
+    osd_hostctrl_free(&hostctrl_ctx);
+    osd_log_free(&log_ctx);
+    return 0;
+}
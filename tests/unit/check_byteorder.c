@@ -0,0 +1,104 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_byteorder"
+
+#include "testutil.h"
+
+#include "byteorder.h"
+
+#define TEST_BUF_WORDS 100
+
+static void fill_buf(uint16_t *buf, size_t words)
+{
+    for (size_t w = 0; w < words; w++) {
+        buf[w] = (((w * 7 + 1) & 0xff) << 8) | ((w * 3 + 2) & 0xff);
+    }
+}
+
+static void check_swapped(const uint16_t *buf, size_t words)
+{
+    for (size_t w = 0; w < words; w++) {
+        uint16_t exp = (((w * 3 + 2) & 0xff) << 8) | ((w * 7 + 1) & 0xff);
+        ck_assert_uint_eq(buf[w], exp);
+    }
+}
+
+/**
+ * Check all implementations supported by the CPU for various buffer sizes
+ * and alignments (to cover the vector loops and the scalar tail handling)
+ */
+START_TEST(test_byteorder_bswap16_impls)
+{
+    size_t impl_cnt;
+    const struct byteorder_bswap16_impl *impls =
+        byteorder_bswap16_get_impls(&impl_cnt);
+    ck_assert_uint_ge(impl_cnt, 1);
+    ck_assert_str_eq(impls[0].name, "scalar");
+
+    uint16_t src[TEST_BUF_WORDS + 1];
+    uint16_t dst[TEST_BUF_WORDS + 1];
+
+    for (size_t i = 0; i < impl_cnt; i++) {
+        for (size_t offset = 0; offset < 2; offset++) {
+            for (size_t words = 0; words < TEST_BUF_WORDS; words++) {
+                // copy
+                fill_buf(src + offset, words);
+                dst[offset + words] = 0xabcd;
+                impls[i].fn(dst + offset, src + offset, words);
+                check_swapped(dst + offset, words);
+                ck_assert_uint_eq(dst[offset + words], 0xabcd);
+
+                // in place
+                fill_buf(dst + offset, words);
+                impls[i].fn(dst + offset, dst + offset, words);
+                check_swapped(dst + offset, words);
+                ck_assert_uint_eq(dst[offset + words], 0xabcd);
+            }
+        }
+    }
+}
+END_TEST
+
+START_TEST(test_byteorder_be16_native)
+{
+    uint16_t buf[TEST_BUF_WORDS];
+    const uint8_t be_bytes[2] = { 0x12, 0x34 };
+
+    memcpy(&buf[0], be_bytes, sizeof(uint16_t));
+    byteorder_be16_to_native(buf, buf, 1);
+    ck_assert_uint_eq(buf[0], 0x1234);
+
+    byteorder_native_to_be16(buf, buf, 1);
+    ck_assert_int_eq(memcmp(buf, be_bytes, sizeof(uint16_t)), 0);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_byteorder_bswap16_impls);
+    tcase_add_test(tc_core, test_byteorder_be16_native);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -80,6 +80,33 @@ START_TEST(test_cpus_stop)
 }
 END_TEST
 
+START_TEST(test_system_reset)
+{
+    osd_result rv;
+
+    mock_hostmod_expect_reg_read16(0x0000,
+                                   osd_diaddr_build(subnet_addr, 0),
+                                   OSD_REG_SCM_SYSRST,
+                                   OSD_OK);
+    mock_hostmod_expect_reg_write16(0x0001,
+                                    osd_diaddr_build(subnet_addr, 0),
+                                    OSD_REG_SCM_SYSRST,
+                                    OSD_OK);
+    mock_hostmod_expect_reg_read16(0x0001,
+                                   osd_diaddr_build(subnet_addr, 0),
+                                   OSD_REG_SCM_SYSRST,
+                                   OSD_OK);
+    mock_hostmod_expect_reg_write16(0x0000,
+                                    osd_diaddr_build(subnet_addr, 0),
+                                    OSD_REG_SCM_SYSRST,
+                                    OSD_OK);
+
+    rv = osd_cl_scm_system_reset(mock_hostmod_get_ctx(), subnet_addr);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(mock_hostmod_get_reg_cache_invalidate_cnt(), 1);
+}
+END_TEST
+
 START_TEST(test_get_subnetinfo)
 {
     osd_result rv;
@@ -118,6 +145,7 @@ Suite *suite(void)
     tcase_add_checked_fixture(tc_core, setup, teardown);
     tcase_add_test(tc_core, test_cpus_start);
     tcase_add_test(tc_core, test_cpus_stop);
+    tcase_add_test(tc_core, test_system_reset);
     tcase_add_test(tc_core, test_get_subnetinfo);
     suite_add_tcase(s, tc_core);
 
@@ -46,6 +46,7 @@ void setup_hostmod(void)
     ck_assert_ptr_ne(coretracelogger_ctx, NULL);
 
     // connect
+    mock_host_controller_expect_router_thread_req(target_subnet_addr);
     mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr);
 
     rv = osd_coretracelogger_connect(coretracelogger_ctx);
@@ -55,6 +56,7 @@ void setup_hostmod(void)
 void teardown_hostmod(void)
 {
     osd_result rv;
+    mock_host_controller_expect_diaddr_release();
     rv = osd_coretracelogger_disconnect(coretracelogger_ctx);
     ck_assert_int_eq(rv, OSD_OK);
 
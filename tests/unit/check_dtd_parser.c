@@ -0,0 +1,169 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_dtd_parser"
+
+#include "testutil.h"
+
+#include "dtd_parser.h"
+
+#include <osd/packet.h>
+
+#define TEST_PKG_CNT 20
+
+/** Maximum size of the test stream in bytes */
+#define TEST_STREAM_SIZE_MAX (TEST_PKG_CNT * 2 * (1 + 3 + TEST_PKG_CNT))
+
+/**
+ * Create a big endian stream of DTDs
+ *
+ * Packet i has i payload words. If @p with_invalid is set, an invalid DTD
+ * (too short for a DI packet) is inserted before each packet.
+ *
+ * @return size of the stream in bytes
+ */
+static size_t create_stream(uint8_t *stream, bool with_invalid)
+{
+    size_t pos = 0;
+    for (unsigned int i = 0; i < TEST_PKG_CNT; i++) {
+        if (with_invalid) {
+            stream[pos++] = 0;
+            stream[pos++] = 1;
+            stream[pos++] = 0xff;
+            stream[pos++] = 0xff;
+        }
+
+        unsigned int data_words = osd_packet_sizeconv_payload2data(i);
+        stream[pos++] = data_words >> 8;
+        stream[pos++] = data_words & 0xff;
+        for (unsigned int w = 0; w < data_words; w++) {
+            uint16_t word = (i << 8) | w;
+            stream[pos++] = word >> 8;
+            stream[pos++] = word & 0xff;
+        }
+    }
+    return pos;
+}
+
+static void check_pkg(const struct osd_packet_view *pkg, unsigned int i)
+{
+    ck_assert_uint_eq(pkg->data_size_words,
+                      osd_packet_sizeconv_payload2data(i));
+    for (unsigned int w = 0; w < pkg->data_size_words; w++) {
+        ck_assert_uint_eq(pkg->data_raw[w], (i << 8) | w);
+    }
+}
+
+/**
+ * Feed a stream into the parser in chunks of @p rx_size bytes and check the
+ * parsed packets
+ */
+static void check_stream(size_t chunk_size, size_t rx_size, size_t max_pkgs,
+                         bool with_invalid)
+{
+    uint8_t stream[TEST_STREAM_SIZE_MAX * 2];
+    size_t stream_size = create_stream(stream, with_invalid);
+    size_t stream_pos = 0;
+
+    struct dtd_parser *parser;
+    dtd_parser_new(&parser, chunk_size);
+
+    struct osd_packet_view pkgs[TEST_PKG_CNT];
+    unsigned int pkg_idx = 0;
+    while (pkg_idx < TEST_PKG_CNT) {
+        uint8_t *buf;
+        size_t buf_size;
+        dtd_parser_get_rx_space(parser, &buf, &buf_size);
+        ck_assert_uint_le(buf_size, chunk_size);
+
+        size_t size = rx_size;
+        if (size > buf_size) {
+            size = buf_size;
+        }
+        if (size > stream_size - stream_pos) {
+            size = stream_size - stream_pos;
+        }
+        memcpy(buf, stream + stream_pos, size);
+        stream_pos += size;
+        dtd_parser_rx_done(parser, size);
+
+        if (dtd_parser_bytes_missing(parser)) {
+            ck_assert_uint_lt(stream_pos, stream_size);
+            continue;
+        }
+
+        size_t pkg_cnt = dtd_parser_parse(parser, pkgs, max_pkgs);
+        ck_assert_uint_le(pkg_cnt, max_pkgs);
+        for (size_t i = 0; i < pkg_cnt; i++) {
+            check_pkg(&pkgs[i], pkg_idx++);
+        }
+    }
+
+    ck_assert_uint_eq(stream_pos, stream_size);
+    ck_assert_uint_eq(dtd_parser_get_invalid_cnt(parser),
+                      with_invalid ? TEST_PKG_CNT : 0);
+
+    dtd_parser_free(&parser);
+    ck_assert_ptr_eq(parser, NULL);
+}
+
+START_TEST(test_dtd_parser_chunks)
+{
+    // whole stream at once
+    check_stream(TEST_STREAM_SIZE_MAX, TEST_STREAM_SIZE_MAX, TEST_PKG_CNT,
+                 false);
+
+    // byte by byte, with odd sizes and DTDs split across reads
+    for (size_t rx_size = 1; rx_size < 16; rx_size++) {
+        check_stream(16, rx_size, TEST_PKG_CNT, false);
+    }
+
+    // chunk size smaller than a DTD
+    check_stream(3, 3, TEST_PKG_CNT, false);
+}
+END_TEST
+
+START_TEST(test_dtd_parser_max_pkgs)
+{
+    check_stream(TEST_STREAM_SIZE_MAX, TEST_STREAM_SIZE_MAX, 1, false);
+    check_stream(TEST_STREAM_SIZE_MAX, 100, 3, false);
+}
+END_TEST
+
+START_TEST(test_dtd_parser_invalid)
+{
+    check_stream(TEST_STREAM_SIZE_MAX, TEST_STREAM_SIZE_MAX, TEST_PKG_CNT,
+                 true);
+    check_stream(16, 5, TEST_PKG_CNT, true);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_dtd_parser_chunks);
+    tcase_add_test(tc_core, test_dtd_parser_max_pkgs);
+    tcase_add_test(tc_core, test_dtd_parser_invalid);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,196 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_event_consumer"
+
+#include "testutil.h"
+
+#include "event_consumer.h"
+#include "packet_ring.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/** Smallest possible ring capacity in words */
+#define TEST_RING_CAPACITY_WORDS (2 * (1 + UINT16_MAX))
+
+/** Number of packets exchanged in each test */
+#define TEST_PKG_CNT 1000
+
+struct test_handler_state {
+    /** Number of packets received by the handler */
+    unsigned int pkg_cnt;
+    /** Number of calls of the batch handler */
+    unsigned int call_cnt;
+    /** The handler waits until this flag is cleared */
+    bool blocked;
+};
+
+static osd_result test_handler(void *arg, struct osd_packet *pkg)
+{
+    struct test_handler_state *state = arg;
+
+    // packets are handled in order
+    ck_assert_uint_eq(pkg->data_size_words, 4);
+    ck_assert_uint_eq(pkg->data_raw[3], state->pkg_cnt & 0xffff);
+    state->pkg_cnt++;
+
+    while (__atomic_load_n(&state->blocked, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+
+    osd_packet_free(&pkg);
+    return OSD_OK;
+}
+
+static osd_result test_batch_handler(void *arg,
+                                     const struct osd_packet_view *pkgs,
+                                     size_t pkg_cnt)
+{
+    struct test_handler_state *state = arg;
+
+    ck_assert_uint_gt(pkg_cnt, 0);
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        ck_assert_uint_eq(pkgs[i].data_size_words, 4);
+        ck_assert_uint_eq(pkgs[i].data_raw[3], state->pkg_cnt & 0xffff);
+        state->pkg_cnt++;
+    }
+    state->call_cnt++;
+
+    return OSD_OK;
+}
+
+static void push_test_pkgs(struct event_consumer *consumer, unsigned int cnt)
+{
+    for (unsigned int i = 0; i < cnt; i++) {
+        uint16_t data[4] = { 0x0001, 0x0002, 0x0000, i & 0xffff };
+        struct osd_packet_view pkg = {
+            .data_size_words = 4,
+            .data_raw = data,
+        };
+        event_consumer_push(consumer, &pkg);
+    }
+}
+
+START_TEST(test_event_consumer_flush)
+{
+    struct event_consumer *consumer;
+    struct test_handler_state state = { 0 };
+    struct event_consumer_stats stats;
+
+    event_consumer_new(&consumer, TEST_RING_CAPACITY_WORDS, test_handler,
+                       &state);
+
+    push_test_pkgs(consumer, TEST_PKG_CNT);
+    event_consumer_flush(consumer);
+    ck_assert_uint_eq(state.pkg_cnt, TEST_PKG_CNT);
+
+    event_consumer_get_stats(consumer, &stats);
+    ck_assert_uint_eq(stats.events, TEST_PKG_CNT);
+    ck_assert_uint_eq(stats.queue_fill_bytes, 0);
+    ck_assert_uint_gt(stats.queue_fill_max_bytes, 0);
+    ck_assert_uint_ge(stats.handler_time_total_ns, stats.handler_time_max_ns);
+
+    event_consumer_free(&consumer);
+    ck_assert_ptr_eq(consumer, NULL);
+}
+END_TEST
+
+/**
+ * The batch handler is called for multiple packets at once, in order
+ */
+START_TEST(test_event_consumer_batch_handler)
+{
+    struct event_consumer *consumer;
+    struct test_handler_state state = { 0 };
+    struct event_consumer_stats stats;
+
+    event_consumer_new_batch(&consumer, TEST_RING_CAPACITY_WORDS,
+                             test_batch_handler, &state);
+
+    push_test_pkgs(consumer, TEST_PKG_CNT);
+    event_consumer_flush(consumer);
+    ck_assert_uint_eq(state.pkg_cnt, TEST_PKG_CNT);
+    ck_assert_uint_le(state.call_cnt, TEST_PKG_CNT);
+
+    event_consumer_get_stats(consumer, &stats);
+    ck_assert_uint_eq(stats.events, TEST_PKG_CNT);
+    ck_assert_uint_eq(stats.queue_fill_bytes, 0);
+
+    event_consumer_free(&consumer);
+}
+END_TEST
+
+static void *unblock_handler_thread(void *state_void)
+{
+    struct test_handler_state *state = state_void;
+
+    usleep(100 * 1000);
+    __atomic_store_n(&state->blocked, false, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * A blocked handler stalls the producer, and all packets are handled before
+ * the consumer is freed
+ */
+START_TEST(test_event_consumer_blocked_handler)
+{
+    struct event_consumer *consumer;
+    struct test_handler_state state = { .blocked = true };
+    struct event_consumer_stats stats;
+    pthread_t thread;
+    int rv;
+
+    event_consumer_new(&consumer, TEST_RING_CAPACITY_WORDS, test_handler,
+                       &state);
+
+    rv = pthread_create(&thread, NULL, unblock_handler_thread, &state);
+    ck_assert_int_eq(rv, 0);
+
+    // five words per packet (including the size word in the ring): the
+    // packets don't fit into the ring
+    const unsigned int pkg_cnt = TEST_RING_CAPACITY_WORDS / 5 + TEST_PKG_CNT;
+    push_test_pkgs(consumer, pkg_cnt);
+
+    rv = pthread_join(thread, NULL);
+    ck_assert_int_eq(rv, 0);
+
+    event_consumer_get_stats(consumer, &stats);
+    ck_assert_uint_gt(stats.queue_stalls, 0);
+    ck_assert_uint_ge(stats.handler_time_max_ns, 10 * 1000 * 1000);
+
+    event_consumer_free(&consumer);
+    ck_assert_uint_eq(state.pkg_cnt, pkg_cnt);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_event_consumer_flush);
+    tcase_add_test(tc_core, test_event_consumer_batch_handler);
+    tcase_add_test(tc_core, test_event_consumer_blocked_handler);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
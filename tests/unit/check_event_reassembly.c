@@ -0,0 +1,270 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_event_reassembly"
+
+#include "testutil.h"
+
+#include "event_reassembly.h"
+
+/** Number of payload words in each test packet */
+#define TEST_PAYLOAD_WORDS 4
+
+/** The last packet returned by get_test_pkg() */
+static struct osd_packet *test_pkg;
+
+/**
+ * Create a view on an EVENT packet from @p src with payload @p seq, seq + 1,
+ * ...
+ */
+static struct osd_packet_view get_test_pkg(unsigned int src,
+                                           unsigned int type_sub,
+                                           unsigned int seq)
+{
+    osd_result rv;
+
+    osd_packet_free(&test_pkg);
+    rv = osd_packet_new(&test_pkg,
+                        osd_packet_sizeconv_payload2data(TEST_PAYLOAD_WORDS));
+    ck_assert_int_eq(rv, OSD_OK);
+    rv = osd_packet_set_header(test_pkg, 0, src, OSD_PACKET_TYPE_EVENT,
+                               type_sub);
+    ck_assert_int_eq(rv, OSD_OK);
+    for (unsigned int w = 0; w < TEST_PAYLOAD_WORDS; w++) {
+        test_pkg->data.payload[w] = (seq + w) & 0xffff;
+    }
+
+    struct osd_packet_view pkg = {
+        .data_size_words = test_pkg->data_size_words,
+        .data_raw = test_pkg->data_raw,
+    };
+    return pkg;
+}
+
+/**
+ * Add the packet returned by get_test_pkg() to the reassembly
+ *
+ * @return a copy of the completed event, or NULL
+ */
+static struct osd_packet *add_test_pkg(struct event_reassembly *reassembly,
+                                       unsigned int src, unsigned int type_sub,
+                                       unsigned int seq, int64_t now_ms)
+{
+    osd_result rv;
+
+    struct osd_packet_view pkg = get_test_pkg(src, type_sub, seq);
+    struct osd_packet_view event;
+    if (!event_reassembly_add(reassembly, &pkg, now_ms, &event)) {
+        return NULL;
+    }
+
+    struct osd_packet *event_pkg;
+    rv = osd_packet_new_from_view(&event_pkg, &event);
+    ck_assert_int_eq(rv, OSD_OK);
+    return event_pkg;
+}
+
+/**
+ * Check an event reassembled from @p pkg_cnt test packets
+ */
+static void check_event(struct osd_packet *event_pkg, unsigned int src,
+                        unsigned int pkg_cnt, unsigned int first_seq)
+{
+    ck_assert_ptr_ne(event_pkg, NULL);
+    ck_assert_uint_eq(osd_packet_get_src(event_pkg), src);
+    ck_assert_uint_eq(osd_packet_get_type(event_pkg), OSD_PACKET_TYPE_EVENT);
+    ck_assert_uint_eq(osd_packet_get_type_sub(event_pkg), EV_LAST);
+    ck_assert_uint_eq(event_pkg->data_size_words,
+                      3 + pkg_cnt * TEST_PAYLOAD_WORDS);
+
+    for (unsigned int p = 0; p < pkg_cnt; p++) {
+        for (unsigned int w = 0; w < TEST_PAYLOAD_WORDS; w++) {
+            ck_assert_uint_eq(
+                event_pkg->data.payload[p * TEST_PAYLOAD_WORDS + w],
+                (first_seq + p * 0x100 + w) & 0xffff);
+        }
+    }
+}
+
+START_TEST(test_event_reassembly_single)
+{
+    struct event_reassembly *reassembly;
+    struct event_reassembly_stats stats;
+
+    event_reassembly_new(&reassembly, EVENT_REASSEMBLY_MAX_BYTES_DEFAULT,
+                         EVENT_REASSEMBLY_TIMEOUT_MS_DEFAULT);
+
+    struct osd_packet *event_pkg = add_test_pkg(reassembly, 5, EV_LAST, 0, 0);
+    check_event(event_pkg, 5, 1, 0);
+    osd_packet_free(&event_pkg);
+
+    ck_assert(!event_reassembly_has_partial(reassembly));
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.completed, 0);
+    ck_assert_uint_eq(stats.partial_events, 0);
+    ck_assert_uint_eq(stats.partial_bytes, 0);
+
+    event_reassembly_free(&reassembly);
+    osd_packet_free(&test_pkg);
+    ck_assert_ptr_eq(reassembly, NULL);
+}
+END_TEST
+
+/**
+ * Reassemble events of many sources sending interleaved packets
+ */
+START_TEST(test_event_reassembly_interleaved)
+{
+    struct event_reassembly *reassembly;
+    struct event_reassembly_stats stats;
+    const unsigned int src_cnt = 1000;
+    const unsigned int pkg_cnt = 3;
+
+    event_reassembly_new(&reassembly, EVENT_REASSEMBLY_MAX_BYTES_DEFAULT,
+                         EVENT_REASSEMBLY_TIMEOUT_MS_DEFAULT);
+
+    for (unsigned int p = 0; p < pkg_cnt - 1; p++) {
+        for (unsigned int src = 0; src < src_cnt; src++) {
+            struct osd_packet *event_pkg =
+                add_test_pkg(reassembly, src * 61, EV_CONT, src + p * 0x100, 0);
+            ck_assert_ptr_eq(event_pkg, NULL);
+        }
+    }
+
+    ck_assert(event_reassembly_has_partial(reassembly));
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.partial_events, src_cnt);
+    ck_assert_uint_eq(stats.partial_bytes,
+                      src_cnt * (3 + 2 * TEST_PAYLOAD_WORDS) * 2);
+
+    for (unsigned int src = 0; src < src_cnt; src++) {
+        struct osd_packet *event_pkg = add_test_pkg(
+            reassembly, src * 61, EV_LAST, src + (pkg_cnt - 1) * 0x100, 0);
+        check_event(event_pkg, src * 61, pkg_cnt, src);
+        osd_packet_free(&event_pkg);
+    }
+
+    ck_assert(!event_reassembly_has_partial(reassembly));
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.completed, src_cnt);
+    ck_assert_uint_eq(stats.partial_events, 0);
+    ck_assert_uint_eq(stats.partial_bytes, 0);
+
+    event_reassembly_free(&reassembly);
+    osd_packet_free(&test_pkg);
+}
+END_TEST
+
+/**
+ * Discard events growing beyond the maximum size
+ */
+START_TEST(test_event_reassembly_overflow)
+{
+    struct event_reassembly *reassembly;
+    struct event_reassembly_stats stats;
+    struct osd_packet *event_pkg;
+
+    // room for the header and the payload of two packets
+    event_reassembly_new(&reassembly, (3 + 2 * TEST_PAYLOAD_WORDS) * 2,
+                         EVENT_REASSEMBLY_TIMEOUT_MS_DEFAULT);
+
+    // an event of three packets is discarded completely
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x000, 0), NULL);
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x100, 0), NULL);
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x200, 0), NULL);
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_LAST, 0x300, 0), NULL);
+
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.overflowed, 1);
+    ck_assert_uint_eq(stats.completed, 0);
+    ck_assert_uint_eq(stats.partial_events, 0);
+    ck_assert_uint_eq(stats.partial_bytes, 0);
+
+    // the next event of the same source fits
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x10, 0), NULL);
+    event_pkg = add_test_pkg(reassembly, 1, EV_LAST, 0x110, 0);
+    check_event(event_pkg, 1, 2, 0x10);
+    osd_packet_free(&event_pkg);
+
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.overflowed, 1);
+    ck_assert_uint_eq(stats.completed, 1);
+
+    event_reassembly_free(&reassembly);
+    osd_packet_free(&test_pkg);
+}
+END_TEST
+
+/**
+ * Discard partial events which didn't receive packets for the timeout
+ */
+START_TEST(test_event_reassembly_timeout)
+{
+    struct event_reassembly *reassembly;
+    struct event_reassembly_stats stats;
+    struct osd_packet *event_pkg;
+
+    event_reassembly_new(&reassembly, EVENT_REASSEMBLY_MAX_BYTES_DEFAULT, 100);
+
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x000, 0), NULL);
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 2, EV_CONT, 0x000, 50), NULL);
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 1, EV_CONT, 0x100, 60), NULL);
+
+    ck_assert_uint_eq(event_reassembly_expire(reassembly, 149), 0);
+    // source 2 was not updated since 50 ms
+    ck_assert_uint_eq(event_reassembly_expire(reassembly, 150), 1);
+
+    event_reassembly_get_stats(reassembly, &stats);
+    ck_assert_uint_eq(stats.timed_out, 1);
+    ck_assert_uint_eq(stats.partial_events, 1);
+    ck_assert_uint_eq(stats.partial_bytes, (3 + 2 * TEST_PAYLOAD_WORDS) * 2);
+
+    // source 1 is still complete
+    event_pkg = add_test_pkg(reassembly, 1, EV_LAST, 0x200, 150);
+    check_event(event_pkg, 1, 3, 0x000);
+    osd_packet_free(&event_pkg);
+
+    // source 2 starts over
+    ck_assert_ptr_eq(add_test_pkg(reassembly, 2, EV_CONT, 0x020, 150), NULL);
+    event_pkg = add_test_pkg(reassembly, 2, EV_LAST, 0x120, 150);
+    check_event(event_pkg, 2, 2, 0x020);
+    osd_packet_free(&event_pkg);
+
+    ck_assert(!event_reassembly_has_partial(reassembly));
+    ck_assert_uint_eq(event_reassembly_expire(reassembly, 1000), 0);
+
+    event_reassembly_free(&reassembly);
+    osd_packet_free(&test_pkg);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_event_reassembly_single);
+    tcase_add_test(tc_core, test_event_reassembly_interleaved);
+    tcase_add_test(tc_core, test_event_reassembly_overflow);
+    tcase_add_test(tc_core, test_event_reassembly_timeout);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
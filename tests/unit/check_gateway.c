@@ -39,6 +39,12 @@ pthread_cond_t packet_write_cond = PTHREAD_COND_INITIALIZER;
 
 volatile int device_is_disconnected = 0;
 
+/** Use packet_write_batch_to_device() to write to the device */
+bool use_packet_write_batch = false;
+
+/** Number of calls to packet_write_batch_to_device() */
+volatile unsigned int packet_write_batch_cnt = 0;
+
 struct device_queue_item {
     struct osd_packet *pkg;
     osd_result retcode;
@@ -103,6 +109,26 @@ ret:
     return retcode;
 }
 
+static osd_result packet_write_batch_to_device(
+    const struct osd_packet_view *pkgs, size_t pkg_cnt, void *cb_arg)
+{
+    osd_result rv;
+
+    packet_write_batch_cnt++;
+
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        struct osd_packet *pkg;
+        rv = osd_packet_new_from_view(&pkg, &pkgs[i]);
+        ck_assert_int_eq(rv, OSD_OK);
+        rv = packet_write_to_device(pkg, cb_arg);
+        osd_packet_free(&pkg);
+        if (OSD_FAILED(rv)) {
+            return rv;
+        }
+    }
+    return OSD_OK;
+}
+
 static struct osd_packet* get_test_packet(void)
 {
     osd_result rv;
@@ -138,7 +164,14 @@ static void setup_gateway(void)
 
     ck_assert_int_eq(osd_gateway_is_connected(gateway_ctx), 0);
 
+    if (use_packet_write_batch) {
+        rv = osd_gateway_set_packet_write_batch_fn(
+            gateway_ctx, packet_write_batch_to_device);
+        ck_assert_int_eq(rv, OSD_OK);
+    }
+
     // connect
+    mock_host_controller_expect_router_thread_req(test_device_subnet_addr);
     mock_host_controller_expect_mgmt_req("GW_REGISTER 0", "ACK");
 
     rv = osd_gateway_connect(gateway_ctx);
@@ -206,6 +239,22 @@ static void teardown(void)
     zlist_destroy(&packet_read_from_device_queue);
 }
 
+/**
+ * Test fixture: setup with writes to the device in batches
+ */
+static void setup_write_batch(void)
+{
+    use_packet_write_batch = true;
+    packet_write_batch_cnt = 0;
+    setup();
+}
+
+static void teardown_write_batch(void)
+{
+    teardown();
+    use_packet_write_batch = false;
+}
+
 START_TEST(test_init_base)
 {
     setup();
@@ -337,6 +386,11 @@ START_TEST(test_shutdown_device_write_err)
     // check if the gateway is now disconnected
     ck_assert_uint_eq(osd_gateway_is_connected(gateway_ctx), false);
 
+    // the failed write is not counted as transferred
+    struct osd_gateway_transfer_stats *stats =
+        osd_gateway_get_transfer_stats(gateway_ctx);
+    ck_assert_uint_eq(stats->bytes_to_device, 0);
+
     teardown();
 }
 END_TEST
@@ -421,10 +475,54 @@ START_TEST(test_core_hostctrl_to_device)
 }
 END_TEST
 
+/**
+ * Send multiple packets from the host controller to the device, and write
+ * them to the device in batches
+ */
+START_TEST(test_write_batch_hostctrl_to_device)
+{
+    const unsigned int pkg_cnt = 10;
+    struct osd_packet *pkgs[pkg_cnt];
+
+    for (unsigned int i = 0; i < pkg_cnt; i++) {
+        pkgs[i] = get_test_packet();
+        pkgs[i]->data.payload[0] = i;
+    }
+
+    // send the packets from host controller: half of them in separate data
+    // messages, the other half in one batch message
+    for (unsigned int i = 0; i < pkg_cnt / 2; i++) {
+        mock_host_controller_queue_data_packet(pkgs[i]);
+    }
+    mock_host_controller_queue_batch(&pkgs[pkg_cnt / 2], pkg_cnt / 2);
+    mock_host_controller_wait_for_event_tx();
+
+    // expect the packets to be written to the device in order
+    pthread_mutex_lock(&packet_write_mutex);
+    for (unsigned int i = 0; i < pkg_cnt; i++) {
+        struct device_queue_item *item =
+            calloc(1, sizeof(struct device_queue_item));
+        item->pkg = pkgs[i];
+        item->retcode = OSD_OK;
+        zlist_append(packet_write_to_device_queue, item);
+    }
+    pthread_cond_signal(&packet_write_cond);
+    pthread_mutex_unlock(&packet_write_mutex);
+
+    while (zlist_size(packet_write_to_device_queue) != 0) {
+        usleep(10);
+    }
+
+    // messages queued at the gateway are written together
+    ck_assert_uint_ge(packet_write_batch_cnt, 1);
+    ck_assert_uint_le(packet_write_batch_cnt, pkg_cnt / 2 + 1);
+}
+END_TEST
+
 Suite *suite(void)
 {
     Suite *s;
-    TCase *tc_init, *tc_shutdown, *tc_core;
+    TCase *tc_init, *tc_shutdown, *tc_core, *tc_write_batch;
 
     s = suite_create(TEST_SUITE_NAME);
 
@@ -451,6 +549,14 @@ Suite *suite(void)
     tcase_add_test(tc_core, test_core_hostctrl_to_device);
     suite_add_tcase(s, tc_core);
 
+    // Writes to the device in batches
+    tc_write_batch = tcase_create("WriteBatch");
+    tcase_add_checked_fixture(tc_write_batch, setup_write_batch,
+                              teardown_write_batch);
+    tcase_add_test(tc_write_batch, test_write_batch_hostctrl_to_device);
+    tcase_add_test(tc_write_batch, test_core_hostctrl_to_device);
+    suite_add_tcase(s, tc_write_batch);
+
     return s;
 }
 
@@ -19,9 +19,13 @@
 
 #include <czmq.h>
 #include <osd/hostctrl.h>
+#include <osd/hostmod.h>
 #include <osd/osd.h>
 #include <osd/packet.h>
 
+/** Maximum number of event subscriptions (HOSTCTRL_SUBSCRIPTIONS_MAX) */
+#define HOSTCTRL_SUBSCRIPTIONS_MAX 64
+
 struct osd_hostctrl_ctx *hostctrl_ctx;
 struct osd_log_ctx *log_ctx;
 
@@ -61,6 +65,204 @@ void teardown(void)
     ck_assert_ptr_eq(hostctrl_ctx, NULL);
 }
 
+/**
+ * Test fixture: setup a host controller with two routing threads
+ */
+void setup_sharded(void)
+{
+    osd_result rv;
+    struct osd_hostctrl_options options = {
+        .router_threads = 2,
+    };
+    hostctrl_ctx = NULL;
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, log_ctx,
+                                       "inproc://testing", &options);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    rv = osd_hostctrl_start(hostctrl_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+}
+
+/**
+ * Send a management request to the host controller
+ *
+ * @return the response, free with free()
+ */
+static char *client_mgmt_request(zsock_t *sock, const char *request)
+{
+    int zmq_rv;
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_addstr(msg, "M");
+    zmsg_addstr(msg, request);
+    zmq_rv = zmsg_send(&msg, sock);
+    ck_assert_int_eq(zmq_rv, 0);
+
+    msg = zmsg_recv(sock);
+    ck_assert_ptr_ne(msg, NULL);
+    char *type = zmsg_popstr(msg);
+    ck_assert_str_eq(type, "M");
+    char *response = zmsg_popstr(msg);
+    ck_assert_ptr_ne(response, NULL);
+    free(type);
+    zmsg_destroy(&msg);
+
+    return response;
+}
+
+/**
+ * Request a DI address from the host controller
+ */
+static unsigned int client_diaddr_request(zsock_t *sock)
+{
+    char *diaddr_str = client_mgmt_request(sock, "DIADDR_REQUEST");
+    char *end;
+    unsigned int diaddr = strtoul(diaddr_str, &end, 10);
+    ck_assert(!*end);
+    free(diaddr_str);
+    return diaddr;
+}
+
+/**
+ * Release the DI address of a client
+ */
+static void client_diaddr_release(zsock_t *sock, const char *exp_response)
+{
+    char *response = client_mgmt_request(sock, "DIADDR_RELEASE");
+    ck_assert_str_eq(response, exp_response);
+    free(response);
+}
+
+/**
+ * Send an EVENT_SUBSCRIBE or EVENT_UNSUBSCRIBE request
+ */
+static void client_subscription(zsock_t *sock, const char *request,
+                                unsigned int src, const char *exp_response)
+{
+    char *full_request;
+    int rv = asprintf(&full_request, "%s %u", request, src);
+    ck_assert_int_ne(rv, -1);
+    char *response = client_mgmt_request(sock, full_request);
+    ck_assert_str_eq(response, exp_response);
+    free(response);
+    free(full_request);
+}
+
+/**
+ * Check that a client doesn't receive any message
+ */
+static void client_expect_nothing(zsock_t *sock)
+{
+    zsock_set_rcvtimeo(sock, 100);
+    zmsg_t *msg = zmsg_recv(sock);
+    ck_assert_ptr_eq(msg, NULL);
+    zsock_set_rcvtimeo(sock, 1000);
+}
+
+/**
+ * Connect a client to the host controller and obtain a DI address
+ */
+static zsock_t *client_connect(const char *address, unsigned int *diaddr)
+{
+    zsock_t *sock = zsock_new_dealer(address);
+    ck_assert_ptr_ne(sock, NULL);
+    zsock_set_rcvtimeo(sock, 1000);
+
+    *diaddr = client_diaddr_request(sock);
+
+    return sock;
+}
+
+/**
+ * Send a data message with one packet per entry in @p dests
+ *
+ * The payload of each packet is its index in @p dests.
+ */
+static void client_send(zsock_t *sock, unsigned int src,
+                        const unsigned int *dests, size_t dest_cnt)
+{
+    int zmq_rv;
+
+    // a batch frame contains each packet prefixed by its size in words
+    uint8_t data[256];
+    size_t data_size = 0;
+    for (size_t i = 0; i < dest_cnt; i++) {
+        struct osd_packet *pkg;
+        osd_packet_new(&pkg, osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(pkg, dests[i], src, OSD_PACKET_TYPE_EVENT, 0);
+        pkg->data.payload[0] = i;
+
+        size_t pkg_size = osd_packet_sizeof(pkg);
+        ck_assert_uint_le(data_size + sizeof(uint16_t) + pkg_size,
+                          sizeof(data));
+        if (dest_cnt > 1) {
+            memcpy(data + data_size, &pkg->data_size_words, sizeof(uint16_t));
+            data_size += sizeof(uint16_t);
+        }
+        memcpy(data + data_size, pkg->data_raw, pkg_size);
+        data_size += pkg_size;
+        osd_packet_free(&pkg);
+    }
+
+    zmsg_t *msg = zmsg_new();
+    zmsg_addstr(msg, dest_cnt == 1 ? "D" : "B");
+    zmsg_addmem(msg, data, data_size);
+    zmq_rv = zmsg_send(&msg, sock);
+    ck_assert_int_eq(zmq_rv, 0);
+}
+
+/**
+ * Receive packets until @p exp_payloads_cnt packets have been received
+ *
+ * @param sock the client socket
+ * @param dest the expected destination of all packets
+ * @param exp_payloads the expected payload of the packets, in order
+ * @param exp_payloads_cnt the expected number of packets
+ */
+static void client_expect(zsock_t *sock, unsigned int dest,
+                          const uint16_t *exp_payloads,
+                          size_t exp_payloads_cnt)
+{
+    size_t pkg_cnt = 0;
+    while (pkg_cnt < exp_payloads_cnt) {
+        zmsg_t *msg = zmsg_recv(sock);
+        ck_assert_ptr_ne(msg, NULL);
+        zframe_t *type_frame = zmsg_first(msg);
+        zframe_t *data_frame = zmsg_next(msg);
+
+        struct osd_packet_view pkgs[16];
+        size_t msg_pkg_cnt = 0;
+        if (zframe_streq(type_frame, "D")) {
+            osd_result rv = osd_packet_view_from_zframe(&pkgs[0], data_frame);
+            ck_assert_int_eq(rv, OSD_OK);
+            msg_pkg_cnt = 1;
+        } else {
+            ck_assert(zframe_streq(type_frame, "B"));
+            const uint8_t *data = zframe_data(data_frame);
+            size_t offset = 0;
+            while (offset < zframe_size(data_frame)) {
+                ck_assert_uint_lt(msg_pkg_cnt, 16);
+                uint16_t data_size_words;
+                memcpy(&data_size_words, data + offset, sizeof(uint16_t));
+                pkgs[msg_pkg_cnt].data_size_words = data_size_words;
+                pkgs[msg_pkg_cnt].data_raw =
+                    (const uint16_t *)(data + offset + sizeof(uint16_t));
+                offset += (1 + data_size_words) * sizeof(uint16_t);
+                msg_pkg_cnt++;
+            }
+        }
+
+        for (size_t i = 0; i < msg_pkg_cnt; i++) {
+            ck_assert_uint_lt(pkg_cnt, exp_payloads_cnt);
+            ck_assert_uint_eq(osd_packet_view_get_dest(&pkgs[i]), dest);
+            ck_assert_uint_eq(osd_packet_view_get_payload(&pkgs[i])[0],
+                              exp_payloads[pkg_cnt]);
+            pkg_cnt++;
+        }
+        zmsg_destroy(&msg);
+    }
+}
+
 START_TEST(test_init_base)
 {
     setup();
@@ -68,10 +270,465 @@ START_TEST(test_init_base)
 }
 END_TEST
 
+/**
+ * Addresses of multiple routing threads
+ */
+START_TEST(test_init_router_addresses)
+{
+    osd_result rv;
+    struct osd_hostctrl_options options = {
+        .router_threads = 3,
+    };
+
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, log_ctx,
+                                       "tcp://127.0.0.1:19537", &options);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(osd_hostctrl_get_router_thread_cnt(hostctrl_ctx), 3);
+    ck_assert_str_eq(osd_hostctrl_get_router_address(hostctrl_ctx, 0),
+                     "tcp://127.0.0.1:19537");
+    ck_assert_str_eq(osd_hostctrl_get_router_address(hostctrl_ctx, 1),
+                     "tcp://127.0.0.1:19538");
+    ck_assert_str_eq(osd_hostctrl_get_router_address(hostctrl_ctx, 2),
+                     "tcp://127.0.0.1:19539");
+    osd_hostctrl_free(&hostctrl_ctx);
+
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, log_ctx,
+                                       "inproc://testing", &options);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_str_eq(osd_hostctrl_get_router_address(hostctrl_ctx, 0),
+                     "inproc://testing");
+    ck_assert_str_eq(osd_hostctrl_get_router_address(hostctrl_ctx, 2),
+                     "inproc://testing-2");
+    osd_hostctrl_free(&hostctrl_ctx);
+
+    // no port to derive the other addresses from
+    hostctrl_ctx = NULL;
+    rv = osd_hostctrl_new_with_options(&hostctrl_ctx, log_ctx, "tcp://*:*",
+                                       &options);
+    ck_assert_int_ne(rv, OSD_OK);
+    ck_assert_ptr_eq(hostctrl_ctx, NULL);
+}
+END_TEST
+
+/**
+ * Route packets between two host modules
+ */
+START_TEST(test_core_route)
+{
+    unsigned int diaddr_a, diaddr_b;
+    zsock_t *sock_a = client_connect("inproc://testing", &diaddr_a);
+    zsock_t *sock_b = client_connect("inproc://testing", &diaddr_b);
+    ck_assert_uint_ne(diaddr_a, diaddr_b);
+
+    const unsigned int dests[] = { diaddr_b, diaddr_b };
+    const uint16_t exp_payloads[] = { 0, 0, 1 };
+    client_send(sock_a, diaddr_a, dests, 1);
+    client_send(sock_a, diaddr_a, dests, 2);
+    client_expect(sock_b, diaddr_b, exp_payloads, 3);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+}
+END_TEST
+
+/**
+ * The lowest unused DI address is assigned, released addresses are reused
+ */
+START_TEST(test_core_diaddr_reuse)
+{
+    unsigned int diaddr_a, diaddr_b, diaddr_c;
+    zsock_t *sock_a = client_connect("inproc://testing", &diaddr_a);
+    zsock_t *sock_b = client_connect("inproc://testing", &diaddr_b);
+    ck_assert_uint_eq(diaddr_a, osd_diaddr_build(1, 1));
+    ck_assert_uint_eq(diaddr_b, osd_diaddr_build(1, 2));
+
+    client_diaddr_release(sock_a, "ACK");
+    client_diaddr_release(sock_a, "NACK");
+
+    zsock_t *sock_c = client_connect("inproc://testing", &diaddr_c);
+    ck_assert_uint_eq(diaddr_c, osd_diaddr_build(1, 1));
+
+    client_diaddr_release(sock_b, "ACK");
+    client_diaddr_release(sock_c, "ACK");
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+    zsock_destroy(&sock_c);
+}
+END_TEST
+
+/**
+ * All addresses of a subnet are assigned, the next request is rejected
+ */
+START_TEST(test_core_diaddr_subnet_full)
+{
+    // A host module may request multiple DI addresses.
+    zsock_t *sock = zsock_new_dealer("inproc://testing");
+    ck_assert_ptr_ne(sock, NULL);
+    zsock_set_rcvtimeo(sock, 1000);
+
+    for (unsigned int localaddr = 1; localaddr <= OSD_DIADDR_LOCAL_MAX;
+         localaddr++) {
+        ck_assert_uint_eq(client_diaddr_request(sock),
+                          osd_diaddr_build(1, localaddr));
+    }
+
+    char *response = client_mgmt_request(sock, "DIADDR_REQUEST");
+    ck_assert_str_eq(response, "NACK");
+    free(response);
+
+    // a released address is available again
+    client_diaddr_release(sock, "ACK");
+    unsigned int diaddr = client_diaddr_request(sock);
+    ck_assert_uint_eq(osd_diaddr_subnet(diaddr), 1);
+
+    for (unsigned int localaddr = 1; localaddr <= OSD_DIADDR_LOCAL_MAX;
+         localaddr++) {
+        client_diaddr_release(sock, "ACK");
+    }
+    client_diaddr_release(sock, "NACK");
+
+    zsock_destroy(&sock);
+}
+END_TEST
+
+/**
+ * Malformed messages are dropped without affecting subsequent packets
+ */
+START_TEST(test_core_route_invalid)
+{
+    int zmq_rv;
+    unsigned int diaddr_a, diaddr_b;
+    zsock_t *sock_a = client_connect("inproc://testing", &diaddr_a);
+    zsock_t *sock_b = client_connect("inproc://testing", &diaddr_b);
+
+    // message without payload
+    zmsg_t *msg = zmsg_new();
+    zmsg_addstr(msg, "D");
+    zmq_rv = zmsg_send(&msg, sock_a);
+    ck_assert_int_eq(zmq_rv, 0);
+
+    // payload too short for a packet header
+    msg = zmsg_new();
+    zmsg_addstr(msg, "D");
+    uint16_t short_pkg[2] = { diaddr_b, diaddr_a };
+    zmsg_addmem(msg, short_pkg, sizeof(short_pkg));
+    zmq_rv = zmsg_send(&msg, sock_a);
+    ck_assert_int_eq(zmq_rv, 0);
+
+    // unknown message type
+    msg = zmsg_new();
+    zmsg_addstr(msg, "X");
+    zmsg_addstr(msg, "payload");
+    zmq_rv = zmsg_send(&msg, sock_a);
+    ck_assert_int_eq(zmq_rv, 0);
+
+    const unsigned int dests[] = { diaddr_b };
+    const uint16_t exp_payloads[] = { 0 };
+    client_send(sock_a, diaddr_a, dests, 1);
+    client_expect(sock_b, diaddr_b, exp_payloads, 1);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+}
+END_TEST
+
+/**
+ * Copy events to subscribers
+ */
+START_TEST(test_core_event_subscribe)
+{
+    unsigned int diaddr_a, diaddr_b, diaddr_c;
+    zsock_t *sock_a = client_connect("inproc://testing", &diaddr_a);
+    zsock_t *sock_b = client_connect("inproc://testing", &diaddr_b);
+    zsock_t *sock_c = client_connect("inproc://testing", &diaddr_c);
+
+    // c receives a copy of all events of a
+    client_subscription(sock_c, "EVENT_SUBSCRIBE", diaddr_a, "ACK");
+
+    const unsigned int dests_single[] = { diaddr_b };
+    const unsigned int dests_single_a[] = { diaddr_a };
+    const uint16_t exp_single[] = { 0 };
+    client_send(sock_a, diaddr_a, dests_single, 1);
+    client_expect(sock_b, diaddr_b, exp_single, 1);
+    client_expect(sock_c, diaddr_b, exp_single, 1);
+
+    // events of other sources are not copied
+    client_send(sock_b, diaddr_b, dests_single_a, 1);
+    client_expect(sock_a, diaddr_a, exp_single, 1);
+    client_expect_nothing(sock_c);
+
+    // batch to a single destination
+    const unsigned int dests_batch[] = { diaddr_b, diaddr_b, diaddr_b };
+    const uint16_t exp_batch[] = { 0, 1, 2 };
+    client_send(sock_a, diaddr_a, dests_batch, 3);
+    client_expect(sock_b, diaddr_b, exp_batch, 3);
+    client_expect(sock_c, diaddr_b, exp_batch, 3);
+
+    // the subscriber doesn't get a second copy of events sent to itself
+    const unsigned int dests_mixed[] = { diaddr_b, diaddr_c };
+    const uint16_t exp_mixed_b[] = { 0 };
+    const uint16_t exp_mixed_c[] = { 1 };
+    client_send(sock_a, diaddr_a, dests_mixed, 2);
+    client_expect(sock_b, diaddr_b, exp_mixed_b, 1);
+    client_expect(sock_c, diaddr_b, exp_mixed_b, 1);
+    client_expect(sock_c, diaddr_c, exp_mixed_c, 1);
+    client_expect_nothing(sock_c);
+
+    client_subscription(sock_c, "EVENT_UNSUBSCRIBE", diaddr_a, "ACK");
+    client_subscription(sock_c, "EVENT_UNSUBSCRIBE", diaddr_a, "NACK");
+
+    client_send(sock_a, diaddr_a, dests_single, 1);
+    client_expect(sock_b, diaddr_b, exp_single, 1);
+    client_expect_nothing(sock_c);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+    zsock_destroy(&sock_c);
+}
+END_TEST
+
+/**
+ * Only host modules with a DI address can subscribe to events
+ */
+START_TEST(test_core_event_subscribe_invalid)
+{
+    zsock_t *sock = zsock_new_dealer("inproc://testing");
+    ck_assert_ptr_ne(sock, NULL);
+    zsock_set_rcvtimeo(sock, 1000);
+
+    client_subscription(sock, "EVENT_SUBSCRIBE", 4096, "NACK");
+
+    unsigned int diaddr = client_diaddr_request(sock);
+    client_subscription(sock, "EVENT_SUBSCRIBE", 65536, "NACK");
+    client_subscription(sock, "EVENT_SUBSCRIBE", 4096, "ACK");
+
+    // releasing the DI address removes the subscriptions
+    client_diaddr_release(sock, "ACK");
+    ck_assert_uint_eq(client_diaddr_request(sock), diaddr);
+    client_subscription(sock, "EVENT_UNSUBSCRIBE", 4096, "NACK");
+
+    zsock_destroy(&sock);
+}
+END_TEST
+
+/**
+ * Disconnecting a host module releases its subscriptions
+ */
+START_TEST(test_core_event_subscribe_reconnect)
+{
+    osd_result rv;
+    struct osd_hostmod_ctx *hostmod_ctx;
+
+    rv = osd_hostmod_new(&hostmod_ctx, log_ctx, "inproc://testing", NULL,
+                         NULL);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    unsigned int diaddr = 0;
+    for (unsigned int i = 0; i < HOSTCTRL_SUBSCRIPTIONS_MAX + 1; i++) {
+        rv = osd_hostmod_connect(hostmod_ctx);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        // the DI address of the previous connection was released
+        if (i == 0) {
+            diaddr = osd_hostmod_get_diaddr(hostmod_ctx);
+        }
+        ck_assert_uint_eq(osd_hostmod_get_diaddr(hostmod_ctx), diaddr);
+
+        rv = osd_hostmod_event_subscribe(hostmod_ctx, 4096);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        rv = osd_hostmod_disconnect(hostmod_ctx);
+        ck_assert_int_eq(rv, OSD_OK);
+    }
+
+    osd_hostmod_free(&hostmod_ctx);
+}
+END_TEST
+
+/**
+ * Route packets between host modules connected to different routing threads
+ */
+START_TEST(test_sharded_route)
+{
+    const char *address_0 = osd_hostctrl_get_router_address(hostctrl_ctx, 0);
+    const char *address_1 = osd_hostctrl_get_router_address(hostctrl_ctx, 1);
+    ck_assert_str_eq(address_1, "inproc://testing-1");
+
+    unsigned int diaddr_a, diaddr_b, diaddr_c;
+    zsock_t *sock_a = client_connect(address_0, &diaddr_a);
+    zsock_t *sock_b = client_connect(address_1, &diaddr_b);
+    zsock_t *sock_c = client_connect(address_0, &diaddr_c);
+    ck_assert_uint_ne(diaddr_a, diaddr_b);
+    ck_assert_uint_ne(diaddr_b, diaddr_c);
+
+    // single packet to another routing thread and back
+    const unsigned int dests_single_b[] = { diaddr_b };
+    const unsigned int dests_single_a[] = { diaddr_a };
+    const uint16_t exp_single[] = { 0 };
+    client_send(sock_a, diaddr_a, dests_single_b, 1);
+    client_expect(sock_b, diaddr_b, exp_single, 1);
+    client_send(sock_b, diaddr_b, dests_single_a, 1);
+    client_expect(sock_a, diaddr_a, exp_single, 1);
+
+    // batch split between both routing threads
+    const unsigned int dests[] = { diaddr_b, diaddr_c, diaddr_b, diaddr_b };
+    const uint16_t exp_payloads_b[] = { 0, 2, 3 };
+    const uint16_t exp_payloads_c[] = { 1 };
+    client_send(sock_a, diaddr_a, dests, 4);
+    client_expect(sock_b, diaddr_b, exp_payloads_b, 3);
+    client_expect(sock_c, diaddr_c, exp_payloads_c, 1);
+
+    struct osd_hostctrl_stats stats;
+    osd_hostctrl_get_stats(hostctrl_ctx, &stats);
+    ck_assert_uint_eq(stats.shard_ring_dropped, 0);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+    zsock_destroy(&sock_c);
+}
+END_TEST
+
+/**
+ * Clients are told which routing thread serves their subnet
+ */
+START_TEST(test_sharded_router_thread)
+{
+    const char *address_1 = osd_hostctrl_get_router_address(hostctrl_ctx, 1);
+    zsock_t *sock = zsock_new_dealer(address_1);
+    ck_assert_ptr_ne(sock, NULL);
+    zsock_set_rcvtimeo(sock, 1000);
+
+    char *response = client_mgmt_request(sock, "ROUTER_THREAD 3");
+    ck_assert_str_eq(response, "1");
+    free(response);
+    response = client_mgmt_request(sock, "ROUTER_THREAD 2");
+    ck_assert_str_eq(response, "0");
+    free(response);
+
+    char *request;
+    int rv = asprintf(&request, "ROUTER_THREAD %u", OSD_DIADDR_SUBNET_MAX + 1);
+    ck_assert_int_ne(rv, -1);
+    response = client_mgmt_request(sock, request);
+    ck_assert_str_eq(response, "NACK");
+    free(response);
+    free(request);
+
+    response = client_mgmt_request(sock, "ROUTER_THREAD x");
+    ck_assert_str_eq(response, "NACK");
+    free(response);
+
+    zsock_destroy(&sock);
+}
+END_TEST
+
+/**
+ * Route packets between host modules connected to two peer host controllers
+ */
+START_TEST(test_peer_route)
+{
+    osd_result rv;
+
+    // the peer host controller connects to the one created by the fixture
+    struct osd_hostctrl_ctx *peer_ctx = NULL;
+    rv = osd_hostctrl_new(&peer_ctx, log_ctx, "inproc://testing-peer");
+    ck_assert_int_eq(rv, OSD_OK);
+    rv = osd_hostctrl_set_subnet_addr(peer_ctx, OSD_DIADDR_SUBNET_MAX + 1);
+    ck_assert_int_ne(rv, OSD_OK);
+    rv = osd_hostctrl_set_subnet_addr(peer_ctx, 2);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(osd_hostctrl_get_subnet_addr(peer_ctx), 2);
+    rv = osd_hostctrl_add_peer(peer_ctx, "inproc://testing");
+    ck_assert_int_eq(rv, OSD_OK);
+    rv = osd_hostctrl_start(peer_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    unsigned int diaddr_a, diaddr_b, diaddr_c;
+    zsock_t *sock_a = client_connect("inproc://testing", &diaddr_a);
+    zsock_t *sock_b = client_connect("inproc://testing-peer", &diaddr_b);
+    zsock_t *sock_c = client_connect("inproc://testing", &diaddr_c);
+    ck_assert_uint_eq(osd_diaddr_subnet(diaddr_a), 1);
+    ck_assert_uint_eq(osd_diaddr_subnet(diaddr_b), 2);
+
+    // packets are dropped until both host controllers learned the subnet of
+    // the other one
+    const unsigned int dests_single_a[] = { diaddr_a };
+    zsock_set_rcvtimeo(sock_a, 100);
+    zmsg_t *msg = NULL;
+    for (int i = 0; i < 50 && !msg; i++) {
+        client_send(sock_b, diaddr_b, dests_single_a, 1);
+        msg = zmsg_recv(sock_a);
+    }
+    ck_assert_ptr_ne(msg, NULL);
+    zmsg_destroy(&msg);
+    zsock_set_rcvtimeo(sock_a, 1000);
+
+    // single packet in the other direction
+    const unsigned int dests_single_b[] = { diaddr_b };
+    const uint16_t exp_single[] = { 0 };
+    client_send(sock_a, diaddr_a, dests_single_b, 1);
+    client_expect(sock_b, diaddr_b, exp_single, 1);
+
+    // batch split between a local host module and the peer
+    const unsigned int dests[] = { diaddr_b, diaddr_c, diaddr_b };
+    const uint16_t exp_payloads_b[] = { 0, 2 };
+    const uint16_t exp_payloads_c[] = { 1 };
+    client_send(sock_a, diaddr_a, dests, 3);
+    client_expect(sock_b, diaddr_b, exp_payloads_b, 2);
+    client_expect(sock_c, diaddr_c, exp_payloads_c, 1);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+    zsock_destroy(&sock_c);
+
+    rv = osd_hostctrl_stop(peer_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostctrl_free(&peer_ctx);
+}
+END_TEST
+
+/**
+ * Copy events to a subscriber connected to another routing thread
+ */
+START_TEST(test_sharded_event_subscribe)
+{
+    const char *address_0 = osd_hostctrl_get_router_address(hostctrl_ctx, 0);
+    const char *address_1 = osd_hostctrl_get_router_address(hostctrl_ctx, 1);
+
+    unsigned int diaddr_a, diaddr_b, diaddr_c, diaddr_d;
+    zsock_t *sock_a = client_connect(address_0, &diaddr_a);
+    zsock_t *sock_b = client_connect(address_0, &diaddr_b);
+    zsock_t *sock_c = client_connect(address_1, &diaddr_c);
+    zsock_t *sock_d = client_connect(address_1, &diaddr_d);
+
+    client_subscription(sock_c, "EVENT_SUBSCRIBE", diaddr_a, "ACK");
+
+    // destination owned by the routing thread of the source: the packet is
+    // passed to the other routing thread for the subscriber only
+    const unsigned int dests_single_b[] = { diaddr_b };
+    const unsigned int dests_single_d[] = { diaddr_d };
+    const uint16_t exp_single[] = { 0 };
+    client_send(sock_a, diaddr_a, dests_single_b, 1);
+    client_expect(sock_b, diaddr_b, exp_single, 1);
+    client_expect(sock_c, diaddr_b, exp_single, 1);
+
+    // destination owned by the routing thread of the subscriber
+    client_send(sock_a, diaddr_a, dests_single_d, 1);
+    client_expect(sock_d, diaddr_d, exp_single, 1);
+    client_expect(sock_c, diaddr_d, exp_single, 1);
+    client_expect_nothing(sock_c);
+
+    zsock_destroy(&sock_a);
+    zsock_destroy(&sock_b);
+    zsock_destroy(&sock_c);
+    zsock_destroy(&sock_d);
+}
+END_TEST
+
 Suite *suite(void)
 {
     Suite *s;
-    TCase *tc_init, *tc_core;
+    TCase *tc_init, *tc_core, *tc_sharded, *tc_peer;
 
     s = suite_create(TEST_SUITE_NAME);
 
@@ -81,7 +738,31 @@ Suite *suite(void)
     // succeeds.
     tc_init = tcase_create("Init");
     tcase_add_test(tc_init, test_init_base);
+    tcase_add_test(tc_init, test_init_router_addresses);
     suite_add_tcase(s, tc_init);
 
+    tc_core = tcase_create("Core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_core_route);
+    tcase_add_test(tc_core, test_core_route_invalid);
+    tcase_add_test(tc_core, test_core_diaddr_reuse);
+    tcase_add_test(tc_core, test_core_diaddr_subnet_full);
+    tcase_add_test(tc_core, test_core_event_subscribe);
+    tcase_add_test(tc_core, test_core_event_subscribe_invalid);
+    tcase_add_test(tc_core, test_core_event_subscribe_reconnect);
+    suite_add_tcase(s, tc_core);
+
+    tc_sharded = tcase_create("Sharded");
+    tcase_add_checked_fixture(tc_sharded, setup_sharded, teardown);
+    tcase_add_test(tc_sharded, test_sharded_route);
+    tcase_add_test(tc_sharded, test_sharded_event_subscribe);
+    tcase_add_test(tc_sharded, test_sharded_router_thread);
+    suite_add_tcase(s, tc_sharded);
+
+    tc_peer = tcase_create("Peer");
+    tcase_add_checked_fixture(tc_peer, setup, teardown);
+    tcase_add_test(tc_peer, test_peer_route);
+    suite_add_tcase(s, tc_peer);
+
     return s;
 }
@@ -20,9 +20,12 @@
 
 #include <czmq.h>
 #include <osd/hostmod.h>
+#include <osd/ioreactor.h>
 #include <osd/osd.h>
 #include <osd/packet.h>
 #include <osd/reg.h>
+#include <pthread.h>
+#include <unistd.h>
 
 struct osd_hostmod_ctx *hostmod_ctx;
 struct osd_log_ctx *log_ctx;
@@ -62,6 +65,7 @@ void teardown_hostmod(void)
 
     ck_assert_int_eq(osd_hostmod_is_connected(hostmod_ctx), 1);
 
+    mock_host_controller_expect_diaddr_release();
     rv = osd_hostmod_disconnect(hostmod_ctx);
     ck_assert_int_eq(rv, OSD_OK);
 
@@ -124,6 +128,235 @@ START_TEST(test_init_hostctrl_unreachable)
 }
 END_TEST
 
+/**
+ * Use multiple host modules sharing the threads of an I/O reactor
+ */
+START_TEST(test_init_reactor)
+{
+    osd_result rv;
+    struct osd_ioreactor_ctx *ioreactor_ctx;
+    struct osd_hostmod_ctx *hostmods[3];
+
+    mock_host_controller_setup();
+    log_ctx = testutil_get_log_ctx();
+
+    rv = osd_ioreactor_new(&ioreactor_ctx, log_ctx, 2);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(osd_ioreactor_get_thread_cnt(ioreactor_ctx), 2);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        rv = osd_hostmod_new_with_reactor(&hostmods[i], log_ctx,
+                                          "inproc://testing", NULL, NULL,
+                                          ioreactor_ctx);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr + i);
+        rv = osd_hostmod_connect(hostmods[i]);
+        ck_assert_int_eq(rv, OSD_OK);
+        ck_assert_uint_eq(osd_hostmod_get_diaddr(hostmods[i]),
+                          mock_hostmod_diaddr + i);
+    }
+
+    for (unsigned int i = 0; i < 3; i++) {
+        uint16_t reg_read_result;
+        mock_host_controller_expect_reg_read(mock_hostmod_diaddr + i, 1,
+                                             0x0000, 0x1000 + i);
+
+        rv = osd_hostmod_reg_read(hostmods[i], &reg_read_result, 1, 0x0000,
+                                  16, 0);
+        ck_assert_int_eq(rv, OSD_OK);
+        ck_assert_uint_eq(reg_read_result, 0x1000 + i);
+    }
+
+    // free one module while the others stay attached to the reactor
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmods[0]);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmods[0]);
+
+    for (unsigned int i = 1; i < 3; i++) {
+        uint16_t reg_val = 0xdead;
+        mock_host_controller_expect_reg_write(mock_hostmod_diaddr + i, 1,
+                                              0x0000, reg_val);
+
+        rv = osd_hostmod_reg_write(hostmods[i], &reg_val, 1, 0x0000, 16, 0);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        mock_host_controller_expect_diaddr_release();
+        rv = osd_hostmod_disconnect(hostmods[i]);
+        ck_assert_int_eq(rv, OSD_OK);
+        osd_hostmod_free(&hostmods[i]);
+        ck_assert_ptr_eq(hostmods[i], NULL);
+    }
+
+    osd_ioreactor_free(&ioreactor_ctx);
+    ck_assert_ptr_eq(ioreactor_ctx, NULL);
+
+    mock_host_controller_teardown();
+}
+END_TEST
+
+/**
+ * test_init_reactor_hostctrl_unreachable
+ */
+struct connect_thread_state {
+    struct osd_hostmod_ctx *hostmod_ctx;
+    osd_result rv;
+    /** Set when osd_hostmod_connect() returned */
+    int done;
+};
+
+static void *connect_thread(void *arg)
+{
+    struct connect_thread_state *state = arg;
+    state->rv = osd_hostmod_connect(state->hostmod_ctx);
+    __atomic_store_n(&state->done, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+/**
+ * A host module connecting to an unreachable host controller doesn't block
+ * another host module sharing the same I/O reactor thread
+ */
+START_TEST(test_init_reactor_hostctrl_unreachable)
+{
+    osd_result rv;
+    int pthread_rv;
+    struct osd_ioreactor_ctx *ioreactor_ctx;
+    struct osd_hostmod_ctx *hostmod_unreachable;
+
+    mock_host_controller_setup();
+    log_ctx = testutil_get_log_ctx();
+
+    rv = osd_ioreactor_new(&ioreactor_ctx, log_ctx, 1);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    rv = osd_hostmod_new_with_reactor(&hostmod_ctx, log_ctx,
+                                      "inproc://testing", NULL, NULL,
+                                      ioreactor_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr);
+    rv = osd_hostmod_connect(hostmod_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    rv = osd_hostmod_new_with_reactor(&hostmod_unreachable, log_ctx,
+                                      "inproc://unreachable", NULL, NULL,
+                                      ioreactor_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct connect_thread_state state = { .hostmod_ctx = hostmod_unreachable };
+    pthread_t thread;
+    pthread_rv = pthread_create(&thread, NULL, connect_thread, &state);
+    ck_assert_int_eq(pthread_rv, 0);
+    // give the connect a head start, it waits for a response until it
+    // times out
+    usleep(100 * 1000);
+
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0000,
+                                         0x1234);
+    rv = osd_hostmod_reg_read(hostmod_ctx, &reg_read_result, 1, 0x0000, 16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(reg_read_result, 0x1234);
+    ck_assert_int_eq(__atomic_load_n(&state.done, __ATOMIC_SEQ_CST), 0);
+
+    pthread_rv = pthread_join(thread, NULL);
+    ck_assert_int_eq(pthread_rv, 0);
+    ck_assert_int_eq(state.rv, OSD_ERROR_CONNECTION_FAILED);
+    ck_assert_int_eq(osd_hostmod_is_connected(hostmod_unreachable), 0);
+    osd_hostmod_free(&hostmod_unreachable);
+
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmod_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmod_ctx);
+
+    osd_ioreactor_free(&ioreactor_ctx);
+    mock_host_controller_teardown();
+}
+END_TEST
+
+/**
+ * test_init_reactor_blocked
+ */
+static osd_result blocking_event_handler(void *arg, struct osd_packet *pkg)
+{
+    int *handler_entered = arg;
+    __atomic_store_n(handler_entered, 1, __ATOMIC_SEQ_CST);
+
+    // block the reactor thread longer than the main thread waits for it
+    sleep(2);
+
+    osd_packet_free(&pkg);
+    return OSD_OK;
+}
+
+/**
+ * Create and free host modules while their reactor thread is blocked
+ */
+START_TEST(test_init_reactor_blocked)
+{
+    osd_result rv;
+    struct osd_ioreactor_ctx *ioreactor_ctx;
+    struct osd_hostmod_ctx *hostmod_free_ctx;
+    struct osd_hostmod_ctx *hostmod_new_ctx = NULL;
+    int handler_entered = 0;
+
+    mock_host_controller_setup();
+    log_ctx = testutil_get_log_ctx();
+
+    rv = osd_ioreactor_new(&ioreactor_ctx, log_ctx, 1);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    rv = osd_hostmod_new_with_reactor(&hostmod_ctx, log_ctx,
+                                      "inproc://testing",
+                                      blocking_event_handler, &handler_entered,
+                                      ioreactor_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr);
+    rv = osd_hostmod_connect(hostmod_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    rv = osd_hostmod_new_with_reactor(&hostmod_free_ctx, log_ctx,
+                                      "inproc://testing", NULL, NULL,
+                                      ioreactor_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct osd_packet *event_pkg;
+    osd_packet_new(&event_pkg, osd_packet_sizeconv_payload2data(1));
+    osd_packet_set_header(event_pkg, 1, mock_hostmod_diaddr,
+                          OSD_PACKET_TYPE_EVENT, EV_LAST);
+    event_pkg->data.payload[0] = 0x0000;
+    mock_host_controller_queue_data_packet(event_pkg);
+    osd_packet_free(&event_pkg);
+
+    while (!__atomic_load_n(&handler_entered, __ATOMIC_SEQ_CST)) {
+        usleep(1000);
+    }
+
+    // the worker setup times out, the worker is detached again once the
+    // reactor thread attached it
+    rv = osd_hostmod_new_with_reactor(&hostmod_new_ctx, log_ctx,
+                                      "inproc://testing", NULL, NULL,
+                                      ioreactor_ctx);
+    ck_assert_int_ne(rv, OSD_OK);
+    ck_assert_ptr_eq(hostmod_new_ctx, NULL);
+
+    // freeing waits for the reactor thread
+    osd_hostmod_free(&hostmod_free_ctx);
+    ck_assert_ptr_eq(hostmod_free_ctx, NULL);
+
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmod_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmod_ctx);
+
+    // all workers were detached
+    osd_ioreactor_free(&ioreactor_ctx);
+    mock_host_controller_teardown();
+}
+END_TEST
+
 START_TEST(test_core_read_register)
 {
     osd_result rv;
@@ -188,6 +421,53 @@ END_TEST
  * Test timeout handling if a debug module doesn't respond to a register read
  * request.
  */
+/**
+ * Access registers through a direct connection of the calling thread to the
+ * host controller, which has its own DI address
+ */
+START_TEST(test_core_reg_access_direct)
+{
+    osd_result rv;
+    struct osd_hostmod_ctx *hostmod_direct_ctx;
+
+    rv = osd_hostmod_new(&hostmod_direct_ctx, log_ctx, "inproc://testing",
+                         NULL, NULL);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    osd_hostmod_set_reg_access_mode(hostmod_direct_ctx,
+                                    OSD_HOSTMOD_REG_ACCESS_DIRECT);
+
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr + 1);
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr + 2);
+    rv = osd_hostmod_connect(hostmod_direct_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(osd_hostmod_get_diaddr(hostmod_direct_ctx),
+                      mock_hostmod_diaddr + 1);
+
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr + 2, 1, 0x0000,
+                                         0x0001);
+    rv = osd_hostmod_reg_read(hostmod_direct_ctx, &reg_read_result, 1, 0x0000,
+                              16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(reg_read_result, 0x0001);
+
+    uint16_t reg_write_val = 0xcafe;
+    mock_host_controller_expect_reg_write(mock_hostmod_diaddr + 2, 1, 0x0001,
+                                          reg_write_val);
+    rv = osd_hostmod_reg_write(hostmod_direct_ctx, &reg_write_val, 1, 0x0001,
+                               16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // both DI addresses are released
+    mock_host_controller_expect_diaddr_release();
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmod_direct_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmod_direct_ctx);
+}
+END_TEST
+
 START_TEST(test_core_read_register_timeout)
 {
     osd_result rv;
@@ -200,6 +480,202 @@ START_TEST(test_core_read_register_timeout)
 }
 END_TEST
 
+/**
+ * Access multiple registers in different modules in one batch
+ */
+START_TEST(test_core_reg_batch)
+{
+    osd_result rv;
+
+    uint16_t rd_val[2];
+    uint16_t wr_val = 0xbeef;
+    struct osd_hostmod_reg_op ops[] = {
+        { .type = OSD_HOSTMOD_REG_OP_READ, .diaddr = 1, .reg_addr = 0x0200,
+          .reg_size_bit = 16, .reg_val = &rd_val[0] },
+        { .type = OSD_HOSTMOD_REG_OP_WRITE, .diaddr = 2, .reg_addr = 0x0201,
+          .reg_size_bit = 16, .reg_val = &wr_val },
+        { .type = OSD_HOSTMOD_REG_OP_READ, .diaddr = 1, .reg_addr = 0x0202,
+          .reg_size_bit = 16, .reg_val = &rd_val[1] },
+    };
+
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0200,
+                                         0x1234);
+    mock_host_controller_expect_reg_write(mock_hostmod_diaddr, 2, 0x0201,
+                                          wr_val);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0202,
+                                         0x5678);
+
+    rv = osd_hostmod_reg_batch(hostmod_ctx, ops, 3, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        ck_assert_int_eq(ops[i].result, OSD_OK);
+    }
+    ck_assert_uint_eq(rd_val[0], 0x1234);
+    ck_assert_uint_eq(rd_val[1], 0x5678);
+}
+END_TEST
+
+/**
+ * A module not responding in a batch doesn't affect accesses to other modules
+ */
+START_TEST(test_core_reg_batch_timeout)
+{
+    osd_result rv;
+
+    uint16_t rd_val[3];
+    struct osd_hostmod_reg_op ops[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        ops[i] = (struct osd_hostmod_reg_op){
+            .type = OSD_HOSTMOD_REG_OP_READ,
+            .diaddr = 1 + i,
+            .reg_addr = 0x0200,
+            .reg_size_bit = 16,
+            .reg_val = &rd_val[i],
+        };
+    }
+
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0200,
+                                         0x1111);
+    mock_host_controller_expect_reg_read_noresp(mock_hostmod_diaddr, 2,
+                                                0x0200);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 3, 0x0200,
+                                         0x3333);
+
+    rv = osd_hostmod_reg_batch(hostmod_ctx, ops, 3, 0);
+    ck_assert_int_eq(rv, OSD_ERROR_TIMEDOUT);
+
+    ck_assert_int_eq(ops[0].result, OSD_OK);
+    ck_assert_uint_eq(rd_val[0], 0x1111);
+    ck_assert_int_eq(ops[1].result, OSD_ERROR_TIMEDOUT);
+    ck_assert_int_eq(ops[2].result, OSD_OK);
+    ck_assert_uint_eq(rd_val[2], 0x3333);
+}
+END_TEST
+
+/**
+ * Completion state of the asynchronous register accesses in
+ * test_core_reg_submit
+ */
+struct reg_submit_state {
+    unsigned int done_cnt;
+    uint64_t req_ids[2];
+};
+
+static void reg_submit_cb(void *cb_arg, uint64_t req_id,
+                          struct osd_hostmod_reg_op *op)
+{
+    struct reg_submit_state *state = cb_arg;
+    unsigned int i = op->diaddr - 1;
+    state->req_ids[i] = req_id;
+    __atomic_add_fetch(&state->done_cnt, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Asynchronous register accesses to two modules
+ */
+START_TEST(test_core_reg_submit)
+{
+    osd_result rv;
+
+    struct reg_submit_state state = { 0 };
+    uint16_t rd_val[2];
+    uint64_t req_ids[2];
+    struct osd_hostmod_reg_op ops[2];
+    for (unsigned int i = 0; i < 2; i++) {
+        ops[i] = (struct osd_hostmod_reg_op){
+            .type = OSD_HOSTMOD_REG_OP_READ,
+            .diaddr = 1 + i,
+            .reg_addr = 0x0200,
+            .reg_size_bit = 16,
+            .reg_val = &rd_val[i],
+        };
+    }
+
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0200,
+                                         0x1111);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 2, 0x0200,
+                                         0x2222);
+
+    for (unsigned int i = 0; i < 2; i++) {
+        rv = osd_hostmod_reg_submit(hostmod_ctx, &ops[i], 0, reg_submit_cb,
+                                    &state, &req_ids[i]);
+        ck_assert_int_eq(rv, OSD_OK);
+    }
+    ck_assert(req_ids[0] != req_ids[1]);
+
+    for (unsigned int i = 0; i < 1000; i++) {
+        if (__atomic_load_n(&state.done_cnt, __ATOMIC_SEQ_CST) == 2) {
+            break;
+        }
+        zclock_sleep(1);
+    }
+    ck_assert_uint_eq(__atomic_load_n(&state.done_cnt, __ATOMIC_SEQ_CST), 2);
+
+    for (unsigned int i = 0; i < 2; i++) {
+        ck_assert_int_eq(ops[i].result, OSD_OK);
+        ck_assert(state.req_ids[i] == req_ids[i]);
+    }
+    ck_assert_uint_eq(rd_val[0], 0x1111);
+    ck_assert_uint_eq(rd_val[1], 0x2222);
+}
+END_TEST
+
+/**
+ * test_core_reg_read_concurrent
+ */
+struct reg_read_thread_state {
+    osd_result rv;
+    uint16_t rd_val;
+    /** Set when the register read returned */
+    int done;
+};
+
+static void *reg_read_thread(void *arg)
+{
+    struct reg_read_thread_state *state = arg;
+    state->rv = osd_hostmod_reg_read(hostmod_ctx, &state->rd_val, 1, 0x0200,
+                                     16, 0);
+    __atomic_store_n(&state->done, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+/**
+ * Register reads from two threads at the same time
+ *
+ * A second thread waits for the response of a module which never answers,
+ * while the main thread reads a register of another module.
+ */
+START_TEST(test_core_reg_read_concurrent)
+{
+    osd_result rv;
+    int pthread_rv;
+
+    struct reg_read_thread_state state = { 0 };
+
+    mock_host_controller_expect_reg_read_noresp(mock_hostmod_diaddr, 1,
+                                                0x0200);
+
+    pthread_t thread;
+    pthread_rv = pthread_create(&thread, NULL, reg_read_thread, &state);
+    ck_assert_int_eq(pthread_rv, 0);
+    mock_host_controller_wait_for_requests();
+
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 2, 0x0200,
+                                         0x2222);
+
+    uint16_t rd_val;
+    rv = osd_hostmod_reg_read(hostmod_ctx, &rd_val, 2, 0x0200, 16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(rd_val, 0x2222);
+    ck_assert_int_eq(__atomic_load_n(&state.done, __ATOMIC_SEQ_CST), 0);
+
+    pthread_rv = pthread_join(thread, NULL);
+    ck_assert_int_eq(pthread_rv, 0);
+    ck_assert_int_eq(state.rv, OSD_ERROR_TIMEDOUT);
+}
+END_TEST
+
 START_TEST(test_core_event_send)
 {
     osd_result rv;
@@ -242,6 +718,92 @@ START_TEST(test_core_event_receive)
 }
 END_TEST
 
+START_TEST(test_core_event_receive_other)
+{
+    osd_result rv;
+
+    // packets of other types than EVENT and REG are received like events
+    struct osd_packet *pkg;
+    osd_packet_new(&pkg, osd_packet_sizeconv_payload2data(1));
+    osd_packet_set_header(pkg, 1, mock_hostmod_diaddr, OSD_PACKET_TYPE_RES1,
+                          0);
+    pkg->data.payload[0] = 0xbeef;
+
+    mock_host_controller_queue_data_packet(pkg);
+
+    struct osd_packet *rcv_pkg;
+    rv = osd_hostmod_event_receive(hostmod_ctx, &rcv_pkg, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    ck_assert(osd_packet_equal(pkg, rcv_pkg));
+
+    osd_packet_free(&pkg);
+    osd_packet_free(&rcv_pkg);
+}
+END_TEST
+
+START_TEST(test_core_event_receive_malformed)
+{
+    osd_result rv;
+
+    // an odd number of bytes, and a packet without a complete header
+    const uint8_t odd_data[3] = { 0x01, 0x02, 0x03 };
+    mock_host_controller_queue_data_raw(odd_data, sizeof(odd_data));
+    const uint16_t short_data[2] = { mock_hostmod_diaddr, 1 };
+    mock_host_controller_queue_data_raw(short_data, sizeof(short_data));
+
+    // both are dropped, the following event is received
+    struct osd_packet *event_pkg;
+    osd_packet_new(&event_pkg, osd_packet_sizeconv_payload2data(1));
+    osd_packet_set_header(event_pkg, 1, mock_hostmod_diaddr,
+                          OSD_PACKET_TYPE_EVENT, EV_LAST);
+    event_pkg->data.payload[0] = 0xbeef;
+    mock_host_controller_queue_data_packet(event_pkg);
+
+    struct osd_packet *rcv_event_pkg;
+    rv = osd_hostmod_event_receive(hostmod_ctx, &rcv_event_pkg, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert(osd_packet_equal(event_pkg, rcv_event_pkg));
+
+    osd_packet_free(&event_pkg);
+    osd_packet_free(&rcv_event_pkg);
+}
+END_TEST
+
+START_TEST(test_core_event_subscribe)
+{
+    osd_result rv;
+
+    mock_host_controller_expect_mgmt_req("EVENT_SUBSCRIBE 4096", "ACK");
+    rv = osd_hostmod_event_subscribe(hostmod_ctx, 4096);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // the host controller rejects the request
+    mock_host_controller_expect_mgmt_req("EVENT_UNSUBSCRIBE 4097", "NACK");
+    rv = osd_hostmod_event_unsubscribe(hostmod_ctx, 4097);
+    ck_assert_int_ne(rv, OSD_OK);
+}
+END_TEST
+
+START_TEST(test_core_event_subscribe_late_resp)
+{
+    osd_result rv;
+
+    // the response arrives after the request timed out
+    mock_host_controller_expect_mgmt_req_noresp("EVENT_SUBSCRIBE 4096");
+    rv = osd_hostmod_event_subscribe(hostmod_ctx, 4096);
+    ck_assert_int_eq(rv, OSD_ERROR_TIMEDOUT);
+
+    mock_host_controller_queue_mgmt_msg("ACK");
+    mock_host_controller_wait_for_event_tx();
+
+    // the late response is not taken as response to the next request
+    mock_host_controller_expect_mgmt_req("EVENT_SUBSCRIBE 4097", "NACK");
+    rv = osd_hostmod_event_subscribe(hostmod_ctx, 4097);
+    ck_assert_int_eq(rv, OSD_ERROR_FAILURE);
+}
+END_TEST
+
 START_TEST(test_core_event_receive_split_transaction)
 {
     osd_result rv;
@@ -358,6 +920,339 @@ START_TEST(test_core_event_receive_split_transaction_interleaved)
 }
 END_TEST
 
+/**
+ * Send multiple events with batching enabled: all events are transmitted in
+ * one batch data message.
+ */
+START_TEST(test_core_event_send_batch)
+{
+    osd_result rv;
+    struct osd_packet *event_pkgs[3];
+
+    struct osd_packet_batch_policy policy = {
+        .max_packets = 3,
+        .max_bytes = 0,
+        .max_delay_us = 1000 * 1000,
+    };
+    rv = osd_hostmod_set_batch_policy(hostmod_ctx, &policy);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], mock_hostmod_diaddr, 1,
+                              OSD_PACKET_TYPE_EVENT, 0);
+        event_pkgs[i]->data.payload[0] = i;
+    }
+
+    mock_host_controller_expect_batch_req(event_pkgs, 3);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        rv = osd_hostmod_event_send(hostmod_ctx, event_pkgs[i]);
+        ck_assert_int_eq(rv, OSD_OK);
+    }
+
+    mock_host_controller_wait_for_requests();
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
+/**
+ * Receive events from a batch data message
+ */
+START_TEST(test_core_event_receive_batch)
+{
+    osd_result rv;
+    struct osd_packet *event_pkgs[2];
+
+    for (unsigned int i = 0; i < 2; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], 1, mock_hostmod_diaddr,
+                              OSD_PACKET_TYPE_EVENT, EV_LAST);
+        event_pkgs[i]->data.payload[0] = 0xbee0 + i;
+    }
+
+    mock_host_controller_queue_batch(event_pkgs, 2);
+
+    for (unsigned int i = 0; i < 2; i++) {
+        struct osd_packet *rcv_event_pkg;
+        rv = osd_hostmod_event_receive(hostmod_ctx, &rcv_event_pkg, 0);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        ck_assert(osd_packet_equal(event_pkgs[i], rcv_event_pkg));
+        osd_packet_free(&rcv_event_pkg);
+    }
+
+    for (unsigned int i = 0; i < 2; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
+/**
+ * Events waiting in the event queue don't interfere with register reads, and
+ * overflowing events are dropped according to the overflow policy
+ */
+START_TEST(test_core_event_queue_overflow)
+{
+    osd_result rv;
+    struct osd_packet *event_pkgs[3];
+
+    osd_hostmod_set_event_queue_policy(hostmod_ctx, 2,
+                                       OSD_HOSTMOD_EVENT_OVERFLOW_DROP_OLDEST);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], 1, mock_hostmod_diaddr,
+                              OSD_PACKET_TYPE_EVENT, EV_LAST);
+        event_pkgs[i]->data.payload[0] = 0xbee0 + i;
+    }
+    mock_host_controller_queue_batch(event_pkgs, 3);
+    mock_host_controller_wait_for_event_tx();
+
+    // the register read response arrives after all events
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0000,
+                                         0x0001);
+    rv = osd_hostmod_reg_read(hostmod_ctx, &reg_read_result, 1, 0x0000, 16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(reg_read_result, 0x0001);
+
+    struct osd_hostmod_event_queue_stats stats;
+    osd_hostmod_get_event_queue_stats(hostmod_ctx, &stats);
+    ck_assert_uint_eq(stats.len, 2);
+    ck_assert_uint_eq(stats.len_max, 2);
+    ck_assert_uint_eq(stats.received, 3);
+    ck_assert_uint_eq(stats.dropped, 1);
+    ck_assert_uint_eq(stats.stalls, 0);
+
+    // the oldest event was dropped
+    for (unsigned int i = 1; i < 3; i++) {
+        struct osd_packet *rcv_event_pkg;
+        rv = osd_hostmod_event_receive(hostmod_ctx, &rcv_event_pkg, 0);
+        ck_assert_int_eq(rv, OSD_OK);
+
+        ck_assert(osd_packet_equal(event_pkgs[i], rcv_event_pkg));
+        osd_packet_free(&rcv_event_pkg);
+    }
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
+/**
+ * Partial events growing beyond the reassembly limit are discarded
+ */
+START_TEST(test_core_event_reassembly_limits)
+{
+    osd_result rv;
+    struct osd_packet *event_pkgs[4];
+    const unsigned int srcs[4] = { 1, 1, 1, 2 };
+    const unsigned int type_subs[4] = { EV_CONT, EV_CONT, EV_LAST, EV_LAST };
+
+    // no room for any payload
+    rv = osd_hostmod_set_event_reassembly_limits(
+        hostmod_ctx, osd_packet_sizeconv_payload2data(0) * sizeof(uint16_t),
+        1000);
+    ck_assert_int_eq(rv, OSD_ERROR_FAILURE);
+    rv = osd_hostmod_set_event_reassembly_limits(hostmod_ctx, 0, 1000);
+    ck_assert_int_eq(rv, OSD_ERROR_FAILURE);
+
+    // room for the header and one payload word
+    rv = osd_hostmod_set_event_reassembly_limits(
+        hostmod_ctx, osd_packet_sizeconv_payload2data(1) * sizeof(uint16_t),
+        1000);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    for (unsigned int i = 0; i < 4; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], srcs[i], mock_hostmod_diaddr,
+                              OSD_PACKET_TYPE_EVENT, type_subs[i]);
+        event_pkgs[i]->data.payload[0] = 0xbee0 + i;
+    }
+    mock_host_controller_queue_batch(event_pkgs, 4);
+    mock_host_controller_wait_for_event_tx();
+
+    // the register read response arrives after all events
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, 1, 0x0000,
+                                         0x0001);
+    rv = osd_hostmod_reg_read(hostmod_ctx, &reg_read_result, 1, 0x0000, 16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct osd_hostmod_event_reassembly_stats stats;
+    osd_hostmod_get_event_reassembly_stats(hostmod_ctx, &stats);
+    ck_assert_uint_eq(stats.completed, 0);
+    ck_assert_uint_eq(stats.overflowed, 1);
+    ck_assert_uint_eq(stats.timed_out, 0);
+    ck_assert_uint_eq(stats.partial_events, 0);
+    ck_assert_uint_eq(stats.partial_bytes, 0);
+
+    // only the single-packet event of source 2 is received
+    struct osd_packet *rcv_event_pkg;
+    rv = osd_hostmod_event_receive(hostmod_ctx, &rcv_event_pkg, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert(osd_packet_equal(event_pkgs[3], rcv_event_pkg));
+    osd_packet_free(&rcv_event_pkg);
+
+    for (unsigned int i = 0; i < 4; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
+static osd_result count_events_handler(void *arg, struct osd_packet *pkg)
+{
+    unsigned int *event_cnt = arg;
+
+    ck_assert_uint_eq(pkg->data.payload[0], 0xbee0 + *event_cnt);
+    (*event_cnt)++;
+
+    osd_packet_free(&pkg);
+    return OSD_OK;
+}
+
+/**
+ * Call the event handler in the event handler thread
+ */
+START_TEST(test_core_event_handler_thread)
+{
+    osd_result rv;
+    struct osd_hostmod_ctx *hostmod_thread_ctx;
+    unsigned int event_cnt = 0;
+
+    rv = osd_hostmod_new(&hostmod_thread_ctx, log_ctx, "inproc://testing",
+                         count_events_handler, &event_cnt);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct osd_hostmod_event_handler_stats stats;
+    rv = osd_hostmod_get_event_handler_stats(hostmod_thread_ctx, &stats);
+    ck_assert_int_eq(rv, OSD_ERROR_FAILURE);
+
+    rv = osd_hostmod_set_event_handler_thread(hostmod_thread_ctx, true);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr + 1);
+    rv = osd_hostmod_connect(hostmod_thread_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct osd_packet *event_pkgs[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], 1, mock_hostmod_diaddr + 1,
+                              OSD_PACKET_TYPE_EVENT, EV_LAST);
+        event_pkgs[i]->data.payload[0] = 0xbee0 + i;
+    }
+    mock_host_controller_queue_batch(event_pkgs, 3);
+    mock_host_controller_wait_for_event_tx();
+
+    // the register read response arrives after all events
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr + 1, 1, 0x0000,
+                                         0x0001);
+    rv = osd_hostmod_reg_read(hostmod_thread_ctx, &reg_read_result, 1, 0x0000,
+                              16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    osd_hostmod_event_handler_flush(hostmod_thread_ctx);
+    ck_assert_uint_eq(event_cnt, 3);
+
+    rv = osd_hostmod_get_event_handler_stats(hostmod_thread_ctx, &stats);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(stats.events, 3);
+    ck_assert_uint_eq(stats.queue_fill_bytes, 0);
+    ck_assert_uint_gt(stats.queue_fill_max_bytes, 0);
+    ck_assert_uint_eq(stats.queue_stalls, 0);
+    ck_assert_uint_ge(stats.handler_time_total_ns, stats.handler_time_max_ns);
+
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmod_thread_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmod_thread_ctx);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
+struct event_batch_cnt {
+    unsigned int event_cnt;
+    unsigned int call_cnt;
+};
+
+static osd_result count_event_batches_handler(
+    void *arg, const struct osd_packet_view *pkgs, size_t pkg_cnt)
+{
+    struct event_batch_cnt *cnt = arg;
+
+    for (size_t i = 0; i < pkg_cnt; i++) {
+        ck_assert_uint_eq(osd_packet_view_get_payload(&pkgs[i])[0],
+                          0xbee0 + cnt->event_cnt);
+        cnt->event_cnt++;
+    }
+    cnt->call_cnt++;
+
+    return OSD_OK;
+}
+
+/**
+ * All events received in one batch message are passed to the batch event
+ * handler at once
+ */
+START_TEST(test_core_event_batch_handler)
+{
+    osd_result rv;
+    struct osd_hostmod_ctx *hostmod_batch_ctx;
+    struct event_batch_cnt cnt = { 0 };
+
+    rv = osd_hostmod_new(&hostmod_batch_ctx, log_ctx, "inproc://testing",
+                         NULL, NULL);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    osd_hostmod_set_event_batch_handler(hostmod_batch_ctx,
+                                        count_event_batches_handler, &cnt);
+
+    mock_host_controller_expect_diaddr_req(mock_hostmod_diaddr + 1);
+    rv = osd_hostmod_connect(hostmod_batch_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    struct osd_packet *event_pkgs[3];
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_new(&event_pkgs[i], osd_packet_sizeconv_payload2data(1));
+        osd_packet_set_header(event_pkgs[i], 1, mock_hostmod_diaddr + 1,
+                              OSD_PACKET_TYPE_EVENT, EV_LAST);
+        event_pkgs[i]->data.payload[0] = 0xbee0 + i;
+    }
+    mock_host_controller_queue_batch(event_pkgs, 3);
+    mock_host_controller_wait_for_event_tx();
+
+    // the register read response arrives after all events
+    uint16_t reg_read_result;
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr + 1, 1, 0x0000,
+                                         0x0001);
+    rv = osd_hostmod_reg_read(hostmod_batch_ctx, &reg_read_result, 1, 0x0000,
+                              16, 0);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    ck_assert_uint_eq(cnt.event_cnt, 3);
+    ck_assert_uint_eq(cnt.call_cnt, 1);
+
+    mock_host_controller_expect_diaddr_release();
+    rv = osd_hostmod_disconnect(hostmod_batch_ctx);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_hostmod_free(&hostmod_batch_ctx);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        osd_packet_free(&event_pkgs[i]);
+    }
+}
+END_TEST
+
 START_TEST(test_layer2_mod_describe)
 {
     osd_result rv;
@@ -381,6 +1276,48 @@ START_TEST(test_layer2_mod_describe)
 }
 END_TEST
 
+/**
+ * Module descriptions are read from the device only once
+ */
+START_TEST(test_layer2_mod_describe_cached)
+{
+    osd_result rv;
+
+    struct osd_hostmod_reg_cache_stats stats;
+    struct osd_module_desc desc;
+
+    // first description: read from the device
+    mock_host_controller_expect_mod_describe(mock_hostmod_diaddr, 1,
+                                             0xbeef, 0xdead, 0xaddf);
+    rv = osd_hostmod_mod_describe(hostmod_ctx, 1, &desc);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // second description: answered from the cache
+    rv = osd_hostmod_mod_describe(hostmod_ctx, 1, &desc);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(desc.vendor, 0xbeef);
+    ck_assert_uint_eq(desc.type, 0xdead);
+    ck_assert_uint_eq(desc.version, 0xaddf);
+
+    osd_hostmod_reg_cache_get_stats(hostmod_ctx, &stats);
+    ck_assert_uint_eq(stats.misses, 3);
+    ck_assert_uint_eq(stats.hits, 3);
+    ck_assert_uint_eq(stats.entries, 3);
+
+    // after invalidation: read from the device again
+    osd_hostmod_reg_cache_invalidate(hostmod_ctx);
+    mock_host_controller_expect_mod_describe(mock_hostmod_diaddr, 1,
+                                             0xbeef, 0xdead, 0x0001);
+    rv = osd_hostmod_mod_describe(hostmod_ctx, 1, &desc);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(desc.version, 0x0001);
+
+    osd_hostmod_reg_cache_get_stats(hostmod_ctx, &stats);
+    ck_assert_uint_eq(stats.misses, 6);
+    ck_assert_uint_eq(stats.hits, 3);
+}
+END_TEST
+
 START_TEST(test_layer2_mod_event_active)
 {
     osd_result rv;
@@ -452,6 +1389,81 @@ END_TEST
 /**
  * Test the debug module enumeration handled by osd_hostmod_get_modules()
  */
+/**
+ * Enumerate the subnet from a topology cache file
+ */
+START_TEST(test_layer2_topology_cache)
+{
+    osd_result rv;
+    struct osd_module_desc *modules;
+    size_t modules_len;
+
+    unsigned int scm_diaddr = osd_diaddr_build(0, 0);
+
+    char cache_filename[] = "/tmp/osd-topology-cache-XXXXXX";
+    int fd = mkstemp(cache_filename);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+
+    // enumerate the subnet on the device
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_NUM_MOD, 2);
+    mock_host_controller_expect_mod_describe(mock_hostmod_diaddr, scm_diaddr,
+                                             OSD_MODULE_VENDOR_OSD,
+                                             OSD_MODULE_TYPE_STD_SCM, 0);
+    mock_host_controller_expect_mod_describe(mock_hostmod_diaddr,
+                                             scm_diaddr + 1,
+                                             OSD_MODULE_VENDOR_OSD,
+                                             OSD_MODULE_TYPE_STD_MAM, 0);
+    rv = osd_hostmod_get_modules(hostmod_ctx, 0, &modules, &modules_len);
+    ck_assert_int_eq(rv, OSD_OK);
+    free(modules);
+
+    // save: only the SCM registers not read so far are read
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_VENDOR_ID, 0x42);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_DEVICE_ID, 0x43);
+    rv = osd_hostmod_topology_cache_save(hostmod_ctx, 0, cache_filename);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // load into an empty cache after validating the device
+    osd_hostmod_reg_cache_invalidate(hostmod_ctx);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_VENDOR_ID, 0x42);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_DEVICE_ID, 0x43);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_NUM_MOD, 2);
+    rv = osd_hostmod_topology_cache_load(hostmod_ctx, 0, cache_filename);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // enumerate again without any device access
+    rv = osd_hostmod_get_modules(hostmod_ctx, 0, &modules, &modules_len);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_uint_eq(modules_len, 2);
+    ck_assert_uint_eq(modules[1].type, OSD_MODULE_TYPE_STD_MAM);
+    free(modules);
+
+    // a different device doesn't use the file
+    osd_hostmod_reg_cache_invalidate(hostmod_ctx);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_VENDOR_ID, 0x42);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_SYSTEM_DEVICE_ID, 0x44);
+    mock_host_controller_expect_reg_read(mock_hostmod_diaddr, scm_diaddr,
+                                         OSD_REG_SCM_NUM_MOD, 2);
+    rv = osd_hostmod_topology_cache_load(hostmod_ctx, 0, cache_filename);
+    ck_assert_int_eq(rv, OSD_ERROR_FILE);
+
+    struct osd_hostmod_reg_cache_stats stats;
+    osd_hostmod_reg_cache_get_stats(hostmod_ctx, &stats);
+    ck_assert_uint_eq(stats.entries, 0);
+
+    unlink(cache_filename);
+}
+END_TEST
+
 START_TEST(test_layer2_get_modules_partial)
 {
     osd_result rv;
@@ -471,10 +1483,17 @@ START_TEST(test_layer2_get_modules_partial)
                                              OSD_MODULE_VENDOR_OSD,
                                              OSD_MODULE_TYPE_STD_SCM, 0);
 
-    // time out when reading the VENDOR register from module at address x.1
+    // module at address x.1 doesn't respond: all description register reads
+    // time out
     mock_host_controller_expect_reg_read_noresp(mock_hostmod_diaddr,
                                                 scm_diaddr + 1,
                                                 OSD_REG_BASE_MOD_VENDOR);
+    mock_host_controller_expect_reg_read_noresp(mock_hostmod_diaddr,
+                                                scm_diaddr + 1,
+                                                OSD_REG_BASE_MOD_TYPE);
+    mock_host_controller_expect_reg_read_noresp(mock_hostmod_diaddr,
+                                                scm_diaddr + 1,
+                                                OSD_REG_BASE_MOD_VERSION);
 
     mock_host_controller_expect_mod_describe(mock_hostmod_diaddr,
                                              scm_diaddr + 2,
@@ -509,6 +1528,9 @@ Suite *suite(void)
     tc_init = tcase_create("Init");
     tcase_add_test(tc_init, test_init_base);
     tcase_add_test(tc_init, test_init_hostctrl_unreachable);
+    tcase_add_test(tc_init, test_init_reactor);
+    tcase_add_test(tc_init, test_init_reactor_hostctrl_unreachable);
+    tcase_add_test(tc_init, test_init_reactor_blocked);
     suite_add_tcase(s, tc_init);
 
     // Core functionality
@@ -516,24 +1538,41 @@ Suite *suite(void)
     tcase_add_checked_fixture(tc_core, setup, teardown);
     tcase_add_test(tc_core, test_core_read_register);
     tcase_add_test(tc_core, test_core_read_register_timeout);
+    tcase_add_test(tc_core, test_core_reg_access_direct);
     tcase_add_test(tc_core, test_core_write_register);
     tcase_add_test(tc_core, test_core_reg_setbit);
+    tcase_add_test(tc_core, test_core_reg_batch);
+    tcase_add_test(tc_core, test_core_reg_batch_timeout);
+    tcase_add_test(tc_core, test_core_reg_submit);
+    tcase_add_test(tc_core, test_core_reg_read_concurrent);
 
     tcase_add_test(tc_core, test_core_event_send);
     tcase_add_test(tc_core, test_core_event_receive);
+    tcase_add_test(tc_core, test_core_event_receive_other);
+    tcase_add_test(tc_core, test_core_event_receive_malformed);
+    tcase_add_test(tc_core, test_core_event_subscribe);
+    tcase_add_test(tc_core, test_core_event_subscribe_late_resp);
     tcase_add_test(tc_core, test_core_event_receive_split_transaction);
     tcase_add_test(tc_core,
                    test_core_event_receive_split_transaction_interleaved);
+    tcase_add_test(tc_core, test_core_event_send_batch);
+    tcase_add_test(tc_core, test_core_event_receive_batch);
+    tcase_add_test(tc_core, test_core_event_queue_overflow);
+    tcase_add_test(tc_core, test_core_event_reassembly_limits);
+    tcase_add_test(tc_core, test_core_event_handler_thread);
+    tcase_add_test(tc_core, test_core_event_batch_handler);
     suite_add_tcase(s, tc_core);
 
     // Higher-layer functionality
     tc_layer2 = tcase_create("Layer2");
     tcase_add_checked_fixture(tc_layer2, setup, teardown);
     tcase_add_test(tc_layer2, test_layer2_mod_describe);
+    tcase_add_test(tc_layer2, test_layer2_mod_describe_cached);
     tcase_add_test(tc_layer2, test_layer2_mod_event_active);
     tcase_add_test(tc_layer2, test_layer2_mod_event_dest);
     tcase_add_test(tc_layer2, test_layer2_get_modules);
     tcase_add_test(tc_layer2, test_layer2_get_modules_partial);
+    tcase_add_test(tc_layer2, test_layer2_topology_cache);
     suite_add_tcase(s, tc_layer2);
 
     return s;
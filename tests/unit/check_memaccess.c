@@ -54,6 +54,7 @@ void setup_hostmod(void)
 void teardown_hostmod(void)
 {
     osd_result rv;
+    mock_host_controller_expect_diaddr_release();
     rv = osd_memaccess_disconnect(memaccess_ctx);
     ck_assert_int_eq(rv, OSD_OK);
 
@@ -204,7 +204,139 @@ START_TEST(test_packet_tostring)
                   "Got string:\n%s\nExpected string:\n%s", str, exp_str);
 
     free(str);
-    free(pkg);
+    osd_packet_free(&pkg);
+}
+END_TEST
+
+START_TEST(test_packet_view)
+{
+    osd_result rv;
+    uint16_t data[] = { 0x1ab, 0x157, 0x9400, 0xdead, 0xbeef };
+    zframe_t *frame = zframe_new(data, sizeof(data));
+    ck_assert_ptr_ne(frame, NULL);
+
+    struct osd_packet_view view;
+    rv = osd_packet_view_from_zframe(&view, frame);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // the view references the frame data
+    ck_assert_ptr_eq(view.data_raw, zframe_data(frame));
+    ck_assert_int_eq(view.data_size_words, 5);
+    ck_assert_uint_eq(osd_packet_view_sizeof(&view), sizeof(data));
+
+    ck_assert_int_eq(osd_packet_view_get_dest(&view), 0x1ab);
+    ck_assert_int_eq(osd_packet_view_get_src(&view), 0x157);
+    ck_assert_int_eq(osd_packet_view_get_type(&view), OSD_PACKET_TYPE_EVENT);
+    ck_assert_int_eq(osd_packet_view_get_type_sub(&view), 0x5);
+    ck_assert_int_eq(osd_packet_view_get_payload_words(&view), 2);
+    ck_assert_int_eq(osd_packet_view_get_payload(&view)[0], 0xdead);
+    ck_assert_int_eq(osd_packet_view_get_payload(&view)[1], 0xbeef);
+
+    // a copy is equal to a packet built from scratch
+    struct osd_packet *pkg, *exp_pkg;
+    rv = osd_packet_new_from_view(&pkg, &view);
+    ck_assert_int_eq(rv, OSD_OK);
+    rv = osd_packet_new(&exp_pkg, osd_packet_sizeconv_payload2data(2));
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_packet_set_header(exp_pkg, 0x1ab, 0x157, OSD_PACKET_TYPE_EVENT, 0x5);
+    exp_pkg->data.payload[0] = 0xdead;
+    exp_pkg->data.payload[1] = 0xbeef;
+    ck_assert(osd_packet_equal(pkg, exp_pkg));
+
+    osd_packet_free(&pkg);
+    osd_packet_free(&exp_pkg);
+    zframe_destroy(&frame);
+
+    // frames too short to hold a packet header are rejected
+    frame = zframe_new(data, 2 * sizeof(uint16_t));
+    rv = osd_packet_view_from_zframe(&view, frame);
+    ck_assert_int_eq(rv, OSD_ERROR_DEVICE_INVALID_DATA);
+    zframe_destroy(&frame);
+
+    // as are frames with an odd number of bytes
+    frame = zframe_new(data, sizeof(data) - 1);
+    rv = osd_packet_view_from_zframe(&view, frame);
+    ck_assert_int_eq(rv, OSD_ERROR_DEVICE_INVALID_DATA);
+    zframe_destroy(&frame);
+}
+END_TEST
+
+START_TEST(test_packet_pool)
+{
+    osd_result rv;
+    struct osd_packet_pool_stats stats_before, stats;
+    osd_packet_pool_get_stats(&stats_before);
+
+    if (stats_before.slots_total == 0) {
+        // packet pool disabled: all packets are allocated on the heap
+        return;
+    }
+
+    // a small packet is served from the pool
+    struct osd_packet *pkg;
+    rv = osd_packet_new(&pkg, osd_packet_sizeconv_payload2data(2));
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_packet_pool_get_stats(&stats);
+    ck_assert_uint_eq(stats.hits, stats_before.hits + 1);
+    ck_assert_uint_eq(stats.oversize, stats_before.oversize);
+
+    osd_packet_set_header(pkg, 0x1ab, 0x157, OSD_PACKET_TYPE_EVENT, 0x5);
+    pkg->data.payload[0] = 0xdead;
+    pkg->data.payload[1] = 0xbeef;
+
+    // growing the packet beyond a small slot moves it to a large slot,
+    // keeping its contents
+    rv = osd_packet_realloc(&pkg, stats.small_slot_words + 1);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_int_eq(pkg->data.dest, 0x1ab);
+    ck_assert_int_eq(pkg->data.payload[1], 0xbeef);
+    osd_packet_pool_get_stats(&stats);
+    ck_assert_uint_eq(stats.hits, stats_before.hits + 2);
+
+    // growing the packet beyond the slot size moves it to the heap, keeping
+    // its contents
+    rv = osd_packet_realloc(&pkg, stats.slot_words + 1);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_int_eq(pkg->data_size_words, stats.slot_words + 1);
+    ck_assert_int_eq(pkg->data.dest, 0x1ab);
+    ck_assert_int_eq(pkg->data.src, 0x157);
+    ck_assert_int_eq(pkg->data.flags, 0x9400);
+    ck_assert_int_eq(pkg->data.payload[0], 0xdead);
+    ck_assert_int_eq(pkg->data.payload[1], 0xbeef);
+    osd_packet_free(&pkg);
+
+    // a packet larger than a slot is allocated on the heap
+    rv = osd_packet_new(&pkg, stats.slot_words + 1);
+    ck_assert_int_eq(rv, OSD_OK);
+    osd_packet_pool_get_stats(&stats);
+    ck_assert_uint_eq(stats.oversize, stats_before.oversize + 1);
+    osd_packet_free(&pkg);
+
+    // freed slots are reused
+    struct osd_packet *pkg2;
+    rv = osd_packet_new(&pkg, osd_packet_sizeconv_payload2data(0));
+    ck_assert_int_eq(rv, OSD_OK);
+    struct osd_packet *pkg_first = pkg;
+    osd_packet_free(&pkg);
+    rv = osd_packet_new(&pkg2, osd_packet_sizeconv_payload2data(0));
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_ptr_eq(pkg2, pkg_first);
+    ck_assert_int_eq(pkg2->data.dest, 0);
+    osd_packet_free(&pkg2);
+
+    // single DI packets and events combined from multiple DI packets are
+    // all served from the pool
+    osd_packet_pool_get_stats(&stats_before);
+    for (unsigned int i = 0; i < 1000; i++) {
+        size_t data_words = i % 2 ? stats.small_slot_words : 4 * 8;
+        rv = osd_packet_new(&pkg, data_words);
+        ck_assert_int_eq(rv, OSD_OK);
+        osd_packet_free(&pkg);
+    }
+    osd_packet_pool_get_stats(&stats);
+    ck_assert_uint_eq(stats.hits, stats_before.hits + 1000);
+    ck_assert_uint_eq(stats.misses, stats_before.misses);
+    ck_assert_uint_eq(stats.oversize, stats_before.oversize);
 }
 END_TEST
 
@@ -234,6 +366,8 @@ Suite *suite(void)
     tcase_add_test(tc_core, test_packet_header_extractparts);
     tcase_add_test(tc_core, test_packet_equal);
     tcase_add_test(tc_core, test_packet_tostring);
+    tcase_add_test(tc_core, test_packet_pool);
+    tcase_add_test(tc_core, test_packet_view);
     suite_add_tcase(s, tc_core);
 
     return s;
@@ -0,0 +1,261 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_packet_ring"
+
+#include "testutil.h"
+
+#include "packet_ring.h"
+
+#include <poll.h>
+#include <pthread.h>
+
+/** Smallest possible ring capacity in words */
+#define TEST_RING_CAPACITY_WORDS (2 * (1 + UINT16_MAX))
+
+/** Number of packets exchanged in the threaded test */
+#define TEST_THREADED_PKG_CNT 100000
+
+/** Packet data buffer, large enough for the biggest packet */
+static uint16_t test_pkg_data[UINT16_MAX];
+
+/**
+ * Create a test packet with sequence number @p seq
+ */
+static struct osd_packet_view get_test_pkg(unsigned int seq,
+                                           uint16_t data_size_words)
+{
+    for (unsigned int w = 0; w < data_size_words; w++) {
+        test_pkg_data[w] = (seq + w) & 0xffff;
+    }
+    struct osd_packet_view pkg = {
+        .data_size_words = data_size_words,
+        .data_raw = test_pkg_data,
+    };
+    return pkg;
+}
+
+static void check_test_pkg(const struct osd_packet_view *pkg, unsigned int seq,
+                           uint16_t data_size_words)
+{
+    ck_assert_uint_eq(pkg->data_size_words, data_size_words);
+    for (unsigned int w = 0; w < data_size_words; w++) {
+        ck_assert_uint_eq(pkg->data_raw[w], (seq + w) & 0xffff);
+    }
+}
+
+START_TEST(test_packet_ring_basic)
+{
+    struct packet_ring *ring;
+    struct osd_packet_view pkgs[4];
+    struct packet_ring_stats stats;
+
+    packet_ring_new(&ring, TEST_RING_CAPACITY_WORDS);
+
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 4), 0);
+    ck_assert(packet_ring_consumer_sleep(ring));
+
+    for (unsigned int i = 0; i < 3; i++) {
+        struct osd_packet_view pkg = get_test_pkg(i, 3 + i);
+        packet_ring_push(ring, &pkg);
+    }
+
+    // the consumer was notified
+    struct pollfd pfd = { .fd = packet_ring_get_fd(ring), .events = POLLIN };
+    ck_assert_int_eq(poll(&pfd, 1, 0), 1);
+
+    packet_ring_get_stats(ring, &stats);
+    ck_assert_uint_eq(stats.capacity_bytes, TEST_RING_CAPACITY_WORDS * 2);
+    ck_assert_uint_eq(stats.fill_bytes, (4 + 5 + 6) * 2);
+
+    // peek without release, twice
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 2), 2);
+    check_test_pkg(&pkgs[1], 1, 4);
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 4), 3);
+    check_test_pkg(&pkgs[0], 0, 3);
+    check_test_pkg(&pkgs[2], 2, 5);
+    packet_ring_release(ring);
+
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 4), 0);
+    ck_assert(packet_ring_consumer_sleep(ring));
+    ck_assert_int_eq(poll(&pfd, 1, 0), 0);
+
+    packet_ring_get_stats(ring, &stats);
+    ck_assert_uint_eq(stats.fill_bytes, 0);
+    ck_assert_uint_eq(stats.fill_max_bytes, (4 + 5 + 6) * 2);
+    ck_assert_uint_eq(stats.producer_stalls, 0);
+
+    packet_ring_free(&ring);
+    ck_assert_ptr_eq(ring, NULL);
+}
+END_TEST
+
+/**
+ * Discarded packets are never returned, packets pushed afterwards are
+ */
+START_TEST(test_packet_ring_discard)
+{
+    struct packet_ring *ring;
+    struct osd_packet_view pkgs[4];
+    struct packet_ring_stats stats;
+
+    packet_ring_new(&ring, TEST_RING_CAPACITY_WORDS);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        struct osd_packet_view pkg = get_test_pkg(i, 3 + i);
+        packet_ring_push(ring, &pkg);
+    }
+    packet_ring_discard(ring);
+
+    packet_ring_get_stats(ring, &stats);
+    ck_assert_uint_eq(stats.fill_bytes, 0);
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 4), 0);
+
+    struct osd_packet_view pkg = get_test_pkg(10, 4);
+    packet_ring_push(ring, &pkg);
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 4), 1);
+    check_test_pkg(&pkgs[0], 10, 4);
+    packet_ring_release(ring);
+
+    packet_ring_free(&ring);
+}
+END_TEST
+
+/**
+ * Fill the ring with packets of the maximum size, which forces the records to
+ * wrap around
+ */
+START_TEST(test_packet_ring_wrap)
+{
+    struct packet_ring *ring;
+    struct osd_packet_view pkgs[2];
+    struct osd_packet_view pkg;
+
+    packet_ring_new(&ring, TEST_RING_CAPACITY_WORDS);
+
+    // a small packet shifts the following records
+    pkg = get_test_pkg(0, 3);
+    ck_assert(packet_ring_try_push(ring, &pkg));
+    pkg = get_test_pkg(1, UINT16_MAX);
+    ck_assert(packet_ring_try_push(ring, &pkg));
+    ck_assert(!packet_ring_try_push(ring, &pkg));
+
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 1), 1);
+    check_test_pkg(&pkgs[0], 0, 3);
+    packet_ring_release(ring);
+
+    // doesn't fit at the end of the ring, and not yet at the start
+    pkg = get_test_pkg(2, UINT16_MAX);
+    ck_assert(!packet_ring_try_push(ring, &pkg));
+
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 2), 1);
+    check_test_pkg(&pkgs[0], 1, UINT16_MAX);
+    packet_ring_release(ring);
+
+    for (unsigned int i = 2; i < 6; i++) {
+        pkg = get_test_pkg(i, UINT16_MAX);
+        ck_assert(packet_ring_try_push(ring, &pkg));
+        ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 2), 1);
+        check_test_pkg(&pkgs[0], i, UINT16_MAX);
+        packet_ring_release(ring);
+    }
+
+    packet_ring_free(&ring);
+}
+END_TEST
+
+static void *producer_thread_main(void *ring_void)
+{
+    struct packet_ring *ring = ring_void;
+
+    for (unsigned int i = 0; i < TEST_THREADED_PKG_CNT; i++) {
+        uint16_t data[3 + 16];
+        data[0] = i & 0xffff;
+        data[1] = i >> 16;
+        struct osd_packet_view pkg = {
+            .data_size_words = 3 + i % 16,
+            .data_raw = data,
+        };
+        packet_ring_push(ring, &pkg);
+    }
+    return NULL;
+}
+
+/**
+ * Exchange packets between two threads, with the consumer waiting for
+ * notifications like an event loop
+ */
+START_TEST(test_packet_ring_threaded)
+{
+    struct packet_ring *ring;
+    struct osd_packet_view pkgs[64];
+    pthread_t producer_thread;
+    int rv;
+
+    packet_ring_new(&ring, TEST_RING_CAPACITY_WORDS);
+
+    rv = pthread_create(&producer_thread, NULL, producer_thread_main, ring);
+    ck_assert_int_eq(rv, 0);
+
+    unsigned int seq = 0;
+    struct pollfd pfd = { .fd = packet_ring_get_fd(ring), .events = POLLIN };
+    while (seq < TEST_THREADED_PKG_CNT) {
+        rv = poll(&pfd, 1, 10 * 1000);
+        ck_assert_int_eq(rv, 1);
+
+        while (1) {
+            size_t pkg_cnt = packet_ring_peek(ring, pkgs, 64);
+            if (pkg_cnt == 0) {
+                if (packet_ring_consumer_sleep(ring)) {
+                    break;
+                }
+                continue;
+            }
+            for (size_t i = 0; i < pkg_cnt; i++) {
+                ck_assert_uint_eq(pkgs[i].data_size_words, 3 + seq % 16);
+                ck_assert_uint_eq(pkgs[i].data_raw[0], seq & 0xffff);
+                ck_assert_uint_eq(pkgs[i].data_raw[1], seq >> 16);
+                seq++;
+            }
+            packet_ring_release(ring);
+        }
+    }
+
+    rv = pthread_join(producer_thread, NULL);
+    ck_assert_int_eq(rv, 0);
+    ck_assert_uint_eq(packet_ring_peek(ring, pkgs, 64), 0);
+
+    packet_ring_free(&ring);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_packet_ring_basic);
+    tcase_add_test(tc_core, test_packet_ring_discard);
+    tcase_add_test(tc_core, test_packet_ring_wrap);
+    tcase_add_test(tc_core, test_packet_ring_threaded);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,372 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_packetcap"
+
+#include "testutil.h"
+
+#include <osd/osd.h>
+#include <osd/packet.h>
+#include <osd/packetcap.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TEST_PKG_CNT 100
+
+/** Source DI address of test packet @p i */
+#define TEST_PKG_SRC(i) ((i) % 10 == 0 ? 5 : 3)
+
+/** Timestamp of test packet @p i */
+#define TEST_PKG_TS(i) (1000 + (i) * 10)
+
+char capture_filename[] = "/tmp/osd-packetcap-XXXXXX";
+char index_filename[sizeof(capture_filename) + 4];
+
+struct osd_log_ctx *log_ctx;
+
+static void check_record(const struct osd_packetcap_record *rec,
+                         unsigned int i)
+{
+    ck_assert_uint_eq(rec->timestamp_ns, TEST_PKG_TS(i));
+    ck_assert_int_eq(rec->dir,
+                     i % 2 ? OSD_PACKETCAP_DIR_TX : OSD_PACKETCAP_DIR_RX);
+    ck_assert_uint_eq(osd_packet_view_get_src(&rec->pkg), TEST_PKG_SRC(i));
+    ck_assert_uint_eq(osd_packet_view_get_dest(&rec->pkg), 1);
+    ck_assert_uint_eq(osd_packet_view_get_payload_words(&rec->pkg), i % 4);
+    for (unsigned int w = 0; w < i % 4; w++) {
+        ck_assert_uint_eq(osd_packet_view_get_payload(&rec->pkg)[w], i + w);
+    }
+}
+
+/**
+ * Write a capture with TEST_PKG_CNT packets
+ */
+static void write_capture(void)
+{
+    osd_result rv;
+    struct osd_packetcap_writer *writer;
+
+    rv = osd_packetcap_writer_new(&writer, log_ctx, capture_filename, 8);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    for (unsigned int i = 0; i < TEST_PKG_CNT; i++) {
+        struct osd_packet *pkg;
+        rv = osd_packet_new(&pkg, osd_packet_sizeconv_payload2data(i % 4));
+        ck_assert_int_eq(rv, OSD_OK);
+        osd_packet_set_header(pkg, 1, TEST_PKG_SRC(i), OSD_PACKET_TYPE_EVENT,
+                              0);
+        for (unsigned int w = 0; w < i % 4; w++) {
+            pkg->data.payload[w] = i + w;
+        }
+
+        rv = osd_packetcap_write(
+            writer, pkg, i % 2 ? OSD_PACKETCAP_DIR_TX : OSD_PACKETCAP_DIR_RX,
+            TEST_PKG_TS(i));
+        ck_assert_int_eq(rv, OSD_OK);
+
+        osd_packet_free(&pkg);
+    }
+
+    rv = osd_packetcap_writer_close(&writer);
+    ck_assert_int_eq(rv, OSD_OK);
+    ck_assert_ptr_eq(writer, NULL);
+}
+
+void setup(void)
+{
+    log_ctx = testutil_get_log_ctx();
+
+    int fd = mkstemp(capture_filename);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+    snprintf(index_filename, sizeof(index_filename), "%s.idx",
+             capture_filename);
+
+    write_capture();
+}
+
+void teardown(void)
+{
+    unlink(capture_filename);
+    unlink(index_filename);
+    osd_log_free(&log_ctx);
+}
+
+START_TEST(test_packetcap_read)
+{
+    osd_result rv;
+    struct osd_packetcap_reader *reader;
+    struct osd_packetcap_record rec;
+
+    rv = osd_packetcap_reader_new(&reader, log_ctx, capture_filename);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    for (unsigned int i = 0; i < TEST_PKG_CNT; i++) {
+        rv = osd_packetcap_reader_next(reader, &rec);
+        ck_assert_int_eq(rv, OSD_OK);
+        check_record(&rec, i);
+    }
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_ERROR_EOF);
+
+    // read again from the start
+    osd_packetcap_reader_rewind(reader);
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_OK);
+    check_record(&rec, 0);
+
+    osd_packetcap_reader_free(&reader);
+    ck_assert_ptr_eq(reader, NULL);
+}
+END_TEST
+
+/**
+ * Seek and filter, using the index file or an index created by the reader
+ */
+static void check_seek_and_filter(void)
+{
+    osd_result rv;
+    struct osd_packetcap_reader *reader;
+    struct osd_packetcap_record rec;
+
+    rv = osd_packetcap_reader_new(&reader, log_ctx, capture_filename);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // seek to an exact timestamp
+    osd_packetcap_reader_seek_time(reader, TEST_PKG_TS(42));
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_OK);
+    check_record(&rec, 42);
+
+    // seek to a timestamp between two packets
+    osd_packetcap_reader_seek_time(reader, TEST_PKG_TS(57) + 1);
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_OK);
+    check_record(&rec, 58);
+
+    // seek past the end
+    osd_packetcap_reader_seek_time(reader, TEST_PKG_TS(TEST_PKG_CNT));
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_ERROR_EOF);
+
+    // only read packets from source 5
+    osd_packetcap_reader_rewind(reader);
+    osd_packetcap_reader_set_src_filter(reader, 5);
+    for (unsigned int i = 0; i < TEST_PKG_CNT; i += 10) {
+        rv = osd_packetcap_reader_next(reader, &rec);
+        ck_assert_int_eq(rv, OSD_OK);
+        check_record(&rec, i);
+    }
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_ERROR_EOF);
+
+    // filter in combination with seeking
+    osd_packetcap_reader_seek_time(reader, TEST_PKG_TS(31));
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_OK);
+    check_record(&rec, 40);
+
+    // no packets from source 9 in the capture
+    osd_packetcap_reader_rewind(reader);
+    osd_packetcap_reader_set_src_filter(reader, 9);
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_ERROR_EOF);
+
+    // disable the filter again
+    osd_packetcap_reader_rewind(reader);
+    osd_packetcap_reader_set_src_filter(reader, OSD_PACKETCAP_SRC_ANY);
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_OK);
+    check_record(&rec, 0);
+
+    osd_packetcap_reader_free(&reader);
+}
+
+START_TEST(test_packetcap_index)
+{
+    ck_assert_int_eq(access(index_filename, R_OK), 0);
+    check_seek_and_filter();
+}
+END_TEST
+
+START_TEST(test_packetcap_index_missing)
+{
+    ck_assert_int_eq(unlink(index_filename), 0);
+    check_seek_and_filter();
+}
+END_TEST
+
+/**
+ * Overwrite a 32 bit word in the index file
+ */
+static void index_file_write_u32(long offset, uint32_t value)
+{
+    FILE *fp = fopen(index_filename, "r+b");
+    ck_assert_ptr_ne(fp, NULL);
+    ck_assert_int_eq(fseek(fp, offset, SEEK_SET), 0);
+    ck_assert_uint_eq(fwrite(&value, sizeof(value), 1, fp), 1);
+    fclose(fp);
+}
+
+/**
+ * Read a 32 bit word from the index file
+ */
+static uint32_t index_file_read_u32(long offset)
+{
+    uint32_t value;
+    FILE *fp = fopen(index_filename, "rb");
+    ck_assert_ptr_ne(fp, NULL);
+    ck_assert_int_eq(fseek(fp, offset, SEEK_SET), 0);
+    ck_assert_uint_eq(fread(&value, sizeof(value), 1, fp), 1);
+    fclose(fp);
+    return value;
+}
+
+/**
+ * Offset of the block count in the index file (file header: 24 bytes, index
+ * header: 8 bytes capture size, 4 bytes interval)
+ */
+#define TEST_IDX_BLOCK_CNT_OFFSET (24 + 8 + 4)
+
+/**
+ * Offset of the block count of the first source (after the index header of 24
+ * bytes and 16 bytes per block; source header: 2 bytes address, 2 bytes
+ * reserved)
+ */
+#define TEST_IDX_SRC_BLOCK_CNT_OFFSET(block_cnt) (24 + 24 + (block_cnt)*16 + 4)
+
+/**
+ * An index with an impossible number of blocks is ignored
+ */
+START_TEST(test_packetcap_index_corrupt_block_cnt)
+{
+    index_file_write_u32(TEST_IDX_BLOCK_CNT_OFFSET, 0xffffffff);
+    check_seek_and_filter();
+}
+END_TEST
+
+/**
+ * An index with an impossible number of blocks of a source is ignored
+ */
+START_TEST(test_packetcap_index_corrupt_src_block_cnt)
+{
+    uint32_t block_cnt = index_file_read_u32(TEST_IDX_BLOCK_CNT_OFFSET);
+    index_file_write_u32(TEST_IDX_SRC_BLOCK_CNT_OFFSET(block_cnt),
+                         0xffffffff);
+    check_seek_and_filter();
+}
+END_TEST
+
+/**
+ * Offset of the first 32 bit word of the capture offset (@p field 0) or the
+ * first timestamp (@p field 8) of an index block
+ */
+#define TEST_IDX_BLOCK_OFFSET(block, field) (24 + 24 + (block)*16 + (field))
+
+/**
+ * An index with blocks which are not in order is ignored
+ */
+START_TEST(test_packetcap_index_corrupt_order)
+{
+    index_file_write_u32(TEST_IDX_BLOCK_OFFSET(1, 0), 0);
+    check_seek_and_filter();
+}
+END_TEST
+
+/**
+ * An index with timestamps which are not in order is ignored
+ */
+START_TEST(test_packetcap_index_corrupt_timestamp)
+{
+    index_file_write_u32(TEST_IDX_BLOCK_OFFSET(1, 8), 0);
+    check_seek_and_filter();
+}
+END_TEST
+
+/**
+ * A capture which was cut off (e.g. by a crash of the writer) can be read up
+ * to the last complete record.
+ */
+START_TEST(test_packetcap_truncated)
+{
+    osd_result rv;
+    struct osd_packetcap_reader *reader;
+    struct osd_packetcap_record rec;
+
+    FILE *fp = fopen(capture_filename, "r");
+    ck_assert_ptr_ne(fp, NULL);
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    ck_assert_int_eq(truncate(capture_filename, size - 4), 0);
+
+    rv = osd_packetcap_reader_new(&reader, log_ctx, capture_filename);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    // the index doesn't match the capture any more and is ignored
+    osd_packetcap_reader_set_src_filter(reader, 3);
+    osd_packetcap_reader_set_src_filter(reader, OSD_PACKETCAP_SRC_ANY);
+
+    for (unsigned int i = 0; i < TEST_PKG_CNT - 1; i++) {
+        rv = osd_packetcap_reader_next(reader, &rec);
+        ck_assert_int_eq(rv, OSD_OK);
+        check_record(&rec, i);
+    }
+    rv = osd_packetcap_reader_next(reader, &rec);
+    ck_assert_int_eq(rv, OSD_ERROR_DEVICE_INVALID_DATA);
+
+    osd_packetcap_reader_free(&reader);
+}
+END_TEST
+
+START_TEST(test_packetcap_invalid_file)
+{
+    osd_result rv;
+    struct osd_packetcap_reader *reader;
+
+    // the index file is no capture file
+    rv = osd_packetcap_reader_new(&reader, log_ctx, index_filename);
+    ck_assert_int_eq(rv, OSD_ERROR_DEVICE_INVALID_DATA);
+
+    rv = osd_packetcap_reader_new(&reader, log_ctx, "/nonexistent/capture");
+    ck_assert_int_eq(rv, OSD_ERROR_FILE);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+
+    tcase_add_test(tc_core, test_packetcap_read);
+    tcase_add_test(tc_core, test_packetcap_index);
+    tcase_add_test(tc_core, test_packetcap_index_missing);
+    tcase_add_test(tc_core, test_packetcap_index_corrupt_block_cnt);
+    tcase_add_test(tc_core, test_packetcap_index_corrupt_src_block_cnt);
+    tcase_add_test(tc_core, test_packetcap_index_corrupt_order);
+    tcase_add_test(tc_core, test_packetcap_index_corrupt_timestamp);
+    tcase_add_test(tc_core, test_packetcap_truncated);
+    tcase_add_test(tc_core, test_packetcap_invalid_file);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
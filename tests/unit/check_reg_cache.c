@@ -0,0 +1,165 @@
+/* Copyright 2018 The Open SoC Debug Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define TEST_SUITE_NAME "check_reg_cache"
+
+#include "testutil.h"
+
+#include "reg_cache.h"
+
+START_TEST(test_reg_cache_basic)
+{
+    struct reg_cache *cache;
+    struct reg_cache_stats stats;
+    uint16_t val16;
+    uint64_t val64;
+
+    reg_cache_new(&cache);
+
+    ck_assert(!reg_cache_lookup(cache, 1, 0x0200, 16, &val16));
+
+    val16 = 0x1234;
+    reg_cache_store(cache, 1, 0x0200, 16, &val16);
+    val64 = 0x1122334455667788;
+    reg_cache_store(cache, 2, 0x0200, 64, &val64);
+
+    val16 = 0;
+    ck_assert(reg_cache_lookup(cache, 1, 0x0200, 16, &val16));
+    ck_assert_uint_eq(val16, 0x1234);
+    val64 = 0;
+    ck_assert(reg_cache_lookup(cache, 2, 0x0200, 64, &val64));
+    ck_assert_uint_eq(val64, 0x1122334455667788);
+
+    // same register, different size
+    ck_assert(!reg_cache_lookup(cache, 2, 0x0200, 16, &val16));
+    // different register in the same module
+    ck_assert(!reg_cache_lookup(cache, 1, 0x0201, 16, &val16));
+
+    reg_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.hits, 2);
+    ck_assert_uint_eq(stats.misses, 3);
+    ck_assert_uint_eq(stats.entries, 2);
+
+    reg_cache_invalidate(cache);
+    ck_assert(!reg_cache_lookup(cache, 1, 0x0200, 16, &val16));
+    reg_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.entries, 0);
+
+    reg_cache_free(&cache);
+    ck_assert_ptr_eq(cache, NULL);
+}
+END_TEST
+
+START_TEST(test_reg_cache_many)
+{
+    struct reg_cache *cache;
+    struct reg_cache_stats stats;
+    uint16_t val;
+
+    reg_cache_new(&cache);
+
+    // enough registers to grow the table a couple of times
+    for (uint16_t diaddr = 0; diaddr < 100; diaddr++) {
+        for (uint16_t reg_addr = 0; reg_addr < 10; reg_addr++) {
+            val = diaddr ^ reg_addr;
+            reg_cache_store(cache, diaddr, reg_addr, 16, &val);
+        }
+    }
+    // replace an existing entry
+    val = 0xffff;
+    reg_cache_store(cache, 99, 9, 16, &val);
+
+    reg_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.entries, 1000);
+
+    for (uint16_t diaddr = 0; diaddr < 100; diaddr++) {
+        for (uint16_t reg_addr = 0; reg_addr < 10; reg_addr++) {
+            ck_assert(reg_cache_lookup(cache, diaddr, reg_addr, 16, &val));
+            if (diaddr == 99 && reg_addr == 9) {
+                ck_assert_uint_eq(val, 0xffff);
+            } else {
+                ck_assert_uint_eq(val, diaddr ^ reg_addr);
+            }
+        }
+    }
+
+    reg_cache_free(&cache);
+}
+END_TEST
+
+START_TEST(test_reg_cache_file)
+{
+    osd_result rv;
+    struct reg_cache *cache;
+    struct reg_cache_stats stats;
+    uint16_t val16;
+    uint64_t val64;
+
+    reg_cache_new(&cache);
+    val16 = 0x1234;
+    reg_cache_store(cache, 0x0001, 0x0200, 16, &val16);
+    val64 = 0x1122334455667788;
+    reg_cache_store(cache, 0x1002, 0x0280, 64, &val64);
+
+    FILE *f = tmpfile();
+    ck_assert_ptr_ne(f, NULL);
+    rv = reg_cache_write(cache, f);
+    ck_assert_int_eq(rv, OSD_OK);
+    reg_cache_free(&cache);
+
+    rewind(f);
+    reg_cache_new(&cache);
+    rv = reg_cache_read(cache, f);
+    ck_assert_int_eq(rv, OSD_OK);
+
+    reg_cache_get_stats(cache, &stats);
+    ck_assert_uint_eq(stats.entries, 2);
+    ck_assert(reg_cache_lookup(cache, 0x0001, 0x0200, 16, &val16));
+    ck_assert_uint_eq(val16, 0x1234);
+    ck_assert(reg_cache_lookup(cache, 0x1002, 0x0280, 64, &val64));
+    ck_assert_uint_eq(val64, 0x1122334455667788);
+    reg_cache_free(&cache);
+    fclose(f);
+
+    // malformed file: register value is missing a word
+    f = tmpfile();
+    ck_assert_ptr_ne(f, NULL);
+    fputs("1 200 20 1234\n", f);
+    rewind(f);
+    reg_cache_new(&cache);
+    rv = reg_cache_read(cache, f);
+    ck_assert_int_eq(rv, OSD_ERROR_FILE);
+    reg_cache_free(&cache);
+    fclose(f);
+}
+END_TEST
+
+Suite *suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create(TEST_SUITE_NAME);
+
+    /* Core test case */
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, test_reg_cache_basic);
+    tcase_add_test(tc_core, test_reg_cache_many);
+    tcase_add_test(tc_core, test_reg_cache_file);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -87,6 +87,7 @@ void teardown_hostmod()
     rv = osd_terminal_stop(terminal_ctx);
     ck_assert_int_eq(rv, OSD_OK);
 
+    mock_host_controller_expect_diaddr_release();
     rv = osd_terminal_disconnect(terminal_ctx);
     ck_assert_int_eq(rv, OSD_OK);
 
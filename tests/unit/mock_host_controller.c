@@ -222,6 +222,37 @@ static void queue_data_packet(zlist_t *list, const struct osd_packet *packet)
     ck_assert_int_eq(rv, 0);
 }
 
+static void queue_batch(zlist_t *list, struct osd_packet **pkgs,
+                        unsigned int pkg_cnt)
+{
+    int rv;
+
+    zmsg_t *msg = zmsg_new();
+    ck_assert_ptr_ne(msg, NULL);
+
+    rv = zmsg_addstr(msg, "B");
+    ck_assert_int_eq(rv, 0);
+
+    // a batch record has the memory layout of struct osd_packet
+    size_t batch_size = 0;
+    for (unsigned int i = 0; i < pkg_cnt; i++) {
+        batch_size += sizeof(uint16_t) + osd_packet_sizeof(pkgs[i]);
+    }
+    zframe_t *batch_frame = zframe_new(NULL, batch_size);
+    ck_assert_ptr_ne(batch_frame, NULL);
+    uint8_t *batch_data = zframe_data(batch_frame);
+    for (unsigned int i = 0; i < pkg_cnt; i++) {
+        size_t record_size = sizeof(uint16_t) + osd_packet_sizeof(pkgs[i]);
+        memcpy(batch_data, pkgs[i], record_size);
+        batch_data += record_size;
+    }
+    rv = zmsg_append(msg, &batch_frame);
+    ck_assert_int_eq(rv, 0);
+
+    rv = zlist_append(list, msg);
+    ck_assert_int_eq(rv, 0);
+}
+
 /**
  * Queue a "null packet"
  *
@@ -259,6 +290,41 @@ osd_result mock_host_controller_queue_data_packet(const struct osd_packet *pkg)
     return OSD_OK;
 }
 
+/**
+ * Queue a data message with arbitrary (possibly malformed) packet data to be
+ * sent by the host controller
+ *
+ * @see mock_host_controller_queue_data_packet()
+ */
+void mock_host_controller_queue_data_raw(const void *data, size_t size)
+{
+    int rv;
+
+    zmsg_t *msg = zmsg_new();
+    ck_assert_ptr_ne(msg, NULL);
+
+    rv = zmsg_addstr(msg, "D");
+    ck_assert_int_eq(rv, 0);
+    rv = zmsg_addmem(msg, data, size);
+    ck_assert_int_eq(rv, 0);
+
+    rv = zlist_append(mock_event_tx_list, msg);
+    ck_assert_int_eq(rv, 0);
+}
+
+/**
+ * Queue a batch of data packets to be sent by the host controller as one
+ * batch data message
+ *
+ * @see mock_host_controller_queue_data_packet()
+ */
+osd_result mock_host_controller_queue_batch(struct osd_packet **pkgs,
+                                            unsigned int pkg_cnt)
+{
+    queue_batch(mock_event_tx_list, pkgs, pkg_cnt);
+    return OSD_OK;
+}
+
 /**
  * Expect a management message with a given command and a given response
  */
@@ -307,6 +373,58 @@ void mock_host_controller_expect_data_req(const struct osd_packet *req,
     }
 }
 
+/**
+ * Expect a batch data message containing @p pkg_cnt packets to be received by
+ * the host controller
+ *
+ * No response is sent.
+ */
+void mock_host_controller_expect_batch_req(struct osd_packet **pkgs,
+                                           unsigned int pkg_cnt)
+{
+    queue_batch(mock_exp_req_list, pkgs, pkg_cnt);
+    queue_null_packet(mock_exp_resp_list);
+}
+
+/**
+ * Expect a management message with a given command, but do not respond to it
+ *
+ * @see mock_host_controller_queue_mgmt_msg()
+ */
+void mock_host_controller_expect_mgmt_req_noresp(const char *cmd)
+{
+    int rv;
+
+    zmsg_t *req_msg = zmsg_new();
+    ck_assert_ptr_ne(req_msg, NULL);
+    rv = zmsg_addstr(req_msg, "M");
+    ck_assert_int_eq(rv, 0);
+    rv = zmsg_addstr(req_msg, cmd);
+    ck_assert_int_eq(rv, 0);
+    rv = zlist_append(mock_exp_req_list, req_msg);
+    ck_assert_int_eq(rv, 0);
+
+    queue_null_packet(mock_exp_resp_list);
+}
+
+/**
+ * Queue a management message to be sent by the host controller without a
+ * request, e.g. a response arriving too late
+ */
+void mock_host_controller_queue_mgmt_msg(const char *resp)
+{
+    int rv;
+
+    zmsg_t *msg = zmsg_new();
+    ck_assert_ptr_ne(msg, NULL);
+    rv = zmsg_addstr(msg, "M");
+    ck_assert_int_eq(rv, 0);
+    rv = zmsg_addstr(msg, resp);
+    ck_assert_int_eq(rv, 0);
+    rv = zlist_append(mock_event_tx_list, msg);
+    ck_assert_int_eq(rv, 0);
+}
+
 /**
  * Expect a request for a DI address from the module
  */
@@ -317,6 +435,25 @@ void mock_host_controller_expect_diaddr_req(unsigned int diaddr)
     mock_host_controller_expect_mgmt_req("DIADDR_REQUEST", diaddr_str);
 }
 
+/**
+ * Expect a host module or gateway to ask for the routing thread serving
+ * @p subnet (the mock has only one routing thread)
+ */
+void mock_host_controller_expect_router_thread_req(unsigned int subnet)
+{
+    char req_str[30];
+    snprintf(req_str, 30, "ROUTER_THREAD %u", subnet);
+    mock_host_controller_expect_mgmt_req(req_str, "0");
+}
+
+/**
+ * Expect the module to release its DI address (when disconnecting)
+ */
+void mock_host_controller_expect_diaddr_release(void)
+{
+    mock_host_controller_expect_mgmt_req("DIADDR_RELEASE", "ACK");
+}
+
 /**
  * Add a 16 bit register read access to the mock
  *
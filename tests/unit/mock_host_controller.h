@@ -26,6 +26,9 @@ void mock_host_controller_setup(void);
 void mock_host_controller_teardown(void);
 
 osd_result mock_host_controller_queue_data_packet(const struct osd_packet *pkg);
+void mock_host_controller_queue_data_raw(const void *data, size_t size);
+osd_result mock_host_controller_queue_batch(struct osd_packet **pkgs,
+                                            unsigned int pkg_cnt);
 void mock_host_controller_expect_reg_write(unsigned int src,
                                            unsigned int dest,
                                            unsigned int reg_addr,
@@ -42,8 +45,14 @@ void mock_host_controller_expect_mod_describe(unsigned int src,
                                               uint16_t vendor, uint16_t type,
                                               uint16_t version);
 void mock_host_controller_expect_mgmt_req(const char* cmd, const char* resp);
+void mock_host_controller_expect_mgmt_req_noresp(const char *cmd);
+void mock_host_controller_queue_mgmt_msg(const char *resp);
 void mock_host_controller_expect_diaddr_req(unsigned int diaddr);
+void mock_host_controller_expect_diaddr_release(void);
+void mock_host_controller_expect_router_thread_req(unsigned int subnet);
 void mock_host_controller_expect_data_req(struct osd_packet *req, struct osd_packet *resp);
+void mock_host_controller_expect_batch_req(struct osd_packet **pkgs,
+                                           unsigned int pkg_cnt);
 void mock_host_controller_wait_for_event_tx(void);
 void mock_host_controller_wait_for_requests(void);
 #endif // MOCK_HOST_CONTROLLER_H
@@ -34,6 +34,7 @@ zlist_t *mock_exp_write_list;
 zlist_t *mock_exp_event_tx_list;
 zlist_t *mock_exp_event_rx_list;
 FILE *mock_exp_event_tx_fd;
+unsigned int mock_reg_cache_invalidate_cnt;
 
 struct mock_osd_hostmod_ctx *mock_hostmod_ctx;
 
@@ -55,6 +56,7 @@ void mock_hostmod_setup(void)
     mock_exp_event_tx_list = zlist_new();
     mock_exp_event_rx_list = zlist_new();
     mock_exp_event_tx_fd = NULL;
+    mock_reg_cache_invalidate_cnt = 0;
 
     mock_hostmod_ctx = calloc(1, sizeof(struct mock_osd_hostmod_ctx));
     mock_hostmod_ctx->is_connected = true;
@@ -325,6 +327,52 @@ osd_result osd_hostmod_reg_write(struct osd_hostmod_ctx *ctx,
     return retval;
 }
 
+/**
+ * Mock for osd_hostmod_reg_batch()
+ *
+ * Register accesses are checked against the expected register reads and
+ * writes one after the other. The first failed access ends the batch, all
+ * remaining accesses fail with the same error (and are not checked).
+ */
+osd_result osd_hostmod_reg_batch(struct osd_hostmod_ctx *ctx,
+                                 struct osd_hostmod_reg_op *ops, size_t op_cnt,
+                                 int flags)
+{
+    osd_result retval = OSD_OK;
+
+    for (size_t i = 0; i < op_cnt; i++) {
+        if (OSD_FAILED(retval)) {
+            ops[i].result = retval;
+            continue;
+        }
+
+        if (ops[i].type == OSD_HOSTMOD_REG_OP_READ) {
+            ops[i].result = osd_hostmod_reg_read(ctx, ops[i].reg_val,
+                                                 ops[i].diaddr,
+                                                 ops[i].reg_addr,
+                                                 ops[i].reg_size_bit, flags);
+        } else {
+            ops[i].result = osd_hostmod_reg_write(ctx, ops[i].reg_val,
+                                                  ops[i].diaddr,
+                                                  ops[i].reg_addr,
+                                                  ops[i].reg_size_bit, flags);
+        }
+        retval = ops[i].result;
+    }
+
+    return retval;
+}
+
+unsigned int mock_hostmod_get_reg_cache_invalidate_cnt(void)
+{
+    return mock_reg_cache_invalidate_cnt;
+}
+
+void osd_hostmod_reg_cache_invalidate(struct osd_hostmod_ctx *ctx)
+{
+    mock_reg_cache_invalidate_cnt++;
+}
+
 uint16_t osd_hostmod_get_diaddr(struct osd_hostmod_ctx *ctx)
 {
     return MOCK_HOSTMOD_DIADDR;
@@ -377,7 +425,7 @@ osd_result osd_hostmod_event_send(struct osd_hostmod_ctx *ctx,
     }
     ck_assert(is_equal);
 
-    free(exp_event_pkg);
+    osd_packet_free(&exp_event_pkg);
 
     return exp_retval;
 }
@@ -62,5 +62,6 @@ void mock_hostmod_expect_event_send_fromfile(const char* path);
 void mock_hostmod_expect_event_receive(struct osd_packet *event_pkg,
                                        osd_result retval);
 struct osd_hostmod_ctx* mock_hostmod_get_ctx();
+unsigned int mock_hostmod_get_reg_cache_invalidate_cnt(void);
 
 #endif // MOCK_HOSTMOD_H